@@ -43,6 +43,8 @@ THE SOFTWARE.
 
 #include <zebra.h>
 #include "if.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "babel_main.h"
 #include "babeld.h"
@@ -55,12 +57,25 @@ THE SOFTWARE.
 struct timeval resend_time = {0, 0};
 struct resend *to_resend = NULL;
 
+/* Index of to_resend by kind and prefix. */
+static struct hash *resends = NULL;
+
+static unsigned int
+resend_hash_key(void *arg)
+{
+    struct resend *resend = arg;
+
+    return jhash(resend->prefix, 16, (resend->kind << 8) | resend->plen);
+}
+
 static int
-resend_match(struct resend *resend,
-             int kind, const unsigned char *prefix, unsigned char plen)
+resend_hash_cmp(const void *arg1, const void *arg2)
 {
-    return (resend->kind == kind &&
-            resend->plen == plen && memcmp(resend->prefix, prefix, 16) == 0);
+    const struct resend *resend1 = arg1, *resend2 = arg2;
+
+    return (resend1->kind == resend2->kind &&
+            resend1->plen == resend2->plen &&
+            memcmp(resend1->prefix, resend2->prefix, 16) == 0);
 }
 
 /* This is called by neigh.c when a neighbour is flushed */
@@ -72,31 +87,24 @@ flush_resends(struct neighbour *neigh)
 }
 
 static struct resend *
-find_resend(int kind, const unsigned char *prefix, unsigned char plen,
-             struct resend **previous_return)
+find_resend(int kind, const unsigned char *prefix, unsigned char plen)
 {
-    struct resend *current, *previous;
+    struct resend key;
 
-    previous = NULL;
-    current = to_resend;
-    while(current) {
-        if(resend_match(current, kind, prefix, plen)) {
-            if(previous_return)
-                *previous_return = previous;
-            return current;
-        }
-        previous = current;
-        current = current->next;
-    }
+    if(resends == NULL)
+        return NULL;
+
+    key.kind = kind;
+    memcpy(key.prefix, prefix, 16);
+    key.plen = plen;
 
-    return NULL;
+    return hash_lookup(resends, &key);
 }
 
 struct resend *
-find_request(const unsigned char *prefix, unsigned char plen,
-             struct resend **previous_return)
+find_request(const unsigned char *prefix, unsigned char plen)
 {
-    return find_resend(RESEND_REQUEST, prefix, plen, previous_return);
+    return find_resend(RESEND_REQUEST, prefix, plen);
 }
 
 int
@@ -116,7 +124,7 @@ record_resend(int kind, const unsigned char *prefix, unsigned char plen,
     if(delay >= 0xFFFF)
         delay = 0xFFFF;
 
-    resend = find_resend(kind, prefix, plen, NULL);
+    resend = find_resend(kind, prefix, plen);
     if(resend) {
         if(resend->delay && delay)
             resend->delay = MIN(resend->delay, delay);
@@ -153,6 +161,9 @@ record_resend(int kind, const unsigned char *prefix, unsigned char plen,
         resend->time = babel_now;
         resend->next = to_resend;
         to_resend = resend;
+        if(resends == NULL)
+            resends = hash_create(resend_hash_key, resend_hash_cmp);
+        hash_get(resends, resend, hash_alloc_intern);
     }
 
     if(resend->delay) {
@@ -180,7 +191,7 @@ unsatisfied_request(const unsigned char *prefix, unsigned char plen,
 {
     struct resend *request;
 
-    request = find_request(prefix, plen, NULL);
+    request = find_request(prefix, plen);
     if(request == NULL || resend_expired(request))
         return 0;
 
@@ -199,7 +210,7 @@ request_redundant(struct interface *ifp,
 {
     struct resend *request;
 
-    request = find_request(prefix, plen, NULL);
+    request = find_request(prefix, plen);
     if(request == NULL || resend_expired(request))
         return 0;
 
@@ -227,9 +238,9 @@ satisfy_request(const unsigned char *prefix, unsigned char plen,
                 unsigned short seqno, const unsigned char *id,
                 struct interface *ifp)
 {
-    struct resend *request, *previous;
+    struct resend *request;
 
-    request = find_request(prefix, plen, &previous);
+    request = find_request(prefix, plen);
     if(request == NULL)
         return 0;
 
@@ -259,6 +270,7 @@ expire_resend()
     current = to_resend;
     while(current) {
         if(resend_expired(current)) {
+            hash_release(resends, current);
             if(previous == NULL) {
                 to_resend = current->next;
                 free(current);
@@ -57,8 +57,7 @@ struct resend {
 
 extern struct timeval resend_time;
 
-struct resend *find_request(const unsigned char *prefix, unsigned char plen,
-                            struct resend **previous_return);
+struct resend *find_request(const unsigned char *prefix, unsigned char plen);
 void flush_resends(struct neighbour *neigh);
 int record_resend(int kind, const unsigned char *prefix, unsigned char plen,
                    unsigned short seqno, const unsigned char *id,
@@ -39,6 +39,8 @@ THE SOFTWARE.
 
 #include <zebra.h>
 #include "if.h"
+#include "prefix.h"
+#include "table.h"
 
 #include "babeld.h"
 #include "util.h"
@@ -53,66 +55,69 @@ THE SOFTWARE.
 
 static void consider_route(struct babel_route *route);
 
-struct babel_route **routes = NULL;
-static int route_slots = 0, max_route_slots = 0;
+static struct route_table *routes = NULL;
+static int route_slots = 0;
 int kernel_metric = 0;
 int allow_duplicates = -1;
 int diversity_kind = DIVERSITY_NONE;
 int diversity_factor = 256;     /* in units of 1/256 */
 int keep_unfeasible = 0;
 
-/* We maintain a list of "slots", ordered by prefix.  Every slot
+/* We maintain a table of "slots", indexed by prefix.  Every slot
    contains a linked list of the routes to this prefix, with the
-   installed route, if any, at the head of the list. */
+   installed route, if any, at the head of the list.  The table is a
+   radix tree, so that slots are found and added in logarithmic time
+   and walked in a stable, prefix-ordered way. */
 
-static int
-route_compare(const unsigned char *prefix, unsigned char plen,
-               struct babel_route *route)
+static void
+route_slot_prefix(struct prefix_ipv6 *p,
+                  const unsigned char *prefix, unsigned char plen)
 {
-    int i = memcmp(prefix, route->src->prefix, 16);
-    if(i != 0)
-        return i;
-
-    if(plen < route->src->plen)
-        return -1;
-    else if(plen > route->src->plen)
-        return 1;
-    else
-        return 0;
+    memset(p, 0, sizeof(struct prefix_ipv6));
+    p->family = AF_INET6;
+    p->prefixlen = plen;
+    memcpy(&p->prefix, prefix, 16);
+    apply_mask_ipv6(p);
 }
 
-/* Performs binary search, returns -1 in case of failure.  In the latter
-   case, new_return is the place where to insert the new element. */
+/* Returns the slot for the given prefix, or NULL if there are no
+   routes to it. */
 
-static int
-find_route_slot(const unsigned char *prefix, unsigned char plen,
-                int *new_return)
+static struct route_node *
+find_route_slot(const unsigned char *prefix, unsigned char plen)
 {
-    int p, m, g, c;
+    struct prefix_ipv6 p;
+    struct route_node *rn;
 
-    if(route_slots < 1) {
-        if(new_return)
-            *new_return = 0;
-        return -1;
-    }
+    if(routes == NULL)
+        return NULL;
 
-    p = 0; g = route_slots - 1;
+    route_slot_prefix(&p, prefix, plen);
+    rn = route_node_lookup(routes, (struct prefix *)&p);
+    if(rn == NULL)
+        return NULL;
 
-    do {
-        m = (p + g) / 2;
-        c = route_compare(prefix, plen, routes[m]);
-        if(c == 0)
-            return m;
-        else if(c < 0)
-            g = m - 1;
-        else
-            p = m + 1;
-    } while(p <= g);
+    /* The slot is kept by the routes it holds. */
+    route_unlock_node(rn);
+    return rn;
+}
+
+/* Walks the slots.  Starts with rn == NULL, and holds a lock on the
+   returned slot until it is passed back in, so that routes may be
+   flushed from it in the meantime. */
+
+static struct route_node *
+route_slot_next(struct route_node *rn)
+{
+    if(rn == NULL)
+        rn = routes ? route_top(routes) : NULL;
+    else
+        rn = route_next(rn);
 
-    if(new_return)
-        *new_return = p;
+    while(rn && rn->info == NULL)
+        rn = route_next(rn);
 
-    return -1;
+    return rn;
 }
 
 struct babel_route *
@@ -120,12 +125,12 @@ find_route(const unsigned char *prefix, unsigned char plen,
            struct neighbour *neigh, const unsigned char *nexthop)
 {
     struct babel_route *route;
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
 
-    if(i < 0)
+    if(rn == NULL)
         return NULL;
 
-    route = routes[i];
+    route = rn->info;
 
     while(route) {
         if(route->neigh == neigh && memcmp(route->nexthop, nexthop, 16) == 0)
@@ -139,10 +144,15 @@ find_route(const unsigned char *prefix, unsigned char plen,
 struct babel_route *
 find_installed_route(const unsigned char *prefix, unsigned char plen)
 {
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
+    struct babel_route *route;
+
+    if(rn == NULL)
+        return NULL;
 
-    if(i >= 0 && routes[i]->installed)
-        return routes[i];
+    route = rn->info;
+    if(route->installed)
+        return route;
 
     return NULL;
 }
@@ -154,51 +164,31 @@ installed_routes_estimate(void)
     return route_slots;
 }
 
-static int
-resize_route_table(int new_slots)
-{
-    struct babel_route **new_routes;
-    assert(new_slots >= route_slots);
-
-    if(new_slots == 0) {
-        new_routes = NULL;
-        free(routes);
-    } else {
-        new_routes = realloc(routes, new_slots * sizeof(struct babel_route*));
-        if(new_routes == NULL)
-            return -1;
-    }
-
-    max_route_slots = new_slots;
-    routes = new_routes;
-    return 1;
-}
-
 /* Insert a route into the table.  If successful, retains the route.
    On failure, caller must free the route. */
 static struct babel_route *
 insert_route(struct babel_route *route)
 {
-    int i, n;
+    struct prefix_ipv6 p;
+    struct route_node *rn;
 
     assert(!route->installed);
 
-    i = find_route_slot(route->src->prefix, route->src->plen, &n);
+    if(routes == NULL)
+        routes = route_table_init();
 
-    if(i < 0) {
-        if(route_slots >= max_route_slots)
-            resize_route_table(max_route_slots < 1 ? 8 : 2 * max_route_slots);
-        if(route_slots >= max_route_slots)
-            return NULL;
+    route_slot_prefix(&p, route->src->prefix, route->src->plen);
+    rn = route_node_get(routes, (struct prefix *)&p);
+
+    if(rn->info == NULL) {
+        /* Keep the lock taken by route_node_get for the new slot. */
         route->next = NULL;
-        if(n < route_slots)
-            memmove(routes + n + 1, routes + n,
-                    (route_slots - n) * sizeof(struct babel_route*));
+        rn->info = route;
         route_slots++;
-        routes[n] = route;
     } else {
         struct babel_route *r;
-        r = routes[i];
+        route_unlock_node(rn);
+        r = rn->info;
         while(r->next)
             r = r->next;
         r->next = route;
@@ -211,7 +201,7 @@ insert_route(struct babel_route *route)
 void
 flush_route(struct babel_route *route)
 {
-    int i;
+    struct route_node *rn;
     struct source *src;
     unsigned oldmetric;
     int lost = 0;
@@ -224,28 +214,20 @@ flush_route(struct babel_route *route)
         lost = 1;
     }
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
-    assert(i >= 0 && i < route_slots);
+    rn = find_route_slot(route->src->prefix, route->src->plen);
+    assert(rn != NULL);
 
-    if(route == routes[i]) {
-        routes[i] = route->next;
+    if(route == rn->info) {
+        rn->info = route->next;
         route->next = NULL;
         free(route);
 
-        if(routes[i] == NULL) {
-            if(i < route_slots - 1)
-                memmove(routes + i, routes + i + 1,
-                        (route_slots - i - 1) * sizeof(struct babel_route*));
-            routes[route_slots - 1] = NULL;
+        if(rn->info == NULL) {
             route_slots--;
+            route_unlock_node(rn);
         }
-
-        if(route_slots == 0)
-            resize_route_table(0);
-        else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
-            resize_route_table(max_route_slots / 2);
     } else {
-        struct babel_route *r = routes[i];
+        struct babel_route *r = rn->info;
         while(r->next != route)
             r = r->next;
         r->next = route->next;
@@ -262,18 +244,16 @@ flush_route(struct babel_route *route)
 void
 flush_all_routes()
 {
-    int i;
+    struct route_node *rn;
 
-    /* Start from the end, to avoid shifting the table. */
-    i = route_slots - 1;
-    while(i >= 0) {
-        while(i < route_slots) {
-        /* Uninstall first, to avoid calling route_lost. */
-            if(routes[i]->installed)
-                uninstall_route(routes[0]);
-            flush_route(routes[i]);
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+        while(rn->info) {
+            struct babel_route *r = rn->info;
+            /* Uninstall first, to avoid calling route_lost. */
+            if(r->installed)
+                uninstall_route(r);
+            flush_route(r);
         }
-        i--;
     }
 
     check_sources_released();
@@ -282,12 +262,12 @@ flush_all_routes()
 void
 flush_neighbour_routes(struct neighbour *neigh)
 {
-    int i;
+    struct route_node *rn;
 
-    i = 0;
-    while(i < route_slots) {
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
         struct babel_route *r;
-        r = routes[i];
+    again:
+        r = rn->info;
         while(r) {
             if(r->neigh == neigh) {
                 flush_route(r);
@@ -295,21 +275,18 @@ flush_neighbour_routes(struct neighbour *neigh)
             }
             r = r->next;
         }
-        i++;
-    again:
-        ;
     }
 }
 
 void
 flush_interface_routes(struct interface *ifp, int v4only)
 {
-    int i;
+    struct route_node *rn;
 
-    i = 0;
-    while(i < route_slots) {
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
         struct babel_route *r;
-        r = routes[i];
+    again:
+        r = rn->info;
         while(r) {
             if(r->neigh->ifp == ifp &&
                (!v4only || v4mapped(r->nexthop))) {
@@ -318,9 +295,6 @@ flush_interface_routes(struct interface *ifp, int v4only)
             }
             r = r->next;
         }
-        i++;
-    again:
-        ;
     }
 }
 
@@ -328,10 +302,10 @@ flush_interface_routes(struct interface *ifp, int v4only)
 void
 for_all_routes(void (*f)(struct babel_route*, void*), void *closure)
 {
-    int i;
+    struct route_node *rn;
 
-    for(i = 0; i < route_slots; i++) {
-        struct babel_route *r = routes[i];
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+        struct babel_route *r = rn->info;
         while(r) {
             (*f)(r, closure);
             r = r->next;
@@ -342,11 +316,12 @@ for_all_routes(void (*f)(struct babel_route*, void*), void *closure)
 void
 for_all_installed_routes(void (*f)(struct babel_route*, void*), void *closure)
 {
-    int i;
+    struct route_node *rn;
 
-    for(i = 0; i < route_slots; i++) {
-        if(routes[i]->installed)
-            (*f)(routes[i], closure);
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+        struct babel_route *r = rn->info;
+        if(r->installed)
+            (*f)(r, closure);
     }
 }
 
@@ -359,25 +334,27 @@ metric_to_kernel(int metric)
 /* This is used to maintain the invariant that the installed route is at
    the head of the list. */
 static void
-move_installed_route(struct babel_route *route, int i)
+move_installed_route(struct babel_route *route, struct route_node *rn)
 {
-    assert(i >= 0 && i < route_slots);
+    assert(rn != NULL && rn->info != NULL);
     assert(route->installed);
 
-    if(route != routes[i]) {
-        struct babel_route *r = routes[i];
+    if(route != rn->info) {
+        struct babel_route *r = rn->info;
         while(r->next != route)
             r = r->next;
         r->next = route->next;
-        route->next = routes[i];
-        routes[i] = route;
+        route->next = rn->info;
+        rn->info = route;
     }
 }
 
 void
 install_route(struct babel_route *route)
 {
-    int i, rc;
+    struct route_node *rn;
+    struct babel_route *head;
+    int rc;
 
     if(route->installed)
         return;
@@ -386,10 +363,11 @@ install_route(struct babel_route *route)
         zlog_err("WARNING: installing unfeasible route "
                  "(this shouldn't happen).");
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
-    assert(i >= 0 && i < route_slots);
+    rn = find_route_slot(route->src->prefix, route->src->plen);
+    assert(rn != NULL);
 
-    if(routes[i] != route && routes[i]->installed) {
+    head = rn->info;
+    if(head != route && head->installed) {
         fprintf(stderr, "WARNING: attempting to install duplicate route "
                 "(this shouldn't happen).");
         return;
@@ -406,7 +384,7 @@ install_route(struct babel_route *route)
             return;
     }
     route->installed = 1;
-    move_installed_route(route, i);
+    move_installed_route(route, rn);
 
 }
 
@@ -461,8 +439,8 @@ switch_routes(struct babel_route *old, struct babel_route *new)
 
     old->installed = 0;
     new->installed = 1;
-    move_installed_route(new, find_route_slot(new->src->prefix, new->src->plen,
-                                              NULL));
+    move_installed_route(new, find_route_slot(new->src->prefix,
+                                              new->src->plen));
 }
 
 static void
@@ -587,12 +565,12 @@ find_best_route(const unsigned char *prefix, unsigned char plen, int feasible,
                 struct neighbour *exclude)
 {
     struct babel_route *route = NULL, *r = NULL;
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
 
-    if(i < 0)
+    if(rn == NULL)
         return NULL;
 
-    route = routes[i];
+    route = rn->info;
 
     r = route->next;
     while(r) {
@@ -638,10 +616,10 @@ update_neighbour_metric(struct neighbour *neigh, int changed)
 {
 
     if(changed) {
-        int i;
+        struct route_node *rn;
 
-        for(i = 0; i < route_slots; i++) {
-            struct babel_route *r = routes[i];
+        for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+            struct babel_route *r = rn->info;
             while(r) {
                 if(r->neigh == neigh)
                     update_route_metric(r);
@@ -654,10 +632,10 @@ update_neighbour_metric(struct neighbour *neigh, int changed)
 void
 update_interface_metric(struct interface *ifp)
 {
-    int i;
+    struct route_node *rn;
 
-    for(i = 0; i < route_slots; i++) {
-        struct babel_route *r = routes[i];
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+        struct babel_route *r = rn->info;
         while(r) {
             if(r->neigh->ifp == ifp)
                 update_route_metric(r);
@@ -862,10 +840,10 @@ consider_route(struct babel_route *route)
 void
 retract_neighbour_routes(struct neighbour *neigh)
 {
-    int i;
+    struct route_node *rn;
 
-    for(i = 0; i < route_slots; i++) {
-        struct babel_route *r = routes[i];
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+        struct babel_route *r = rn->info;
         while(r) {
             if(r->neigh == neigh) {
                 if(r->refmetric != INFINITY) {
@@ -877,7 +855,6 @@ retract_neighbour_routes(struct neighbour *neigh)
             }
             r = r->next;
         }
-        i++;
     }
 }
 
@@ -988,13 +965,13 @@ void
 expire_routes(void)
 {
     struct babel_route *r;
-    int i;
+    struct route_node *rn;
 
     debugf(BABEL_DEBUG_COMMON,"Expiring old routes.");
 
-    i = 0;
-    while(i < route_slots) {
-        r = routes[i];
+    for(rn = route_slot_next(NULL); rn; rn = route_slot_next(rn)) {
+    again:
+        r = rn->info;
         while(r) {
             /* Protect against clock being stepped. */
             if(r->time > babel_now.tv_sec || route_old(r)) {
@@ -1012,8 +989,5 @@ expire_routes(void)
             }
             r = r->next;
         }
-        i++;
-    again:
-        ;
     }
 }
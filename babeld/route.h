@@ -65,7 +65,6 @@ struct babel_route {
     struct babel_route *next;
 };
 
-extern struct babel_route **routes;
 extern int kernel_metric, allow_duplicates;
 extern int diversity_kind, diversity_factor;
 extern int keep_unfeasible;
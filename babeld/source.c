@@ -47,30 +47,46 @@ THE SOFTWARE.
 #include "source.h"
 #include "babel_interface.h"
 #include "route.h"
+#include "hash.h"
+#include "jhash.h"
 
-struct source *srcs = NULL;
+/* Sources, hashed by router-id and prefix. */
+static struct hash *srcs = NULL;
+
+static unsigned int
+source_hash_key(void *arg)
+{
+    struct source *src = arg;
+
+    return jhash(src->id, 8, jhash(src->prefix, 16, src->plen));
+}
+
+static int
+source_hash_cmp(const void *arg1, const void *arg2)
+{
+    const struct source *src1 = arg1, *src2 = arg2;
+
+    return src1->plen == src2->plen &&
+        memcmp(src1->id, src2->id, 8) == 0 &&
+        memcmp(src1->prefix, src2->prefix, 16) == 0;
+}
 
 struct source*
 find_source(const unsigned char *id, const unsigned char *p, unsigned char plen,
             int create, unsigned short seqno)
 {
-    struct source *src;
-
-    for(src = srcs; src; src = src->next) {
-        /* This should really be a hash table.  For now, check the
-           last byte first. */
-        if(src->id[7] != id[7])
-            continue;
-        if(memcmp(src->id, id, 8) != 0)
-            continue;
-        if(src->plen != plen)
-            continue;
-        if(memcmp(src->prefix, p, 16) == 0)
-            return src;
-    }
+    struct source key, *src;
 
-    if(!create)
-        return NULL;
+    if(srcs == NULL)
+        srcs = hash_create(source_hash_key, source_hash_cmp);
+
+    memcpy(key.id, id, 8);
+    memcpy(key.prefix, p, 16);
+    key.plen = plen;
+
+    src = hash_lookup(srcs, &key);
+    if(src != NULL || !create)
+        return src;
 
     src = malloc(sizeof(struct source));
     if(src == NULL) {
@@ -85,8 +101,7 @@ find_source(const unsigned char *id, const unsigned char *p, unsigned char plen,
     src->metric = INFINITY;
     src->time = babel_now.tv_sec;
     src->route_count = 0;
-    src->next = srcs;
-    srcs = src;
+    hash_get(srcs, src, hash_alloc_intern);
     return src;
 }
 
@@ -112,15 +127,7 @@ flush_source(struct source *src)
         /* The source is in use by a route. */
         return 0;
 
-    if(srcs == src) {
-        srcs = src->next;
-    } else {
-        struct source *previous = srcs;
-        while(previous->next != src)
-            previous = previous->next;
-        previous->next = src->next;
-    }
-
+    hash_release(srcs, src);
     free(src);
     return 1;
 }
@@ -145,36 +152,40 @@ update_source(struct source *src,
     src->time = babel_now.tv_sec;
 }
 
+static void
+expire_source(struct hash_backet *backet, void *arg)
+{
+    struct source *src = backet->data;
+
+    if(src->time > babel_now.tv_sec)
+        /* clock stepped */
+        src->time = babel_now.tv_sec;
+    if(src->time < babel_now.tv_sec - SOURCE_GC_TIME)
+        flush_source(src);
+}
+
 void
 expire_sources()
 {
-    struct source *src;
-
-    src = srcs;
-    while(src) {
-        if(src->time > babel_now.tv_sec)
-            /* clock stepped */
-            src->time = babel_now.tv_sec;
-        if(src->time < babel_now.tv_sec - SOURCE_GC_TIME) {
-            struct source *old = src;
-            src = src->next;
-            flush_source(old);
-            continue;
-        }
-        src = src->next;
-    }
+    if(srcs)
+        hash_iterate(srcs, expire_source, NULL);
+}
+
+static void
+check_source_released(struct hash_backet *backet, void *arg)
+{
+    struct source *src = backet->data;
+
+    if(src->route_count != 0)
+        fprintf(stderr, "Warning: source %s %s has refcount %d.\n",
+                format_eui64(src->id),
+                format_prefix(src->prefix, src->plen),
+                (int)src->route_count);
 }
 
 void
 check_sources_released(void)
 {
-    struct source *src;
-
-    for(src = srcs; src; src = src->next) {
-        if(src->route_count != 0)
-            fprintf(stderr, "Warning: source %s %s has refcount %d.\n",
-                    format_eui64(src->id),
-                    format_prefix(src->prefix, src->plen),
-                    (int)src->route_count);
-    }
+    if(srcs)
+        hash_iterate(srcs, check_source_released, NULL);
 }
@@ -152,6 +152,11 @@ bgp_advertise_unintern (struct hash *hash, struct bgp_advertise_attr *baa)
     }
 }
 
+/* Per-peer lists of adjacencies are kept per afi/safi of the table
+   the node is in.  */
+#define BGP_ADJ_PEER_LIST(A,L) \
+  ((A)->peer->L[bgp_node_table ((A)->rn)->afi][bgp_node_table ((A)->rn)->safi])
+
 /* BGP adjacency keeps minimal advertisement information.  */
 static void
 bgp_adj_out_free (struct bgp_adj_out *adj)
@@ -238,7 +243,9 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
       
       if (rn)
         {
+          adj->rn = rn;
           BGP_ADJ_OUT_ADD (rn, adj);
+          BGP_PEER_LIST_ADD (BGP_ADJ_PEER_LIST (adj, adj_out_list), adj);
           bgp_lock_node (rn);
         }
     }
@@ -306,6 +313,7 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
     {
       /* Remove myself from adjacency. */
       BGP_ADJ_OUT_DEL (rn, adj);
+      BGP_PEER_LIST_DEL (BGP_ADJ_PEER_LIST (adj, adj_out_list), adj);
       
       /* Free allocated information.  */
       bgp_adj_out_free (adj);
@@ -325,9 +333,155 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
     bgp_advertise_clean (peer, adj, afi, safi);
 
   BGP_ADJ_OUT_DEL (rn, adj);
+  BGP_PEER_LIST_DEL (BGP_ADJ_PEER_LIST (adj, adj_out_list), adj);
   bgp_adj_out_free (adj);
 }
 
+/* Number of adjacencies in, over all peers.  */
+static unsigned long bgp_adj_in_entries;
+
+unsigned long
+bgp_adj_in_count (void)
+{
+  return bgp_adj_in_entries;
+}
+
+static void
+bgp_adj_in_block_unlink (struct bgp_adj_in_block **head,
+                         struct bgp_adj_in_block *block)
+{
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    *head = block->next;
+  if (block->next)
+    block->next->prev = block->prev;
+  block->next = block->prev = NULL;
+}
+
+static void
+bgp_adj_in_block_push (struct bgp_adj_in_block **head,
+                       struct bgp_adj_in_block *block)
+{
+  block->next = *head;
+  if (block->next)
+    block->next->prev = block;
+  *head = block;
+}
+
+/* Adjacencies in are taken from blocks owned by their peer, one set of
+   blocks per afi/safi, which saves the allocator's overhead and the
+   peer pointer and list links on every one of them.  The peer lists the
+   blocks with free entries and the full ones.  A block goes back as
+   soon as none of its entries is used, except when it is the only one
+   with room left and there are full ones, so that a prefix coming and
+   going does not allocate and free a block every time.  */
+static struct bgp_adj_in *
+bgp_adj_in_alloc (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_block **room = &peer->adj_in_blocks[afi][safi];
+  struct bgp_adj_in_block *block;
+  struct bgp_adj_in *adj;
+  int i;
+
+  if (! (block = *room))
+    {
+      block = XCALLOC_ALIGNED (MTYPE_BGP_ADJ_IN_BLOCK, BGP_ADJ_IN_BLOCK_BYTES,
+                               BGP_ADJ_IN_BLOCK_BYTES);
+      block->peer = peer;
+      block->afi = afi;
+      block->safi = safi;
+      for (i = BGP_ADJ_IN_BLOCK_SIZE - 1; i >= 0; i--)
+        {
+          block->adj[i].next = block->free;
+          block->free = &block->adj[i];
+        }
+      bgp_adj_in_block_push (room, block);
+    }
+
+  adj = block->free;
+  block->free = adj->next;
+  adj->next = NULL;
+
+  if (++block->used == BGP_ADJ_IN_BLOCK_SIZE)
+    {
+      bgp_adj_in_block_unlink (room, block);
+      bgp_adj_in_block_push (&peer->adj_in_full[afi][safi], block);
+    }
+
+  bgp_adj_in_entries++;
+  return adj;
+}
+
+static void
+bgp_adj_in_free (struct bgp_adj_in *adj)
+{
+  struct bgp_adj_in_block *block = BGP_ADJ_IN_BLOCK (adj);
+  struct peer *peer = block->peer;
+  struct bgp_adj_in_block **room, **full, *empty;
+
+  room = &peer->adj_in_blocks[block->afi][block->safi];
+  full = &peer->adj_in_full[block->afi][block->safi];
+  adj->rn = NULL;
+  adj->attr = NULL;
+  adj->next = block->free;
+  block->free = adj;
+  bgp_adj_in_entries--;
+
+  /* A block that was full has room again, and the empty one kept for
+     when there was none is not needed any more.  */
+  if (block->used-- == BGP_ADJ_IN_BLOCK_SIZE)
+    {
+      bgp_adj_in_block_unlink (full, block);
+      if ((empty = *room) != NULL && empty->used == 0)
+        {
+          bgp_adj_in_block_unlink (room, empty);
+          XFREE (MTYPE_BGP_ADJ_IN_BLOCK, empty);
+        }
+      bgp_adj_in_block_push (room, block);
+      return;
+    }
+
+  if (block->used == 0 && (block->prev || block->next || ! *full))
+    {
+      bgp_adj_in_block_unlink (room, block);
+      XFREE (MTYPE_BGP_ADJ_IN_BLOCK, block);
+    }
+}
+
+/* Call func for each of the peer's adjacencies in of the afi/safi, in
+   no particular order, until it returns non-zero.  func may remove the
+   adjacency it is called for, but no other one.  */
+void
+bgp_adj_in_walk (struct peer *peer, afi_t afi, safi_t safi,
+                 int (*func) (struct bgp_adj_in *, void *), void *arg)
+{
+  struct bgp_adj_in_block *lists[2];
+  struct bgp_adj_in_block *block, *next;
+  unsigned int i, left;
+  int l;
+
+  /* A full block moves to the blocks with room as an entry of it is
+     removed, those are walked first so that it isn't walked twice.  */
+  lists[0] = peer->adj_in_blocks[afi][safi];
+  lists[1] = peer->adj_in_full[afi][safi];
+
+  for (l = 0; l < 2; l++)
+    for (block = lists[l]; block; block = next)
+      {
+        next = block->next;
+
+        /* The block is gone once its last entry is removed.  */
+        for (i = 0, left = block->used; left; i++)
+          if (block->adj[i].rn)
+            {
+              left--;
+              if ((*func) (&block->adj[i], arg))
+                return;
+            }
+      }
+}
+
 void
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 {
@@ -335,7 +489,7 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 
   for (adj = rn->adj_in; adj; adj = adj->next)
     {
-      if (adj->peer == peer)
+      if (BGP_ADJ_IN_PEER (adj) == peer)
 	{
 	  if (adj->attr != attr)
 	    {
@@ -345,20 +499,31 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 	  return;
 	}
     }
-  adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
-  adj->peer = peer_lock (peer); /* adj_in peer reference */
+  adj = bgp_adj_in_alloc (peer, bgp_node_table (rn)->afi,
+                          bgp_node_table (rn)->safi);
+  peer_lock (peer); /* adj_in peer reference */
   adj->attr = bgp_attr_intern (attr);
-  BGP_ADJ_IN_ADD (rn, adj);
+  adj->rn = rn;
+  adj->next = rn->adj_in;
+  rn->adj_in = adj;
   bgp_lock_node (rn);
 }
 
 void
 bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
+  struct bgp_adj_in **adjp;
+  struct peer *peer = BGP_ADJ_IN_PEER (bai);
+
   bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
-  peer_unlock (bai->peer); /* adj_in peer reference */
-  XFREE (MTYPE_BGP_ADJ_IN, bai);
+
+  /* There are no more entries on a node than there are peers.  */
+  for (adjp = &rn->adj_in; *adjp != bai; adjp = &(*adjp)->next)
+    ;
+  *adjp = bai->next;
+
+  bgp_adj_in_free (bai);
+  peer_unlock (peer); /* adj_in peer reference */
 }
 
 void
@@ -367,7 +532,7 @@ bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer)
   struct bgp_adj_in *adj;
 
   for (adj = rn->adj_in; adj; adj = adj->next)
-    if (adj->peer == peer)
+    if (BGP_ADJ_IN_PEER (adj) == peer)
       break;
 
   if (! adj)
@@ -66,6 +66,13 @@ struct bgp_adj_out
   /* Advertised peer.  */
   struct peer *peer;
 
+  /* Linked list of the peer's adjacencies, see peer->adj_out_list.  */
+  struct bgp_adj_out *peer_next;
+  struct bgp_adj_out *peer_prev;
+
+  /* Node this adjacency is on.  */
+  struct bgp_node *rn;
+
   /* Advertised attribute.  */
   struct attr *attr;
 
@@ -73,20 +80,52 @@ struct bgp_adj_out
   struct bgp_advertise *adv;
 };
 
-/* BGP adjacency in. */
+/* BGP adjacency in.  With soft-reconfiguration inbound there is one of
+   these per prefix per peer, so it is kept small: the per-node list is
+   singly linked, and entries are carved out of blocks of their peer,
+   which the peer and the block are found from, see BGP_ADJ_IN_BLOCK.  */
 struct bgp_adj_in
 {
   /* Linked list pointer.  */
   struct bgp_adj_in *next;
-  struct bgp_adj_in *prev;
 
-  /* Received peer.  */
-  struct peer *peer;
+  /* Node this adjacency is on, NULL while the entry is free.  */
+  struct bgp_node *rn;
 
   /* Received attribute.  */
   struct attr *attr;
 };
 
+/* Adjacencies in of a peer for an afi/safi, allocated at once.  Blocks
+   are aligned to their size.  */
+struct bgp_adj_in_block
+{
+  /* The peer's blocks of the afi/safi with free entries, or full.  */
+  struct bgp_adj_in_block *next;
+  struct bgp_adj_in_block *prev;
+
+  /* Received peer.  */
+  struct peer *peer;
+
+  /* Free entries, linked through their next pointer.  */
+  struct bgp_adj_in *free;
+  unsigned int used;
+  u_char afi;
+  u_char safi;
+
+  struct bgp_adj_in adj[];
+};
+
+#define BGP_ADJ_IN_BLOCK_BYTES 4096
+#define BGP_ADJ_IN_BLOCK_SIZE \
+  ((BGP_ADJ_IN_BLOCK_BYTES - sizeof (struct bgp_adj_in_block)) \
+   / sizeof (struct bgp_adj_in))
+
+#define BGP_ADJ_IN_BLOCK(A) \
+  ((struct bgp_adj_in_block *) \
+   ((uintptr_t) (A) & ~(uintptr_t) (BGP_ADJ_IN_BLOCK_BYTES - 1)))
+#define BGP_ADJ_IN_PEER(A) (BGP_ADJ_IN_BLOCK (A)->peer)
+
 /* BGP advertisement list.  */
 struct bgp_synchronize
 {
@@ -117,8 +156,26 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
-#define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
-#define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
+/* Per-peer list, headed at H and linked through peer_next/peer_prev.  */
+#define BGP_PEER_LIST_ADD(H,A)                        \
+  do {                                                \
+    (A)->peer_prev = NULL;                            \
+    (A)->peer_next = (H);                             \
+    if (H)                                            \
+      (H)->peer_prev = (A);                           \
+    (H) = (A);                                        \
+  } while (0)
+
+#define BGP_PEER_LIST_DEL(H,A)                        \
+  do {                                                \
+    if ((A)->peer_next)                               \
+      (A)->peer_next->peer_prev = (A)->peer_prev;     \
+    if ((A)->peer_prev)                               \
+      (A)->peer_prev->peer_next = (A)->peer_next;     \
+    else                                              \
+      (H) = (A)->peer_next;                           \
+  } while (0)
+
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
 #define BGP_ADJ_OUT_DEL(N,A)   BGP_INFO_DEL(N,A,adj_out)
 
@@ -135,6 +192,9 @@ extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *);
 extern void bgp_adj_in_unset (struct bgp_node *, struct peer *);
 extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern unsigned long bgp_adj_in_count (void);
+extern void bgp_adj_in_walk (struct peer *, afi_t, safi_t,
+                             int (*) (struct bgp_adj_in *, void *), void *);
 
 extern struct bgp_advertise *
 bgp_advertise_clean (struct peer *, struct bgp_adj_out *, afi_t, safi_t);
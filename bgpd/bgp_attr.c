@@ -38,6 +38,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_ecommunity.h"
+#ifdef ENABLE_OVSDB
+#include "bgpd/bgp_ovsdb_route.h"
+#endif
 
 /* Attribute strings for logging. */
 static const struct message attr_str [] = 
@@ -321,6 +324,9 @@ bgp_attr_dup (struct attr *new, struct attr *orig)
   struct attr_extra *extra = new->extra;
 
   *new = *orig;
+#ifdef ENABLE_OVSDB
+  new->ovsdb_path_attributes = NULL;
+#endif
   /* if caller provided attr_extra space, use it in any case.
    *
    * This is neccesary even if orig->extra equals NULL, because otherwise
@@ -492,6 +498,9 @@ bgp_attr_hash_alloc (void *p)
       *attr->extra = *val->extra;
     }
   attr->refcnt = 0;
+#ifdef ENABLE_OVSDB
+  attr->ovsdb_path_attributes = NULL;
+#endif
   return attr;
 }
 
@@ -693,6 +702,9 @@ bgp_attr_unintern (struct attr **pattr)
     {
       ret = hash_release (attrhash, attr);
       assert (ret != NULL);
+#ifdef ENABLE_OVSDB
+      bgp_ovsdb_attr_free (attr);
+#endif
       bgp_attr_extra_free (attr);
       XFREE (MTYPE_ATTR, attr);
       *pattr = NULL;
@@ -1788,11 +1800,150 @@ bgp_attr_check (struct peer *peer, struct attr *attr)
   return BGP_ATTR_PARSE_PROCEED;
 }
 
+/* Take the references on the sub-components of a copy of an interned
+   attribute which bgp_attr_parse would have, for the caller's
+   bgp_attr_unintern_sub.  */
+static void
+bgp_attr_lock_sub (struct attr *attr)
+{
+  if (attr->aspath)
+    attr->aspath->refcnt++;
+  if (attr->community)
+    attr->community->refcnt++;
+  if (attr->extra)
+    {
+      if (attr->extra->ecommunity)
+        attr->extra->ecommunity->refcnt++;
+      if (attr->extra->cluster)
+        attr->extra->cluster->refcnt++;
+      if (attr->extra->transit)
+        attr->extra->transit->refcnt++;
+    }
+}
+
+static struct attr *
+bgp_attr_cache_lookup (struct peer *peer, u_int32_t key,
+		       const u_char *data, bgp_size_t length)
+{
+  struct bgp_attr_cache_entry *entry;
+
+  if (! peer->attr_cache)
+    return NULL;
+
+  entry = &peer->attr_cache->entry[key % BGP_ATTR_CACHE_SIZE];
+  if (entry->attr
+      && entry->key == key
+      && entry->length == length
+      && memcmp (entry->data, data, length) == 0)
+    return entry->attr;
+  return NULL;
+}
+
+static void
+bgp_attr_cache_entry_free (struct bgp_attr_cache_entry *entry)
+{
+  if (entry->attr)
+    bgp_attr_unintern (&entry->attr);
+  if (entry->data)
+    XFREE (MTYPE_BGP_ATTR_CACHE, entry->data);
+  entry->attr = NULL;
+  entry->length = 0;
+}
+
+static void
+bgp_attr_cache_add (struct peer *peer, u_int32_t key,
+		    const u_char *data, bgp_size_t length, struct attr *attr)
+{
+  struct bgp_attr_cache_entry *entry;
+
+  if (! peer->attr_cache)
+    peer->attr_cache = XCALLOC (MTYPE_BGP_ATTR_CACHE,
+				sizeof (struct bgp_attr_cache));
+
+  entry = &peer->attr_cache->entry[key % BGP_ATTR_CACHE_SIZE];
+  bgp_attr_cache_entry_free (entry);
+
+  entry->key = key;
+  entry->length = length;
+  entry->data = XMALLOC (MTYPE_BGP_ATTR_CACHE, length);
+  memcpy (entry->data, data, length);
+  entry->attr = bgp_attr_intern (attr);
+}
+
+/* Forget the attribute blocks received from the peer, as when the
+   session goes down or the checks done on them change.  */
+void
+bgp_attr_cache_flush (struct peer *peer)
+{
+  int i;
+
+  if (! peer->attr_cache)
+    return;
+
+  for (i = 0; i < BGP_ATTR_CACHE_SIZE; i++)
+    bgp_attr_cache_entry_free (&peer->attr_cache->entry[i]);
+  XFREE (MTYPE_BGP_ATTR_CACHE, peer->attr_cache);
+  peer->attr_cache = NULL;
+}
+
+void
+bgp_attr_cache_flush_all (struct bgp *bgp)
+{
+  struct listnode *node;
+  struct peer *peer;
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    bgp_attr_cache_flush (peer);
+}
+
+static bgp_attr_parse_ret_t
+bgp_attr_parse_raw (struct peer *peer, struct attr *attr, bgp_size_t size,
+		    struct bgp_nlri *mp_update, struct bgp_nlri *mp_withdraw);
+
 /* Read attribute of update packet.  This function is called from
-   bgp_update_receive() in bgp_packet.c.  */
+   bgp_update_receive() in bgp_packet.c.
+
+   Attribute blocks without MP_(UN)REACH_NLRI, which carries NLRI of its
+   own, often repeat verbatim across the UPDATEs from a peer.  Those are
+   looked up in the peer's cache first, a hit costs a copy of the
+   interned attribute and skips both parsing and interning.  */
 bgp_attr_parse_ret_t
 bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
 		struct bgp_nlri *mp_update, struct bgp_nlri *mp_withdraw)
+{
+  bgp_attr_parse_ret_t ret;
+  u_char *startp = BGP_INPUT_PNT (peer);
+  struct attr *cached;
+  u_int32_t key = 0;
+
+  if (size <= BGP_ATTR_CACHE_MAXLEN
+      && STREAM_READABLE (BGP_INPUT (peer)) >= size)
+    {
+      key = jhash (startp, size, 0);
+      if ((cached = bgp_attr_cache_lookup (peer, key, startp, size)) != NULL)
+	{
+	  bgp_attr_dup (attr, cached);
+	  attr->refcnt = 0;
+	  bgp_attr_lock_sub (attr);
+	  stream_forward_getp (BGP_INPUT (peer), size);
+	  return BGP_ATTR_PARSE_PROCEED;
+	}
+    }
+
+  ret = bgp_attr_parse_raw (peer, attr, size, mp_update, mp_withdraw);
+
+  if (ret == BGP_ATTR_PARSE_PROCEED
+      && size <= BGP_ATTR_CACHE_MAXLEN
+      && ! CHECK_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_MP_REACH_NLRI))
+      && ! CHECK_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_MP_UNREACH_NLRI)))
+    bgp_attr_cache_add (peer, key, startp, size, attr);
+
+  return ret;
+}
+
+static bgp_attr_parse_ret_t
+bgp_attr_parse_raw (struct peer *peer, struct attr *attr, bgp_size_t size,
+		    struct bgp_nlri *mp_update, struct bgp_nlri *mp_withdraw)
 {
   int ret;
   u_char flag = 0;
@@ -117,6 +117,12 @@ struct attr
   
   /* Path origin attribute */
   u_char origin;
+
+#ifdef ENABLE_OVSDB
+  /* Path attributes as published to OVSDB, kept on interned
+     attributes only, see bgp_ovsdb_route.c.  */
+  struct ovsdb_datum *ovsdb_path_attributes;
+#endif
 };
 
 /* Router Reflector related structure. */
@@ -137,6 +143,25 @@ struct transit
 
 #define ATTR_FLAG_BIT(X)  (1 << ((X) - 1))
 
+/* Attribute blocks recently received from a peer, with what they
+   parsed to, so that repeats need not be parsed again.  Entries are
+   direct mapped by a hash of the raw bytes.  */
+#define BGP_ATTR_CACHE_SIZE     64
+#define BGP_ATTR_CACHE_MAXLEN   1024
+
+struct bgp_attr_cache_entry
+{
+  u_int32_t key;
+  bgp_size_t length;
+  u_char *data;
+  struct attr *attr;
+};
+
+struct bgp_attr_cache
+{
+  struct bgp_attr_cache_entry entry[BGP_ATTR_CACHE_SIZE];
+};
+
 typedef enum {
  BGP_ATTR_PARSE_PROCEED = 0,
  BGP_ATTR_PARSE_ERROR = -1,
@@ -159,6 +184,8 @@ extern struct attr *bgp_attr_intern (struct attr *attr);
 extern void bgp_attr_unintern_sub (struct attr *);
 extern void bgp_attr_unintern (struct attr **);
 extern void bgp_attr_flush (struct attr *);
+extern void bgp_attr_cache_flush (struct peer *);
+extern void bgp_attr_cache_flush_all (struct bgp *);
 extern struct attr *bgp_attr_default_set (struct attr *attr, u_char);
 extern struct attr *bgp_attr_default_intern (u_char);
 extern struct attr *bgp_attr_aggregate_intern (struct bgp *, u_char,
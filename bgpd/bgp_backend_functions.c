@@ -996,6 +996,42 @@ DEFUN (no_bgp_deterministic_med,
   return CMD_SUCCESS;
 }
 
+/* "bgp pic" configuration. */
+DEFUN (bgp_pic,
+       bgp_pic_cmd,
+       "bgp pic",
+       "BGP specific commands\n"
+       "Precompute backup paths for prefix independent convergence\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  if (! bgp_flag_check (bgp, BGP_FLAG_PIC))
+    {
+      bgp_flag_set (bgp, BGP_FLAG_PIC);
+      bgp_process_all (bgp);
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_pic,
+       no_bgp_pic_cmd,
+       "no bgp pic",
+       NO_STR
+       "BGP specific commands\n"
+       "Precompute backup paths for prefix independent convergence\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  if (bgp_flag_check (bgp, BGP_FLAG_PIC))
+    {
+      bgp_flag_unset (bgp, BGP_FLAG_PIC);
+      bgp_process_all (bgp);
+    }
+  return CMD_SUCCESS;
+}
+
 /* "bgp graceful-restart" configuration. */
 DEFUN (bgp_graceful_restart,
        bgp_graceful_restart_cmd,
@@ -1110,6 +1146,7 @@ DEFUN (bgp_enforce_first_as,
 
   bgp = vty->index;
   bgp_flag_set (bgp, BGP_FLAG_ENFORCE_FIRST_AS);
+  bgp_attr_cache_flush_all (bgp);
   return CMD_SUCCESS;
 }
 
@@ -7603,10 +7640,11 @@ DEFUN (show_bgp_memory,
                          count * sizeof (struct bgp_static)));
 
   /* Adj-In/Out */
-  if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)))
+  if ((count = bgp_adj_in_count ()))
     LOG_ERROR("%ld Adj-In entries, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_adj_in)));
+                           mtype_stats_alloc (MTYPE_BGP_ADJ_IN_BLOCK)
+                           * BGP_ADJ_IN_BLOCK_BYTES));
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
     LOG_ERROR("%ld Adj-Out entries, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
@@ -9915,6 +9953,10 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &bgp_deterministic_med_cmd);
   install_element (BGP_NODE, &no_bgp_deterministic_med_cmd);
 
+  /* "bgp pic" commands */
+  install_element (BGP_NODE, &bgp_pic_cmd);
+  install_element (BGP_NODE, &no_bgp_pic_cmd);
+
   /* "bgp graceful-restart" commands */
   install_element (BGP_NODE, &bgp_graceful_restart_cmd);
   install_element (BGP_NODE, &no_bgp_graceful_restart_cmd);
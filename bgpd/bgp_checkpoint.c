@@ -0,0 +1,1126 @@
+/* BGP Loc-RIB checkpoint for warm restart
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* The default instance periodically writes the routes it has in the
+   FIB to a checkpoint file.  When bgpd starts again while the FIB
+   still holds those routes (bgpd was killed, or ran with -r), it maps
+   the checkpoint and leaves alone every route that comes out of best
+   path selection unchanged, instead of installing the whole table
+   again.  Only the routes found in the Route table of OVSDB are left
+   alone: without OVSDB, every route is installed again.  The routes
+   that no peer resent by the end of the restore time are withdrawn.
+
+   The file is only ever read back by bgpd on the same box, so it is
+   kept in host byte order.  Its layout is a header, the routes sorted
+   in table order and the nexthops of the routes.  The routes are
+   looked up by binary search in the mapped file.
+
+   A route the checkpoint does not have can go into the FIB between two
+   checkpoints.  The file is then marked incomplete, and the restore
+   from it also withdraws the other BGP routes the FIB has, if they are
+   not selected again. */
+
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "prefix.h"
+#include "thread.h"
+#include "log.h"
+#include "linklist.h"
+#include "vty.h"
+#include "memory.h"
+#include "workqueue.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_checkpoint.h"
+#ifdef ENABLE_OVSDB
+#include "bgpd/bgp_ovsdb_route.h"
+#endif
+
+#define BGP_CHECKPOINT_MAGIC         0x42475043 /* "BGPC" */
+#define BGP_CHECKPOINT_VERSION       1
+#define BGP_CHECKPOINT_NEXTHOP_SIZE  16
+
+struct bgp_checkpoint_header
+{
+  u_int32_t magic;
+  u_int16_t version;
+  u_int16_t header_size;
+  u_int32_t route_size;
+  u_int32_t route_count;
+  u_int32_t nexthop_count;
+  u_int32_t flags;
+#define BGP_CHECKPOINT_INCOMPLETE (1 << 0) /* FIB has routes not in here */
+  u_int64_t time;
+};
+
+/* A route as the FIB has it.  Its nexthops, the selected path's one
+   followed by those of the multipaths, are nexthop_num slots of the
+   nexthop array, starting at index nexthop. */
+struct bgp_checkpoint_route
+{
+  u_char afi;
+  u_char safi;
+  u_char prefixlen;
+  u_char flags;
+#define BGP_CHECKPOINT_DIRTY      (1 << 0) /* FIB changed since written */
+#define BGP_CHECKPOINT_INSTALLED  (1 << 1) /* known to be in the FIB */
+#define BGP_CHECKPOINT_DONE       (1 << 2) /* selected again on restore */
+  u_int16_t nexthop_num;
+  u_char distance;
+  u_char pad;
+  u_int32_t metric;
+  u_int32_t nexthop;
+  u_char prefix[16];
+};
+
+/* Nodes walked between two checks whether to yield. */
+#define BGP_CHECKPOINT_WALK_BATCH    256
+
+/* A checkpoint being written.  The tables are walked a slice at a time
+   on the write queue, gathering the routes and their nexthops here,
+   and the file is written out once the walk is done. */
+struct bgp_checkpoint_walk
+{
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+  bgp_table_iter_t iter;
+
+  /* Key of the last node walked.  A route going into the FIB at or
+     before it, that the walk did not find, makes the file incomplete. */
+  struct bgp_checkpoint_route last;
+  u_int32_t flags;
+
+  struct bgp_checkpoint_route *routes;
+  u_int32_t route_count;
+  u_int32_t route_max;
+  u_char (*nexthops)[BGP_CHECKPOINT_NEXTHOP_SIZE];
+  u_int32_t nexthop_count;
+  u_int32_t nexthop_max;
+};
+
+static struct
+{
+  /* Checkpoint file, NULL when checkpoints are not kept. */
+  const char *path;
+
+  /* The mapped checkpoint.  It is the one being restored from, or the
+     last one written, whose routes are marked dirty as the FIB changes. */
+  void *map;
+  size_t size;
+  struct bgp_checkpoint_header *header;
+  struct bgp_checkpoint_route *routes;
+  u_char (*nexthops)[BGP_CHECKPOINT_NEXTHOP_SIZE];
+
+  /* The checkpoint being restored from is mapped privately, and kept
+     open to write back the routes the restore changes in the FIB, so
+     that they are not trusted if bgpd goes away before it is done.
+     -1 otherwise. */
+  int fd;
+
+  int restoring;
+  int adopted;
+  unsigned long suppressed;
+
+  /* The checkpoint restored from was incomplete.  The BGP routes found
+     in the FIB that it does not have are kept here, by SAFI, until the
+     sweep at the end of the restore. */
+  int incomplete;
+  struct list *unknown[SAFI_MULTICAST + 1];
+
+  /* FIB updates since the last checkpoint was started. */
+  unsigned long changes;
+
+  /* The checkpoint being written, if any, and the queue walking the
+     tables for it. */
+  struct bgp_checkpoint_walk *walk;
+  struct work_queue *write_queue;
+
+  struct thread *t_write;
+  struct thread *t_restore;
+} checkpoint;
+
+static int bgp_checkpoint_timer (struct thread *);
+
+/* Order of the routes in the file, which is the order a walk of the
+   tables finds them in: a prefix comes before the longer prefixes it
+   covers, otherwise the lower address comes first. */
+static int
+bgp_checkpoint_cmp (const struct bgp_checkpoint_route *a,
+                    const struct bgp_checkpoint_route *b)
+{
+  int i, len;
+  u_char mask;
+
+  if (a->afi != b->afi)
+    return a->afi - b->afi;
+  if (a->safi != b->safi)
+    return a->safi - b->safi;
+
+  len = MIN (a->prefixlen, b->prefixlen);
+  for (i = 0; len >= 8; i++, len -= 8)
+    if (a->prefix[i] != b->prefix[i])
+      return a->prefix[i] - b->prefix[i];
+  if (len)
+    {
+      mask = 0xff << (8 - len);
+      if ((a->prefix[i] & mask) != (b->prefix[i] & mask))
+        return (a->prefix[i] & mask) - (b->prefix[i] & mask);
+    }
+  return a->prefixlen - b->prefixlen;
+}
+
+static void
+bgp_checkpoint_key (struct bgp_checkpoint_route *route, afi_t afi,
+                    safi_t safi, struct prefix *p)
+{
+  memset (route, 0, sizeof (struct bgp_checkpoint_route));
+  route->afi = afi;
+  route->safi = safi;
+  route->prefixlen = p->prefixlen;
+  memcpy (route->prefix, &p->u.prefix,
+          afi == AFI_IP ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN);
+}
+
+static struct bgp_checkpoint_route *
+bgp_checkpoint_search (struct bgp_checkpoint_route *routes, u_int32_t count,
+                       const struct bgp_checkpoint_route *key)
+{
+  u_int32_t low, high, mid;
+  int cmp;
+
+  low = 0;
+  high = count;
+  while (low < high)
+    {
+      mid = low + (high - low) / 2;
+      cmp = bgp_checkpoint_cmp (key, &routes[mid]);
+      if (cmp == 0)
+        return &routes[mid];
+      if (cmp < 0)
+        high = mid;
+      else
+        low = mid + 1;
+    }
+  return NULL;
+}
+
+static struct bgp_checkpoint_route *
+bgp_checkpoint_lookup (afi_t afi, safi_t safi, struct prefix *p)
+{
+  struct bgp_checkpoint_route key;
+
+  bgp_checkpoint_key (&key, afi, safi, p);
+  return bgp_checkpoint_search (checkpoint.routes,
+                                checkpoint.header->route_count, &key);
+}
+
+/* The nexthop the FIB gets for a path, as bgp_zebra_announce picks it. */
+static void
+bgp_checkpoint_nexthop (afi_t afi, struct bgp_info *info, u_char *nexthop)
+{
+  memset (nexthop, 0, BGP_CHECKPOINT_NEXTHOP_SIZE);
+
+  if (afi == AFI_IP)
+    memcpy (nexthop, &info->attr->nexthop, IPV4_MAX_BYTELEN);
+#ifdef HAVE_IPV6
+  else if (info->attr->extra)
+    {
+      if (info->attr->extra->mp_nexthop_len == 16)
+        memcpy (nexthop, &info->attr->extra->mp_nexthop_global,
+                IPV6_MAX_BYTELEN);
+      else if (info->attr->extra->mp_nexthop_len == 32)
+        memcpy (nexthop, &info->attr->extra->mp_nexthop_local,
+                IPV6_MAX_BYTELEN);
+    }
+#endif /* HAVE_IPV6 */
+}
+
+static u_char
+bgp_checkpoint_distance (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                         struct bgp_info *info)
+{
+  return afi == AFI_IP ? bgp_distance_apply (&rn->p, info, bgp) : 0;
+}
+
+/* Does the FIB have the route from the checkpoint for the selected path? */
+static int
+bgp_checkpoint_match (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                      struct bgp_checkpoint_route *route,
+                      struct bgp_info *select)
+{
+  u_char nexthop[BGP_CHECKPOINT_NEXTHOP_SIZE];
+  struct bgp_info *mpinfo;
+  u_int32_t i;
+
+  if (route->metric != select->attr->med
+      || route->nexthop_num != 1 + bgp_info_mpath_count (select)
+      || route->distance != bgp_checkpoint_distance (bgp, rn, afi, select))
+    return 0;
+
+  i = route->nexthop;
+  bgp_checkpoint_nexthop (afi, select, nexthop);
+  if (memcmp (nexthop, checkpoint.nexthops[i++], sizeof (nexthop)))
+    return 0;
+
+  for (mpinfo = bgp_info_mpath_first (select); mpinfo;
+       mpinfo = bgp_info_mpath_next (mpinfo))
+    {
+      bgp_checkpoint_nexthop (afi, mpinfo, nexthop);
+      if (memcmp (nexthop, checkpoint.nexthops[i++], sizeof (nexthop)))
+        return 0;
+    }
+  return 1;
+}
+
+/* The path of a node that is in the FIB, if any. */
+static struct bgp_info *
+bgp_checkpoint_selected (struct bgp_node *rn)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      {
+        if (ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL)
+          return ri;
+        return NULL;
+      }
+  return NULL;
+}
+
+static void
+bgp_checkpoint_map (void *map, size_t size)
+{
+  checkpoint.map = map;
+  checkpoint.size = size;
+  checkpoint.header = map;
+  checkpoint.routes = (struct bgp_checkpoint_route *) (checkpoint.header + 1);
+  checkpoint.nexthops = (void *) (checkpoint.routes
+                                  + checkpoint.header->route_count);
+}
+
+static void
+bgp_checkpoint_unknown_free (void)
+{
+  struct listnode *node, *nnode;
+  struct prefix *p;
+  safi_t safi;
+
+  for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+    if (checkpoint.unknown[safi])
+      {
+        for (ALL_LIST_ELEMENTS (checkpoint.unknown[safi], node, nnode, p))
+          prefix_free (p);
+        list_delete (checkpoint.unknown[safi]);
+        checkpoint.unknown[safi] = NULL;
+      }
+  checkpoint.incomplete = 0;
+}
+
+static void
+bgp_checkpoint_unmap (void)
+{
+  if (checkpoint.map)
+    {
+      munmap (checkpoint.map, checkpoint.size);
+      if (checkpoint.fd >= 0)
+        close (checkpoint.fd);
+    }
+  checkpoint.fd = -1;
+  checkpoint.map = NULL;
+  checkpoint.size = 0;
+  checkpoint.header = NULL;
+  checkpoint.routes = NULL;
+  checkpoint.nexthops = NULL;
+}
+
+/* Write back a change to the checkpoint being restored from. */
+static void
+bgp_checkpoint_pwrite (const void *data, size_t size, void *at)
+{
+  off_t offset = (u_char *) at - (u_char *) checkpoint.map;
+
+  if (pwrite (checkpoint.fd, data, size, offset) != (ssize_t) size)
+    zlog_warn ("bgp_checkpoint_pwrite: %s: %s", checkpoint.path,
+               safe_strerror (errno));
+}
+
+/* The FIB no longer has the route as the checkpoint has it. */
+static void
+bgp_checkpoint_dirty (struct bgp_checkpoint_route *route)
+{
+  u_char flags = BGP_CHECKPOINT_DIRTY;
+
+  if (CHECK_FLAG (route->flags, BGP_CHECKPOINT_DIRTY))
+    return;
+  SET_FLAG (route->flags, BGP_CHECKPOINT_DIRTY);
+
+  /* The file only ever holds the dirty flag of a route. */
+  if (checkpoint.restoring)
+    bgp_checkpoint_pwrite (&flags, sizeof (flags), &route->flags);
+}
+
+static void
+bgp_checkpoint_walk_free (void)
+{
+  struct bgp_checkpoint_walk *walk = checkpoint.walk;
+
+  if (! walk)
+    return;
+
+  if (walk->iter.table)
+    bgp_table_iter_cleanup (&walk->iter);
+  bgp_unlock (walk->bgp);
+  if (walk->routes)
+    XFREE (MTYPE_BGP_CHECKPOINT, walk->routes);
+  if (walk->nexthops)
+    XFREE (MTYPE_BGP_CHECKPOINT, walk->nexthops);
+  XFREE (MTYPE_BGP_CHECKPOINT, walk);
+  checkpoint.walk = NULL;
+}
+
+/* Start a checkpoint of the routes the default instance has in the
+   FIB. */
+static int
+bgp_checkpoint_walk_start (void)
+{
+  struct bgp_checkpoint_walk *walk;
+  struct bgp *bgp;
+
+  /* The checkpoint being restored from holds routes that were not
+     selected again yet. */
+  if (! checkpoint.path || checkpoint.restoring)
+    return -1;
+
+  if (checkpoint.walk)
+    return 0;
+
+  if ((bgp = bgp_get_default ()) == NULL)
+    return -1;
+
+  walk = XCALLOC (MTYPE_BGP_CHECKPOINT, sizeof (struct bgp_checkpoint_walk));
+  walk->bgp = bgp;
+  bgp_lock (bgp);
+  walk->afi = AFI_IP;
+  walk->safi = SAFI_UNICAST;
+  checkpoint.walk = walk;
+  checkpoint.changes = 0;
+  return 0;
+}
+
+/* Add the route the FIB has for a node, if any, to the checkpoint. */
+static void
+bgp_checkpoint_walk_node (struct bgp_checkpoint_walk *walk,
+                          struct bgp_node *rn)
+{
+  struct bgp_checkpoint_route *route;
+  struct bgp_info *ri, *mpinfo;
+  u_int32_t num;
+
+  bgp_checkpoint_key (&walk->last, walk->afi, walk->safi, &rn->p);
+  if ((ri = bgp_checkpoint_selected (rn)) == NULL)
+    return;
+
+  if (walk->route_count == walk->route_max)
+    {
+      walk->route_max = walk->route_max ? walk->route_max * 2 : 1024;
+      walk->routes = XREALLOC (MTYPE_BGP_CHECKPOINT, walk->routes,
+                               walk->route_max
+                               * sizeof (struct bgp_checkpoint_route));
+    }
+  num = 1 + bgp_info_mpath_count (ri);
+  while (walk->nexthop_count + num > walk->nexthop_max)
+    {
+      walk->nexthop_max = walk->nexthop_max ? walk->nexthop_max * 2 : 1024;
+      walk->nexthops = XREALLOC (MTYPE_BGP_CHECKPOINT, walk->nexthops,
+                                 walk->nexthop_max
+                                 * BGP_CHECKPOINT_NEXTHOP_SIZE);
+    }
+
+  route = &walk->routes[walk->route_count++];
+  *route = walk->last;
+  route->nexthop_num = num;
+  route->distance = bgp_checkpoint_distance (walk->bgp, rn, walk->afi, ri);
+  route->metric = ri->attr->med;
+  route->nexthop = walk->nexthop_count;
+
+  bgp_checkpoint_nexthop (walk->afi, ri,
+                          walk->nexthops[walk->nexthop_count++]);
+  for (mpinfo = bgp_info_mpath_first (ri); mpinfo;
+       mpinfo = bgp_info_mpath_next (mpinfo))
+    bgp_checkpoint_nexthop (walk->afi, mpinfo,
+                            walk->nexthops[walk->nexthop_count++]);
+}
+
+/* Walk the tables on, in file order.  On the write queue, stop when it
+   is time to yield; otherwise walk to the end.  Returns 1 once every
+   table was walked. */
+static int
+bgp_checkpoint_walk (struct work_queue *wq)
+{
+  struct bgp_checkpoint_walk *walk = checkpoint.walk;
+  struct bgp_table *table;
+  struct bgp_node *rn;
+  unsigned int count = 0;
+
+  while (walk->afi <= AFI_IP6)
+    {
+      if (! walk->iter.table)
+        {
+          if ((table = walk->bgp->rib[walk->afi][walk->safi]) != NULL)
+            bgp_table_iter_init (&walk->iter, table);
+        }
+      if (! walk->iter.table
+          || (rn = bgp_table_iter_next (&walk->iter)) == NULL)
+        {
+          if (walk->iter.table)
+            bgp_table_iter_cleanup (&walk->iter);
+          if (walk->safi++ == SAFI_MULTICAST)
+            {
+              walk->safi = SAFI_UNICAST;
+              walk->afi++;
+            }
+          continue;
+        }
+
+      bgp_checkpoint_walk_node (walk, rn);
+
+      if (++count % BGP_CHECKPOINT_WALK_BATCH == 0)
+        {
+          bgp_keepalives_send_due ();
+          if (wq && work_queue_should_yield (wq))
+            {
+              bgp_table_iter_pause (&walk->iter);
+              work_queue_batch_done (wq, count, 1);
+              return 0;
+            }
+        }
+    }
+
+  if (wq)
+    work_queue_batch_done (wq, count, 0);
+  return 1;
+}
+
+/* Write out the checkpoint walked.  The file is written next to the
+   old one and then renamed over it, so a crash never leaves half a
+   checkpoint. */
+static int
+bgp_checkpoint_walk_end (void)
+{
+  struct bgp_checkpoint_walk *walk = checkpoint.walk;
+  struct bgp_checkpoint_header *header;
+  struct bgp_checkpoint_route *routes;
+  char tmp[MAXPATHLEN];
+  size_t size;
+  void *map;
+  int fd;
+
+  size = sizeof (struct bgp_checkpoint_header)
+         + walk->route_count * sizeof (struct bgp_checkpoint_route)
+         + walk->nexthop_count * BGP_CHECKPOINT_NEXTHOP_SIZE;
+
+  snprintf (tmp, sizeof (tmp), "%s.tmp", checkpoint.path);
+  fd = open (tmp, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    {
+      zlog_warn ("bgp_checkpoint_write: %s: %s", tmp, safe_strerror (errno));
+      bgp_checkpoint_walk_free ();
+      return -1;
+    }
+  if (ftruncate (fd, size) < 0
+      || (map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0)) == MAP_FAILED)
+    {
+      zlog_warn ("bgp_checkpoint_write: %s: %s", tmp, safe_strerror (errno));
+      close (fd);
+      unlink (tmp);
+      bgp_checkpoint_walk_free ();
+      return -1;
+    }
+  close (fd);
+
+  header = map;
+  header->magic = BGP_CHECKPOINT_MAGIC;
+  header->version = BGP_CHECKPOINT_VERSION;
+  header->header_size = sizeof (struct bgp_checkpoint_header);
+  header->route_size = sizeof (struct bgp_checkpoint_route);
+  header->route_count = walk->route_count;
+  header->nexthop_count = walk->nexthop_count;
+  header->flags = walk->flags;
+  header->time = time (NULL);
+
+  routes = (struct bgp_checkpoint_route *) (header + 1);
+  memcpy (routes, walk->routes,
+          walk->route_count * sizeof (struct bgp_checkpoint_route));
+  memcpy (routes + walk->route_count, walk->nexthops,
+          walk->nexthop_count * BGP_CHECKPOINT_NEXTHOP_SIZE);
+
+  if (rename (tmp, checkpoint.path) < 0)
+    {
+      zlog_warn ("bgp_checkpoint_write: %s: %s", checkpoint.path,
+                 safe_strerror (errno));
+      munmap (map, size);
+      unlink (tmp);
+      bgp_checkpoint_walk_free ();
+      return -1;
+    }
+
+  bgp_checkpoint_unmap ();
+  bgp_checkpoint_map (map, size);
+
+  if (BGP_DEBUG (normal, NORMAL))
+    zlog_debug ("Wrote checkpoint %s of %u routes", checkpoint.path,
+                walk->route_count);
+
+  bgp_checkpoint_walk_free ();
+  return 0;
+}
+
+/* The write queue holds a single item while a checkpoint is walked. */
+static wq_item_status
+bgp_checkpoint_write_slice (struct work_queue *wq, void *data)
+{
+  if (! checkpoint.walk)
+    return WQ_SUCCESS;
+
+  if (! bgp_checkpoint_walk (wq))
+    return WQ_REQUEUE;
+
+  bgp_checkpoint_walk_end ();
+  return WQ_SUCCESS;
+}
+
+/* Write the routes the default instance has in the FIB to the
+   checkpoint file at once, finishing the checkpoint being walked if
+   there is one. */
+int
+bgp_checkpoint_write (void)
+{
+  if (bgp_checkpoint_walk_start () < 0)
+    return -1;
+
+  bgp_checkpoint_walk (NULL);
+  return bgp_checkpoint_walk_end ();
+}
+
+/* Write a checkpoint a slice at a time, between the other work. */
+static void
+bgp_checkpoint_write_queue (void)
+{
+  if (checkpoint.walk || bgp_checkpoint_walk_start () < 0)
+    return;
+
+  work_queue_add (checkpoint.write_queue, &checkpoint);
+}
+
+/* Is the mapped file a checkpoint the lookups can rely on? */
+static int
+bgp_checkpoint_verify (void)
+{
+  struct bgp_checkpoint_header *header = checkpoint.header;
+  struct bgp_checkpoint_route *route;
+  u_int32_t i;
+
+  if (checkpoint.size < sizeof (struct bgp_checkpoint_header)
+      || header->magic != BGP_CHECKPOINT_MAGIC
+      || header->version != BGP_CHECKPOINT_VERSION
+      || header->header_size != sizeof (struct bgp_checkpoint_header)
+      || header->route_size != sizeof (struct bgp_checkpoint_route)
+      || checkpoint.size != sizeof (struct bgp_checkpoint_header)
+         + (size_t) header->route_count * sizeof (struct bgp_checkpoint_route)
+         + (size_t) header->nexthop_count * BGP_CHECKPOINT_NEXTHOP_SIZE)
+    return -1;
+
+  for (i = 0; i < header->route_count; i++)
+    {
+      route = &checkpoint.routes[i];
+
+      if ((route->afi != AFI_IP && route->afi != AFI_IP6)
+          || (route->safi != SAFI_UNICAST && route->safi != SAFI_MULTICAST)
+          || route->prefixlen > (route->afi == AFI_IP ? IPV4_MAX_BITLEN
+                                                      : IPV6_MAX_BITLEN)
+          || route->nexthop_num == 0
+          || route->nexthop > header->nexthop_count
+          || route->nexthop_num > header->nexthop_count - route->nexthop)
+        return -1;
+
+      if (i && bgp_checkpoint_cmp (route - 1, route) >= 0)
+        return -1;
+    }
+  return 0;
+}
+
+static int
+bgp_checkpoint_load (void)
+{
+  struct stat st;
+  struct bgp_checkpoint_route *route;
+  void *map;
+  u_int32_t i;
+  int fd;
+
+  fd = open (checkpoint.path, O_RDWR);
+  if (fd < 0)
+    {
+      if (errno != ENOENT)
+        zlog_warn ("bgp_checkpoint_load: %s: %s", checkpoint.path,
+                   safe_strerror (errno));
+      return -1;
+    }
+  if (fstat (fd, &st) < 0 || st.st_size == 0)
+    {
+      close (fd);
+      return -1;
+    }
+
+  /* Private, so the restore can keep its state in the routes. */
+  map = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      zlog_warn ("bgp_checkpoint_load: %s: %s", checkpoint.path,
+                 safe_strerror (errno));
+      close (fd);
+      return -1;
+    }
+
+  bgp_checkpoint_map (map, st.st_size);
+  checkpoint.fd = fd;
+  if (st.st_size < (off_t) sizeof (struct bgp_checkpoint_header)
+      || bgp_checkpoint_verify () < 0)
+    {
+      zlog_warn ("bgp_checkpoint_load: %s is not a usable checkpoint",
+                 checkpoint.path);
+      bgp_checkpoint_unmap ();
+      return -1;
+    }
+
+  checkpoint.incomplete = CHECK_FLAG (checkpoint.header->flags,
+                                      BGP_CHECKPOINT_INCOMPLETE);
+#ifndef ENABLE_OVSDB
+  /* The routes zebra has cannot be searched for those the checkpoint
+     is missing. */
+  if (checkpoint.incomplete)
+    {
+      zlog_notice ("Checkpoint %s is incomplete, not restoring from it",
+                   checkpoint.path);
+      bgp_checkpoint_unmap ();
+      checkpoint.incomplete = 0;
+      return -1;
+    }
+#endif /* ENABLE_OVSDB */
+
+  /* A route is only taken to be in the FIB once it is found there,
+     see bgp_checkpoint_adopt.  zebra cannot be asked for the routes it
+     kept, and may have restarted along with bgpd, so without OVSDB
+     every route is installed again. */
+  for (i = 0; i < checkpoint.header->route_count; i++)
+    {
+      route = &checkpoint.routes[i];
+      route->flags &= BGP_CHECKPOINT_DIRTY;
+    }
+  return 0;
+}
+
+/* Take the routes the previous bgpd left in the FIB into account. */
+static void
+bgp_checkpoint_adopt_fib (void)
+{
+  if (checkpoint.adopted)
+    return;
+  checkpoint.adopted = 1;
+
+#ifdef ENABLE_OVSDB
+  bgp_ovsdb_adopt_rib_entries ();
+#endif /* ENABLE_OVSDB */
+}
+
+/* Called for each Route row left behind by the previous bgpd.  Returns
+   1 if the row is one of the checkpoint's routes, or is to be swept
+   because the checkpoint is incomplete. */
+int
+bgp_checkpoint_adopt (struct prefix *p, safi_t safi)
+{
+  struct bgp_checkpoint_route *route;
+  struct prefix *unknown;
+
+  if (! checkpoint.restoring)
+    return 0;
+
+  route = bgp_checkpoint_lookup (family2afi (p->family), safi, p);
+  if (route == NULL)
+    {
+      if (! checkpoint.incomplete)
+        return 0;
+      if (! checkpoint.unknown[safi])
+        checkpoint.unknown[safi] = list_new ();
+      unknown = prefix_new ();
+      prefix_copy (unknown, p);
+      listnode_add (checkpoint.unknown[safi], unknown);
+      return 1;
+    }
+
+  SET_FLAG (route->flags, BGP_CHECKPOINT_INSTALLED);
+  return 1;
+}
+
+/* Withdraw the routes found in the FIB that the checkpoint does not
+   have, unless they were selected again. */
+static unsigned long
+bgp_checkpoint_sweep_unknown (struct bgp *bgp)
+{
+  struct listnode *node;
+  struct bgp_node *rn;
+  struct bgp_info info;
+  struct attr attr;
+  struct attr_extra extra;
+  struct prefix *p;
+  unsigned long withdrawn = 0;
+  safi_t safi;
+  int selected;
+
+  for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+    if (checkpoint.unknown[safi])
+      for (ALL_LIST_ELEMENTS_RO (checkpoint.unknown[safi], node, p))
+        {
+          selected = 0;
+          rn = bgp_node_lookup (bgp->rib[family2afi (p->family)][safi], p);
+          if (rn)
+            {
+              selected = bgp_checkpoint_selected (rn) != NULL;
+              bgp_unlock_node (rn);
+            }
+          if (selected)
+            continue;
+
+          memset (&attr, 0, sizeof (struct attr));
+          memset (&extra, 0, sizeof (struct attr_extra));
+          memset (&info, 0, sizeof (struct bgp_info));
+          attr.extra = &extra;
+          info.type = ZEBRA_ROUTE_BGP;
+          info.sub_type = BGP_ROUTE_NORMAL;
+          info.peer = bgp->peer_self;
+          info.attr = &attr;
+
+          bgp_zebra_withdraw (p, &info, safi);
+          withdrawn++;
+        }
+  return withdrawn;
+}
+
+/* Withdraw the routes of the checkpoint that were not selected again. */
+static unsigned long
+bgp_checkpoint_sweep (struct bgp *bgp)
+{
+  struct bgp_checkpoint_route *route;
+  struct bgp_info info;
+  struct attr attr;
+  struct attr_extra extra;
+  struct prefix p;
+  unsigned long withdrawn;
+  u_int32_t i;
+
+  withdrawn = bgp_checkpoint_sweep_unknown (bgp);
+
+  for (i = 0; i < checkpoint.header->route_count; i++)
+    {
+      route = &checkpoint.routes[i];
+      if (CHECK_FLAG (route->flags, BGP_CHECKPOINT_DONE)
+          || ! CHECK_FLAG (route->flags, BGP_CHECKPOINT_INSTALLED))
+        continue;
+
+      memset (&p, 0, sizeof (struct prefix));
+      memset (&attr, 0, sizeof (struct attr));
+      memset (&extra, 0, sizeof (struct attr_extra));
+      memset (&info, 0, sizeof (struct bgp_info));
+
+      attr.extra = &extra;
+      attr.med = route->metric;
+      if (route->afi == AFI_IP)
+        {
+          p.family = AF_INET;
+          memcpy (&attr.nexthop, checkpoint.nexthops[route->nexthop],
+                  IPV4_MAX_BYTELEN);
+        }
+#ifdef HAVE_IPV6
+      else
+        {
+          p.family = AF_INET6;
+          extra.mp_nexthop_len = 16;
+          memcpy (&extra.mp_nexthop_global,
+                  checkpoint.nexthops[route->nexthop], IPV6_MAX_BYTELEN);
+        }
+#endif /* HAVE_IPV6 */
+      p.prefixlen = route->prefixlen;
+      memcpy (&p.u.prefix, route->prefix,
+              route->afi == AFI_IP ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN);
+
+      info.type = ZEBRA_ROUTE_BGP;
+      info.sub_type = BGP_ROUTE_NORMAL;
+      info.peer = bgp->peer_self;
+      info.attr = &attr;
+
+      bgp_checkpoint_dirty (route);
+      bgp_zebra_withdraw (&p, &info, route->safi);
+      withdrawn++;
+    }
+  return withdrawn;
+}
+
+static void
+bgp_checkpoint_restore_end (struct bgp *bgp)
+{
+  unsigned long withdrawn = 0;
+
+  if (bgp && ! bgp_option_check (BGP_OPT_NO_FIB))
+    {
+      bgp_checkpoint_adopt_fib ();
+      withdrawn = bgp_checkpoint_sweep (bgp);
+    }
+
+  zlog_notice ("Restore from checkpoint %s done: %lu routes kept, "
+               "%lu withdrawn", checkpoint.path, checkpoint.suppressed,
+               withdrawn);
+
+  bgp_checkpoint_unmap ();
+  bgp_checkpoint_unknown_free ();
+  checkpoint.restoring = 0;
+
+  bgp_checkpoint_write_queue ();
+  checkpoint.t_write = thread_add_timer (bm->master, bgp_checkpoint_timer,
+                                         NULL, BGP_CHECKPOINT_INTERVAL);
+}
+
+static int
+bgp_checkpoint_restore_timer (struct thread *thread)
+{
+  checkpoint.t_restore = NULL;
+
+  /* Let the prefixes still waiting for best path selection find their
+     route in the checkpoint first. */
+  if (bm->process_main_head)
+    {
+      checkpoint.t_restore = thread_add_timer (bm->master,
+                                               bgp_checkpoint_restore_timer,
+                                               NULL, 1);
+      return 0;
+    }
+
+  bgp_checkpoint_restore_end (bgp_get_default ());
+  return 0;
+}
+
+/* End the restore early once every peer of the default instance has
+   resent its table. */
+void
+bgp_checkpoint_eor_received (struct peer *peer)
+{
+  struct peer *other;
+  struct listnode *node;
+  afi_t afi;
+  safi_t safi;
+
+  if (! checkpoint.restoring || peer->bgp != bgp_get_default ())
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (peer->bgp->peer, node, other))
+    {
+      if (CHECK_FLAG (other->flags, PEER_FLAG_SHUTDOWN))
+        continue;
+      if (other->status != Established)
+        return;
+      for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+        for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+          if (other->afc_nego[afi][safi]
+              && ! CHECK_FLAG (other->af_sflags[afi][safi],
+                               PEER_STATUS_EOR_RECEIVED))
+            return;
+    }
+
+  THREAD_TIMER_OFF (checkpoint.t_restore);
+  checkpoint.t_restore = thread_add_timer (bm->master,
+                                           bgp_checkpoint_restore_timer,
+                                           NULL, 0);
+}
+
+/* A route the checkpoint does not have goes into the FIB.  Mark the
+   file, so that a restore from it looks for such routes. */
+static void
+bgp_checkpoint_incomplete (void)
+{
+  if (CHECK_FLAG (checkpoint.header->flags, BGP_CHECKPOINT_INCOMPLETE))
+    return;
+  SET_FLAG (checkpoint.header->flags, BGP_CHECKPOINT_INCOMPLETE);
+
+  if (checkpoint.restoring)
+    bgp_checkpoint_pwrite (&checkpoint.header->flags,
+                           sizeof (checkpoint.header->flags),
+                           &checkpoint.header->flags);
+}
+
+/* Called for each FIB update of a prefix, with the path going into
+   the FIB or NULL when the prefix is withdrawn.  Returns 1 when the
+   FIB already has the route, from before a restart. */
+int
+bgp_checkpoint_fib_update (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                           safi_t safi, struct bgp_info *select)
+{
+  struct bgp_checkpoint_route *route;
+
+  if (bgp->name || (safi != SAFI_UNICAST && safi != SAFI_MULTICAST))
+    return 0;
+
+  checkpoint.changes++;
+
+  /* The routes the walk already took are written as they were. */
+  if (checkpoint.walk)
+    {
+      struct bgp_checkpoint_walk *walk = checkpoint.walk;
+      struct bgp_checkpoint_route key;
+
+      bgp_checkpoint_key (&key, afi, safi, &rn->p);
+      route = bgp_checkpoint_search (walk->routes, walk->route_count, &key);
+      if (route)
+        SET_FLAG (route->flags, BGP_CHECKPOINT_DIRTY);
+      else if (select && bgp_checkpoint_cmp (&key, &walk->last) <= 0)
+        SET_FLAG (walk->flags, BGP_CHECKPOINT_INCOMPLETE);
+    }
+
+  if (! checkpoint.map)
+    return 0;
+
+  route = bgp_checkpoint_lookup (afi, safi, &rn->p);
+  if (route == NULL && select)
+    bgp_checkpoint_incomplete ();
+
+  if (! checkpoint.restoring)
+    {
+      if (route)
+        bgp_checkpoint_dirty (route);
+      return 0;
+    }
+
+  bgp_checkpoint_adopt_fib ();
+
+  if (route == NULL)
+    return 0;
+
+  if (! CHECK_FLAG (route->flags, BGP_CHECKPOINT_DONE))
+    {
+      SET_FLAG (route->flags, BGP_CHECKPOINT_DONE);
+      if (select
+          && CHECK_FLAG (route->flags, BGP_CHECKPOINT_INSTALLED)
+          && ! CHECK_FLAG (route->flags, BGP_CHECKPOINT_DIRTY)
+          && bgp_checkpoint_match (bgp, rn, afi, route, select))
+        {
+          checkpoint.suppressed++;
+          return 1;
+        }
+    }
+
+  bgp_checkpoint_dirty (route);
+  return 0;
+}
+
+static int
+bgp_checkpoint_timer (struct thread *thread)
+{
+  checkpoint.t_write = NULL;
+
+  if (checkpoint.changes)
+    bgp_checkpoint_write_queue ();
+
+  checkpoint.t_write = thread_add_timer (bm->master, bgp_checkpoint_timer,
+                                         NULL, BGP_CHECKPOINT_INTERVAL);
+  return 0;
+}
+
+/* The routes were withdrawn from the FIB, the checkpoint is no good
+   any more. */
+void
+bgp_checkpoint_discard (void)
+{
+  if (! checkpoint.path)
+    return;
+
+  THREAD_TIMER_OFF (checkpoint.t_write);
+  THREAD_TIMER_OFF (checkpoint.t_restore);
+  bgp_checkpoint_walk_free ();
+  bgp_checkpoint_unmap ();
+  bgp_checkpoint_unknown_free ();
+  checkpoint.restoring = 0;
+
+  if (unlink (checkpoint.path) < 0 && errno != ENOENT)
+    zlog_warn ("bgp_checkpoint_discard: %s: %s", checkpoint.path,
+               safe_strerror (errno));
+  checkpoint.path = NULL;
+}
+
+/* Keep checkpoints in the given file, restoring from it first if the
+   previous bgpd left one. */
+void
+bgp_checkpoint_init (const char *path)
+{
+  memset (&checkpoint, 0, sizeof (checkpoint));
+  checkpoint.fd = -1;
+  checkpoint.path = path;
+
+  checkpoint.write_queue = work_queue_new (bm->master, "checkpoint_write");
+  checkpoint.write_queue->spec.workfunc = &bgp_checkpoint_write_slice;
+  checkpoint.write_queue->spec.max_retries = 0;
+  checkpoint.write_queue->spec.hold = 10;
+
+  if (bgp_checkpoint_load () == 0)
+    {
+      zlog_notice ("Restoring %u routes from checkpoint %s",
+                   checkpoint.header->route_count, checkpoint.path);
+      checkpoint.restoring = 1;
+      checkpoint.t_restore = thread_add_timer (bm->master,
+                                               bgp_checkpoint_restore_timer,
+                                               NULL,
+                                               BGP_CHECKPOINT_RESTORE_TIME);
+    }
+  else
+    checkpoint.t_write = thread_add_timer (bm->master, bgp_checkpoint_timer,
+                                           NULL, BGP_CHECKPOINT_INTERVAL);
+}
+
+void
+bgp_checkpoint_finish (void)
+{
+  THREAD_TIMER_OFF (checkpoint.t_write);
+  THREAD_TIMER_OFF (checkpoint.t_restore);
+  bgp_checkpoint_walk_free ();
+  if (checkpoint.write_queue)
+    work_queue_free (checkpoint.write_queue);
+  bgp_checkpoint_unmap ();
+  bgp_checkpoint_unknown_free ();
+  memset (&checkpoint, 0, sizeof (checkpoint));
+  checkpoint.fd = -1;
+}
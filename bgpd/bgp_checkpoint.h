@@ -0,0 +1,40 @@
+/* BGP Loc-RIB checkpoint for warm restart
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_CHECKPOINT_H
+#define _QUAGGA_BGP_CHECKPOINT_H
+
+/* Seconds between two checkpoints. */
+#define BGP_CHECKPOINT_INTERVAL      60
+
+/* Seconds to wait for the peers to resend their tables after a
+   restart, before the routes they did not resend are withdrawn. */
+#define BGP_CHECKPOINT_RESTORE_TIME  BGP_DEFAULT_RESTART_TIME
+
+extern void bgp_checkpoint_init (const char *);
+extern void bgp_checkpoint_finish (void);
+extern int bgp_checkpoint_write (void);
+extern void bgp_checkpoint_discard (void);
+extern int bgp_checkpoint_fib_update (struct bgp *, struct bgp_node *,
+                                      afi_t, safi_t, struct bgp_info *);
+extern int bgp_checkpoint_adopt (struct prefix *, safi_t);
+extern void bgp_checkpoint_eor_received (struct peer *);
+
+#endif /* _QUAGGA_BGP_CHECKPOINT_H */
@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
@@ -253,15 +254,41 @@ bgp_connect_timer (struct thread *thread)
   return 0;
 }
 
-/* BGP holdtime timer. */
+/* BGP holdtime timer.  Once established, the timer is not restarted
+   for every message received; when it expires it checks when the peer
+   was last heard from instead. */
 static int
 bgp_holdtime_timer (struct thread *thread)
 {
   struct peer *peer;
+  time_t readtime, elapsed;
+  int pending;
 
   peer = THREAD_ARG (thread);
   peer->t_holdtime = NULL;
 
+  if (peer->status == Established)
+    {
+      /* The reader notes messages as they come in, while they may
+	 wait behind other work of the main thread to be parsed. */
+      readtime = MAX (peer->readtime, bgp_io_readtime (peer));
+      elapsed = bgp_clock () - readtime;
+      if (elapsed >= 0 && elapsed < peer->v_holdtime)
+	{
+	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
+			peer->v_holdtime - elapsed);
+	  return 0;
+	}
+
+      /* With the reader's buffer full, the peer's keepalives may
+	 still be waiting in the socket. */
+      if (ioctl (peer->fd, FIONREAD, &pending) == 0 && pending > 0)
+	{
+	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer, 1);
+	  return 0;
+	}
+    }
+
   if (BGP_DEBUG (fsm, FSM))
     zlog (peer->log, LOG_DEBUG,
       "%s [FSM] Timer (holdtime timer expire)",
@@ -293,6 +320,47 @@ bgp_keepalive_timer (struct thread *thread)
   return 0;
 }
 
+/* Send the keepalives which are due without waiting for their timers.
+   Timers only run in between threads, so this is called from the work
+   which may keep the main thread busy for longer than a keepalive
+   interval: route processing, the nexthop and PIC scans, announcing a
+   table to a peer, soft reconfiguration, writing the checkpoint, and
+   OVSDB updates and republishing.  Only the keepalive goes out, ahead
+   of the UPDATEs queued: the peer's adj-out is not packed meanwhile.
+   Sending stays cooperative: work which does not call this still holds
+   keepalives up.  Peers are looked at once a second at most. */
+void
+bgp_keepalives_send_due (void)
+{
+  static time_t last;
+  struct listnode *node, *nnode, *pnode, *pnnode;
+  struct bgp *bgp;
+  struct peer *peer;
+  time_t now;
+
+  now = bgp_clock ();
+  if (now == last)
+    return;
+  last = now;
+
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
+    for (ALL_LIST_ELEMENTS (bgp->peer, pnode, pnnode, peer))
+      {
+	if (peer->status != Established || ! peer->t_keepalive
+	    || thread_timer_remain_second (peer->t_keepalive) > 0)
+	  continue;
+
+	if (BGP_DEBUG (fsm, FSM))
+	  zlog (peer->log, LOG_DEBUG,
+		"%s [FSM] Keepalive due while busy", peer->host);
+
+	/* The write thread does not get to run either. */
+	BGP_TIMER_OFF (peer->t_keepalive);
+	bgp_keepalive_send_now (peer);
+	bgp_timer_set (peer);
+      }
+}
+
 static int
 bgp_routeadv_timer (struct thread *thread)
 {
@@ -510,6 +578,10 @@ bgp_stop (struct peer *peer)
   /* Stop read and write threads when exists. */
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
+  THREAD_OFF (peer->t_process_packet);
+
+  /* The reader goes before the socket is closed. */
+  bgp_io_stop (peer);
 
   /* Stop all timers. */
   BGP_TIMER_OFF (peer->t_start);
@@ -525,11 +597,16 @@ bgp_stop (struct peer *peer)
   /* Clear input and output buffer.  */
   if (peer->ibuf)
     stream_reset (peer->ibuf);
+  if (peer->ibuf_work)
+    stream_reset (peer->ibuf_work);
   if (peer->work)
     stream_reset (peer->work);
   if (peer->obuf)
     stream_fifo_clean (peer->obuf);
 
+  /* Cached attributes were checked against this session's parameters. */
+  bgp_attr_cache_flush (peer);
+
   /* Close of file descriptor. */
   if (peer->fd >= 0)
     {
@@ -640,7 +717,11 @@ bgp_connect_success (struct peer *peer)
                 peer->fd);
       return -1;
     }
-  BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+  if (bgp_io_start (peer) < 0)
+    {
+      BGP_EVENT_ADD (peer, TCP_fatal_error);
+      return -1;
+    }
 
   if (! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
     bgp_getsockname (peer);
@@ -937,15 +1018,14 @@ bgp_fsm_keepalive (struct peer *peer)
   bgp_daemon_ovsdb_neighbor_statistics_update(true, NULL, peer);
 #endif // ENABLE_OVSDB
 
-  BGP_TIMER_OFF (peer->t_holdtime);
   return 0;
 }
 
-/* Update packet is received. */
+/* Update packet is received.  The hold timer goes by peer->readtime,
+   see bgp_holdtime_timer(). */
 static int
 bgp_fsm_update (struct peer *peer)
 {
-  BGP_TIMER_OFF (peer->t_holdtime);
   return 0;
 }
 
@@ -69,12 +69,14 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
   do { 						\
     assert (peer); 				\
     thread_cancel_event (master, (P)); 		\
+    (P)->t_process_packet = NULL;		\
   } while (0)
 
 /* Prototypes. */
 extern int bgp_event (struct thread *);
 extern int bgp_stop (struct peer *peer);
 extern void bgp_timer_set (struct peer *);
+extern void bgp_keepalives_send_due (void);
 extern void bgp_fsm_change_status (struct peer *peer, int status);
 extern const char *peer_down_str[];
 
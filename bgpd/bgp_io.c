@@ -0,0 +1,472 @@
+/* BGP socket input on reader threads
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Once its TCP connection is up, a peer's socket is read by one of a
+   few reader threads, BGP_IO_THREADS at most, each of which polls the
+   sockets of the peers given to it.  A reader reads whatever a socket
+   has into the peer's buffer, and splits it into messages by their
+   length.  The complete messages are handed to the main thread: a byte
+   in a pipe wakes bgp_read, which takes them with bgp_io_fetch and
+   checks and parses them as before.  The reader notes when a message
+   was last complete, so that the hold timer does not expire while the
+   peer's keepalives wait behind other work of the main thread.
+
+   A reader only touches the struct bgp_io of its peers: not the peers,
+   and it neither allocates through the memory types nor logs.  A peer
+   is taken off its reader before the socket is closed.  When an
+   accepted connection is handed over to the configured peer, its
+   struct bgp_io goes along with it. */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <poll.h>
+
+#include "stream.h"
+#include "thread.h"
+#include "log.h"
+#include "memory.h"
+#include "network.h"
+#include "vty.h"
+#include "prefix.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
+
+/* Reader threads.  Sockets are nonblocking, so a reader is never held
+   up by one peer; the threads only spread the copying and framing. */
+#define BGP_IO_THREADS 4
+
+struct bgp_io_reader
+{
+  pthread_t tid;
+  int started;
+  int kick[2];			/* the peers or their room changed */
+
+  /* Under mtx, which is taken before that of a struct bgp_io. */
+  pthread_mutex_t mtx;
+  struct bgp_io *ios;		/* the peers read */
+  int count;
+  unsigned int gen;		/* bumped whenever ios changes */
+};
+
+struct bgp_io
+{
+  int fd;			/* the peer's socket */
+  struct bgp_io_reader *reader;
+  struct bgp_io *next;		/* on the reader's list */
+  int wake[2];			/* input is waiting for the main thread */
+
+  pthread_mutex_t mtx;
+
+  /* Under mtx.  The main thread takes from before framed. */
+  struct stream *in;
+  size_t framed;		/* end of the complete messages */
+  int unsynced;			/* a message length was out of range */
+  int woken;			/* a byte is in the wake pipe */
+  int full;			/* not polled until input is taken */
+  int closed;			/* nothing more is read */
+  int error;			/* errno of the failed read, if any */
+  time_t readtime;		/* a message was last complete */
+};
+
+static struct bgp_io_reader bgp_io_readers[BGP_IO_THREADS];
+
+/* Let the main thread know there is something for it.  Called with
+   the mutex held. */
+static void
+bgp_io_wake (struct bgp_io *io)
+{
+  char c = 0;
+
+  if (io->woken)
+    return;
+  io->woken = 1;
+  if (write (io->wake[1], &c, 1) < 0)
+    io->woken = 0;
+}
+
+/* Have the reader look at its peers again.  The pipe is nonblocking:
+   when it is full, the reader has enough to wake for. */
+static void
+bgp_io_kick (struct bgp_io_reader *reader)
+{
+  char c = 0;
+
+  if (write (reader->kick[1], &c, 1) < 0 && ! ERRNO_IO_RETRY (errno))
+    zlog_warn ("%s: %s", __func__, safe_strerror (errno));
+}
+
+/* Find the end of the complete messages read.  A length out of range
+   is handed over with its header, and everything read behind it, for
+   bgp_packet_check to refuse.  Returns 1 if new messages are complete.
+   Called with the mutex held. */
+static int
+bgp_io_frame (struct bgp_io *io)
+{
+  struct stream *s = io->in;
+  size_t framed = io->framed;
+  size_t endp = stream_get_endp (s);
+  bgp_size_t size;
+
+  while (! io->unsynced && endp - framed >= BGP_HEADER_SIZE)
+    {
+      size = stream_getw_from (s, framed + BGP_MARKER_SIZE);
+      if (size < BGP_HEADER_SIZE || size > BGP_MAX_PACKET_SIZE)
+	io->unsynced = 1;
+      else if (endp - framed < size)
+	break;
+      else
+	framed += size;
+    }
+  if (io->unsynced)
+    framed = endp;
+
+  if (framed == io->framed)
+    return 0;
+  io->framed = framed;
+  return 1;
+}
+
+/* Make room behind what the main thread has not taken yet.  Returns 0
+   if the peer is not to be polled.  Called with the mutex held. */
+static int
+bgp_io_room (struct bgp_io *io)
+{
+  struct stream *s = io->in;
+
+  if (io->closed)
+    return 0;
+  io->framed -= stream_get_getp (s);
+  stream_pulldown (s);
+  io->full = ! STREAM_WRITEABLE (s);
+  return ! io->full;
+}
+
+/* Read what the peer's socket has.  Called with the mutex held. */
+static void
+bgp_io_read (struct bgp_io *io)
+{
+  struct stream *s = io->in;
+  struct timespec now;
+  size_t endp;
+  ssize_t nbytes;
+
+  if (! bgp_io_room (io))
+    return;
+
+  endp = stream_get_endp (s);
+  nbytes = read (io->fd, STREAM_DATA (s) + endp, STREAM_SIZE (s) - endp);
+  if (nbytes < 0 && ERRNO_IO_RETRY (errno))
+    return;
+  if (nbytes <= 0)
+    {
+      io->error = (nbytes < 0) ? errno : 0;
+      io->closed = 1;
+      bgp_io_wake (io);
+      return;
+    }
+
+  stream_set_endp (s, endp + nbytes);
+  if (bgp_io_frame (io))
+    {
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      io->readtime = now.tv_sec;
+      bgp_io_wake (io);
+    }
+}
+
+static void *
+bgp_io_reader (void *arg)
+{
+  struct bgp_io_reader *reader = arg;
+  struct pollfd *fds = NULL;
+  struct bgp_io **polled = NULL;
+  struct bgp_io *io;
+  unsigned int gen;
+  int max = 0;
+  int nfds, ret, i;
+  char buf[64];
+
+  pthread_mutex_lock (&reader->mtx);
+  for (;;)
+    {
+      /* The arrays are the reader's own: plain realloc, as the memory
+	 statistics are not kept for threads. */
+      if (reader->count + 1 > max)
+	{
+	  max = reader->count + 1;
+	  fds = realloc (fds, max * sizeof (struct pollfd));
+	  polled = realloc (polled, max * sizeof (struct bgp_io *));
+	  assert (fds && polled);
+	}
+
+      fds[0].fd = reader->kick[0];
+      fds[0].events = POLLIN;
+      nfds = 1;
+      for (io = reader->ios; io; io = io->next)
+	{
+	  pthread_mutex_lock (&io->mtx);
+	  if (bgp_io_room (io))
+	    {
+	      fds[nfds].fd = io->fd;
+	      fds[nfds].events = POLLIN;
+	      polled[nfds++] = io;
+	    }
+	  pthread_mutex_unlock (&io->mtx);
+	}
+      gen = reader->gen;
+      pthread_mutex_unlock (&reader->mtx);
+
+      ret = poll (fds, nfds, -1);
+      pthread_mutex_lock (&reader->mtx);
+      if (ret < 0)
+	continue;
+      if (fds[0].revents)
+	while (read (reader->kick[0], buf, sizeof (buf)) > 0)
+	  ;
+
+      /* A peer was taken off: its socket may be closed, and the
+	 descriptor used again.  What the others have waits for the
+	 next poll. */
+      if (gen != reader->gen)
+	continue;
+
+      for (i = 1; i < nfds; i++)
+	if (fds[i].revents)
+	  {
+	    io = polled[i];
+	    pthread_mutex_lock (&io->mtx);
+	    bgp_io_read (io);
+	    pthread_mutex_unlock (&io->mtx);
+	  }
+    }
+
+  return NULL;
+}
+
+/* Start the reader, with the signals left to the main thread. */
+static int
+bgp_io_reader_start (struct bgp_io_reader *reader)
+{
+  sigset_t sigs, oldsigs;
+  int ret;
+
+  if (pipe (reader->kick) < 0)
+    return errno;
+  set_nonblocking (reader->kick[0]);
+  set_nonblocking (reader->kick[1]);
+  pthread_mutex_init (&reader->mtx, NULL);
+
+  sigfillset (&sigs);
+  pthread_sigmask (SIG_BLOCK, &sigs, &oldsigs);
+  ret = pthread_create (&reader->tid, NULL, bgp_io_reader, reader);
+  pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+  if (ret)
+    {
+      close (reader->kick[0]);
+      close (reader->kick[1]);
+      pthread_mutex_destroy (&reader->mtx);
+      return ret;
+    }
+
+  reader->started = 1;
+  return 0;
+}
+
+/* The reader with the fewest peers, started if need be.  The readers
+   stay up once started. */
+static struct bgp_io_reader *
+bgp_io_reader_get (struct peer *peer)
+{
+  struct bgp_io_reader *reader = NULL;
+  int i, ret;
+
+  for (i = 0; i < BGP_IO_THREADS; i++)
+    {
+      if (! bgp_io_readers[i].started)
+	{
+	  if ((ret = bgp_io_reader_start (&bgp_io_readers[i])) != 0)
+	    {
+	      zlog_err ("%s: could not start a reader for %s: %s", __func__,
+			peer->host, safe_strerror (ret));
+	      break;
+	    }
+	  return &bgp_io_readers[i];
+	}
+      if (! reader || bgp_io_readers[i].count < reader->count)
+	reader = &bgp_io_readers[i];
+    }
+  return reader;
+}
+
+static void
+bgp_io_free (struct bgp_io *io)
+{
+  if (io->wake[0] >= 0)
+    close (io->wake[0]);
+  if (io->wake[1] >= 0)
+    close (io->wake[1]);
+  pthread_mutex_destroy (&io->mtx);
+  stream_free (io->in);
+  XFREE (MTYPE_BGP_IO, io);
+}
+
+/* Start reading from the peer's socket, and watch for the input the
+   reader hands over. */
+int
+bgp_io_start (struct peer *peer)
+{
+  struct bgp_io_reader *reader;
+  struct bgp_io *io;
+
+  if (peer->io)
+    return 0;
+
+  if ((reader = bgp_io_reader_get (peer)) == NULL)
+    return -1;
+
+  io = XCALLOC (MTYPE_BGP_IO, sizeof (struct bgp_io));
+  io->fd = peer->fd;
+  io->reader = reader;
+  io->wake[0] = io->wake[1] = -1;
+  io->in = stream_new (BGP_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX);
+  io->readtime = bgp_clock ();
+  pthread_mutex_init (&io->mtx, NULL);
+
+  if (pipe (io->wake) < 0)
+    {
+      zlog_err ("%s: no pipe for %s: %s", __func__, peer->host,
+		safe_strerror (errno));
+      bgp_io_free (io);
+      return -1;
+    }
+
+  pthread_mutex_lock (&reader->mtx);
+  io->next = reader->ios;
+  reader->ios = io;
+  reader->count++;
+  reader->gen++;
+  pthread_mutex_unlock (&reader->mtx);
+  bgp_io_kick (reader);
+
+  peer->io = io;
+  BGP_READ_ON (peer->t_read, bgp_read, io->wake[0]);
+  return 0;
+}
+
+/* Stop reading from the peer's socket.  Input not taken yet is lost.
+   The peer's read thread must be off already.  Once the reader's
+   mutex is let go, the reader does not look at the peer again. */
+void
+bgp_io_stop (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  struct bgp_io_reader *reader;
+  struct bgp_io **iop;
+
+  if (! io)
+    return;
+
+  reader = io->reader;
+  pthread_mutex_lock (&reader->mtx);
+  for (iop = &reader->ios; *iop; iop = &(*iop)->next)
+    if (*iop == io)
+      {
+	*iop = io->next;
+	break;
+      }
+  reader->count--;
+  reader->gen++;
+  pthread_mutex_unlock (&reader->mtx);
+  bgp_io_kick (reader);
+
+  peer->io = NULL;
+  bgp_io_free (io);
+}
+
+/* The descriptor bgp_read watches for input handed over. */
+int
+bgp_io_fd (struct peer *peer)
+{
+  return peer->io ? peer->io->wake[0] : -1;
+}
+
+/* Move the complete messages handed over into s, as far as they fit.
+   Returns the number of bytes moved, -2 if there was nothing to move,
+   0 once the peer closed the connection, and -1 with errno set once
+   reading from it failed. */
+int
+bgp_io_fetch (struct peer *peer, struct stream *s)
+{
+  struct bgp_io *io = peer->io;
+  size_t size;
+  int ret = -2;
+  char c;
+
+  pthread_mutex_lock (&io->mtx);
+  size = MIN (io->framed - stream_get_getp (io->in), STREAM_WRITEABLE (s));
+  if (size)
+    {
+      stream_put (s, stream_pnt (io->in), size);
+      stream_forward_getp (io->in, size);
+      ret = size;
+      if (io->full)
+	{
+	  io->full = 0;
+	  bgp_io_kick (io->reader);
+	}
+    }
+  else if (io->closed)
+    {
+      errno = io->error;
+      ret = io->error ? -1 : 0;
+    }
+
+  /* All taken: the reader wakes us again when it has more.  Otherwise
+     the wake byte stays, and bgp_read comes back for the rest once
+     there is room. */
+  if (io->woken && ! io->closed && io->framed == stream_get_getp (io->in))
+    {
+      if (read (io->wake[0], &c, 1) == 1)
+	io->woken = 0;
+    }
+  pthread_mutex_unlock (&io->mtx);
+
+  return ret;
+}
+
+/* When the reader last had a complete message from the peer, on the
+   clock of bgp_clock. */
+time_t
+bgp_io_readtime (struct peer *peer)
+{
+  time_t readtime;
+
+  if (! peer->io)
+    return 0;
+
+  pthread_mutex_lock (&peer->io->mtx);
+  readtime = peer->io->readtime;
+  pthread_mutex_unlock (&peer->io->mtx);
+  return readtime;
+}
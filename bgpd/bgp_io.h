@@ -0,0 +1,30 @@
+/* BGP socket input on a thread of its own
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_IO_H
+#define _QUAGGA_BGP_IO_H
+
+extern int bgp_io_start (struct peer *);
+extern void bgp_io_stop (struct peer *);
+extern int bgp_io_fd (struct peer *);
+extern int bgp_io_fetch (struct peer *, struct stream *);
+extern time_t bgp_io_readtime (struct peer *);
+
+#endif /* _QUAGGA_BGP_IO_H */
@@ -43,6 +43,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_regex.h"
@@ -50,6 +51,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_checkpoint.h"
 
 #ifdef ENABLE_OVSDB
 #include "bgpd/bgp_ovsdb_if.h"
@@ -74,6 +76,8 @@ static const struct option longopts[] =
   { "group",       required_argument, NULL, 'g'},
   { "version",     no_argument,       NULL, 'v'},
   { "dryrun",      no_argument,       NULL, 'C'},
+  { "threads",     required_argument, NULL, 't'},
+  { "checkpoint",  required_argument, NULL, 'k'},
   { "help",        no_argument,       NULL, 'h'},
   { 0 }
 };
@@ -111,6 +115,9 @@ char config_default[] = SYSCONFDIR BGP_DEFAULT_CONFIG;
 /* Route retain mode flag. */
 static int retain_mode = 0;
 
+/* Checkpoint file of the routes in the FIB. */
+static const char *checkpoint_file = NULL;
+
 /* Master of threads. */
 struct thread_master *master;
 
@@ -171,6 +178,8 @@ redistribution between different routing protocols.\n\n\
 -g, --group        Group to run as\n\
 -v, --version      Print program version\n\
 -C, --dryrun       Check configuration for validity and exit\n\
+-t, --threads      Number of threads comparing paths in best path selection\n\
+-k, --checkpoint   Keep checkpoints of the routes in the FIB in this file\n\
 -h, --help         Display this help and exit\n\
 \n\
 Report bugs to %s\n", progname, ZEBRA_BUG_ADDRESS);
@@ -209,6 +218,8 @@ sigint (void)
 
   if (! retain_mode)
     bgp_terminate ();
+  else
+    bgp_checkpoint_write ();
 
   zprivs_terminate (&bgpd_privs);
   bgp_exit (0);
@@ -272,9 +283,15 @@ bgp_exit (int status)
   /* reverse bgp_attr_init */
   bgp_attr_finish ();
 
+  /* messages shared between the peers */
+  bgp_packet_finish ();
+
   /* reverse bgp_dump_init */
   bgp_dump_finish ();
 
+  /* reverse bgp_checkpoint_init */
+  bgp_checkpoint_finish ();
+
   /* reverse bgp_route_init */
   bgp_route_finish ();
 
@@ -381,7 +398,7 @@ main (int argc, char **argv)
   /* Command line argument treatment. */
   while (1) 
     {
-      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vCt:k:", longopts, 0);
     
       if (opt == EOF)
 	break;
@@ -433,6 +450,12 @@ main (int argc, char **argv)
 	case 'n':
 	  bgp_option_set (BGP_OPT_NO_FIB);
 	  break;
+	case 't':
+	  bm->process_threads = atoi (optarg);
+	  break;
+	case 'k':
+	  checkpoint_file = optarg;
+	  break;
 	case 'u':
 	  bgpd_privs.user = optarg;
 	  break;
@@ -481,6 +504,10 @@ main (int argc, char **argv)
   /* Start execution only if not in dry-run mode */
   if(dryrun)
     return(0);
+
+  /* Restore from the checkpoint left by the previous bgpd, if any. */
+  if (checkpoint_file)
+    bgp_checkpoint_init (checkpoint_file);
   
 #ifndef ENABLE_OVSDB
   /* Turn into daemon if daemon_mode is set. */
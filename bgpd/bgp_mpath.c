@@ -563,20 +563,53 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
 void
 bgp_mp_dmed_deselect (struct bgp_info *dmed_best)
 {
-  struct bgp_info *mpinfo, *mpnext;
-
   if (!dmed_best)
     return;
 
-  for (mpinfo = bgp_info_mpath_first (dmed_best); mpinfo; mpinfo = mpnext)
+  bgp_info_mpath_clear (dmed_best);
+}
+
+/*
+ * bgp_info_mpath_clear
+ *
+ * Drop all multipaths attached to a best path, e.g. when the best path
+ * is being replaced by its backup without running best path selection.
+ */
+void
+bgp_info_mpath_clear (struct bgp_info *best)
+{
+  struct bgp_info *mpinfo, *mpnext;
+
+  for (mpinfo = bgp_info_mpath_first (best); mpinfo; mpinfo = mpnext)
     {
       mpnext = bgp_info_mpath_next (mpinfo);
       bgp_info_mpath_dequeue (mpinfo);
     }
 
-  bgp_info_mpath_count_set (dmed_best, 0);
-  UNSET_FLAG (dmed_best->flags, BGP_INFO_MULTIPATH_CHG);
-  assert (bgp_info_mpath_first (dmed_best) == 0);
+  bgp_info_mpath_count_set (best, 0);
+  UNSET_FLAG (best->flags, BGP_INFO_MULTIPATH_CHG);
+  assert (bgp_info_mpath_first (best) == 0);
+}
+
+/*
+ * bgp_info_backup_eligible
+ *
+ * Check whether a path may be kept as the precomputed backup of a best
+ * path: it must not share its fate with the best path, i.e. it has to
+ * come from another peer over another nexthop.  The caller has to check
+ * that it is not forwarded on as one of the multipaths already, as that
+ * may only be known after bgp_info_mpath_update.
+ */
+int
+bgp_info_backup_eligible (struct bgp_info *best, struct bgp_info *bi)
+{
+  if (!best || bi == best)
+    return 0;
+
+  if (bi->peer == best->peer)
+    return 0;
+
+  return bgp_info_nexthop_cmp (best, bi) != 0;
 }
 
 /*
@@ -65,6 +65,10 @@ extern void bgp_info_mpath_update (struct bgp_node *, struct bgp_info *,
 extern void bgp_info_mpath_aggregate_update (struct bgp_info *,
                                              struct bgp_info *);
 
+/* Functions used for prefix independent convergence */
+extern void bgp_info_mpath_clear (struct bgp_info *);
+extern int bgp_info_backup_eligible (struct bgp_info *, struct bgp_info *);
+
 /* Unlink and free multipath information associated with a bgp_info */
 extern void bgp_info_mpath_dequeue (struct bgp_info *);
 extern void bgp_info_mpath_free (struct bgp_info_mpath **);
@@ -38,6 +38,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_damp.h"
+#include "bgpd/bgp_fsm.h"
 #include "zebra/rib.h"
 #include "zebra/zserv.h"	/* For ZEBRA_SERV_PATH. */
 
@@ -264,28 +265,27 @@ bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
 	bnc = bnc_new ();
       else
 	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
+	  /* Compared with the old cache whether or not the caller asks,
+	     since the entry is kept for the lookups after it. */
+	  struct bgp_table *old;
+	  struct bgp_node *oldrn;
 
-	      if (bgp_nexthop_cache_table[AFI_IP6] == cache1_table[AFI_IP6])
-		old = cache2_table[AFI_IP6];
-	      else
-		old = cache1_table[AFI_IP6];
+	  if (bgp_nexthop_cache_table[AFI_IP6] == cache1_table[AFI_IP6])
+	    old = cache2_table[AFI_IP6];
+	  else
+	    old = cache1_table[AFI_IP6];
 
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
+	  oldrn = bgp_node_lookup (old, &p);
+	  if (oldrn)
+	    {
+	      struct bgp_nexthop_cache *oldbnc = oldrn->info;
 
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
+	      bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
 
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
+	      if (bnc->metric != oldbnc->metric)
+		bnc->metricchanged = 1;
 
-                  bgp_unlock_node (oldrn);
-		}
+	      bgp_unlock_node (oldrn);
 	    }
 	}
       rn->info = bnc;
@@ -350,28 +350,27 @@ bgp_nexthop_lookup (afi_t afi, struct peer *peer, struct bgp_info *ri,
 	bnc = bnc_new ();
       else
 	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
+	  /* Compared with the old cache whether or not the caller asks,
+	     since the entry is kept for the lookups after it. */
+	  struct bgp_table *old;
+	  struct bgp_node *oldrn;
 
-	      if (bgp_nexthop_cache_table[AFI_IP] == cache1_table[AFI_IP])
-		old = cache2_table[AFI_IP];
-	      else
-		old = cache1_table[AFI_IP];
+	  if (bgp_nexthop_cache_table[AFI_IP] == cache1_table[AFI_IP])
+	    old = cache2_table[AFI_IP];
+	  else
+	    old = cache1_table[AFI_IP];
 
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
+	  oldrn = bgp_node_lookup (old, &p);
+	  if (oldrn)
+	    {
+	      struct bgp_nexthop_cache *oldbnc = oldrn->info;
 
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
+	      bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
 
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
+	      if (bnc->metric != oldbnc->metric)
+		bnc->metricchanged = 1;
 
-                  bgp_unlock_node (oldrn);
-		}
+	      bgp_unlock_node (oldrn);
 	    }
 	}
       rn->info = bnc;
@@ -407,6 +406,21 @@ bgp_nexthop_cache_reset (struct bgp_table *table)
       }
 }
 
+/* Check whether the nexthop of a path is reachable. */
+int
+bgp_info_nexthop_check (afi_t afi, struct bgp_info *bi, int *changed,
+			int *metricchanged)
+{
+  if (bi->type != ZEBRA_ROUTE_BGP || bi->sub_type != BGP_ROUTE_NORMAL)
+    return 1;
+
+  if (bi->peer->sort == BGP_PEER_EBGP && bi->peer->ttl == 1
+      && !CHECK_FLAG(bi->peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+    return bgp_nexthop_onlink (afi, bi->attr);
+
+  return bgp_nexthop_lookup (afi, bi->peer, bi, changed, metricchanged);
+}
+
 static void
 bgp_scan (afi_t afi, safi_t safi)
 {
@@ -446,6 +460,9 @@ bgp_scan (afi_t afi, safi_t safi)
 	bgp_maximum_prefix_overflow (peer, afi, SAFI_MPLS_VPN, 1);
     }
 
+  if (bgp_flag_check (bgp, BGP_FLAG_PIC))
+    bgp_pic_nexthop_scan (bgp, afi);
+
   for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
        rn = bgp_route_next (rn))
     {
@@ -458,12 +475,7 @@ bgp_scan (afi_t afi, safi_t safi)
 	      changed = 0;
 	      metricchanged = 0;
 
-	      if (bi->peer->sort == BGP_PEER_EBGP && bi->peer->ttl == 1
-		  && !CHECK_FLAG(bi->peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
-		valid = bgp_nexthop_onlink (afi, bi->attr);
-	      else
-		valid = bgp_nexthop_lookup (afi, bi->peer, bi,
-					    &changed, &metricchanged);
+	      valid = bgp_info_nexthop_check (afi, bi, &changed, &metricchanged);
 
 	      current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
 
@@ -479,6 +491,7 @@ bgp_scan (afi_t afi, safi_t safi)
 		      bgp_aggregate_decrement (bgp, &rn->p, bi,
 					       afi, SAFI_UNICAST);
 		      bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
+		      bgp_pic_switchover (bgp, rn, bi, afi, SAFI_UNICAST);
 		    }
 		  else
 		    {
@@ -497,6 +510,7 @@ bgp_scan (afi_t afi, safi_t safi)
 	    }
 	}
       bgp_process (bgp, rn, afi, SAFI_UNICAST);
+      bgp_keepalives_send_due ();
     }
 
   /* Flash old cache. */
@@ -543,6 +557,19 @@ bgp_scan_timer (struct thread *t)
   return 0;
 }
 
+/* Zebra told about an interface or address going away: check the
+   nexthops right now rather than at the next scan interval, so that
+   bgp pic fails the routes using them over to their backups. */
+void
+bgp_scan_now (void)
+{
+  if (bgp_scan_thread == NULL)
+    return;
+
+  thread_cancel (bgp_scan_thread);
+  bgp_scan_thread = thread_add_event (master, bgp_scan_timer, NULL, 0);
+}
+
 /* BGP own address structure */
 struct bgp_addr
 {
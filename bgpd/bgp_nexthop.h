@@ -48,8 +48,10 @@ struct bgp_nexthop_cache
 
 extern void bgp_scan_init (void);
 extern void bgp_scan_finish (void);
+extern void bgp_scan_now (void);
 extern int bgp_nexthop_lookup (afi_t, struct peer *peer, struct bgp_info *,
 			int *, int *);
+extern int bgp_info_nexthop_check (afi_t, struct bgp_info *, int *, int *);
 extern void bgp_connected_add (struct connected *c);
 extern void bgp_connected_delete (struct connected *c);
 extern int bgp_multiaccess_check_v4 (struct in_addr, char *);
@@ -88,6 +88,9 @@ static bgp_ovsdb_t glob_bgp_ovs;
 #define MAX_ERR_STR_LEN 256
 #define PEER_DOWN_TRIGGER_LEN 100
 
+/* Seconds between two publications of the neighbor statistics. */
+#define BGP_NBR_STATS_INTERVAL 1
+
 COVERAGE_DEFINE(bgp_ovsdb_cnt);
 VLOG_DEFINE_THIS_MODULE(bgp_ovsdb_if);
 
@@ -475,12 +478,13 @@ bgp_dump_memory (struct ds *ds)
                                      count * sizeof (struct bgp_static)));
 
     /* Adj-In/Out */
-    count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN);
+    count = bgp_adj_in_count ();
     if (count > 0)
         ds_put_format (ds, "%ld Adj-In entries, using %s of memory\n",
                        count,
                        mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                                     count * sizeof (struct bgp_adj_in)));
+                                     mtype_stats_alloc (MTYPE_BGP_ADJ_IN_BLOCK)
+                                     * BGP_ADJ_IN_BLOCK_BYTES));
 
     count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT);
     if (count > 0)
@@ -2019,43 +2023,49 @@ get_bgp_neighbor_db_row (struct peer *peer)
     return NULL;
 }
 
-void
-bgp_daemon_ovsdb_neighbor_statistics_update (bool start_new_db_txn,
-    const struct ovsrec_bgp_neighbor *ovs_bgp_neighbor_ptr,
+/*
+ * Same as get_bgp_neighbor_db_row, but remembers the uuid of the row
+ * in the peer, so that later lookups are a hash lookup in the idl
+ * instead of a walk over all vrfs, routers and neighbors.  The row
+ * itself is not kept, since the idl frees it when it goes away.
+ */
+static const struct ovsrec_bgp_neighbor *
+get_bgp_neighbor_db_row_cached (struct peer *peer)
+{
+    const struct ovsrec_bgp_neighbor *row;
+
+    if (!uuid_is_zero(&peer->nbr_row_uuid)) {
+        row = ovsrec_bgp_neighbor_get_for_uuid(idl, &peer->nbr_row_uuid);
+        if (row) {
+            return row;
+        }
+    }
+
+    row = get_bgp_neighbor_db_row(peer);
+    if (row) {
+        peer->nbr_row_uuid = row->header_.uuid;
+    } else {
+        uuid_zero(&peer->nbr_row_uuid);
+    }
+    return row;
+}
+
+static void
+bgp_nbr_stats_set (const struct ovsrec_bgp_neighbor *ovs_bgp_neighbor_ptr,
     struct peer *peer)
 {
 
 #define MAX_BGP_NEIGHBOR_STATS        64
 
-    struct ovsdb_idl_txn *db_txn;
     char *keywords[MAX_BGP_NEIGHBOR_STATS];
     int64_t values [MAX_BGP_NEIGHBOR_STATS];
     int count;
-    enum ovsdb_idl_txn_status status;
 
 #define ADD_BGPN_STAT(key, value) \
     keywords[count] = key; \
     values[count] = value; \
     count++
 
-    /* if row is not given, find it */
-    if (NULL == ovs_bgp_neighbor_ptr) {
-        ovs_bgp_neighbor_ptr = get_bgp_neighbor_db_row(peer);
-
-        /* it is possible to come here with no db entry, this is ok */
-        if (NULL == ovs_bgp_neighbor_ptr) return;
-    }
-
-    /* is this an independent txn or piggybacked onto another txn */
-    if (start_new_db_txn) {
-        db_txn = ovsdb_idl_txn_create(idl);
-        if (NULL == db_txn) {
-            VLOG_ERR("%%ovsdb_idl_txn_create failed in "
-            "bgp_daemon_ovsdb_neighbor_statistics_update\n");
-            return;
-        }
-    }
-
     count = 0;
 
     ADD_BGPN_STAT(BGP_PEER_ESTABLISHED_COUNT,  peer->established);
@@ -2080,11 +2090,99 @@ bgp_daemon_ovsdb_neighbor_statistics_update (bool start_new_db_txn,
     ovsrec_bgp_neighbor_set_statistics(ovs_bgp_neighbor_ptr,
     keywords, values, count);
 
-    if (start_new_db_txn) {
+    peer->stats_dirty = 0;
+}
+
+/*
+ * Peers whose statistics changed since they were last published.
+ * Each holds a peer lock while on the list.
+ */
+static struct list *nbr_stats_dirty;
+static struct thread *t_nbr_stats;
+
+/*
+ * Publish the statistics of all dirty peers in one transaction.
+ */
+static int
+bgp_nbr_stats_publish (struct thread *thread)
+{
+    const struct ovsrec_bgp_neighbor *ovs_bgp_neighbor_ptr;
+    struct ovsdb_idl_txn *db_txn;
+    enum ovsdb_idl_txn_status status;
+    struct listnode *node, *nnode;
+    struct peer *peer;
+    int count = 0;
+
+    t_nbr_stats = NULL;
+
+    db_txn = ovsdb_idl_txn_create(idl);
+    if (NULL == db_txn) {
+        VLOG_ERR("%%ovsdb_idl_txn_create failed in "
+                 "bgp_nbr_stats_publish\n");
+    }
+
+    for (ALL_LIST_ELEMENTS(nbr_stats_dirty, node, nnode, peer)) {
+        if (db_txn && peer->stats_dirty && peer->status != Deleted) {
+            /* it is possible to have no db entry, this is ok */
+            ovs_bgp_neighbor_ptr = get_bgp_neighbor_db_row_cached(peer);
+            if (ovs_bgp_neighbor_ptr) {
+                bgp_nbr_stats_set(ovs_bgp_neighbor_ptr, peer);
+                count++;
+            }
+        }
+        peer->stats_queued = 0;
+        list_delete_node(nbr_stats_dirty, node);
+        peer_unlock(peer);
+    }
+
+    if (db_txn) {
         status = ovsdb_idl_txn_commit(db_txn);
         ovsdb_idl_txn_destroy(db_txn);
-        VLOG_DBG("%s OVSDB Neighbour statistics update transaction status is %s",
-                __FUNCTION__, ovsdb_idl_txn_status_to_string(status));
+        VLOG_DBG("%s OVSDB statistics update of %d neighbours, transaction "
+                 "status is %s", __FUNCTION__, count,
+                 ovsdb_idl_txn_status_to_string(status));
+    }
+    return 0;
+}
+
+/*
+ * Update the statistics of a peer in the database.  Piggybacked onto
+ * the caller's transaction they are written right away, otherwise the
+ * peer is only marked dirty and the statistics of all dirty peers are
+ * published together, at most once every BGP_NBR_STATS_INTERVAL
+ * seconds.
+ */
+void
+bgp_daemon_ovsdb_neighbor_statistics_update (bool start_new_db_txn,
+    const struct ovsrec_bgp_neighbor *ovs_bgp_neighbor_ptr,
+    struct peer *peer)
+{
+    if (!start_new_db_txn) {
+        /* if row is not given, find it */
+        if (NULL == ovs_bgp_neighbor_ptr) {
+            ovs_bgp_neighbor_ptr = get_bgp_neighbor_db_row_cached(peer);
+
+            /* it is possible to come here with no db entry, this is ok */
+            if (NULL == ovs_bgp_neighbor_ptr) return;
+        }
+        bgp_nbr_stats_set(ovs_bgp_neighbor_ptr, peer);
+        return;
+    }
+
+    peer->stats_dirty = 1;
+    if (peer->stats_queued) {
+        return;
+    }
+
+    if (NULL == nbr_stats_dirty) {
+        nbr_stats_dirty = list_new();
+    }
+    listnode_add(nbr_stats_dirty, peer_lock(peer));
+    peer->stats_queued = 1;
+
+    if (NULL == t_nbr_stats) {
+        t_nbr_stats = thread_add_timer(bm->master, bgp_nbr_stats_publish,
+                                       NULL, BGP_NBR_STATS_INTERVAL);
     }
 }
 
@@ -3120,6 +3218,9 @@ bgp_ovs_run ()
     ovsdb_idl_run(idl);
     unixctl_server_run(appctl);
 
+    /* A large batch of changes keeps the keepalive timers from running. */
+    bgp_keepalives_send_due();
+
     if (ovsdb_idl_is_lock_contended(idl)) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
 
@@ -3133,6 +3234,7 @@ bgp_ovs_run ()
     bgp_chk_for_system_configured();
     if (system_configured) {
         bgp_reconfigure(idl);
+        bgp_keepalives_send_due();
         daemonize_complete();
         vlog_enable_async();
         VLOG_INFO_ONCE("%s (OpenSwitch bgpd) %s", program_name, VERSION);
@@ -3249,5 +3351,19 @@ ovsdb_exit (void)
  */
 void bgp_ovsdb_exit (void)
 {
+    struct listnode *node, *nnode;
+    struct peer *peer;
+
+    THREAD_TIMER_OFF(t_nbr_stats);
+    if (nbr_stats_dirty) {
+        for (ALL_LIST_ELEMENTS(nbr_stats_dirty, node, nnode, peer)) {
+            peer->stats_queued = 0;
+            list_delete_node(nbr_stats_dirty, node);
+            peer_unlock(peer);
+        }
+        list_delete(nbr_stats_dirty);
+        nbr_stats_dirty = NULL;
+    }
+
     ovsdb_exit();
 }
@@ -47,14 +47,17 @@
 #include "thread.h"
 #include "workqueue.h"
 #include "ovs/hash.h"
+#include "ovsdb-data.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_checkpoint.h"
 #include "bgpd/bgp_ovsdb_route.h"
 #include "openvswitch/vlog.h"
 #include "bgpd/bgp_ovsdb_if.h"
@@ -248,61 +251,49 @@ bgp_ovsdb_get_vrf(struct bgp *bgp)
 }
 
 
-static int
-bgp_ovsdb_set_rib_path_attributes(struct smap *smap,
-                                  struct bgp_info *info,
-                                  struct bgp *bgp)
+/*
+ * The path attributes of a route which depend on its attr alone.  An
+ * interned attr is shared by many routes, so they are formatted once
+ * and kept on it until it is freed, see bgp_ovsdb_attr_free().  They
+ * are kept as a datum sorted by key, ready to be merged with the keys
+ * of each route.
+ */
+static const struct ovsdb_datum *
+bgp_ovsdb_attr_path_attributes(struct attr *attr)
 {
-    struct attr *attr;
-    struct peer *peer;
-    char *comm = NULL;
-    char *ecomm = NULL;
-    time_t tbuf;
+    struct ovsdb_datum *datum;
+    struct smap_node *node, *next;
+    struct smap attr_smap;
+    struct smap *smap = &attr_smap;
+    const char *comm = "";
+    const char *ecomm = "";
+    size_t i;
 
-     if (info == NULL) {
-        VLOG_DBG("In %s info is NULL", __FUNCTION__);
-        return -1;
+    if (attr->ovsdb_path_attributes) {
+        return attr->ovsdb_path_attributes;
     }
 
-    attr = info->attr;
-    peer = info->peer;
-    smap_add_format(smap,
-                    OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_FLAGS,
-                    "%d",
-                    info->flags);
+    smap_init(smap);
+
     smap_add(smap,
              OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_AS_PATH,
-             aspath_print(info->attr->aspath));
+             aspath_print(attr->aspath));
     smap_add(smap,
              OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ORIGIN,
-             bgp_origin_str[info->attr->origin]);
+             bgp_origin_str[attr->origin]);
 
     if (attr->community) {
-        comm = (char *)community_str(attr->community);
-    }
-    if (attr->extra) {
-        if (attr->extra->ecommunity) {
-            ecomm =  (char *)ecommunity_str(attr->extra->ecommunity);
-        }
+        comm = community_str(attr->community);
     }
-    if(comm != NULL) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_COMMUNITY,
-                 comm);
-    } else if(comm == NULL) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_COMMUNITY,
-                 "");
-    }
-    if(ecomm != NULL) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ECOMMUNITY,
-                 ecomm);
-    } else if(ecomm == NULL) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ECOMMUNITY,
-                 "");
+    if (attr->extra && attr->extra->ecommunity) {
+        ecomm = ecommunity_str(attr->extra->ecommunity);
     }
+    smap_add(smap,
+             OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_COMMUNITY,
+             comm);
+    smap_add(smap,
+             OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ECOMMUNITY,
+             ecomm);
 
     smap_add_format(smap,
                     OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_LOC_PREF,
@@ -342,9 +333,6 @@ bgp_ovsdb_set_rib_path_attributes(struct smap *smap,
         smap_add(smap,
                  OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_AGGREGATOR_ADDR,
                  "");
-        smap_add(smap,
-                OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ECOMMUNITY,
-                 "");
     }
     if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE)) {
         smap_add(smap,
@@ -355,36 +343,121 @@ bgp_ovsdb_set_rib_path_attributes(struct smap *smap,
                  OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_ATOMIC_AGGREGATE,
                  "");
     }
+
+    datum = xmalloc(sizeof *datum);
+    datum->n = smap_count(smap);
+    datum->keys = xmalloc(datum->n * sizeof *datum->keys);
+    datum->values = xmalloc(datum->n * sizeof *datum->values);
+    i = 0;
+    SMAP_FOR_EACH_SAFE (node, next, smap) {
+        smap_steal(smap, node, &datum->keys[i].string,
+                   &datum->values[i].string);
+        i++;
+    }
+    smap_destroy(smap);
+    ovsdb_datum_sort_unique(datum, OVSDB_TYPE_STRING, OVSDB_TYPE_STRING);
+
+    attr->ovsdb_path_attributes = datum;
+    return datum;
+}
+
+/* Called by bgp_attr_unintern() as an interned attr is freed. */
+void
+bgp_ovsdb_attr_free(struct attr *attr)
+{
+    if (attr->ovsdb_path_attributes) {
+        ovsdb_datum_destroy(attr->ovsdb_path_attributes,
+                            &ovsrec_bgp_route_col_path_attributes.type);
+        free(attr->ovsdb_path_attributes);
+        attr->ovsdb_path_attributes = NULL;
+    }
+}
+
+/*
+ * Write the path attributes of a route to its row.  The keys which
+ * depend on the route itself are formatted here and merged in key order
+ * with those kept on its attr, into the datum handed to the IDL.  The
+ * IDL takes the datum over, so the kept strings are duplicated once, but
+ * no map is built and nothing is sorted for each route.
+ */
+static int
+bgp_ovsdb_set_rib_path_attributes(const struct ovsrec_bgp_route *rib,
+                                  struct bgp_info *info,
+                                  struct bgp *bgp)
+{
+    const struct ovsdb_datum *attrs;
+    struct ovsdb_datum datum;
+    const char *keys[4];
+    char *values[4];
+    const char *key;
+    char *value;
+    struct peer *peer;
+    time_t tbuf;
+    size_t n = 0, i, j, k;
+
+     if (info == NULL) {
+        VLOG_DBG("In %s info is NULL", __FUNCTION__);
+        return -1;
+    }
+
+    peer = info->peer;
+    keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_FLAGS;
+    values[n++] = xasprintf("%d", info->flags);
+
     /* TODO: Check for confed flag later */
     if (peer->sort == BGP_PEER_IBGP) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL,
-                 "true");
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_IBGP,
-                 "true");
+        keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL;
+        values[n++] = xstrdup("true");
+        keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_IBGP;
+        values[n++] = xstrdup("true");
 
     } else if ((peer->sort == BGP_PEER_EBGP && peer->ttl != 1)
                || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)) {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL,
-                 "true");
+        keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL;
+        values[n++] = xstrdup("true");
     } else {
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL,
-                 "false");
-        smap_add(smap,
-                 OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_IBGP,
-                 "false");
+        keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_INTERNAL;
+        values[n++] = xstrdup("false");
+        keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_IBGP;
+        values[n++] = xstrdup("false");
     }
 #ifdef HAVE_CLOCK_MONOTONIC
     tbuf = time(NULL) - (bgp_clock() - info->uptime);
 #else
     tbuf = info->uptime;
 #endif
-    smap_add(smap,
-             OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_UPTIME,
-             ctime(&tbuf));
+    keys[n] = OVSDB_BGP_ROUTE_PATH_ATTRIBUTES_UPTIME;
+    values[n++] = xstrdup(ctime(&tbuf));
+
+    /* Few enough for an insertion sort. */
+    for (i = 1; i < n; i++) {
+        key = keys[i];
+        value = values[i];
+        for (j = i; j > 0 && strcmp(keys[j - 1], key) > 0; j--) {
+            keys[j] = keys[j - 1];
+            values[j] = values[j - 1];
+        }
+        keys[j] = key;
+        values[j] = value;
+    }
+
+    attrs = bgp_ovsdb_attr_path_attributes(info->attr);
+    datum.n = attrs->n + n;
+    datum.keys = xmalloc(datum.n * sizeof *datum.keys);
+    datum.values = xmalloc(datum.n * sizeof *datum.values);
+    for (i = j = k = 0; k < datum.n; k++) {
+        if (j < n
+            && (i == attrs->n || strcmp(keys[j], attrs->keys[i].string) < 0)) {
+            datum.keys[k].string = xstrdup(keys[j]);
+            datum.values[k].string = values[j++];
+        } else {
+            datum.keys[k].string = xstrdup(attrs->keys[i].string);
+            datum.values[k].string = xstrdup(attrs->values[i++].string);
+        }
+    }
+
+    ovsdb_idl_txn_write(&rib->header_,
+                        &ovsrec_bgp_route_col_path_attributes, &datum);
     return 0;
 }
 
@@ -993,7 +1066,6 @@ bgp_ovsdb_add_local_rib_entry(struct prefix *p,
     int64_t distance = 0, nexthop_num;
     int64_t metric_val = 0;
     const struct ovsrec_vrf *vrf = NULL;
-    struct smap smap;
     struct lookup_hmap_element *global_hmap_node = NULL;
     struct lookup_hmap_element *hmap_entry = NULL;
     uint32_t lookup_hash;
@@ -1069,10 +1141,7 @@ bgp_ovsdb_add_local_rib_entry(struct prefix *p,
     /* Set VRF */
     ovsrec_bgp_route_set_vrf(rib, vrf);
     /* Set path attributes */
-    smap_init(&smap);
-    if (bgp_ovsdb_set_rib_path_attributes(&smap, info, bgp) == 0)
-        ovsrec_bgp_route_set_path_attributes(rib, &smap);
-    smap_destroy(&smap);
+    bgp_ovsdb_set_rib_path_attributes(rib, info, bgp);
 
     /*Insert into global hash map, with temporary UUID*/
     global_hmap_node = malloc(sizeof(struct lookup_hmap_element));
@@ -1097,7 +1166,6 @@ bgp_ovsdb_update_local_rib_entry_attributes(struct prefix *p,
     const struct ovsrec_bgp_route *rib_row = NULL;
     char pr[PREFIX_MAXLEN];
     struct ovsdb_idl_txn *txn = NULL;
-    struct smap smap;
     struct lookup_hmap_element *hmap_entry = NULL;
     uint32_t lookup_hash;
 
@@ -1131,10 +1199,7 @@ bgp_ovsdb_update_local_rib_entry_attributes(struct prefix *p,
 
     START_DB_TXN(txn, "Failed to create route table txn",
                  TXN_BGP_UPD_ATTR, p, info, bgp->as, safi);
-    smap_init(&smap);
-    if (bgp_ovsdb_set_rib_path_attributes(&smap, info, bgp) == 0)
-        ovsrec_bgp_route_set_path_attributes(rib_row, &smap);
-    smap_destroy(&smap);
+    bgp_ovsdb_set_rib_path_attributes(rib_row, info, bgp);
 
     /* Update global hash map entry with update operation */
     hmap_entry->needs_review = 0;
@@ -2792,10 +2857,69 @@ bgp_ovsdb_republish_route(const struct ovsrec_bgp_router *bgp_first, int asn)
                 bgp_ovsdb_announce_rib_entry(&rn->p, ri,bgp, SAFI_UNICAST);
             }
         }
+        bgp_keepalives_send_due();
     }
     return 0;
 }
 
+/*
+ * Take over the Route rows a previous bgpd left behind for the routes
+ * of the checkpoint being restored, so that they are updated or
+ * deleted in place instead of being inserted again.
+ */
+void
+bgp_ovsdb_adopt_rib_entries(void)
+{
+    const struct ovsrec_route *rib;
+    struct lookup_hmap_element *hmap_entry;
+    struct prefix p;
+    safi_t safi;
+    uint32_t lookup_hash;
+    bool found;
+    int adopted = 0;
+
+    OVSREC_ROUTE_FOR_EACH(rib, idl) {
+        if (!rib->from || strcmp(rib->from, "bgp") || !rib->prefix
+            || !rib->sub_address_family) {
+            continue;
+        }
+        if (!strcmp(rib->sub_address_family, "unicast")) {
+            safi = SAFI_UNICAST;
+        } else if (!strcmp(rib->sub_address_family, "multicast")) {
+            safi = SAFI_MULTICAST;
+        } else {
+            continue;
+        }
+        if (!str2prefix(rib->prefix, &p) || !bgp_checkpoint_adopt(&p, safi)) {
+            continue;
+        }
+
+        lookup_hash = get_lookup_key(rib->prefix, ROUTE_TABLE);
+        found = false;
+        HMAP_FOR_EACH_IN_BUCKET(hmap_entry, node, lookup_hash, &global_hmap) {
+            if (!strcmp(hmap_entry->prefix, rib->prefix)
+                && (hmap_entry->table_type == ROUTE)) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            continue;
+        }
+
+        hmap_entry = xmalloc(sizeof(struct lookup_hmap_element));
+        hmap_entry->uuid = rib->header_.uuid;
+        hmap_entry->needs_review = 0;
+        hmap_entry->state = DB_SYNC;
+        hmap_entry->op_type = INSERT;
+        hmap_entry->table_type = ROUTE;
+        strcpy(hmap_entry->prefix, rib->prefix);
+        hmap_insert(&global_hmap, &hmap_entry->node, lookup_hash);
+        adopted++;
+    }
+    VLOG_INFO("%s: %d routes kept from before restart", __FUNCTION__, adopted);
+}
+
 static uint32_t get_lookup_key(char *prefix, char *table_name) {
     char key[MAX_KEY_LEN];
     int hashkey;
@@ -181,9 +181,15 @@ bgp_ovsdb_update_local_rib_entry_attributes(struct prefix *p, struct bgp_info *i
 extern const struct ovsrec_bgp_route*
 bgp_ovsdb_lookup_local_rib_entry(struct prefix *p);
 
+extern void
+bgp_ovsdb_attr_free(struct attr *attr);
+
 extern int
 bgp_ovsdb_republish_route(const struct ovsrec_bgp_router *bgp_first, int asn);
 
+extern void
+bgp_ovsdb_adopt_rib_entries(void);
+
 extern void
 bgp_txn_complete_processing(void);
 
@@ -31,6 +31,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "sockunion.h"		/* for inet_ntop () */
 #include "linklist.h"
 #include "plist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -40,6 +42,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_community.h"
@@ -48,9 +51,27 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_checkpoint.h"
 
 int stream_put_prefix (struct stream *, struct prefix *);
 
+/* Messages which are the same for every peer.  They are encoded once and
+   a reference is queued on each peer. */
+static struct stream *bgp_keepalive_msg;
+static struct stream *bgp_eor_msg[AFI_MAX][SAFI_MAX];
+
+/* UPDATEs encoded lately for more than one peer.  A peer whose UPDATE
+   turns out the same as one of these, as it is for peers sharing their
+   outbound policy, queues a reference to it instead of a copy of its
+   own.  An UPDATE is only kept once it has been seen twice: the hashes
+   of those seen once are noted in bgp_update_seen, by their low bits.
+   The oldest kept are let go of once there are BGP_UPDATE_SHARED_MAX of
+   them. */
+#define BGP_UPDATE_SHARED_MAX 1024
+static struct hash *bgp_update_shared;
+static struct stream_fifo *bgp_update_shared_fifo;
+static unsigned int bgp_update_seen[BGP_UPDATE_SHARED_MAX];
+
 /* Set up BGP packet marker and packet type. */
 static int
 bgp_packet_set_marker (struct stream *s, u_char type)
@@ -93,6 +114,35 @@ bgp_packet_add (struct peer *peer, struct stream *s)
   stream_fifo_push (peer->obuf, s);
 }
 
+/* Add a packet ahead of those queued for the peer, but behind one that
+   is partly written already. */
+static void
+bgp_packet_add_first (struct peer *peer, struct stream *s)
+{
+  struct stream_fifo *fifo = peer->obuf;
+  struct stream *head = stream_fifo_head (fifo);
+
+  if (! head)
+    {
+      stream_fifo_push (fifo, s);
+      return;
+    }
+
+  if (stream_get_getp (head))
+    {
+      s->next = head->next;
+      head->next = s;
+      if (fifo->tail == head)
+	fifo->tail = s;
+    }
+  else
+    {
+      s->next = head;
+      fifo->head = s;
+    }
+  fifo->count++;
+}
+
 /* Free first packet. */
 static void
 bgp_packet_delete (struct peer *peer)
@@ -138,6 +188,72 @@ bgp_connect_check (struct peer *peer)
     }
 }
 
+static unsigned int
+bgp_update_shared_key (void *arg)
+{
+  struct stream *s = arg;
+
+  return jhash (STREAM_DATA (s), stream_get_endp (s), 0);
+}
+
+static int
+bgp_update_shared_cmp (const void *arg1, const void *arg2)
+{
+  const struct stream *s1 = arg1;
+  const struct stream *s2 = arg2;
+
+  return s1->endp == s2->endp && memcmp (s1->data, s2->data, s1->endp) == 0;
+}
+
+/* Return the packet to queue for the UPDATE s: a reference to the same
+   one encoded for another peer lately, or else s itself, copied first
+   if copy is set.  Unless copy is set, s is handed over. */
+static struct stream *
+bgp_update_packet_share (struct stream *s, int copy)
+{
+  struct stream *shared;
+  unsigned int key, *seen;
+
+  if (! bgp_update_shared)
+    {
+      bgp_update_shared = hash_create (bgp_update_shared_key,
+                                       bgp_update_shared_cmp);
+      bgp_update_shared_fifo = stream_fifo_new ();
+    }
+
+  shared = hash_lookup (bgp_update_shared, s);
+  if (shared)
+    {
+      if (! copy)
+        stream_free (s);
+      return stream_ref (shared);
+    }
+
+  if (copy)
+    s = stream_dup (s);
+
+  key = bgp_update_shared_key (s);
+  seen = &bgp_update_seen[key % BGP_UPDATE_SHARED_MAX];
+  if (*seen != key)
+    {
+      *seen = key;
+      return s;
+    }
+
+  hash_get (bgp_update_shared, s, hash_alloc_intern);
+  stream_fifo_push (bgp_update_shared_fifo, s);
+
+  if (bgp_update_shared_fifo->count > BGP_UPDATE_SHARED_MAX)
+    {
+      struct stream *old = stream_fifo_pop (bgp_update_shared_fifo);
+
+      hash_release (bgp_update_shared, old);
+      stream_free (old);
+    }
+
+  return stream_ref (s);
+}
+
 /* Make BGP update packet.  */
 static struct stream *
 bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
@@ -258,10 +374,17 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       stream_putw_at (s, attrlen_pos, total_attr_len);
 
       if (!stream_empty(snlri))
-	packet = stream_dupcat(s, snlri, mpattr_pos);
+	{
+	  struct stream *mp = stream_dupcat(s, snlri, mpattr_pos);
+
+	  bgp_packet_set_size (mp);
+	  packet = bgp_update_packet_share (mp, 0);
+	}
       else
-	packet = stream_dup (s);
-      bgp_packet_set_size (packet);
+	{
+	  bgp_packet_set_size (s);
+	  packet = bgp_update_packet_share (s, 1);
+	}
       bgp_packet_add (peer, packet);
       BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
       stream_reset (s);
@@ -283,34 +406,39 @@ bgp_update_packet_eor (struct peer *peer, afi_t afi, safi_t safi)
   if (BGP_DEBUG (normal, NORMAL))
     zlog_debug ("send End-of-RIB for %s to %s", afi_safi_print (afi, safi), peer->host);
 
-  s = stream_new (BGP_MAX_PACKET_SIZE);
-
-  /* Make BGP update packet. */
-  bgp_packet_set_marker (s, BGP_MSG_UPDATE);
+  s = bgp_eor_msg[afi][safi];
+  if (! s)
+    {
+      s = stream_new (BGP_HEADER_SIZE + 10);
 
-  /* Unfeasible Routes Length */
-  stream_putw (s, 0);
+      /* Make BGP update packet. */
+      bgp_packet_set_marker (s, BGP_MSG_UPDATE);
 
-  if (afi == AFI_IP && safi == SAFI_UNICAST)
-    {
-      /* Total Path Attribute Length */
+      /* Unfeasible Routes Length */
       stream_putw (s, 0);
-    }
-  else
-    {
-      /* Total Path Attribute Length */
-      stream_putw (s, 6);
-      stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
-      stream_putc (s, BGP_ATTR_MP_UNREACH_NLRI);
-      stream_putc (s, 3);
-      stream_putw (s, afi);
-      stream_putc (s, safi);
+
+      if (afi == AFI_IP && safi == SAFI_UNICAST)
+	{
+	  /* Total Path Attribute Length */
+	  stream_putw (s, 0);
+	}
+      else
+	{
+	  /* Total Path Attribute Length */
+	  stream_putw (s, 6);
+	  stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
+	  stream_putc (s, BGP_ATTR_MP_UNREACH_NLRI);
+	  stream_putc (s, 3);
+	  stream_putw (s, afi);
+	  stream_putc (s, safi);
+	}
+
+      bgp_packet_set_size (s);
+      bgp_eor_msg[afi][safi] = s;
     }
 
-  bgp_packet_set_size (s);
-  packet = stream_dup (s);
+  packet = stream_ref (s);
   bgp_packet_add (peer, packet);
-  stream_free (s);
   return packet;
 }
 
@@ -579,7 +707,8 @@ bgp_default_withdraw_send (struct peer *peer, afi_t afi, safi_t safi)
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 }
 
-/* Get next packet to be written.  */
+/* Make the next packet from the pending withdrawals and updates, and
+   queue it on the peer's output.  */
 static struct stream *
 bgp_write_packet (struct peer *peer)
 {
@@ -588,10 +717,6 @@ bgp_write_packet (struct peer *peer)
   struct stream *s = NULL;
   struct bgp_advertise *adv;
 
-  s = stream_fifo_head (peer->obuf);
-  if (s)
-    return s;
-
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
@@ -674,63 +799,62 @@ bgp_write_proceed (struct peer *peer)
   return 0;
 }
 
-/* Write packet to the peer. */
-int
-bgp_write (struct thread *thread)
+/* Write the packets queued for the peer.  They are handed to the kernel
+   with a single writev(), up to BGP_WRITE_PACKET_MAX of them. */
+static void
+bgp_write_queued (struct peer *peer)
 {
-  struct peer *peer;
   u_char type;
   struct stream *s; 
-  int num;
-  unsigned int count = 0;
-
-  /* Yes first of all get peer pointer. */
-  peer = THREAD_ARG (thread);
-  peer->t_write = NULL;
-
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
+  struct iovec iov[BGP_WRITE_PACKET_MAX];
+  unsigned int iovcnt;
+  ssize_t num;
+  size_t writenum;
+
+  iovcnt = 0;
+  for (s = stream_fifo_head (peer->obuf); s && iovcnt < BGP_WRITE_PACKET_MAX;
+       s = s->next)
     {
-      bgp_connect_check (peer);
-      return 0;
+      iov[iovcnt].iov_base = STREAM_PNT (s);
+      iov[iovcnt].iov_len = STREAM_READABLE (s);
+      iovcnt++;
+
+      /* Nothing goes out after a NOTIFICATION. */
+      if (stream_getc_from (s, BGP_MARKER_SIZE + 2) == BGP_MSG_NOTIFY)
+	break;
     }
 
-  s = bgp_write_packet (peer);
-  if (!s)
-    return 0;	/* nothing to send */
+  if (iovcnt == 0)
+    return;	/* nothing to send */
 
   sockopt_cork (peer->fd, 1);
 
   /* Nonblocking write until TCP output buffer is full.  */
-  do
+  num = writev (peer->fd, iov, iovcnt);
+  if (num < 0)
     {
-      int writenum;
-
-      /* Number of bytes to be sent.  */
-      writenum = stream_get_endp (s) - stream_get_getp (s);
-
-      /* Call write() system call.  */
-      num = write (peer->fd, STREAM_PNT (s), writenum);
-      if (num < 0)
+      /* write failed either retry needed or error */
+      if (! ERRNO_IO_RETRY(errno))
 	{
-	  /* write failed either retry needed or error */
-	  if (ERRNO_IO_RETRY(errno))
-		break;
-
-          BGP_EVENT_ADD (peer, TCP_fatal_error);
-	  return 0;
+	  BGP_EVENT_ADD (peer, TCP_fatal_error);
+	  return;
 	}
+      num = 0;
+    }
 
-      if (num != writenum)
+  while (num > 0 && (s = stream_fifo_head (peer->obuf)) != NULL)
+    {
+      writenum = STREAM_READABLE (s);
+      if ((size_t) num < writenum)
 	{
 	  /* Partial write */
 	  stream_forward_getp (s, num);
 	  break;
 	}
+      num -= writenum;
 
       /* Retrieve BGP packet type. */
-      stream_set_getp (s, BGP_MARKER_SIZE + 2);
-      type = stream_getc (s);
+      type = stream_getc_from (s, BGP_MARKER_SIZE + 2);
 
       switch (type)
 	{
@@ -772,14 +896,38 @@ bgp_write (struct thread *thread)
       /* OK we send packet so delete it. */
       bgp_packet_delete (peer);
     }
-  while (++count < BGP_WRITE_PACKET_MAX &&
-	 (s = bgp_write_packet (peer)) != NULL);
   
   if (bgp_write_proceed (peer))
     BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 
  done:
   sockopt_cork (peer->fd, 0);
+}
+
+/* Write packets to the peer, after making the next ones from the pending
+   advertisements. */
+int
+bgp_write (struct thread *thread)
+{
+  struct peer *peer;
+
+  /* Yes first of all get peer pointer. */
+  peer = THREAD_ARG (thread);
+  peer->t_write = NULL;
+
+  /* For non-blocking IO check. */
+  if (peer->status == Connect)
+    {
+      bgp_connect_check (peer);
+      return 0;
+    }
+
+  /* Fill the output queue from the pending advertisements. */
+  while (peer->obuf->count < BGP_WRITE_PACKET_MAX)
+    if (! bgp_write_packet (peer))
+      break;
+
+  bgp_write_queued (peer);
   return 0;
 }
 
@@ -838,20 +986,26 @@ bgp_write_notify (struct peer *peer)
   return 0;
 }
 
-/* Make keepalive packet and send it to the peer. */
-void
-bgp_keepalive_send (struct peer *peer)
+/* The keepalive packet, for the peer to send. */
+static struct stream *
+bgp_keepalive_packet (struct peer *peer)
 {
   struct stream *s;
   int length;
 
-  s = stream_new (BGP_MAX_PACKET_SIZE);
+  s = bgp_keepalive_msg;
+  if (! s)
+    {
+      s = stream_new (BGP_HEADER_SIZE);
 
-  /* Make keepalive packet. */
-  bgp_packet_set_marker (s, BGP_MSG_KEEPALIVE);
+      /* Make keepalive packet. */
+      bgp_packet_set_marker (s, BGP_MSG_KEEPALIVE);
 
-  /* Set packet size. */
-  length = bgp_packet_set_size (s);
+      /* Set packet size. */
+      bgp_packet_set_size (s);
+      bgp_keepalive_msg = s;
+    }
+  length = stream_get_endp (s);
 
   /* Dump packet if debug option is set. */
   /* bgp_packet_dump (s); */
@@ -862,12 +1016,29 @@ bgp_keepalive_send (struct peer *peer)
     zlog_debug ("%s send message type %d, length (incl. header) %d",
                peer->host, BGP_MSG_KEEPALIVE, length);
 
+  return stream_ref (s);
+}
+
+/* Make keepalive packet and send it to the peer. */
+void
+bgp_keepalive_send (struct peer *peer)
+{
   /* Add packet to the peer. */
-  bgp_packet_add (peer, s);
+  bgp_packet_add (peer, bgp_keepalive_packet (peer));
 
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 }
 
+/* Send a keepalive to the peer right away, ahead of the packets queued
+   for it.  Only what is queued is written: no UPDATEs are made, that is
+   left to the write thread. */
+void
+bgp_keepalive_send_now (struct peer *peer)
+{
+  bgp_packet_add_first (peer, bgp_keepalive_packet (peer));
+  bgp_write_queued (peer);
+}
+
 /* Make open packet and send it to the peer. */
 void
 bgp_open_send (struct peer *peer)
@@ -1239,6 +1410,8 @@ bgp_collision_detect (struct peer *new, struct in_addr remote_id)
   return 0;
 }
 
+static int bgp_process_packet_event (struct thread *);
+
 static int
 bgp_open_receive (struct peer *peer, bgp_size_t size)
 {
@@ -1250,6 +1423,7 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
   as_t remote_as;
   as_t as4 = 0;
   struct peer *realpeer;
+  struct stream *work;
   struct in_addr remote_id;
   int mp_capability;
   u_int8_t notify_data_remote_as[2];
@@ -1452,9 +1626,11 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 
       bgp_stop (realpeer);
       
-      /* Transfer file descriptor. */
+      /* Transfer file descriptor, and the reader on it. */
       realpeer->fd = peer->fd;
       peer->fd = -1;
+      realpeer->io = peer->io;
+      peer->io = NULL;
 
       /* Transfer input buffer. */
       stream_free (realpeer->ibuf);
@@ -1462,6 +1638,11 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
       realpeer->packet_size = peer->packet_size;
       peer->ibuf = NULL;
 
+      /* And any input read behind the Open. */
+      work = realpeer->ibuf_work;
+      realpeer->ibuf_work = peer->ibuf_work;
+      peer->ibuf_work = work;
+
       /* Transfer status. */
       realpeer->status = peer->status;
       bgp_stop (peer);
@@ -1475,7 +1656,7 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 		    peer->fd);
 	  return -1;
 	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+      BGP_READ_ON (peer->t_read, bgp_read, bgp_io_fd (peer));
     }
 
   /* remote router-id check. */
@@ -1594,6 +1775,12 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 
   BGP_EVENT_ADD (peer, Receive_OPEN_message);
 
+  /* The input read behind the Open came over with the connection, and
+     bgp_process_packets stopped at the handover, so pick it up here. */
+  if (peer == realpeer && ! peer->t_process_packet)
+    peer->t_process_packet =
+      thread_add_event (master, bgp_process_packet_event, peer, 0);
+
   peer->packet_size = 0;
   if (peer->ibuf)
     stream_reset (peer->ibuf);
@@ -1617,6 +1804,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   struct bgp_nlri withdraw;
   struct bgp_nlri mp_update;
   struct bgp_nlri mp_withdraw;
+  int eor = 0;
 
   /* Status must be Established. */
   if (peer->status != Established) 
@@ -1805,6 +1993,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  /* NSF delete stale route */
 	  if (peer->nsf[AFI_IP][SAFI_UNICAST])
 	    bgp_clear_stale_route (peer, AFI_IP, SAFI_UNICAST);
+	  eor = 1;
 
 	  if (BGP_DEBUG (normal, NORMAL))
 	    zlog (peer->log, LOG_DEBUG, "rcvd End-of-RIB for IPv4 Unicast from %s",
@@ -1835,6 +2024,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  /* NSF delete stale route */
 	  if (peer->nsf[AFI_IP][SAFI_MULTICAST])
 	    bgp_clear_stale_route (peer, AFI_IP, SAFI_MULTICAST);
+	  eor = 1;
 
 	  if (BGP_DEBUG (normal, NORMAL))
 	    zlog (peer->log, LOG_DEBUG, "rcvd End-of-RIB for IPv4 Multicast from %s",
@@ -1864,6 +2054,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  /* NSF delete stale route */
 	  if (peer->nsf[AFI_IP6][SAFI_UNICAST])
 	    bgp_clear_stale_route (peer, AFI_IP6, SAFI_UNICAST);
+	  eor = 1;
 
 	  if (BGP_DEBUG (normal, NORMAL))
 	    zlog (peer->log, LOG_DEBUG, "rcvd End-of-RIB for IPv6 Unicast from %s",
@@ -1888,10 +2079,13 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  && mp_withdraw.length == 0)
 	{
 	  /* End-of-RIB received */
+	  SET_FLAG (peer->af_sflags[AFI_IP6][SAFI_MULTICAST],
+		    PEER_STATUS_EOR_RECEIVED);
 
 	  /* NSF delete stale route */
 	  if (peer->nsf[AFI_IP6][SAFI_MULTICAST])
 	    bgp_clear_stale_route (peer, AFI_IP6, SAFI_MULTICAST);
+	  eor = 1;
 
 	  if (BGP_DEBUG (update, UPDATE_IN))
 	    zlog (peer->log, LOG_DEBUG, "rcvd End-of-RIB for IPv6 Multicast from %s",
@@ -1940,6 +2134,9 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   BGP_TIMER_OFF (peer->t_holdtime);
   bgp_timer_set (peer);
 
+  if (eor)
+    bgp_checkpoint_eor_received (peer);
+
 #ifdef ENABLE_OVSDB
   bgp_daemon_ovsdb_neighbor_statistics_update(true, NULL, peer);
 #endif // ENABLE_OVSDB
@@ -2388,26 +2585,28 @@ bgp_capability_receive (struct peer *peer, bgp_size_t size)
   return bgp_capability_msg_parse (peer, pnt, size);
 }
 
-/* BGP read utility function. */
+/* BGP read utility function.  Take the messages the reader has read
+   from the socket into the peer's work buffer, behind the messages not
+   processed yet. */
 static int
 bgp_read_packet (struct peer *peer)
 {
   int nbytes;
   int readsize;
 
-  readsize = peer->packet_size - stream_get_endp (peer->ibuf);
+  stream_pulldown (peer->ibuf_work);
+  readsize = STREAM_WRITEABLE (peer->ibuf_work);
 
   /* If size is zero then return. */
   if (! readsize)
     return 0;
 
-  /* Read packet from fd. */
-  nbytes = stream_read_try (peer->ibuf, peer->fd, readsize);
+  nbytes = bgp_io_fetch (peer, peer->ibuf_work);
 
   /* If read byte is smaller than zero then error occured. */
   if (nbytes < 0) 
     {
-      /* Transient error should retry */
+      /* Nothing handed over. */
       if (nbytes == -2)
 	return -1;
 
@@ -2451,10 +2650,6 @@ bgp_read_packet (struct peer *peer)
       return -1;
     }
 
-  /* We read partial packet. */
-  if (stream_get_endp (peer->ibuf) != peer->packet_size)
-    return -1;
-
   return 0;
 }
 
@@ -2463,9 +2658,10 @@ static int
 bgp_marker_all_one (struct stream *s, int length)
 {
   int i;
+  u_char *pnt = stream_pnt (s);
 
   for (i = 0; i < length; i++)
-    if (s->data[i] != 0xff)
+    if (pnt[i] != 0xff)
       return 0;
 
   return 1;
@@ -2480,163 +2676,248 @@ bgp_recent_clock (void)
   return recent_relative_time().tv_sec;
 }
 
-/* Starting point of packet process function. */
-int
-bgp_read (struct thread *thread)
+/* Check the header of the next message in the work buffer.  Returns
+   its length if the whole message has been read, 0 if more input is
+   needed and -1 if the header is malformed (the session is then being
+   closed with a NOTIFICATION). */
+static int
+bgp_packet_check (struct peer *peer)
 {
-  int ret;
-  u_char type = 0;
-  struct peer *peer;
+  struct stream *s = peer->ibuf_work;
+  u_char type;
   bgp_size_t size;
   char notify_data_length[2];
 
-  /* Yes first of all get peer pointer. */
-  peer = THREAD_ARG (thread);
-  peer->t_read = NULL;
+  if (STREAM_READABLE (s) < BGP_HEADER_SIZE)
+    return 0;
 
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
+  /* Get size and type. */
+  memcpy (notify_data_length, stream_pnt (s) + BGP_MARKER_SIZE, 2);
+  size = stream_getw_from (s, stream_get_getp (s) + BGP_MARKER_SIZE);
+  type = stream_getc_from (s, stream_get_getp (s) + BGP_MARKER_SIZE + 2);
+
+  /* Marker check */
+  if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
+      && ! bgp_marker_all_one (s, BGP_MARKER_SIZE))
     {
-      bgp_connect_check (peer);
-      goto done;
+      bgp_notify_send (peer,
+		       BGP_NOTIFY_HEADER_ERR, 
+		       BGP_NOTIFY_HEADER_NOT_SYNC);
+      return -1;
     }
-  else
+
+  /* BGP type check. */
+  if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
+      && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
+      && type != BGP_MSG_ROUTE_REFRESH_NEW
+      && type != BGP_MSG_ROUTE_REFRESH_OLD
+      && type != BGP_MSG_CAPABILITY)
     {
-      if (peer->fd < 0)
-	{
-	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
-	  return -1;
-	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+      if (BGP_DEBUG (normal, NORMAL))
+	plog_debug (peer->log,
+		  "%s unknown message type 0x%02x",
+		  peer->host, type);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESTYPE,
+				 &type, 1);
+      return -1;
+    }
+  /* Mimimum packet length check. */
+  if ((size < BGP_HEADER_SIZE)
+      || (size > BGP_MAX_PACKET_SIZE)
+      || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
+      || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
+      || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
+      || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
+    {
+      if (BGP_DEBUG (normal, NORMAL))
+	plog_debug (peer->log,
+		  "%s bad message length - %d for %s",
+		  peer->host, size, 
+		  type == 128 ? "ROUTE-REFRESH" :
+		  bgp_type_str[(int) type]);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESLEN,
+				 (u_char *) notify_data_length, 2);
+      return -1;
     }
 
-  /* Read packet header to determine type of the packet */
-  if (peer->packet_size == 0)
-    peer->packet_size = BGP_HEADER_SIZE;
+  if (STREAM_READABLE (s) < size)
+    return 0;
+
+  return size;
+}
+
+/* Process the messages read from the peer, at most BGP_READ_PACKET_MAX
+   of them at a time so that a peer sending its full table does not hold
+   up everybody else.  Whatever is left is picked up again by an event
+   once the other peers have had their turn.
+
+   Only UPDATEs on an established session are taken in a batch.  Other
+   messages raise FSM events, which are run from the event queue, so the
+   batch stops after them to let the FSM catch up before the next
+   message is looked at: a KEEPALIVE taking the session to Established
+   has to be acted upon before the UPDATE following it is. */
+static void
+bgp_process_packets (struct peer *peer)
+{
+  int fd = peer->fd;
+  int size;
+  u_char type;
+  unsigned int i;
+  u_int32_t notify_out;
 
-  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
+  for (i = 0; i < BGP_READ_PACKET_MAX; i++)
     {
-      ret = bgp_read_packet (peer);
+      size = bgp_packet_check (peer);
+      if (size < 0)
+	stream_reset (peer->ibuf_work);
+      if (size <= 0)
+	return;
 
-      /* Header read error or partial read packet. */
-      if (ret < 0) 
-	goto done;
+      /* Move the message to the input buffer the parsers work on. */
+      stream_reset (peer->ibuf);
+      stream_put (peer->ibuf, stream_pnt (peer->ibuf_work), size);
+      stream_forward_getp (peer->ibuf_work, size);
+      stream_set_getp (peer->ibuf, BGP_HEADER_SIZE);
+      peer->packet_size = size;
 
-      /* Get size and type. */
-      stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
-      memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
-      size = stream_getw (peer->ibuf);
-      type = stream_getc (peer->ibuf);
+      type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
 
       if (BGP_DEBUG (normal, NORMAL) && type != 2 && type != 0)
 	zlog_debug ("%s rcv message type %d, length (excl. header) %d",
 		   peer->host, type, size - BGP_HEADER_SIZE);
 
-      /* Marker check */
-      if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
-	  && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
-	{
-	  bgp_notify_send (peer,
-			   BGP_NOTIFY_HEADER_ERR, 
-			   BGP_NOTIFY_HEADER_NOT_SYNC);
-	  goto done;
-	}
+      /* BGP packet dump function. */
+      bgp_dump_packet (peer, type, peer->ibuf);
 
-      /* BGP type check. */
-      if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
-	  && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
-	  && type != BGP_MSG_ROUTE_REFRESH_NEW
-	  && type != BGP_MSG_ROUTE_REFRESH_OLD
-	  && type != BGP_MSG_CAPABILITY)
-	{
-	  if (BGP_DEBUG (normal, NORMAL))
-	    plog_debug (peer->log,
-		      "%s unknown message type 0x%02x",
-		      peer->host, type);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			 	     BGP_NOTIFY_HEADER_BAD_MESTYPE,
-				     &type, 1);
-	  goto done;
-	}
-      /* Mimimum packet length check. */
-      if ((size < BGP_HEADER_SIZE)
-	  || (size > BGP_MAX_PACKET_SIZE)
-	  || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
-	  || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
-	  || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
-	  || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
+      size = (peer->packet_size - BGP_HEADER_SIZE);
+
+      notify_out = peer->notify_out;
+
+      /* Any message from the peer keeps the session alive. */
+      peer->readtime = bgp_recent_clock ();
+
+      /* Read rest of the packet and call each sort of packet routine */
+      switch (type) 
 	{
-	  if (BGP_DEBUG (normal, NORMAL))
-	    plog_debug (peer->log,
-		      "%s bad message length - %d for %s",
-		      peer->host, size, 
-		      type == 128 ? "ROUTE-REFRESH" :
-		      bgp_type_str[(int) type]);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			  	     BGP_NOTIFY_HEADER_BAD_MESLEN,
-				     (u_char *) notify_data_length, 2);
-	  goto done;
+	case BGP_MSG_OPEN:
+	  peer->open_in++;
+	  bgp_open_receive (peer, size); /* XXX return value ignored! */
+	  break;
+	case BGP_MSG_UPDATE:
+	  bgp_update_receive (peer, size);
+	  break;
+	case BGP_MSG_NOTIFY:
+	  bgp_notify_receive (peer, size);
+	  break;
+	case BGP_MSG_KEEPALIVE:
+	  bgp_keepalive_receive (peer, size);
+	  break;
+	case BGP_MSG_ROUTE_REFRESH_NEW:
+	case BGP_MSG_ROUTE_REFRESH_OLD:
+	  peer->refresh_in++;
+	  bgp_route_refresh_receive (peer, size);
+	  break;
+	case BGP_MSG_CAPABILITY:
+	  peer->dynamic_cap_in++;
+	  bgp_capability_receive (peer, size);
+	  break;
 	}
 
-      /* Adjust size to message length. */
-      peer->packet_size = size;
+#ifdef ENABLE_OVSDB
+	bgp_daemon_ovsdb_neighbor_statistics_update(true, NULL, peer);
+#endif // ENABLE_OVSDB
+
+      /* Clear input buffer. */
+      peer->packet_size = 0;
+      if (peer->ibuf)
+	stream_reset (peer->ibuf);
+
+      /* The message may have closed the session, or handed the
+	 connection over to the configured peer. */
+      if (peer->fd != fd || ! peer->ibuf
+	  || CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
+	return;
+
+      /* Let the FSM run first. */
+      if (type != BGP_MSG_UPDATE || peer->status != Established
+	  || peer->notify_out != notify_out)
+	break;
     }
 
-  ret = bgp_read_packet (peer);
-  if (ret < 0) 
-    goto done;
+  size = bgp_packet_check (peer);
+  if (size < 0)
+    stream_reset (peer->ibuf_work);
+  if (size <= 0)
+    return;
 
-  /* Get size and type again. */
-  size = stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
-  type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
+  /* A whole message is waiting, which is as good as a keepalive as
+     far as the hold timer is concerned. */
+  peer->readtime = bgp_recent_clock ();
 
-  /* BGP packet dump function. */
-  bgp_dump_packet (peer, type, peer->ibuf);
-  
-  size = (peer->packet_size - BGP_HEADER_SIZE);
+  if (! peer->t_process_packet && peer->status != Deleted)
+    peer->t_process_packet =
+      thread_add_event (master, bgp_process_packet_event, peer, 0);
+}
+
+static int
+bgp_process_packet_event (struct thread *thread)
+{
+  struct peer *peer;
 
-  /* Read rest of the packet and call each sort of packet routine */
-  switch (type) 
+  peer = THREAD_ARG (thread);
+  peer->t_process_packet = NULL;
+
+  if (peer->fd >= 0)
+    bgp_process_packets (peer);
+  return 0;
+}
+
+/* Starting point of packet process function. */
+int
+bgp_read (struct thread *thread)
+{
+  int ret;
+  struct peer *peer;
+
+  /* Yes first of all get peer pointer. */
+  peer = THREAD_ARG (thread);
+  peer->t_read = NULL;
+
+  /* For non-blocking IO check. */
+  if (peer->status == Connect)
     {
-    case BGP_MSG_OPEN:
-      peer->open_in++;
-      bgp_open_receive (peer, size); /* XXX return value ignored! */
-      break;
-    case BGP_MSG_UPDATE:
-      peer->readtime = bgp_recent_clock ();
-      bgp_update_receive (peer, size);
-      break;
-    case BGP_MSG_NOTIFY:
-      bgp_notify_receive (peer, size);
-      break;
-    case BGP_MSG_KEEPALIVE:
-      peer->readtime = bgp_recent_clock ();
-      bgp_keepalive_receive (peer, size);
-      break;
-    case BGP_MSG_ROUTE_REFRESH_NEW:
-    case BGP_MSG_ROUTE_REFRESH_OLD:
-      peer->refresh_in++;
-      bgp_route_refresh_receive (peer, size);
-      break;
-    case BGP_MSG_CAPABILITY:
-      peer->dynamic_cap_in++;
-      bgp_capability_receive (peer, size);
-      break;
+      bgp_connect_check (peer);
+      goto done;
+    }
+  else
+    {
+      if (peer->fd < 0)
+	{
+	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
+	  return -1;
+	}
+      if (! peer->io)
+	{
+	  zlog_err ("bgp_read peer %s has no reader", peer->host);
+	  return -1;
+	}
+      BGP_READ_ON (peer->t_read, bgp_read, bgp_io_fd (peer));
     }
 
-#ifdef ENABLE_OVSDB
-    bgp_daemon_ovsdb_neighbor_statistics_update(true, NULL, peer);
-#endif // ENABLE_OVSDB
+  ret = bgp_read_packet (peer);
 
-  /* Clear input buffer. */
-  peer->packet_size = 0;
-  if (peer->ibuf)
-    stream_reset (peer->ibuf);
+  /* Read error. */
+  if (ret < 0) 
+    goto done;
+
+  bgp_process_packets (peer);
 
  done:
   if (CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
@@ -2647,3 +2928,31 @@ bgp_read (struct thread *thread)
     }
   return 0;
 }
+
+/* Free the messages shared between peers. */
+void
+bgp_packet_finish (void)
+{
+  afi_t afi;
+  safi_t safi;
+
+  stream_free (bgp_keepalive_msg);
+  bgp_keepalive_msg = NULL;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	stream_free (bgp_eor_msg[afi][safi]);
+	bgp_eor_msg[afi][safi] = NULL;
+      }
+
+  if (bgp_update_shared)
+    {
+      hash_clean (bgp_update_shared, NULL);
+      hash_free (bgp_update_shared);
+      bgp_update_shared = NULL;
+      stream_fifo_free (bgp_update_shared_fifo);
+      bgp_update_shared_fifo = NULL;
+    }
+  memset (bgp_update_seen, 0, sizeof (bgp_update_seen));
+}
@@ -25,6 +25,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define BGP_TOTAL_ATTR_LEN    2U
 #define BGP_UNFEASIBLE_LEN    2U
 #define BGP_WRITE_PACKET_MAX 10U
+#define BGP_READ_PACKET_MAX 10U
 
 /* When to refresh */
 #define REFRESH_IMMEDIATE 1
@@ -42,6 +43,7 @@ extern int bgp_read (struct thread *);
 extern int bgp_write (struct thread *);
 
 extern void bgp_keepalive_send (struct peer *);
+extern void bgp_keepalive_send_now (struct peer *);
 extern void bgp_open_send (struct peer *);
 extern void bgp_notify_send (struct peer *, u_int8_t, u_int8_t);
 extern void bgp_notify_send_with_data (struct peer *, u_int8_t, u_int8_t, 
@@ -53,5 +55,6 @@ extern void bgp_default_update_send (struct peer *, struct attr *,
 extern void bgp_default_withdraw_send (struct peer *, afi_t, safi_t);
 
 extern int bgp_capability_receive (struct peer *, bgp_size_t);
+extern void bgp_packet_finish (void);
 
 #endif /* _QUAGGA_BGP_PACKET_H */
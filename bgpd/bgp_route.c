@@ -35,6 +35,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "thread.h"
 #include "workqueue.h"
+#include "workpool.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -56,6 +57,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_checkpoint.h"
 #include "bgpd/bgp_ovsdb_route.h"
 #include "openvswitch/vlog.h"
 /* Extern from bgp_dump.c */
@@ -129,6 +131,116 @@ bgp_info_extra_get (struct bgp_info *ri)
   return ri->extra;
 }
 
+/* The peer's list of routes for the afi/safi of the table the route
+   is in, see peer->info_list.  */
+#define BGP_INFO_PEER_LIST(R) \
+  ((R)->peer->info_list[bgp_node_table ((R)->net)->afi] \
+                       [bgp_node_table ((R)->net)->safi])
+
+/* bgp pic: the nexthop of the path, as far as its reachability goes,
+   see bgp_info_nexthop_check. */
+static void
+bgp_pic_nexthop (afi_t afi, struct bgp_info *ri, struct prefix *nh)
+{
+  memset (nh, 0, sizeof (struct prefix));
+  if (afi == AFI_IP)
+    {
+      nh->family = AF_INET;
+      nh->prefixlen = IPV4_MAX_BITLEN;
+      nh->u.prefix4 = ri->attr->nexthop;
+    }
+#ifdef HAVE_IPV6
+  else if (afi == AFI_IP6)
+    {
+      nh->family = AF_INET6;
+      nh->prefixlen = IPV6_MAX_BITLEN;
+      if (ri->attr->extra)
+        nh->u.prefix6 = ri->attr->extra->mp_nexthop_global;
+    }
+#endif /* HAVE_IPV6 */
+}
+
+/* Take the node out of the bgp pic index, dropping the entry it was in
+   once that is empty. */
+static void
+bgp_pic_dep_del (struct bgp_node *rn)
+{
+  struct bgp_pic_dep *dep = rn->pic_dep;
+  struct bgp_pic_dep **depp;
+  struct bgp_table *table;
+
+  if (! dep)
+    return;
+
+  if (rn->pic_next)
+    rn->pic_next->pic_prev = rn->pic_prev;
+  if (rn->pic_prev)
+    rn->pic_prev->pic_next = rn->pic_next;
+  else
+    dep->nodes = rn->pic_next;
+  rn->pic_dep = NULL;
+  rn->pic_prev = rn->pic_next = NULL;
+
+  if (dep->nodes)
+    return;
+
+  table = bgp_node_table (rn);
+  for (depp = &dep->peer->pic_deps[table->afi][table->safi]; *depp != dep;
+       depp = &(*depp)->next)
+    ;
+  *depp = dep->next;
+  XFREE (MTYPE_BGP_PIC_DEP, dep);
+}
+
+/* Set the bgp pic backup of the node, whose selected path is given.  A
+ * node with a backup is filed under the peer and nexthop of its
+ * selected path, so that a failure of either finds the nodes to switch
+ * over without walking the table.  Our own routes don't fail like that
+ * and aren't filed.
+ */
+static void
+bgp_pic_backup_set (struct bgp_node *rn, struct bgp_info *selected,
+                    struct bgp_info *backup)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_pic_dep *dep;
+  struct prefix nh;
+
+  rn->pic_backup = backup;
+
+  if (! backup || ! selected
+      || selected->peer == selected->peer->bgp->peer_self)
+    {
+      bgp_pic_dep_del (rn);
+      return;
+    }
+
+  bgp_pic_nexthop (table->afi, selected, &nh);
+  dep = rn->pic_dep;
+  if (dep && dep->peer == selected->peer && prefix_same (&dep->nexthop, &nh))
+    return;
+  bgp_pic_dep_del (rn);
+
+  for (dep = selected->peer->pic_deps[table->afi][table->safi]; dep;
+       dep = dep->next)
+    if (prefix_same (&dep->nexthop, &nh))
+      break;
+  if (! dep)
+    {
+      dep = XCALLOC (MTYPE_BGP_PIC_DEP, sizeof (struct bgp_pic_dep));
+      dep->peer = selected->peer;
+      dep->nexthop = nh;
+      dep->next = selected->peer->pic_deps[table->afi][table->safi];
+      selected->peer->pic_deps[table->afi][table->safi] = dep;
+    }
+
+  rn->pic_dep = dep;
+  rn->pic_next = dep->nodes;
+  if (dep->nodes)
+    dep->nodes->pic_prev = rn;
+  dep->nodes = rn;
+}
+
 /* Allocate new bgp info structure. */
 static struct bgp_info *
 bgp_info_new (void)
@@ -198,6 +310,9 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri, safi_t safi)
     top->prev = ri;
   rn->info = ri;
 
+  ri->net = rn;
+  BGP_PEER_LIST_ADD (BGP_INFO_PEER_LIST (ri), ri);
+
   bgp_info_lock (ri);
   bgp_lock_node (rn);
   peer_lock (ri->peer); /* bgp_info peer reference */
@@ -217,6 +332,12 @@ bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri, safi_t safi)
     ri->prev->next = ri->next;
   else
     rn->info = ri->next;
+  /* The index has the node under the peer of the selected path, which
+     is about to go. */
+  if (rn->pic_backup == ri
+      || (rn->pic_dep && rn->pic_dep->peer == ri->peer))
+    bgp_pic_backup_set (rn, NULL, NULL);
+  BGP_PEER_LIST_DEL (BGP_INFO_PEER_LIST (ri), ri);
 #ifdef ENABLE_OVSDB
   bgp_ovsdb_delete_local_rib_entry(&rn->p, ri, ri->peer->bgp, safi);
 #endif
@@ -1314,8 +1435,183 @@ struct bgp_info_pair
 {
   struct bgp_info *old;
   struct bgp_info *new;
+
+  /* First of the paths marked BGP_INFO_MULTIPATH_CAND that count. */
+  struct bgp_info *mp_first;
+
+  /* bgp pic: best of the paths other than the candidates for multipath
+     that may back up the new best path. */
+  struct bgp_info *backup;
 };
 
+/* Compare the paths of a node, finding the selected path and the new
+ * best path.  For multipath, the paths equal to the best path are
+ * marked BGP_INFO_MULTIPATH_CAND, the candidates being those from
+ * mp_first on.  With bgp pic, the best of the other paths which may
+ * back up the new best path is found as well.
+ *
+ * Without deterministic-med this only reads the paths and sets flags on
+ * them which bgp_info_set_flag needn't know of, so that the nodes of a
+ * batch can be compared in parallel, see bgp_process_main.
+ */
+static void
+bgp_best_compare (struct bgp *bgp, struct bgp_node *rn, int do_mpath,
+                  struct bgp_info_pair *result)
+{
+  struct bgp_info *new_select;
+  struct bgp_info *old_select;
+  struct bgp_info *mp_first;
+  struct bgp_info *backup;
+  struct bgp_info *ri;
+  int paths_eq, mp_cand;
+
+  old_select = NULL;
+  new_select = NULL;
+  mp_first = NULL;
+  backup = NULL;
+  for (ri = rn->info; ri; ri = ri->next)
+    {
+      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	old_select = ri;
+
+      if (BGP_INFO_HOLDDOWN (ri))
+	continue;
+
+      if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED)
+          && (! CHECK_FLAG (ri->flags, BGP_INFO_DMED_SELECTED)))
+	{
+	  bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
+	  continue;
+        }
+      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
+      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_SELECTED);
+
+      if (bgp_info_cmp (bgp, ri, new_select, &paths_eq))
+	{
+	  if (do_mpath && bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
+	    bgp_mp_dmed_deselect (new_select);
+
+	  new_select = ri;
+
+	  if (do_mpath && !paths_eq)
+	    {
+	      mp_first = ri;
+	      SET_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND);
+	    }
+	}
+      else if (do_mpath && bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
+	bgp_mp_dmed_deselect (ri);
+
+      if (do_mpath && paths_eq)
+	SET_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND);
+    }
+
+  /* bgp pic: keep the best of the remaining paths at hand, to be
+     installed straight away should the selected path fail.  Which of
+     the candidates become multipaths is known only in bgp_best_update,
+     they are left to it.  Without deterministic-med no other path stays
+     a multipath, whatever its flags say now. */
+  if (new_select && bgp_flag_check (bgp, BGP_FLAG_PIC)
+      && bgp_node_table (rn)->type == BGP_TABLE_MAIN)
+    {
+      mp_cand = 0;
+      for (ri = rn->info; ri; ri = ri->next)
+	{
+	  if (ri == mp_first)
+	    mp_cand = 1;
+	  if (BGP_INFO_HOLDDOWN (ri))
+	    continue;
+	  if (mp_cand && CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND))
+	    continue;
+	  if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED)
+	      && CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH))
+	    continue;
+	  if (! bgp_info_backup_eligible (new_select, ri))
+	    continue;
+	  if (bgp_info_cmp (bgp, ri, backup, &paths_eq))
+	    backup = ri;
+	}
+    }
+
+  result->old = old_select;
+  result->new = new_select;
+  result->mp_first = mp_first;
+  result->backup = backup;
+}
+
+/* Complete best path selection of a node after bgp_best_compare: reap
+ * the removed paths and update the multipaths of the new best path.
+ */
+static void
+bgp_best_update (struct bgp *bgp, struct bgp_node *rn,
+                 struct bgp_maxpaths_cfg *mpath_cfg,
+                 struct bgp_info_pair *result, safi_t safi)
+{
+  struct bgp_info *new_select = result->new;
+  struct bgp_info *old_select = result->old;
+  struct bgp_info *backup;
+  struct bgp_info *ri;
+  struct bgp_info *nextri;
+  int paths_eq, mp_cand, pic;
+  struct list mp_list;
+
+  bgp_mp_list_init (&mp_list);
+
+  mp_cand = 0;
+  for (ri = rn->info; ri; ri = nextri)
+    {
+      nextri = ri->next;
+
+      if (ri == result->mp_first)
+	mp_cand = 1;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND))
+	{
+	  if (mp_cand)
+	    bgp_mp_list_add (&mp_list, ri);
+	  else
+	    UNSET_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND);
+	}
+
+      /* reap REMOVED routes, if needs be
+       * selected route must stay for a while longer though
+       */
+      if (BGP_INFO_HOLDDOWN (ri)
+          && CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+          && (ri != old_select))
+        bgp_info_reap (rn, ri, safi);
+    }
+
+  if (!bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
+      bgp_info_mpath_update (rn, new_select, old_select, &mp_list, mpath_cfg);
+
+  bgp_info_mpath_aggregate_update (new_select, old_select);
+  bgp_mp_list_clear (&mp_list);
+
+  /* bgp pic: a candidate left out of the multipaths is as good as the
+     best path, so it beats the backup bgp_best_compare found. */
+  backup = result->backup;
+  pic = (bgp_flag_check (bgp, BGP_FLAG_PIC)
+         && bgp_node_table (rn)->type == BGP_TABLE_MAIN);
+  for (ri = result->mp_first; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND))
+      {
+	UNSET_FLAG (ri->flags, BGP_INFO_MULTIPATH_CAND);
+	if (pic
+	    && ! CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH)
+	    && bgp_info_backup_eligible (new_select, ri)
+	    && bgp_info_cmp (bgp, ri, backup, &paths_eq))
+	  backup = ri;
+      }
+  bgp_pic_backup_set (rn, new_select, backup);
+}
+
+static int
+bgp_best_do_mpath (struct bgp_maxpaths_cfg *mpath_cfg)
+{
+  return (mpath_cfg->maxpaths_ebgp != BGP_DEFAULT_MAXPATHS ||
+          mpath_cfg->maxpaths_ibgp != BGP_DEFAULT_MAXPATHS);
+}
+
 static void
 bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
                     struct bgp_maxpaths_cfg *mpath_cfg,
@@ -1323,16 +1619,13 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 {
   struct bgp_info *new_select;
   struct bgp_info *old_select;
-  struct bgp_info *ri;
   struct bgp_info *ri1;
   struct bgp_info *ri2;
-  struct bgp_info *nextri = NULL;
   int paths_eq, do_mpath;
   struct list mp_list;
 
   bgp_mp_list_init (&mp_list);
-  do_mpath = (mpath_cfg->maxpaths_ebgp != BGP_DEFAULT_MAXPATHS ||
-	      mpath_cfg->maxpaths_ibgp != BGP_DEFAULT_MAXPATHS);
+  do_mpath = bgp_best_do_mpath (mpath_cfg);
 
   /* bgp deterministic-med */
   new_select = NULL;
@@ -1386,65 +1679,8 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 	bgp_mp_list_clear (&mp_list);
       }
 
-  /* Check old selected route and new selected route. */
-  old_select = NULL;
-  new_select = NULL;
-  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
-    {
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
-	old_select = ri;
-
-      if (BGP_INFO_HOLDDOWN (ri))
-        {
-          /* reap REMOVED routes, if needs be
-           * selected route must stay for a while longer though
-           */
-          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
-              && (ri != old_select))
-              bgp_info_reap (rn, ri, safi);
-
-          continue;
-        }
-
-      if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED)
-          && (! CHECK_FLAG (ri->flags, BGP_INFO_DMED_SELECTED)))
-	{
-	  bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
-	  continue;
-        }
-      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
-      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_SELECTED);
-
-      if (bgp_info_cmp (bgp, ri, new_select, &paths_eq))
-	{
-	  if (do_mpath && bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
-	    bgp_mp_dmed_deselect (new_select);
-
-	  new_select = ri;
-
-	  if (do_mpath && !paths_eq)
-	    {
-	      bgp_mp_list_clear (&mp_list);
-	      bgp_mp_list_add (&mp_list, ri);
-	    }
-	}
-      else if (do_mpath && bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
-	bgp_mp_dmed_deselect (ri);
-
-      if (do_mpath && paths_eq)
-	bgp_mp_list_add (&mp_list, ri);
-    }
-
-  if (!bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
-      bgp_info_mpath_update (rn, new_select, old_select, &mp_list, mpath_cfg);
-
-  bgp_info_mpath_aggregate_update (new_select, old_select);
-  bgp_mp_list_clear (&mp_list);
-
-  result->old = old_select;
-  result->new = new_select;
-
-  return;
+  bgp_best_compare (bgp, rn, do_mpath, result);
+  bgp_best_update (bgp, rn, mpath_cfg, result, safi);
 }
 
 static int
@@ -1497,12 +1733,22 @@ bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
   return 0;
 }
 
+/* Nodes of the main tables processed at once, see bgp_process_main.  */
+#define BGP_PROCESS_MAIN_BATCH 256
+
 struct bgp_process_queue
 {
   struct bgp *bgp;
   struct bgp_node *rn;
   afi_t afi;
   safi_t safi;
+
+  /* Nodes of the main tables waiting for processing, see bm.  */
+  struct bgp_process_queue *next;
+
+  /* Set once the paths are compared in a batch.  */
+  int compared;
+  struct bgp_info_pair result;
 };
 
 static wq_item_status
@@ -1567,10 +1813,57 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
   return WQ_SUCCESS;
 }
 
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+/* Announce a change of the selected path of a node to the peers, the
+   FIB and OVSDB. */
+static void
+bgp_process_install (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                     safi_t safi, struct bgp_info *old_select,
+                     struct bgp_info *new_select)
+{
+  struct prefix *p = &rn->p;
+  struct listnode *node, *nnode;
+  struct peer *peer;
+
+  /* Check each BGP peer. */
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    {
+      bgp_process_announce_selected (peer, new_select, rn, afi, safi);
+    }
+
+  /* FIB update. */
+  if ((safi == SAFI_UNICAST || safi == SAFI_MULTICAST) && (! bgp->name &&
+      ! bgp_option_check (BGP_OPT_NO_FIB)))
+    {
+      if (new_select
+	  && new_select->type == ZEBRA_ROUTE_BGP
+          && new_select->sub_type == BGP_ROUTE_NORMAL) {
+          if (! bgp_checkpoint_fib_update (bgp, rn, afi, safi, new_select))
+            bgp_zebra_announce (p, new_select, bgp, safi);
+      }
+      else
+	{
+	  /* Withdraw the route from the kernel. */
+	  if (old_select
+	      && old_select->type == ZEBRA_ROUTE_BGP
+	      && old_select->sub_type == BGP_ROUTE_NORMAL) {
+          bgp_checkpoint_fib_update (bgp, rn, afi, safi, NULL);
+          bgp_zebra_withdraw (p, old_select, safi);
+      }
+	}
+    }
+#ifdef ENABLE_OVSDB
+  if (old_select) {
+      bgp_ovsdb_update_local_rib_entry_attributes (p, old_select, bgp, safi);
+  }
+  if (new_select) {
+      bgp_ovsdb_update_local_rib_entry_attributes (p, new_select, bgp, safi);
+  }
+#endif
+}
+
+static void
+bgp_process_main_node (struct bgp_process_queue *pq)
 {
-  struct bgp_process_queue *pq = data;
   struct bgp *bgp = pq->bgp;
   struct bgp_node *rn = pq->rn;
   afi_t afi = pq->afi;
@@ -1579,11 +1872,17 @@ bgp_process_main (struct work_queue *wq, void *data)
   struct bgp_info *new_select;
   struct bgp_info *old_select;
   struct bgp_info_pair old_and_new;
-  struct listnode *node, *nnode;
-  struct peer *peer;
 
-  /* Best path selection. */
-  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new, safi);
+  /* Best path selection, unless the paths were compared already. */
+  if (pq->compared)
+    {
+      old_and_new = pq->result;
+      bgp_best_update (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new,
+                       safi);
+    }
+  else
+    bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new,
+                        safi);
   old_select = old_and_new.old;
   new_select = old_and_new.new;
 
@@ -1594,14 +1893,16 @@ bgp_process_main (struct work_queue *wq, void *data)
         {
           if (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED) ||
               CHECK_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG)) {
-              bgp_zebra_announce (p, old_select, bgp, safi);
+              if (! bgp_checkpoint_fib_update (bgp, rn, afi, safi,
+                                               old_select))
+                bgp_zebra_announce (p, old_select, bgp, safi);
           }
           UNSET_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG);
           UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
 #ifdef ENABLE_OVSDB
           bgp_ovsdb_update_local_rib_entry_attributes (p, old_select, bgp, safi);
 #endif
-          return WQ_SUCCESS;
+          return;
         }
     }
 
@@ -1614,39 +1915,7 @@ bgp_process_main (struct work_queue *wq, void *data)
       UNSET_FLAG (new_select->flags, BGP_INFO_MULTIPATH_CHG);
     }
 
-  /* Check each BGP peer. */
-  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-    {
-      bgp_process_announce_selected (peer, new_select, rn, afi, safi);
-    }
-
-  /* FIB update. */
-  if ((safi == SAFI_UNICAST || safi == SAFI_MULTICAST) && (! bgp->name &&
-      ! bgp_option_check (BGP_OPT_NO_FIB)))
-    {
-      if (new_select
-	  && new_select->type == ZEBRA_ROUTE_BGP
-          && new_select->sub_type == BGP_ROUTE_NORMAL) {
-          bgp_zebra_announce (p, new_select, bgp, safi);
-      }
-      else
-	{
-	  /* Withdraw the route from the kernel. */
-	  if (old_select
-	      && old_select->type == ZEBRA_ROUTE_BGP
-	      && old_select->sub_type == BGP_ROUTE_NORMAL) {
-          bgp_zebra_withdraw (p, old_select, safi);
-      }
-	}
-    }
-#ifdef ENABLE_OVSDB
-  if (old_select) {
-      bgp_ovsdb_update_local_rib_entry_attributes (p, old_select, bgp, safi);
-  }
-  if (new_select) {
-      bgp_ovsdb_update_local_rib_entry_attributes (p, new_select, bgp, safi);
-  }
-#endif
+  bgp_process_install (bgp, rn, afi, safi, old_select, new_select);
 
   /* Reap old select bgp_info, it it has been removed */
   if (old_select && CHECK_FLAG (old_select->flags, BGP_INFO_REMOVED)) {
@@ -1654,19 +1923,106 @@ bgp_process_main (struct work_queue *wq, void *data)
   }
 
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-  return WQ_SUCCESS;
 }
 
 static void
-bgp_processq_del (struct work_queue *wq, void *data)
+bgp_processq_del (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp_table *table = bgp_node_table (pq->rn);
+
+  bgp_unlock (pq->bgp);
+  bgp_unlock_node (pq->rn);
+  bgp_table_unlock (table);
+  XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
+}
+
+/* Compare the paths of a node of a batch, on any thread of the pool. */
+static void
+bgp_process_compare (void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp_maxpaths_cfg *mpath_cfg = &pq->bgp->maxpaths[pq->afi][pq->safi];
+
+  bgp_best_compare (pq->bgp, pq->rn, bgp_best_do_mpath (mpath_cfg),
+                    &pq->result);
+}
+
+/* Process the nodes of the main tables in batches, until all are done or
+ * the time slot of this work queue run is used up.  The paths of the
+ * nodes of a batch are compared in parallel by the threads of the
+ * process pool.  Everything else, from reaping removed paths to updating
+ * peers, the FIB and OVSDB, is done on this thread, one node after the
+ * other.  With deterministic-med the comparison does more than read the
+ * paths, such nodes are done on this thread from the start.  Keepalives
+ * which fall due meanwhile are sent in between batches.
+ */
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *batch[BGP_PROCESS_MAIN_BATCH];
+  struct bgp_process_queue *cmp[BGP_PROCESS_MAIN_BATCH];
+  struct bgp_process_queue *pq;
+  unsigned int i, n, ncmp;
+  unsigned int count = 0;
+  int yielded = 0;
+
+  while (bm->process_main_head)
+    {
+      n = ncmp = 0;
+      while (n < BGP_PROCESS_MAIN_BATCH && (pq = bm->process_main_head))
+        {
+          bm->process_main_head = pq->next;
+          pq->next = NULL;
+          batch[n++] = pq;
+
+          if (! bgp_flag_check (pq->bgp, BGP_FLAG_DETERMINISTIC_MED))
+            {
+              pq->compared = 1;
+              cmp[ncmp++] = pq;
+            }
+        }
+      if (! bm->process_main_head)
+        bm->process_main_tail = NULL;
+
+      work_pool_run (bm->process_pool, bgp_process_compare,
+                     (void **) cmp, ncmp);
+
+      for (i = 0; i < n; i++)
+        {
+          bgp_process_main_node (batch[i]);
+          bgp_processq_del (wq, batch[i]);
+        }
+      count += n;
+
+      bgp_keepalives_send_due ();
+
+      if (bm->process_main_head && work_queue_should_yield (wq))
+        {
+          yielded = 1;
+          break;
+        }
+    }
+
+  work_queue_batch_done (wq, count, yielded);
+
+  return bm->process_main_head ? WQ_REQUEUE : WQ_SUCCESS;
+}
+
+/* The process_main_queue item is removed: drop the nodes still waiting,
+ * if the queue is going away. */
+static void
+bgp_process_main_del (struct work_queue *wq, void *data)
 {
-  struct bgp_process_queue *pq = data;
-  struct bgp_table *table = bgp_node_table (pq->rn);
+  struct bgp_process_queue *pq;
 
-  bgp_unlock (pq->bgp);
-  bgp_unlock_node (pq->rn);
-  bgp_table_unlock (table);
-  XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
+  while ((pq = bm->process_main_head) != NULL)
+    {
+      bm->process_main_head = pq->next;
+      UNSET_FLAG (pq->rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+      bgp_processq_del (wq, pq);
+    }
+  bm->process_main_tail = NULL;
 }
 
 static void
@@ -1683,14 +2039,21 @@ bgp_process_queue_init (void)
       exit (1);
     }
 
+  /* The main queue holds a single item while there are nodes waiting on
+     bm->process_main_head, see bgp_process. */
   bm->process_main_queue->spec.workfunc = &bgp_process_main;
-  bm->process_main_queue->spec.del_item_data = &bgp_processq_del;
+  bm->process_main_queue->spec.del_item_data = &bgp_process_main_del;
   bm->process_main_queue->spec.max_retries = 0;
   bm->process_main_queue->spec.hold = 50;
 
-  memcpy (bm->process_rsclient_queue, bm->process_main_queue,
-          sizeof (struct work_queue *));
   bm->process_rsclient_queue->spec.workfunc = &bgp_process_rsclient;
+  bm->process_rsclient_queue->spec.del_item_data = &bgp_processq_del;
+  bm->process_rsclient_queue->spec.max_retries = 0;
+  bm->process_rsclient_queue->spec.hold = 50;
+
+  if (! bm->process_pool)
+    bm->process_pool = work_pool_new ("bgp_best_compare",
+                                      bm->process_threads);
 }
 
 void
@@ -1722,7 +2085,14 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   switch (bgp_node_table (rn)->type)
     {
       case BGP_TABLE_MAIN:
-        work_queue_add (bm->process_main_queue, pqnode);
+        if (! bm->process_main_head)
+          {
+            work_queue_add (bm->process_main_queue, bm);
+            bm->process_main_head = pqnode;
+          }
+        else
+          bm->process_main_tail->next = pqnode;
+        bm->process_main_tail = pqnode;
         break;
       case BGP_TABLE_RSCLIENT:
         work_queue_add (bm->process_rsclient_queue, pqnode);
@@ -1733,6 +2103,169 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   return;
 }
 
+/* Queue every node of the main tables of the instance for best path
+ * selection, e.g. as bgp pic is turned on or off.
+ */
+void
+bgp_process_all (struct bgp *bgp)
+{
+  struct bgp_node *rn, *rm;
+  struct bgp_table *table;
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      for (rn = bgp_table_top (bgp->rib[afi][safi]); rn;
+           rn = bgp_route_next (rn))
+        {
+          if (safi != SAFI_MPLS_VPN)
+            {
+              if (rn->info)
+                bgp_process (bgp, rn, afi, safi);
+              continue;
+            }
+
+          if ((table = rn->info) != NULL)
+            for (rm = bgp_table_top (table); rm; rm = bgp_route_next (rm))
+              if (rm->info)
+                bgp_process (bgp, rm, afi, safi);
+        }
+}
+
+/* bgp pic: the selected path of a node is about to fail, because its
+ * peer went down or its nexthop became unreachable.  Move the node over
+ * to the backup path chosen by the last best path selection at once,
+ * without waiting for the node to be processed, and queue the node so
+ * that selection catches up later on.  The backup may have failed along
+ * with the selected path, so its nexthop is checked again first.
+ * Returns 1 if the backup path was installed.
+ */
+int
+bgp_pic_switchover (struct bgp *bgp, struct bgp_node *rn,
+                    struct bgp_info *failed, afi_t afi, safi_t safi)
+{
+  struct bgp_info *backup = rn->pic_backup;
+
+  if (! bgp_flag_check (bgp, BGP_FLAG_PIC))
+    return 0;
+  if (bgp_node_table (rn)->type != BGP_TABLE_MAIN)
+    return 0;
+  if (! CHECK_FLAG (failed->flags, BGP_INFO_SELECTED))
+    return 0;
+  if (! backup || backup == failed || BGP_INFO_HOLDDOWN (backup))
+    return 0;
+  if (backup->peer == failed->peer)
+    return 0;
+  if (backup->peer != bgp->peer_self
+      && backup->peer->status != Established)
+    return 0;
+  if (safi == SAFI_UNICAST
+      && ! bgp_info_nexthop_check (afi, backup, NULL, NULL))
+    return 0;
+
+  bgp_info_mpath_clear (failed);
+  bgp_info_unset_flag (rn, failed, BGP_INFO_SELECTED);
+  bgp_info_set_flag (rn, backup, BGP_INFO_SELECTED);
+  bgp_info_unset_flag (rn, backup, BGP_INFO_ATTR_CHANGED);
+  bgp_pic_backup_set (rn, NULL, NULL);
+
+  if (BGP_DEBUG (events, EVENTS))
+    {
+      char buf[SU_ADDRSTRLEN];
+
+      zlog_debug ("%s/%d: switching over from %s to backup path via %s",
+                  inet_ntop (rn->p.family, &rn->p.u.prefix, buf, sizeof (buf)),
+                  rn->p.prefixlen, failed->peer->host, backup->peer->host);
+    }
+
+  bgp_process_install (bgp, rn, afi, safi, failed, backup);
+  bgp_process (bgp, rn, afi, safi);
+  return 1;
+}
+
+/* The selected path of a node of the bgp pic index, if it is the
+   peer's. */
+static struct bgp_info *
+bgp_pic_selected (struct bgp_node *rn, struct peer *peer)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      return ri->peer == peer ? ri : NULL;
+  return NULL;
+}
+
+/* bgp pic: the peer goes down.  Switch the nodes whose selected path
+ * is the peer's over to their backups at once, finding them in the
+ * index, rather than as the clear queue gets to each node.
+ */
+static void
+bgp_pic_peer_down (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_pic_dep *dep, *dep_next;
+  struct bgp_node *rn, *rn_next;
+  struct bgp_info *ri;
+
+  for (dep = peer->pic_deps[afi][safi]; dep; dep = dep_next)
+    {
+      dep_next = dep->next;
+      for (rn = dep->nodes; rn; rn = rn_next)
+        {
+          rn_next = rn->pic_next;
+          if ((ri = bgp_pic_selected (rn, peer)) != NULL)
+            bgp_pic_switchover (peer->bgp, rn, ri, afi, safi);
+        }
+      bgp_keepalives_send_due ();
+    }
+}
+
+/* bgp pic: before bgp_scan walks the unicast table, look up the
+ * nexthops of the index once each, and switch the nodes whose selected
+ * path goes over one that became unreachable over to their backups.
+ */
+void
+bgp_pic_nexthop_scan (struct bgp *bgp, afi_t afi)
+{
+  struct peer *peer;
+  struct listnode *node, *nnode;
+  struct bgp_pic_dep *dep, *dep_next;
+  struct bgp_node *rn, *rn_next;
+  struct bgp_info *ri;
+  struct prefix nh;
+  int valid;
+
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    for (dep = peer->pic_deps[afi][SAFI_UNICAST]; dep; dep = dep_next)
+      {
+        dep_next = dep->next;
+        valid = -1;
+        for (rn = dep->nodes; rn; rn = rn_next)
+          {
+            rn_next = rn->pic_next;
+            ri = bgp_pic_selected (rn, peer);
+            if (! ri || ! CHECK_FLAG (ri->flags, BGP_INFO_VALID))
+              continue;
+
+            /* Its attributes may have changed since it was filed. */
+            bgp_pic_nexthop (afi, ri, &nh);
+            if (! prefix_same (&dep->nexthop, &nh))
+              continue;
+
+            if (valid < 0)
+              valid = bgp_info_nexthop_check (afi, ri, NULL, NULL);
+            if (valid)
+              break;
+
+            bgp_aggregate_decrement (bgp, &rn->p, ri, afi, SAFI_UNICAST);
+            bgp_info_unset_flag (rn, ri, BGP_INFO_VALID);
+            bgp_pic_switchover (bgp, rn, ri, afi, SAFI_UNICAST);
+          }
+        bgp_keepalives_send_due ();
+      }
+}
+
 static int
 bgp_maximum_prefix_restart_timer (struct thread *thread)
 {
@@ -2620,16 +3153,19 @@ bgp_announce_table (struct peer *peer, afi_t afi, safi_t safi,
   attr.extra = &extra;
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next(rn))
-    for (ri = rn->info; ri; ri = ri->next)
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) && ri->peer != peer)
-	{
-         if ( (rsclient) ?
-              (bgp_announce_check_rsclient (ri, peer, &rn->p, &attr, afi, safi))
-              : (bgp_announce_check (ri, peer, &rn->p, &attr, afi, safi)))
-	    bgp_adj_out_set (rn, peer, &rn->p, &attr, afi, safi, ri);
-	  else
-	    bgp_adj_out_unset (rn, peer, &rn->p, afi, safi);
-	}
+    {
+      for (ri = rn->info; ri; ri = ri->next)
+	if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) && ri->peer != peer)
+	  {
+	    if ( (rsclient) ?
+		 (bgp_announce_check_rsclient (ri, peer, &rn->p, &attr, afi, safi))
+		 : (bgp_announce_check (ri, peer, &rn->p, &attr, afi, safi)))
+	      bgp_adj_out_set (rn, peer, &rn->p, &attr, afi, safi, ri);
+	    else
+	      bgp_adj_out_unset (rn, peer, &rn->p, afi, safi);
+	  }
+      bgp_keepalives_send_due ();
+    }
 }
 
 void
@@ -2687,8 +3223,8 @@ bgp_soft_reconfig_table_rsclient (struct peer *rsclient, afi_t afi,
         struct bgp_info *ri = rn->info;
         u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-        bgp_update_rsclient (rsclient, afi, safi, ain->attr, ain->peer,
-                &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+        bgp_update_rsclient (rsclient, afi, safi, ain->attr,
+                BGP_ADJ_IN_PEER (ain), &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
       }
 }
 
@@ -2723,29 +3259,49 @@ bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
 
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+    {
+      for (ain = rn->adj_in; ain; ain = ain->next)
+	{
+	  if (BGP_ADJ_IN_PEER (ain) == peer)
+	    {
+	      struct bgp_info *ri = rn->info;
+	      u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
+	      ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
+				ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+				prd, tag, 1);
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	    continue;
-	  }
-      }
+	      if (ret < 0)
+		{
+		  bgp_unlock_node (rn);
+		  return;
+		}
+	      continue;
+	    }
+	}
+      bgp_keepalives_send_due ();
+    }
+}
+
+static int
+bgp_soft_reconfig_adj_in (struct bgp_adj_in *ain, void *arg)
+{
+  struct bgp_node *rn = ain->rn;
+  struct bgp_info *ri = rn->info;
+  u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+
+  /* The session may go down over it, and the adjacencies with it. */
+  return bgp_update (BGP_ADJ_IN_PEER (ain), &rn->p, ain->attr,
+                     bgp_node_table (rn)->afi, bgp_node_table (rn)->safi,
+                     ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, tag, 1) < 0;
+}
+
+/* Replay the peer's Adj-RIB-In from its own blocks of adjacencies. */
+static void
+bgp_soft_reconfig_peer (struct peer *peer, afi_t afi, safi_t safi)
+{
+  bgp_adj_in_walk (peer, afi, safi, bgp_soft_reconfig_adj_in, NULL);
 }
 
 void
@@ -2758,7 +3314,7 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
     return;
 
   if (safi != SAFI_MPLS_VPN)
-    bgp_soft_reconfig_table (peer, afi, safi, NULL, NULL);
+    bgp_soft_reconfig_peer (peer, afi, safi);
   else
     for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
 	 rn = bgp_route_next (rn))
@@ -2802,7 +3358,11 @@ bgp_clear_route_node (struct work_queue *wq, void *data)
             && ! CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
           bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
         else
-          bgp_rib_remove (rn, ri, peer, afi, safi);
+          {
+            /* Fail the route over to its backup before it goes. */
+            bgp_pic_switchover (peer->bgp, rn, ri, afi, safi);
+            bgp_rib_remove (rn, ri, peer, afi, safi);
+          }
         break;
       }
   return WQ_SUCCESS;
@@ -2855,100 +3415,92 @@ bgp_clear_node_queue_init (struct peer *peer)
 }
 
 static void
-bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
-                       struct bgp_table *table, struct peer *rsclient,
-                       enum bgp_clear_route_type purpose)
+bgp_clear_node_queue_add (struct peer *peer, struct bgp_node *rn,
+                          enum bgp_clear_route_type purpose)
+{
+  struct bgp_clear_node_queue *cnq;
+
+  /* both unlocked in bgp_clear_node_queue_del */
+  bgp_table_lock (bgp_node_table (rn));
+  bgp_lock_node (rn);
+  cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                 sizeof (struct bgp_clear_node_queue));
+  cnq->rn = rn;
+  cnq->purpose = purpose;
+  work_queue_add (peer->clear_node_queue, cnq);
+}
+
+/* Scrub the peer's own entries, in whichever table of the afi/safi
+ * they are: its Adj-RIB-In and Adj-RIB-Out go right away, the nodes
+ * with its routes are queued for bgp_clear_route_node.
+ */
+static void
+bgp_clear_route_peer (struct peer *peer, afi_t afi, safi_t safi,
+                      enum bgp_clear_route_type purpose)
 {
   struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct bgp_adj_out *aout, *aout_next;
 
+  bgp_clear_adj_in (peer, afi, safi);
 
-  if (! table)
-    table = (rsclient) ? rsclient->rib[afi][safi] : peer->bgp->rib[afi][safi];
+  for (aout = peer->adj_out_list[afi][safi]; aout; aout = aout_next)
+    {
+      aout_next = aout->peer_next;
+      rn = aout->rn;
+      bgp_adj_out_remove (rn, aout, peer, afi, safi);
+      bgp_unlock_node (rn);
+    }
 
-  /* If still no table => afi/safi isn't configured at all or smth. */
+  /* The peer can have more than one route on a node; queue it once.
+   * The mark only lasts for this walk, as other peers may be clearing
+   * the same nodes on queues of their own. */
+  for (ri = peer->info_list[afi][safi]; ri; ri = ri->peer_next)
+    if (! CHECK_FLAG (ri->net->flags, BGP_NODE_CLEAR_QUEUED))
+      {
+        SET_FLAG (ri->net->flags, BGP_NODE_CLEAR_QUEUED);
+        bgp_clear_node_queue_add (peer, ri->net, purpose);
+      }
+  for (ri = peer->info_list[afi][safi]; ri; ri = ri->peer_next)
+    UNSET_FLAG (ri->net->flags, BGP_NODE_CLEAR_QUEUED);
+}
+
+/* Scrub every entry of a route server client's own RIB. */
+static void
+bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
+                       struct bgp_table *table,
+                       enum bgp_clear_route_type purpose)
+{
+  struct bgp_node *rn;
+
+  /* If no table => afi/safi isn't configured at all or smth. */
   if (! table)
     return;
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_info *ri;
       struct bgp_adj_in *ain;
       struct bgp_adj_out *aout;
 
-      /* OPS_TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       */
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_in_remove (rn, ain);
-            bgp_unlock_node (rn);
-            break;
-          }
-      for (aout = rn->adj_out; aout; aout = aout->next)
-        if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_out_remove (rn, aout, peer, afi, safi);
-            bgp_unlock_node (rn);
-            break;
-          }
-
-      for (ri = rn->info; ri; ri = ri->next)
-        if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            struct bgp_clear_node_queue *cnq;
-
-            /* both unlocked in bgp_clear_node_queue_del */
-            bgp_table_lock (bgp_node_table (rn));
-            bgp_lock_node (rn);
-            cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-                           sizeof (struct bgp_clear_node_queue));
-            cnq->rn = rn;
-            cnq->purpose = purpose;
-            work_queue_add (peer->clear_node_queue, cnq);
-            break;
-          }
+      if ((ain = rn->adj_in) != NULL)
+        {
+          bgp_adj_in_remove (rn, ain);
+          bgp_unlock_node (rn);
+        }
+      if ((aout = rn->adj_out) != NULL)
+        {
+          bgp_adj_out_remove (rn, aout, peer, afi, safi);
+          bgp_unlock_node (rn);
+        }
+      if (rn->info)
+        bgp_clear_node_queue_add (peer, rn, purpose);
     }
-  return;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
                  enum bgp_clear_route_type purpose)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-  struct peer *rsclient;
-  struct listnode *node, *nnode;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
 
@@ -2970,22 +3522,14 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   switch (purpose)
     {
     case BGP_CLEAR_ROUTE_NORMAL:
-      if (safi != SAFI_MPLS_VPN)
-        bgp_clear_route_table (peer, afi, safi, NULL, NULL, purpose);
-      else
-        for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-             rn = bgp_route_next (rn))
-          if ((table = rn->info) != NULL)
-            bgp_clear_route_table (peer, afi, safi, table, NULL, purpose);
-
-      for (ALL_LIST_ELEMENTS (peer->bgp->rsclient, node, nnode, rsclient))
-        if (CHECK_FLAG(rsclient->af_flags[afi][safi],
-                       PEER_FLAG_RSERVER_CLIENT))
-          bgp_clear_route_table (peer, afi, safi, NULL, rsclient, purpose);
+      if (! (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
+             && peer->nsf[afi][safi]))
+        bgp_pic_peer_down (peer, afi, safi);
+      bgp_clear_route_peer (peer, afi, safi, purpose);
       break;
 
     case BGP_CLEAR_ROUTE_MY_RSCLIENT:
-      bgp_clear_route_table (peer, afi, safi, NULL, peer, purpose);
+      bgp_clear_route_table (peer, afi, safi, peer->rib[afi][safi], purpose);
       break;
 
     default:
@@ -2995,8 +3539,6 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
 
   /* If no routes were cleared, nothing was added to workqueue, the
    * completion function won't be run by workqueue code - call it here.
-   * XXX: Actually, this assumption doesn't hold, see
-   * bgp_clear_route_table(), we queue all non-empty nodes.
    *
    * Additionally, there is a presumption in FSM that clearing is only
    * really needed if peer state is Established - peers in
@@ -3027,43 +3569,32 @@ bgp_clear_route_all (struct peer *peer)
       bgp_clear_route (peer, afi, safi, BGP_CLEAR_ROUTE_NORMAL);
 }
 
-void
-bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
+static int
+bgp_clear_adj_in_one (struct bgp_adj_in *ain, void *arg)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
+  struct bgp_node *rn = ain->rn;
 
-  table = peer->bgp->rib[afi][safi];
+  bgp_adj_in_remove (rn, ain);
+  bgp_unlock_node (rn);
+  return 0;
+}
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+void
+bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
+{
+  bgp_adj_in_walk (peer, afi, safi, bgp_clear_adj_in_one, NULL);
 }
 
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_info *ri;
-  struct bgp_table *table;
-
-  table = peer->bgp->rib[afi][safi];
+  struct bgp_info *ri, *next;
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (ri = peer->info_list[afi][safi]; ri; ri = next)
     {
-      for (ri = rn->info; ri; ri = ri->next)
-	if (ri->peer == peer)
-	  {
-	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
-	    break;
-	  }
+      next = ri->peer_next;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+	bgp_rib_remove (ri->net, ri, peer, afi, safi);
     }
 }
 
@@ -6200,21 +6731,51 @@ enum bgp_show_type
   bgp_show_type_damp_neighbor
 };
 
+/* State of a BGP table display, see vty_show_start(). */
+struct bgp_show
+{
+  struct bgp_table *table;
+
+  /* Next node to display, locked. */
+  struct bgp_node *rn;
+
+  struct in_addr router_id;
+  enum bgp_show_type type;
+  void *output_arg;
+
+  /* Private copy of output_arg for filters passed by value. */
+  union
+  {
+    struct prefix p;
+    union sockunion su;
+  } arg;
+
+  int header;
+  unsigned long output_count;
+};
+
+static void
+bgp_show_free (void *arg)
+{
+  struct bgp_show *show = arg;
+
+  if (show->rn)
+    bgp_unlock_node (show->rn);
+  bgp_table_unlock (show->table);
+  XFREE (MTYPE_TMP, show);
+}
+
 static int
-bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
-	  enum bgp_show_type type, void *output_arg)
+bgp_show_table_resume (struct vty *vty, void *arg)
 {
+  struct bgp_show *show = arg;
+  enum bgp_show_type type = show->type;
+  void *output_arg = show->output_arg;
   struct bgp_info *ri;
   struct bgp_node *rn;
-  int header = 1;
   int display;
-  unsigned long output_count;
 
-  /* This is first entry point, so reset total line. */
-  output_count = 0;
-
-  /* Start processing of routes. */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (rn = show->rn; rn; rn = bgp_route_next (rn))
     if (rn->info != NULL)
       {
 	display = 0;
@@ -6365,9 +6926,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  continue;
 	      }
 
-	    if (header)
+	    if (show->header)
 	      {
-		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (*router_id), VTY_NEWLINE);
+		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (show->router_id), VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		if (type == bgp_show_type_dampend_paths
@@ -6386,7 +6947,7 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  vty_out (vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
 		else
 		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		header = 0;
+		show->header = 0;
 	      }
 
 	    if (type == bgp_show_type_dampend_paths
@@ -6408,18 +6969,80 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    display++;
 	  }
 	if (display)
-	  output_count++;
+	  show->output_count++;
+
+	/* Yield between nodes, bgp_route_next() keeps our place locked. */
+	if (vty_show_full (vty))
+	  {
+	    show->rn = bgp_route_next (rn);
+	    if (show->rn)
+	      return VTY_SHOW_MORE;
+	    break;
+	  }
       }
+  show->rn = NULL;
 
   /* No route is displayed */
-  if (output_count == 0)
+  if (show->output_count == 0)
     {
       if (type == bgp_show_type_normal)
 	vty_out (vty, "No BGP network exists%s", VTY_NEWLINE);
     }
   else
     vty_out (vty, "%sTotal number of prefixes %ld%s",
-	     VTY_NEWLINE, output_count, VTY_NEWLINE);
+	     VTY_NEWLINE, show->output_count, VTY_NEWLINE);
+
+  return VTY_SHOW_DONE;
+}
+
+static int
+bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
+	  enum bgp_show_type type, void *output_arg)
+{
+  struct bgp_show *show;
+
+  show = XCALLOC (MTYPE_TMP, sizeof (struct bgp_show));
+  bgp_table_lock (table);
+  show->table = table;
+  show->router_id = *router_id;
+  show->type = type;
+  show->output_arg = output_arg;
+  show->header = 1;
+
+  switch (type)
+    {
+    case bgp_show_type_normal:
+    case bgp_show_type_cidr_only:
+    case bgp_show_type_community_all:
+    case bgp_show_type_flap_statistics:
+    case bgp_show_type_flap_cidr_only:
+    case bgp_show_type_dampend_paths:
+      break;
+    case bgp_show_type_prefix_longer:
+    case bgp_show_type_flap_address:
+    case bgp_show_type_flap_prefix:
+    case bgp_show_type_flap_prefix_longer:
+      prefix_copy (&show->arg.p, output_arg);
+      show->output_arg = &show->arg.p;
+      break;
+    case bgp_show_type_neighbor:
+    case bgp_show_type_flap_neighbor:
+    case bgp_show_type_damp_neighbor:
+      show->arg.su = *(union sockunion *) output_arg;
+      show->output_arg = &show->arg.su;
+      break;
+    default:
+      /* Filters owned by the caller or the configuration could go away
+	 between two chunks, display everything at once. */
+      show->rn = bgp_table_top (table);
+      while (bgp_show_table_resume (vty, show) == VTY_SHOW_MORE)
+	;
+      bgp_show_free (show);
+      return CMD_SUCCESS;
+    }
+
+  show->rn = bgp_table_top (table);
+  vty_show_start (vty, bgp_show_table_resume, show, bgp_show_free);
 
   return CMD_SUCCESS;
 }
@@ -9686,7 +10309,7 @@ bgp_peer_count_walker (struct thread *t)
       struct bgp_info *ri;
 
       for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
+        if (BGP_ADJ_IN_PEER (ain) == peer)
           pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
@@ -9911,7 +10534,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
     if (in)
       {
 	for (ain = rn->adj_in; ain; ain = ain->next)
-	  if (ain->peer == peer)
+	  if (BGP_ADJ_IN_PEER (ain) == peer)
 	    {
 	      if (header1)
 		{
@@ -54,6 +54,13 @@ struct bgp_info
   /* Peer structure.  */
   struct peer *peer;
 
+  /* Linked list of the peer's routes, see peer->info_list. */
+  struct bgp_info *peer_next;
+  struct bgp_info *peer_prev;
+
+  /* Node this route is on. */
+  struct bgp_node *net;
+
   /* Attribute structure.  */
   struct attr *attr;
   
@@ -85,6 +92,7 @@ struct bgp_info
 #define BGP_INFO_COUNTED	(1 << 10)
 #define BGP_INFO_MULTIPATH      (1 << 11)
 #define BGP_INFO_MULTIPATH_CHG  (1 << 12)
+#define BGP_INFO_MULTIPATH_CAND (1 << 13)
 
   /* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
   u_char type;
@@ -98,6 +106,18 @@ struct bgp_info
 #define BGP_ROUTE_REDISTRIBUTE 3 
 };
 
+/* bgp pic: the nodes of the tables of an afi/safi whose selected path
+   comes from the peer over the nexthop, and which have a backup path.
+   These are what is to be switched over should the peer go down or the
+   nexthop become unreachable, see peer->pic_deps. */
+struct bgp_pic_dep
+{
+  struct bgp_pic_dep *next;
+  struct peer *peer;
+  struct prefix nexthop;
+  struct bgp_node *nodes;
+};
+
 /* BGP static route configuration. */
 struct bgp_static
 {
@@ -233,6 +253,10 @@ extern int bgp_withdraw (struct peer *, struct prefix *, struct attr *,
 
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process (struct bgp *, struct bgp_node *, afi_t, safi_t);
+extern void bgp_process_all (struct bgp *);
+extern int bgp_pic_switchover (struct bgp *, struct bgp_node *,
+                               struct bgp_info *, afi_t, safi_t);
+extern void bgp_pic_nexthop_scan (struct bgp *, afi_t);
 extern int bgp_config_write_network (struct vty *, struct bgp *, afi_t, safi_t, int *);
 extern int bgp_config_write_distance (struct vty *, struct bgp *);
 
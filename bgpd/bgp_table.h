@@ -63,8 +63,18 @@ struct bgp_node
 
   struct bgp_node *prn;
 
+  /* Precomputed backup of the selected path, see bgp pic. */
+  struct bgp_info *pic_backup;
+
+  /* Nodes with a backup, by the peer and nexthop of the selected path,
+     see bgp_pic_backup_set. */
+  struct bgp_pic_dep *pic_dep;
+  struct bgp_node *pic_prev;
+  struct bgp_node *pic_next;
+
   u_char flags;
 #define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
+#define BGP_NODE_CLEAR_QUEUED		(1 << 1)
 };
 
 /*
@@ -102,7 +102,7 @@ bgp_interface_delete (int command, struct zclient *zclient,
 
   s = zclient->ibuf;
   ifp = zebra_interface_state_read (s);
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   if (BGP_DEBUG(zebra, ZEBRA))
     zlog_debug("Zebra rcvd: interface delete %s", ifp->name);
@@ -151,6 +151,7 @@ bgp_interface_down (int command, struct zclient *zclient, zebra_size_t length)
 
   for (ALL_LIST_ELEMENTS (ifp->connected, node, nnode, c))
     bgp_connected_delete (c);
+  bgp_scan_now ();
 
   /* Fast external-failover */
   {
@@ -222,7 +223,10 @@ bgp_interface_address_delete (int command, struct zclient *zclient,
     }
 
   if (if_is_operative (ifc->ifp))
-    bgp_connected_delete (ifc);
+    {
+      bgp_connected_delete (ifc);
+      bgp_scan_now ();
+    }
 
   connected_free (ifc);
 
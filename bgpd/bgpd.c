@@ -36,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "linklist.h"
 #include "workqueue.h"
+#include "workpool.h"
 #include "openvswitch/vlog.h"
 
 #include "bgpd/bgpd.h"
@@ -50,6 +51,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_clist.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_filter.h"
@@ -60,6 +62,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_checkpoint.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -747,6 +750,7 @@ peer_free (struct peer *peer)
   bgp_timer_set (peer);
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
+  bgp_io_stop (peer);
   BGP_EVENT_FLUSH (peer);
   
   if (peer->desc)
@@ -767,6 +771,7 @@ peer_free (struct peer *peer)
     work_queue_free (peer->clear_node_queue);
   
   bgp_sync_delete (peer);
+  bgp_attr_cache_flush (peer);
   memset (peer, 0, sizeof (struct peer));
   
   XFREE (MTYPE_BGP_PEER, peer);
@@ -859,6 +864,7 @@ peer_new (struct bgp *bgp)
 
   /* Create buffers.  */
   peer->ibuf = stream_new (BGP_MAX_PACKET_SIZE);
+  peer->ibuf_work = stream_new (BGP_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX);
   peer->obuf = stream_fifo_new ();
   peer->work = stream_new (BGP_MAX_PACKET_SIZE);
   peer->scratch = stream_new (BGP_MAX_PACKET_SIZE);
@@ -1322,6 +1328,8 @@ peer_delete (struct peer *peer)
   /* Buffers.  */
   if (peer->ibuf)
     stream_free (peer->ibuf);
+  if (peer->ibuf_work)
+    stream_free (peer->ibuf_work);
   if (peer->obuf)
     stream_fifo_free (peer->obuf);
   if (peer->work)
@@ -1329,7 +1337,7 @@ peer_delete (struct peer *peer)
   if (peer->scratch)
     stream_free(peer->scratch);
   peer->obuf = NULL;
-  peer->work = peer->scratch = peer->ibuf = NULL;
+  peer->work = peer->scratch = peer->ibuf = peer->ibuf_work = NULL;
 
   /* Local and remote addresses. */
   if (peer->su_local)
@@ -5403,6 +5411,10 @@ bgp_config_write (struct vty *vty)
       if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
 	vty_out (vty, " bgp deterministic-med%s", VTY_NEWLINE);
 
+      /* BGP pic. */
+      if (bgp_flag_check (bgp, BGP_FLAG_PIC))
+	vty_out (vty, " bgp pic%s", VTY_NEWLINE);
+
       /* BGP graceful-restart. */
       if (bgp->stalepath_time != BGP_DEFAULT_STALEPATH_TIME)
 	vty_out (vty, " bgp graceful-restart stalepath-time %d%s",
@@ -5566,6 +5578,7 @@ bgp_terminate (void)
                            BGP_NOTIFY_CEASE_PEER_UNCONFIG);
   
   bgp_cleanup_routes ();
+  bgp_checkpoint_discard ();
   
   if (bm->process_main_queue)
     {
@@ -5577,4 +5590,9 @@ bgp_terminate (void)
       work_queue_free (bm->process_rsclient_queue);
       bm->process_rsclient_queue = NULL;
     }
+  if (bm->process_pool)
+    {
+      work_pool_free (bm->process_pool);
+      bm->process_pool = NULL;
+    }
 }
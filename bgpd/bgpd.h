@@ -28,6 +28,10 @@
 #include "sockunion.h"
 /* For struct stream_fifo */
 #include "stream.h"
+#ifdef ENABLE_OVSDB
+/* For struct uuid */
+#include "uuid.h"
+#endif
 
 /* Typedef BGP specific types.  */
 typedef u_int32_t as_t;
@@ -46,6 +50,13 @@ struct bgp_master
   /* work queues */
   struct work_queue *process_main_queue;
   struct work_queue *process_rsclient_queue;
+
+  /* Nodes of the main tables waiting for best path selection, and
+     the threads comparing their paths, see bgp_process_main.  */
+  struct bgp_process_queue *process_main_head;
+  struct bgp_process_queue *process_main_tail;
+  unsigned int process_threads;
+  struct work_pool *process_pool;
   
   /* Listening sockets */
   struct list *listen_sockets;
@@ -128,6 +139,7 @@ struct bgp
 #define BGP_FLAG_GRACEFUL_RESTART         (1 << 12)
 #define BGP_FLAG_ASPATH_CONFED            (1 << 13)
 #define BGP_FLAG_ASPATH_MULTIPATH_RELAX   (1 << 14)
+#define BGP_FLAG_PIC                      (1 << 15)
 
   /* BGP Per AF flags */
   u_int16_t af_flags[AFI_MAX][SAFI_MAX];
@@ -318,6 +330,12 @@ struct peer
   /* Packet receive and send buffer. */
   struct stream *ibuf;
   struct stream_fifo *obuf;
+
+  /* Input read from the socket, not yet split into messages. */
+  struct stream *ibuf_work;
+
+  /* Thread reading from the socket. */
+  struct bgp_io *io;
   struct stream *work;
 
   /* We use a separate stream to encode MP_REACH_NLRI for efficient
@@ -359,6 +377,11 @@ struct peer
 #ifdef ENABLE_OVSDB
   /* BFD section */
   int bfd_status;	/* status of BFD session */
+
+  /* Statistics publication to OVSDB, see bgp_ovsdb_if.c */
+  int stats_dirty;		/* changed since last published */
+  int stats_queued;		/* on the list of peers to publish */
+  struct uuid nbr_row_uuid;	/* BGP_Neighbor row, zero if not known */
 #endif
 
   /* Peer address family configuration. */
@@ -495,6 +518,7 @@ struct peer
   struct thread *t_pmax_restart;
   struct thread *t_gr_restart;
   struct thread *t_gr_stale;
+  struct thread *t_process_packet;
   
   /* workqueues */
   struct work_queue *clear_node_queue;
@@ -528,6 +552,24 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Recently received attribute blocks, see bgp_attr_parse.  */
+  struct bgp_attr_cache *attr_cache;
+
+  /* Routes and Adj-RIB-Out entries of this peer, over all tables of
+     the afi/safi, so clearing needn't walk the whole RIB.  The Adj-RIB-In
+     entries are found from their blocks, see bgp_adj_in_walk. */
+  struct bgp_info *info_list[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_out *adj_out_list[AFI_MAX][SAFI_MAX];
+
+  /* Storage of the peer's adjacencies in, in blocks with free entries
+     and full ones, see bgp_adj_in_alloc.  */
+  struct bgp_adj_in_block *adj_in_blocks[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_in_block *adj_in_full[AFI_MAX][SAFI_MAX];
+
+  /* bgp pic: the nodes whose selected path is this peer's, and which
+     have a backup, by nexthop.  */
+  struct bgp_pic_dep *pic_deps[AFI_MAX][SAFI_MAX];
+
   /* Notify data. */
   struct bgp_notify notify;
 
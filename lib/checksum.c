@@ -9,6 +9,312 @@
 #include <zebra.h>
 #include "checksum.h"
 
+/*
+ * Both checksums spend their time adding up the buffer, 16-bit words
+ * for in_cksum and bytes for fletcher_checksum.  That part comes in a
+ * plain C version and, on x86, SSE2 and AVX2 versions, which are
+ * picked at run time by what the CPU supports.  They all come to the
+ * same sums, so the checksums do not depend on which one is used.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#endif
+
+/* Fletcher Checksum -- Refer to RFC1008. */
+#define MODX                 4102   /* 5802 should be fine */
+
+/* Vector blocks summed before the lanes are added up, small enough
+   that none of them can overflow. */
+#define IN_CKSUM_BLOCKS      32768
+#define FLETCHER_BLOCKS      4096
+
+struct checksum_ops
+{
+  const char *name;
+  int (*supported) (void);
+  long (*in_cksum_add) (const u_short *, int);
+  void (*fletcher_add) (const u_int8_t *, size_t, int *, int *);
+};
+
+/* Sum of nwords 16-bit words. */
+static long
+in_cksum_add_scalar (const u_short *ptr, int nwords)
+{
+  long sum = 0;
+
+  while (nwords-- > 0)
+    sum += *ptr++;
+  return sum;
+}
+
+/* Add len bytes to the running sums c0 and c1, which are kept modulo
+   255. */
+static void
+fletcher_add_scalar (const u_int8_t *p, size_t len, int *c0p, int *c1p)
+{
+  int c0 = *c0p, c1 = *c1p;
+  size_t partial_len, i;
+
+  while (len != 0)
+    {
+      partial_len = MIN(len, MODX);
+
+      for (i = 0; i < partial_len; i++)
+	{
+	  c0 = c0 + *(p++);
+	  c1 += c0;
+	}
+
+      c0 = c0 % 255;
+      c1 = c1 % 255;
+
+      len -= partial_len;
+    }
+
+  *c0p = c0;
+  *c1p = c1;
+}
+
+static int
+checksum_supported_scalar (void)
+{
+  return 1;
+}
+
+#ifdef CHECKSUM_X86
+static int
+checksum_supported_sse2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("sse2");
+}
+
+static int
+checksum_supported_avx2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2");
+}
+
+/* Words are widened to 32-bit lanes, each lane takes two words per
+   block. */
+static long __attribute__ ((target ("sse2")))
+in_cksum_add_sse2 (const u_short *ptr, int nwords)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i acc, v;
+  u_int32_t lanes[4];
+  long sum = 0;
+  int n, i;
+
+  while (nwords >= 8)
+    {
+      n = MIN (nwords / 8, IN_CKSUM_BLOCKS);
+      acc = zero;
+      for (i = 0; i < n; i++)
+	{
+	  v = _mm_loadu_si128 ((const __m128i *) ptr);
+	  acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (v, zero));
+	  acc = _mm_add_epi32 (acc, _mm_unpackhi_epi16 (v, zero));
+	  ptr += 8;
+	}
+      _mm_storeu_si128 ((__m128i *) lanes, acc);
+      sum += (long) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+      nwords -= n * 8;
+    }
+
+  return sum + in_cksum_add_scalar (ptr, nwords);
+}
+
+static long __attribute__ ((target ("avx2")))
+in_cksum_add_avx2 (const u_short *ptr, int nwords)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i acc, v;
+  u_int32_t lanes[8];
+  long sum = 0;
+  int n, i;
+
+  while (nwords >= 16)
+    {
+      n = MIN (nwords / 16, IN_CKSUM_BLOCKS);
+      acc = zero;
+      for (i = 0; i < n; i++)
+	{
+	  v = _mm256_loadu_si256 ((const __m256i *) ptr);
+	  acc = _mm256_add_epi32 (acc, _mm256_unpacklo_epi16 (v, zero));
+	  acc = _mm256_add_epi32 (acc, _mm256_unpackhi_epi16 (v, zero));
+	  ptr += 16;
+	}
+      _mm256_storeu_si256 ((__m256i *) lanes, acc);
+      for (i = 0; i < 8; i++)
+	sum += lanes[i];
+      nwords -= n * 16;
+    }
+
+  return sum + in_cksum_add_scalar (ptr, nwords);
+}
+
+/*
+ * For a run of n blocks of 16 bytes, c0 grows by the sum of the bytes
+ * and c1 by 16 * n * c0 plus the sum of each byte weighted by the
+ * number of bytes from it to the end of the run.  The weight within a
+ * block comes from a multiply, the 16 bytes for each later block from
+ * the sum of the bytes of the blocks before every block.
+ */
+static void __attribute__ ((target ("sse2")))
+fletcher_add_sse2 (const u_int8_t *p, size_t len, int *c0p, int *c1p)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i wlo = _mm_set_epi16 (9, 10, 11, 12, 13, 14, 15, 16);
+  const __m128i whi = _mm_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8);
+  __m128i vs1, vs2, vps, v;
+  u_int32_t s1[4], s2[4], ps[4];
+  u_int64_t c0 = *c0p, c1 = *c1p;
+  size_t n, i;
+
+  while (len >= 16)
+    {
+      n = MIN (len / 16, FLETCHER_BLOCKS / 16);
+      vs1 = vs2 = vps = zero;
+      for (i = 0; i < n; i++)
+	{
+	  v = _mm_loadu_si128 ((const __m128i *) p);
+	  vps = _mm_add_epi32 (vps, vs1);
+	  vs1 = _mm_add_epi32 (vs1, _mm_sad_epu8 (v, zero));
+	  vs2 = _mm_add_epi32 (vs2,
+			       _mm_madd_epi16 (_mm_unpacklo_epi8 (v, zero), wlo));
+	  vs2 = _mm_add_epi32 (vs2,
+			       _mm_madd_epi16 (_mm_unpackhi_epi8 (v, zero), whi));
+	  p += 16;
+	}
+      _mm_storeu_si128 ((__m128i *) s1, vs1);
+      _mm_storeu_si128 ((__m128i *) s2, vs2);
+      _mm_storeu_si128 ((__m128i *) ps, vps);
+
+      c1 += 16 * n * c0;
+      c1 += 16 * ((u_int64_t) ps[0] + ps[2]);
+      c1 += (u_int64_t) s2[0] + s2[1] + s2[2] + s2[3];
+      c0 += (u_int64_t) s1[0] + s1[2];
+      c0 %= 255;
+      c1 %= 255;
+      len -= n * 16;
+    }
+
+  *c0p = c0;
+  *c1p = c1;
+  fletcher_add_scalar (p, len, c0p, c1p);
+}
+
+static void __attribute__ ((target ("avx2")))
+fletcher_add_avx2 (const u_int8_t *p, size_t len, int *c0p, int *c1p)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i wlo = _mm256_set_epi16 (17, 18, 19, 20, 21, 22, 23, 24,
+					25, 26, 27, 28, 29, 30, 31, 32);
+  const __m256i whi = _mm256_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8,
+					9, 10, 11, 12, 13, 14, 15, 16);
+  __m256i vs1, vs2, vps, v;
+  u_int32_t s1[8], s2[8], ps[8];
+  u_int64_t c0 = *c0p, c1 = *c1p;
+  size_t n, i;
+
+  while (len >= 32)
+    {
+      n = MIN (len / 32, FLETCHER_BLOCKS / 32);
+      vs1 = vs2 = vps = zero;
+      for (i = 0; i < n; i++)
+	{
+	  v = _mm256_loadu_si256 ((const __m256i *) p);
+	  vps = _mm256_add_epi32 (vps, vs1);
+	  vs1 = _mm256_add_epi32 (vs1, _mm256_sad_epu8 (v, zero));
+	  vs2 = _mm256_add_epi32 (vs2, _mm256_madd_epi16
+				  (_mm256_cvtepu8_epi16
+				   (_mm256_castsi256_si128 (v)), wlo));
+	  vs2 = _mm256_add_epi32 (vs2, _mm256_madd_epi16
+				  (_mm256_cvtepu8_epi16
+				   (_mm256_extracti128_si256 (v, 1)), whi));
+	  p += 32;
+	}
+      _mm256_storeu_si256 ((__m256i *) s1, vs1);
+      _mm256_storeu_si256 ((__m256i *) s2, vs2);
+      _mm256_storeu_si256 ((__m256i *) ps, vps);
+
+      c1 += 32 * n * c0;
+      for (i = 0; i < 8; i++)
+	{
+	  c1 += 32 * (u_int64_t) ps[i] + s2[i];
+	  c0 += s1[i];
+	}
+      c0 %= 255;
+      c1 %= 255;
+      len -= n * 32;
+    }
+
+  *c0p = c0;
+  *c1p = c1;
+  fletcher_add_scalar (p, len, c0p, c1p);
+}
+#endif /* CHECKSUM_X86 */
+
+static const struct checksum_ops checksum_ops[CHECKSUM_IMPL_MAX] =
+{
+  [CHECKSUM_IMPL_SCALAR] = { "scalar", checksum_supported_scalar,
+			     in_cksum_add_scalar, fletcher_add_scalar },
+#ifdef CHECKSUM_X86
+  [CHECKSUM_IMPL_SSE2] = { "sse2", checksum_supported_sse2,
+			   in_cksum_add_sse2, fletcher_add_sse2 },
+  [CHECKSUM_IMPL_AVX2] = { "avx2", checksum_supported_avx2,
+			   in_cksum_add_avx2, fletcher_add_avx2 },
+#else
+  [CHECKSUM_IMPL_SSE2] = { "sse2", NULL, NULL, NULL },
+  [CHECKSUM_IMPL_AVX2] = { "avx2", NULL, NULL, NULL },
+#endif
+};
+
+/* The implementation in use, the best one the CPU supports unless
+   set otherwise. */
+static const struct checksum_ops *cksum_ops = NULL;
+
+/* Use the given implementation of the checksums.  Returns -1 if the
+   CPU does not support it. */
+int
+checksum_impl_set (enum checksum_impl impl)
+{
+  const struct checksum_ops *ops;
+
+  if (impl >= CHECKSUM_IMPL_MAX)
+    return -1;
+  ops = &checksum_ops[impl];
+  if (! ops->supported || ! ops->supported ())
+    return -1;
+  cksum_ops = ops;
+  return 0;
+}
+
+enum checksum_impl
+checksum_impl_get (void)
+{
+  enum checksum_impl impl;
+
+  if (! cksum_ops)
+    for (impl = CHECKSUM_IMPL_MAX; impl-- > 0; )
+      if (checksum_impl_set (impl) == 0)
+	break;
+  return cksum_ops - checksum_ops;
+}
+
+const char *
+checksum_impl_name (enum checksum_impl impl)
+{
+  if (impl >= CHECKSUM_IMPL_MAX)
+    return "unknown";
+  return checksum_ops[impl].name;
+}
+
 int			/* return checksum in low-order 16 bits */
 in_cksum(void *parg, int nbytes)
 {
@@ -23,10 +329,14 @@ in_cksum(void *parg, int nbytes)
 	 * all the carry bits from the top 16 bits into the lower 16 bits.
 	 */
 
+	if (! cksum_ops)
+		checksum_impl_get ();
+
 	sum = 0;
-	while (nbytes > 1)  {
-		sum += *ptr++;
-		nbytes -= 2;
+	if (nbytes > 1) {
+		sum = cksum_ops->in_cksum_add (ptr, nbytes / 2);
+		ptr += nbytes / 2;
+		nbytes %= 2;
 	}
 
 				/* mop up an odd byte, if necessary */
@@ -46,9 +356,6 @@ in_cksum(void *parg, int nbytes)
 	return(answer);
 }
 
-/* Fletcher Checksum -- Refer to RFC1008. */
-#define MODX                 4102   /* 5802 should be fine */
-
 /* To be consistent, offset is 0-based index, rather than the 1-based 
    index required in the specification ISO 8473, Annex C.1 */
 /* calling with offset == FLETCHER_CHECKSUM_VALIDATE will validate the checksum
@@ -56,12 +363,10 @@ in_cksum(void *parg, int nbytes)
 u_int16_t
 fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
 {
-  u_int8_t *p;
   int x, y, c0, c1;
   u_int16_t checksum;
   u_int16_t *csum;
-  size_t partial_len, i, left = len;
-  
+
   checksum = 0;
 
 
@@ -73,25 +378,12 @@ fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
       *(csum) = 0;
     }
 
-  p = buffer;
+  if (! cksum_ops)
+    checksum_impl_get ();
+
   c0 = 0;
   c1 = 0;
-
-  while (left != 0)
-    {
-      partial_len = MIN(left, MODX);
-
-      for (i = 0; i < partial_len; i++)
-	{
-	  c0 = c0 + *(p++);
-	  c1 += c0;
-	}
-
-      c0 = c0 % 255;
-      c1 = c1 % 255;
-
-      left -= partial_len;
-    }
+  cksum_ops->fletcher_add (buffer, len, &c0, &c1);
 
   /* The cast is important, to ensure the mod is taken as a signed value. */
   x = (int)((len - offset - 1) * c0 - c1) % 255;
@@ -1,3 +1,21 @@
+#ifndef _ZEBRA_CHECKSUM_H
+#define _ZEBRA_CHECKSUM_H
+
+/* Implementations of the checksums, by how fast they are. */
+enum checksum_impl
+{
+  CHECKSUM_IMPL_SCALAR,
+  CHECKSUM_IMPL_SSE2,
+  CHECKSUM_IMPL_AVX2,
+  CHECKSUM_IMPL_MAX,
+};
+
 extern int in_cksum(void *, int);
 #define FLETCHER_CHECKSUM_VALIDATE 0xffff
 extern u_int16_t fletcher_checksum(u_char *, const size_t len, const uint16_t offset);
+
+extern int checksum_impl_set (enum checksum_impl);
+extern enum checksum_impl checksum_impl_get (void);
+extern const char *checksum_impl_name (enum checksum_impl);
+
+#endif /* _ZEBRA_CHECKSUM_H */
@@ -31,6 +31,7 @@ Boston, MA 02111-1307, USA.  */
 #include "vector.h"
 #include "vty.h"
 #include "command.h"
+#include "hash.h"
 #include "workqueue.h"
 
 /* Command vector which includes some level of command lists. Normally
@@ -571,6 +572,249 @@ cmd_parse_format(const char *string, const char *descstr)
     }
 }
 
+/* The commands of a node are compiled into a token trie when they are
+ * installed.  Every edge of the trie stands for a token which consumes
+ * exactly one word of the commandline (a plain terminal or a multiple),
+ * so the leading tokens of a command form a path starting at the root.
+ * Tokens which may consume a varying number of words (keywords and
+ * varargs) end that path; the command is then recorded as opaque at the
+ * trie node it reached.  Commands which are completely described by
+ * their path are recorded as ended at the trie node they reached.
+ *
+ * Command lines are then matched in cmd_execute_command_real against the
+ * few commands the trie leads to, instead of against every command of
+ * the node. */
+struct cmd_trie_index
+{
+  unsigned int count;
+  unsigned int alloced;
+  unsigned int *index;		/* Indexes into the node's cmd_vector. */
+};
+
+struct cmd_trie
+{
+  /* Vector of struct cmd_trie_edge leaving this trie node. */
+  vector edges;
+
+  /* Literal words of the edges, hash of struct cmd_trie_literal. */
+  struct hash *literals;
+
+  /* Commands whose tokens all lie on the path to this trie node. */
+  struct cmd_trie_index ended;
+
+  /* Commands whose path ends here at a keyword or vararg token. */
+  struct cmd_trie_index opaque;
+};
+
+struct cmd_trie_edge
+{
+  struct cmd_token *token;	/* TOKEN_TERMINAL or TOKEN_MULTIPLE */
+  int literal;			/* token matches literal words only */
+  struct cmd_trie *child;
+};
+
+struct cmd_trie_literal
+{
+  const char *word;
+  vector edges;			/* edges accepting word as exact match */
+};
+
+/* Words which are matched literally by cmd_word_match. */
+#define CMD_LITERAL(S) \
+  (!CMD_VARARG (S) && !CMD_OPTION (S) && !CMD_VARIABLE (S))
+
+static unsigned int
+cmd_trie_literal_key (void *arg)
+{
+  struct cmd_trie_literal *literal = arg;
+
+  return string_hash_make (literal->word);
+}
+
+static int
+cmd_trie_literal_cmp (const void *a, const void *b)
+{
+  const struct cmd_trie_literal *la = a;
+  const struct cmd_trie_literal *lb = b;
+
+  return strcmp (la->word, lb->word) == 0;
+}
+
+static void *
+cmd_trie_literal_alloc (void *arg)
+{
+  struct cmd_trie_literal *key = arg;
+  struct cmd_trie_literal *literal;
+
+  literal = XMALLOC (MTYPE_CMD_TRIE, sizeof (struct cmd_trie_literal));
+  literal->word = key->word;
+  literal->edges = vector_init (VECTOR_MIN_SIZE);
+  return literal;
+}
+
+static void
+cmd_trie_literal_free (void *arg)
+{
+  struct cmd_trie_literal *literal = arg;
+
+  vector_free (literal->edges);
+  XFREE (MTYPE_CMD_TRIE, literal);
+}
+
+static struct cmd_trie *
+cmd_trie_new (void)
+{
+  struct cmd_trie *trie;
+
+  trie = XCALLOC (MTYPE_CMD_TRIE, sizeof (struct cmd_trie));
+  trie->edges = vector_init (VECTOR_MIN_SIZE);
+  return trie;
+}
+
+static void
+cmd_trie_free (struct cmd_trie *trie)
+{
+  unsigned int i;
+  struct cmd_trie_edge *edge;
+
+  for (i = 0; i < vector_active (trie->edges); i++)
+    if ((edge = vector_slot (trie->edges, i)) != NULL)
+      {
+        cmd_trie_free (edge->child);
+        XFREE (MTYPE_CMD_TRIE, edge);
+      }
+  vector_free (trie->edges);
+
+  if (trie->literals)
+    {
+      hash_clean (trie->literals, cmd_trie_literal_free);
+      hash_free (trie->literals);
+    }
+
+  if (trie->ended.index)
+    XFREE (MTYPE_CMD_TRIE, trie->ended.index);
+  if (trie->opaque.index)
+    XFREE (MTYPE_CMD_TRIE, trie->opaque.index);
+  XFREE (MTYPE_CMD_TRIE, trie);
+}
+
+static void
+cmd_trie_index_add (struct cmd_trie_index *list, unsigned int index)
+{
+  if (list->count == list->alloced)
+    {
+      list->alloced = list->alloced ? list->alloced * 2 : 4;
+      list->index = XREALLOC (MTYPE_CMD_TRIE, list->index,
+                              sizeof (unsigned int) * list->alloced);
+    }
+  list->index[list->count++] = index;
+}
+
+static void
+cmd_trie_literal_add (struct cmd_trie *trie, const char *word,
+                      struct cmd_trie_edge *edge)
+{
+  struct cmd_trie_literal key;
+  struct cmd_trie_literal *literal;
+
+  if (trie->literals == NULL)
+    trie->literals = hash_create_size (16, cmd_trie_literal_key,
+                                       cmd_trie_literal_cmp);
+
+  key.word = word;
+  literal = hash_get (trie->literals, &key, cmd_trie_literal_alloc);
+  vector_set (literal->edges, edge);
+}
+
+/* Tokens are matched the same way if they are spelled the same way. */
+static int
+cmd_trie_token_equal (struct cmd_token *a, struct cmd_token *b)
+{
+  unsigned int i;
+  struct cmd_token *ta, *tb;
+
+  if (a->type != b->type)
+    return 0;
+
+  if (a->type == TOKEN_TERMINAL)
+    return strcmp (a->cmd, b->cmd) == 0;
+
+  if (vector_active (a->multiple) != vector_active (b->multiple))
+    return 0;
+
+  for (i = 0; i < vector_active (a->multiple); i++)
+    {
+      ta = vector_slot (a->multiple, i);
+      tb = vector_slot (b->multiple, i);
+      if (strcmp (ta->cmd, tb->cmd) != 0)
+        return 0;
+    }
+  return 1;
+}
+
+static struct cmd_trie_edge *
+cmd_trie_edge_get (struct cmd_trie *trie, struct cmd_token *token)
+{
+  unsigned int i;
+  struct cmd_trie_edge *edge;
+  struct cmd_token *word_token;
+
+  for (i = 0; i < vector_active (trie->edges); i++)
+    if ((edge = vector_slot (trie->edges, i)) != NULL
+        && cmd_trie_token_equal (edge->token, token))
+      return edge;
+
+  edge = XMALLOC (MTYPE_CMD_TRIE, sizeof (struct cmd_trie_edge));
+  edge->token = token;
+  edge->child = cmd_trie_new ();
+  vector_set (trie->edges, edge);
+
+  if (token->type == TOKEN_TERMINAL)
+    {
+      edge->literal = CMD_LITERAL (token->cmd);
+      if (edge->literal)
+        cmd_trie_literal_add (trie, token->cmd, edge);
+      return edge;
+    }
+
+  edge->literal = 1;
+  for (i = 0; i < vector_active (token->multiple); i++)
+    {
+      word_token = vector_slot (token->multiple, i);
+      if (CMD_LITERAL (word_token->cmd))
+        cmd_trie_literal_add (trie, word_token->cmd, edge);
+      else
+        edge->literal = 0;
+    }
+  return edge;
+}
+
+static void
+cmd_trie_insert (struct cmd_trie *trie, struct cmd_element *cmd,
+                 unsigned int index)
+{
+  unsigned int token_index;
+  struct cmd_token *token;
+
+  for (token_index = 0;
+       token_index < vector_active (cmd->tokens);
+       token_index++)
+    {
+      token = vector_slot (cmd->tokens, token_index);
+
+      if (token->type == TOKEN_KEYWORD
+          || (token->type == TOKEN_TERMINAL && CMD_VARARG (token->cmd)))
+        {
+          cmd_trie_index_add (&trie->opaque, index);
+          return;
+        }
+
+      trie = cmd_trie_edge_get (trie, token)->child;
+    }
+
+  cmd_trie_index_add (&trie->ended, index);
+}
+
 /* Return prompt character of specified node. */
 const char *
 cmd_prompt (enum node_type node)
@@ -586,6 +830,7 @@ void
 install_element (enum node_type ntype, struct cmd_element *cmd)
 {
   struct cmd_node *cnode;
+  unsigned int index;
   
   /* cmd_init hasn't been called */
   if (!cmdvec)
@@ -600,9 +845,13 @@ install_element (enum node_type ntype, struct cmd_element *cmd)
       exit (1);
     }
 
-  vector_set (cnode->cmd_vector, cmd);
+  index = vector_set (cnode->cmd_vector, cmd);
   if (cmd->tokens == NULL)
     cmd->tokens = cmd_parse_format(cmd->string, cmd->doc);
+
+  if (cnode->cmd_trie == NULL)
+    cnode->cmd_trie = cmd_trie_new ();
+  cmd_trie_insert (cnode->cmd_trie, cmd, index);
 }
 
 static const unsigned char itoa64[] =
@@ -638,6 +887,8 @@ zencrypt (const char *passwd)
 static int
 config_write_host (struct vty *vty)
 {
+  unsigned long slots, dropped;
+
   if (host.name)
     vty_out (vty, "hostname %s%s", host.name, VTY_NEWLINE);
 
@@ -708,6 +959,14 @@ config_write_host (struct vty *vty)
     vty_out (vty, "log timestamp precision %d%s",
 	     zlog_default->timestamp_precision, VTY_NEWLINE);
 
+  if (zlog_async_stats (zlog_default, &slots, &dropped))
+    {
+      vty_out (vty, "log asynchronous");
+      if (slots != ZLOG_ASYNC_SLOTS)
+	vty_out (vty, " %lu", slots);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+
   if (host.advanced)
     vty_out (vty, "service advanced-vty%s", VTY_NEWLINE);
 
@@ -2561,6 +2820,242 @@ node_parent ( enum node_type node )
   return ret;
 }
 
+static void
+cmd_trie_index_mark (struct cmd_trie_index *list, u_char *mark)
+{
+  unsigned int i;
+
+  for (i = 0; i < list->count; i++)
+    mark[list->index[i]] = 1;
+}
+
+/* Mark every command reachable from a trie node. */
+static void
+cmd_trie_mark_all (struct cmd_trie *trie, u_char *mark)
+{
+  unsigned int i;
+  struct cmd_trie_edge *edge;
+
+  cmd_trie_index_mark (&trie->ended, mark);
+  cmd_trie_index_mark (&trie->opaque, mark);
+
+  for (i = 0; i < vector_active (trie->edges); i++)
+    if ((edge = vector_slot (trie->edges, i)) != NULL)
+      cmd_trie_mark_all (edge->child, mark);
+}
+
+static void
+cmd_trie_vector_add (vector tries, struct cmd_trie *trie)
+{
+  unsigned int i;
+
+  for (i = 0; i < vector_active (tries); i++)
+    if (vector_slot (tries, i) == trie)
+      return;
+  vector_set (tries, trie);
+}
+
+/* Match the word at position index against an edge the same way
+ * cmd_element_match would match it against the corresponding token. */
+static enum matcher_rv
+cmd_trie_edge_match (struct cmd_trie_edge *edge,
+                     enum filter_type filter,
+                     vector vline,
+                     unsigned int index,
+                     enum match_type *match_type,
+                     vector *match)
+{
+  struct cmd_matcher matcher;
+
+  cmd_matcher_init(&matcher, NULL, filter, vline, index, match_type, match);
+  matcher.word_index = index;
+
+  if (edge->token->type == TOKEN_TERMINAL)
+    return cmd_matcher_match_terminal(&matcher, edge->token, NULL, NULL);
+  return cmd_matcher_match_multiple(&matcher, edge->token, NULL, NULL);
+}
+
+/**
+ * Advance a set of trie nodes by the word at position index of vline.
+ *
+ * The trie nodes' commands are those which survived the filtering of
+ * cmd_execute_command_real for all previous words and which are still
+ * aligned to the commandline.  The same filtering is done here once per
+ * edge instead of once per command.
+ *
+ * @param tries Vector of struct cmd_trie*, the current trie nodes.
+ * @param opaque Whether any opaque command is still a candidate.
+ * @param best Where to store the best match type for the word.
+ * @return Vector of the trie nodes reached, or NULL if the word cannot be
+ *         resolved by the trie alone.
+ */
+static vector
+cmd_trie_step (vector tries,
+               enum filter_type filter,
+               vector vline,
+               unsigned int index,
+               int opaque,
+               enum match_type *best)
+{
+  unsigned int i, j, k;
+  struct cmd_trie *trie;
+  struct cmd_trie_edge *edge;
+  struct cmd_trie_literal key;
+  struct cmd_trie_literal *literal;
+  enum match_type edge_match;
+  vector next;
+  vector edges;
+  vector matches;
+  int ret;
+
+  next = vector_init (VECTOR_MIN_SIZE);
+
+  /* An exact match beats any other match and makes is_cmd_ambiguous()
+   * drop every candidate which didn't match exactly. */
+  key.word = vector_slot (vline, index);
+  for (i = 0; i < vector_active (tries); i++)
+    if ((trie = vector_slot (tries, i))->literals
+        && (literal = hash_lookup (trie->literals, &key)) != NULL)
+      for (j = 0; j < vector_active (literal->edges); j++)
+        cmd_trie_vector_add (next, ((struct cmd_trie_edge *)
+                                    vector_slot (literal->edges, j))->child);
+
+  if (vector_active (next))
+    {
+      *best = exact_match;
+      return next;
+    }
+
+  /* Without an exact match, the best match type depends on all the
+   * candidates, which can't be told for opaque commands. */
+  if (opaque)
+    {
+      vector_free (next);
+      return NULL;
+    }
+
+  *best = no_match;
+  edges = vector_init (VECTOR_MIN_SIZE);
+  matches = vector_init (VECTOR_MIN_SIZE);
+
+  for (i = 0, k = 0; i < vector_active (tries); i++)
+    {
+      trie = vector_slot (tries, i);
+      for (j = 0; j < vector_active (trie->edges); j++)
+        {
+          edge = vector_slot (trie->edges, j);
+
+          /* Literals can only match partly, which strict filtering
+           * doesn't accept. */
+          if (filter == FILTER_STRICT && edge->literal)
+            continue;
+
+          vector_set_index (matches, k, NULL);
+          if (MATCHER_ERROR(cmd_trie_edge_match (edge, filter, vline, index,
+                                                 &edge_match,
+                                                 (vector *)&vector_slot(matches, k))))
+            continue;
+
+          vector_set_index (edges, k++, edge);
+          if (edge_match > *best)
+            *best = edge_match;
+        }
+    }
+
+  ret = is_cmd_ambiguous (edges, vector_slot (vline, index), matches, *best);
+  cmd_matches_free(&matches);
+
+  if (ret == 0)
+    for (i = 0; i < vector_active (edges); i++)
+      if ((edge = vector_slot (edges, i)) != NULL)
+        cmd_trie_vector_add (next, edge->child);
+
+  vector_free (edges);
+
+  /* Leave ambiguous commandlines to the full matcher for reporting. */
+  if (ret != 0)
+    {
+      vector_free (next);
+      return NULL;
+    }
+  return next;
+}
+
+/**
+ * Collect the commands of a node which may match a given commandline.
+ *
+ * The returned vector holds, in their original order, a subset of the
+ * node's commands on which cmd_execute_command_real comes to the same
+ * conclusion as on the full set, provided it raises the best match type
+ * of each word to at least the one recorded in best.
+ *
+ * @param cnode The command node.
+ * @param filter Either FILTER_RELAXED or FILTER_STRICT.
+ * @param vline The tokenized commandline.
+ * @param best Array of vector_active(vline) match types to fill in.
+ * @return A newly allocated vector of struct cmd_element*.
+ */
+static vector
+cmd_trie_filter (struct cmd_node *cnode,
+                 enum filter_type filter,
+                 vector vline,
+                 enum match_type *best)
+{
+  unsigned int i;
+  unsigned int index;
+  vector tries;
+  vector next;
+  vector commands;
+  struct cmd_trie *trie;
+  const char *word;
+  u_char *mark;
+  int opaque;
+
+  if (cnode->cmd_trie == NULL)
+    return vector_copy (cnode->cmd_vector);
+
+  mark = XCALLOC (MTYPE_TMP, vector_active (cnode->cmd_vector) + 1);
+  tries = vector_init (VECTOR_MIN_SIZE);
+  vector_set (tries, cnode->cmd_trie);
+  opaque = 0;
+
+  for (index = 0; index < vector_active (vline); index++)
+    {
+      for (i = 0; i < vector_active (tries); i++)
+        {
+          trie = vector_slot (tries, i);
+          if (trie->opaque.count)
+            {
+              cmd_trie_index_mark (&trie->opaque, mark);
+              opaque = 1;
+            }
+        }
+
+      word = vector_slot (vline, index);
+      if (word == NULL || *word == '\0')
+        break;
+
+      next = cmd_trie_step (tries, filter, vline, index, opaque, &best[index]);
+      if (next == NULL)
+        break;
+
+      vector_free (tries);
+      tries = next;
+    }
+
+  for (i = 0; i < vector_active (tries); i++)
+    cmd_trie_mark_all (vector_slot (tries, i), mark);
+  vector_free (tries);
+
+  commands = vector_init (VECTOR_MIN_SIZE);
+  for (i = 0; i < vector_active (cnode->cmd_vector); i++)
+    if (mark[i])
+      vector_set (commands, vector_slot (cnode->cmd_vector, i));
+
+  XFREE (MTYPE_TMP, mark);
+  return commands;
+}
+
 /* Execute command by argument vline vector. */
 static int
 cmd_execute_command_real (vector vline,
@@ -2577,12 +3072,16 @@ cmd_execute_command_real (vector vline,
   int argc;
   const char *argv[CMD_ARGC_MAX];
   enum match_type match = 0;
+  enum match_type *best;
   char *command;
   int ret;
   vector matches;
 
-  /* Make copy of command elements. */
-  cmd_vector = vector_copy (cmd_node_vector (cmdvec, vty->node));
+  /* Collect the candidate command elements. */
+  best = XCALLOC (MTYPE_TMP, sizeof (enum match_type)
+                             * (vector_active (vline) + 1));
+  cmd_vector = cmd_trie_filter (vector_slot (cmdvec, vty->node), filter,
+                                vline, best);
 
   for (index = 0; index < vector_active (vline); index++)
     {
@@ -2596,9 +3095,15 @@ cmd_execute_command_real (vector vline,
       if (ret != CMD_SUCCESS)
 	{
 	  cmd_matches_free(&matches);
+	  vector_free(cmd_vector);
+	  XFREE (MTYPE_TMP, best);
 	  return ret;
 	}
 
+      /* Commands left behind by the trie may have matched better. */
+      if (match < best[index])
+	match = best[index];
+
       if (match == vararg_match)
 	{
 	  cmd_matches_free(&matches);
@@ -2611,14 +3116,17 @@ cmd_execute_command_real (vector vline,
       if (ret == 1)
 	{
 	  vector_free(cmd_vector);
+	  XFREE (MTYPE_TMP, best);
 	  return CMD_ERR_AMBIGUOUS;
 	}
       else if (ret == 2)
 	{
 	  vector_free(cmd_vector);
+	  XFREE (MTYPE_TMP, best);
 	  return CMD_ERR_NO_MATCH;
 	}
     }
+  XFREE (MTYPE_TMP, best);
 
   /* Check matched count. */
   matched_element = NULL;
@@ -3539,6 +4047,7 @@ DEFUN (show_logging,
        "Show current logging configuration\n")
 {
   struct zlog *zl = zlog_default;
+  unsigned long slots, dropped;
 
   vty_out (vty, "Syslog logging: ");
   if (zl->maxlvl[ZLOG_DEST_SYSLOG] == ZLOG_DISABLED)
@@ -3581,6 +4090,12 @@ DEFUN (show_logging,
   	   (zl->record_priority ? "enabled" : "disabled"), VTY_NEWLINE);
   vty_out (vty, "Timestamp precision: %d%s",
 	   zl->timestamp_precision, VTY_NEWLINE);
+  vty_out (vty, "Asynchronous logging: ");
+  if (!zlog_async_stats (zl, &slots, &dropped))
+    vty_out (vty, "disabled");
+  else
+    vty_out (vty, "%lu messages, %lu dropped", slots, dropped);
+  vty_out (vty, "%s", VTY_NEWLINE);
 
   return CMD_SUCCESS;
 }
@@ -3905,6 +4420,60 @@ DEFUN (no_config_log_record_priority,
   return CMD_SUCCESS;
 }
 
+DEFUN (config_log_async,
+       config_log_async_cmd,
+       "log asynchronous",
+       "Logging control\n"
+       "Write syslog, file and stdout logs from a separate thread\n")
+{
+  if (zlog_async_enable (NULL, ZLOG_ASYNC_SLOTS) < 0)
+    {
+      vty_out (vty, "%% Could not set up asynchronous logging%s",
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (config_log_async_slots,
+       config_log_async_slots_cmd,
+       "log asynchronous <64-65536>",
+       "Logging control\n"
+       "Write syslog, file and stdout logs from a separate thread\n"
+       "Number of messages queued before messages are dropped\n")
+{
+  unsigned int slots;
+
+  VTY_GET_INTEGER_RANGE ("slots", slots, argv[0], 64, ZLOG_ASYNC_SLOTS_MAX);
+
+  if (zlog_async_enable (NULL, slots) < 0)
+    {
+      vty_out (vty, "%% Could not set up asynchronous logging%s",
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_config_log_async,
+       no_config_log_async_cmd,
+       "no log asynchronous",
+       NO_STR
+       "Logging control\n"
+       "Write syslog, file and stdout logs from a separate thread\n")
+{
+  zlog_async_disable (NULL);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_config_log_async,
+       no_config_log_async_slots_cmd,
+       "no log asynchronous <64-65536>",
+       NO_STR
+       "Logging control\n"
+       "Write syslog, file and stdout logs from a separate thread\n"
+       "Number of messages queued before messages are dropped\n")
+
 DEFUN (config_log_timestamp_precision,
        config_log_timestamp_precision_cmd,
        "log timestamp precision <0-6>",
@@ -4108,6 +4677,10 @@ cmd_init (int terminal)
       install_element (CONFIG_NODE, &no_config_log_trap_cmd);
       install_element (CONFIG_NODE, &config_log_record_priority_cmd);
       install_element (CONFIG_NODE, &no_config_log_record_priority_cmd);
+      install_element (CONFIG_NODE, &config_log_async_cmd);
+      install_element (CONFIG_NODE, &config_log_async_slots_cmd);
+      install_element (CONFIG_NODE, &no_config_log_async_cmd);
+      install_element (CONFIG_NODE, &no_config_log_async_slots_cmd);
       install_element (CONFIG_NODE, &config_log_timestamp_precision_cmd);
       install_element (CONFIG_NODE, &no_config_log_timestamp_precision_cmd);
       install_element (CONFIG_NODE, &service_password_encrypt_cmd);
@@ -4121,6 +4694,12 @@ cmd_init (int terminal)
       install_element (VIEW_NODE, &show_thread_cpu_cmd);
       install_element (ENABLE_NODE, &show_thread_cpu_cmd);
       install_element (RESTRICTED_NODE, &show_thread_cpu_cmd);
+      install_element (VIEW_NODE, &show_thread_latency_cmd);
+      install_element (ENABLE_NODE, &show_thread_latency_cmd);
+      install_element (VIEW_NODE, &show_thread_histogram_cmd);
+      install_element (ENABLE_NODE, &show_thread_histogram_cmd);
+      install_element (VIEW_NODE, &show_thread_dump_cmd);
+      install_element (ENABLE_NODE, &show_thread_dump_cmd);
       
       install_element (ENABLE_NODE, &clear_thread_cpu_cmd);
       install_element (VIEW_NODE, &show_work_queues_cmd);
@@ -4192,6 +4771,12 @@ cmd_terminate ()
           {
             cmd_node_v = cmd_node->cmd_vector;
 
+            if (cmd_node->cmd_trie)
+              {
+                cmd_trie_free (cmd_node->cmd_trie);
+                cmd_node->cmd_trie = NULL;
+              }
+
             for (j = 0; j < vector_active (cmd_node_v); j++)
               if ((cmd_element = vector_slot (cmd_node_v, j)) != NULL)
                 cmd_terminate_element(cmd_element);
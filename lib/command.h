@@ -125,6 +125,9 @@ struct cmd_node
 
   /* Vector of this node's command list. */
   vector cmd_vector;	
+
+  /* Token trie compiled from cmd_vector, see install_element(). */
+  struct cmd_trie *cmd_trie;
 };
 
 enum
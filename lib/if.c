@@ -35,10 +35,21 @@
 #include "buffer.h"
 #include "str.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 /* Master list of interfaces. */
 struct list *iflist;
 
+/* Indexes of iflist by name and by ifindex. */
+static struct hash *ifname_hash;
+static struct hash *ifindex_hash;
+
+/* IPv4 connected addresses and destinations of all interfaces.  The
+   info of each node is the list of struct connected whose address or
+   destination falls on the node's prefix. */
+static struct route_table *ifaddr_ipv4_table;
+
 /* One for each program.  This structure is needed to store hooks. */
 struct if_master
 {
@@ -111,6 +122,76 @@ if_cmp_func (struct interface *ifp1, struct interface *ifp2)
   return 0;
 }
 
+static unsigned int
+if_name_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return string_hash_make (ifp->name);
+}
+
+static int
+if_name_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct interface *ifp1 = arg1;
+  const struct interface *ifp2 = arg2;
+
+  return strcmp (ifp1->name, ifp2->name) == 0;
+}
+
+static unsigned int
+if_index_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return jhash_1word (ifp->ifindex, 0);
+}
+
+static int
+if_index_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct interface *ifp1 = arg1;
+  const struct interface *ifp2 = arg2;
+
+  return ifp1->ifindex == ifp2->ifindex;
+}
+
+/* Drop the interface from the ifindex index.  The kernel may have
+   handed its index to another interface we still hold, which then
+   takes its place. */
+static void
+if_index_release (struct interface *ifp)
+{
+  struct listnode *node;
+  struct interface *other;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL
+      || hash_lookup (ifindex_hash, ifp) != ifp)
+    return;
+
+  hash_release (ifindex_hash, ifp);
+
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, other))
+    if (other != ifp && other->ifindex == ifp->ifindex)
+      {
+        hash_get (ifindex_hash, other, hash_alloc_intern);
+        break;
+      }
+}
+
+/* Set the ifindex of an interface. */
+void
+if_set_index (struct interface *ifp, unsigned int ifindex)
+{
+  if (ifp->ifindex == ifindex)
+    return;
+
+  if_index_release (ifp);
+  ifp->ifindex = ifindex;
+  if (ifindex != IFINDEX_INTERNAL)
+    hash_get (ifindex_hash, ifp, hash_alloc_intern);
+}
+
 /* Create new interface structure. */
 struct interface *
 if_create (const char *name, int namelen)
@@ -125,7 +206,10 @@ if_create (const char *name, int namelen)
   strncpy (ifp->name, name, namelen);
   ifp->name[namelen] = '\0';
   if (if_lookup_by_name(ifp->name) == NULL)
-    listnode_add_sort (iflist, ifp);
+    {
+      listnode_add_sort (iflist, ifp);
+      hash_get (ifname_hash, ifp, hash_alloc_intern);
+    }
   else
     zlog_err("if_create(%s): corruption detected -- interface with this "
 	     "name exists already!", ifp->name);
@@ -145,7 +229,7 @@ if_delete_retain (struct interface *ifp)
   if (if_master.if_delete_hook)
     (*if_master.if_delete_hook) (ifp);
 
-  /* Free connected address list */
+  /* Free connected address list, connected_free unindexes them. */
   list_delete_all_node (ifp->connected);
 }
 
@@ -153,6 +237,9 @@ if_delete_retain (struct interface *ifp)
 void
 if_delete (struct interface *ifp)
 {
+  if (hash_lookup (ifname_hash, ifp) == ifp)
+    hash_release (ifname_hash, ifp);
+  if_index_release (ifp);
   listnode_delete (iflist, ifp);
 
   if_delete_retain(ifp);
@@ -182,15 +269,13 @@ if_add_hook (int type, int (*func)(struct interface *ifp))
 struct interface *
 if_lookup_by_index (unsigned int index)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
-  for (ALL_LIST_ELEMENTS_RO(iflist, node, ifp))
-    {
-      if (ifp->ifindex == index)
-	return ifp;
-    }
-  return NULL;
+  if (index == IFINDEX_INTERNAL)
+    return NULL;
+
+  key.ifindex = index;
+  return hash_lookup (ifindex_hash, &key);
 }
 
 const char *
@@ -215,70 +300,78 @@ ifname2ifindex (const char *name)
 struct interface *
 if_lookup_by_name (const char *name)
 {
-  struct listnode *node;
-  struct interface *ifp;
-  
-  if (name)
-    for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-      {
-        if (strcmp(name, ifp->name) == 0)
-          return ifp;
-      }
-  return NULL;
+  if (name == NULL)
+    return NULL;
+
+  return if_lookup_by_name_len (name, strlen (name));
 }
 
 struct interface *
 if_lookup_by_name_len(const char *name, size_t namelen)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
   if (namelen > INTERFACE_NAMSIZ)
     return NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      if (!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0'))
-	return ifp;
-    }
-  return NULL;
+  memcpy (key.name, name, namelen);
+  key.name[namelen] = '\0';
+  return hash_lookup (ifname_hash, &key);
+}
+
+/* Return the node of the most specific prefix in the IPv4 address
+   index covering addr, the walk up its parents visits all others. */
+static struct route_node *
+ifaddr_ipv4_match (struct in_addr addr)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+
+  p.family = AF_INET;
+  p.prefix = addr;
+  p.prefixlen = IPV4_MAX_BITLEN;
+
+  rn = route_node_match (ifaddr_ipv4_table, (struct prefix *) &p);
+  if (rn)
+    route_unlock_node (rn);
+  return rn;
 }
 
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_exact_address (struct in_addr src)
 {
-  struct listnode *node;
+  struct route_node *rn;
   struct listnode *cnode;
-  struct interface *ifp;
   struct prefix *p;
   struct connected *c;
+  struct interface *match;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
+  match = NULL;
+
+  /* An address is always covered by its own prefix. */
+  for (rn = ifaddr_ipv4_match (src); rn; rn = rn->parent)
+    if (rn->info)
+      for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, cnode, c))
 	{
 	  p = c->address;
 
-	  if (p && p->family == AF_INET)
-	    {
-	      if (IPV4_ADDR_SAME (&p->u.prefix4, &src))
-		return ifp;
-	    }	      
+	  if (p && p->family == AF_INET &&
+	      IPV4_ADDR_SAME (&p->u.prefix4, &src) &&
+	      (!match || if_cmp_func (c->ifp, match) < 0))
+	    match = c->ifp;
 	}
-    }
-  return NULL;
+  return match;
 }
 
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_address (struct in_addr src)
 {
-  struct listnode *node;
+  struct route_node *rn;
   struct prefix addr;
   int bestlen = 0;
   struct listnode *cnode;
-  struct interface *ifp;
   struct connected *c;
   struct interface *match;
 
@@ -288,19 +381,22 @@ if_lookup_address (struct in_addr src)
 
   match = NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
+  /* Both the address and the destination of a connected are indexed,
+     so every connected whose prefix covers src is on this path. */
+  for (rn = ifaddr_ipv4_match (src); rn; rn = rn->parent)
+    if (rn->info)
+      for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, cnode, c))
 	{
 	  if (c->address && (c->address->family == AF_INET) &&
 	      prefix_match(CONNECTED_PREFIX(c), &addr) &&
-	      (c->address->prefixlen > bestlen))
+	      ((c->address->prefixlen > bestlen) ||
+	       (match && c->address->prefixlen == bestlen &&
+	        if_cmp_func (c->ifp, match) < 0)))
 	    {
 	      bestlen = c->address->prefixlen;
-	      match = ifp;
+	      match = c->ifp;
 	    }
 	}
-    }
   return match;
 }
 
@@ -651,6 +747,8 @@ connected_new (void)
 void
 connected_free (struct connected *connected)
 {
+  connected_index_delete (connected);
+
   if (connected->address)
     prefix_free (connected->address);
 
@@ -722,6 +820,7 @@ connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 
       if (connected_same_prefix (ifc->address, p))
 	{
+	  connected_index_delete (ifc);
 	  listnode_delete (ifp->connected, ifc);
 	  return ifc;
 	}
@@ -778,6 +877,7 @@ connected_add_by_prefix (struct interface *ifp, struct prefix *p,
 
   /* Add connected address to the interface. */
   listnode_add (ifp->connected, ifc);
+  connected_index_add (ifc);
   return ifc;
 }
 
@@ -805,93 +905,85 @@ if_indextoname (unsigned int ifindex, char *name)
 }
 #endif
 
-#if 0 /* this route_table of struct connected's is unused
-       * however, it would be good to use a route_table rather than
-       * a list..
-       */
-/* Interface looking up by interface's address. */
-/* Interface's IPv4 address reverse lookup table. */
-struct route_table *ifaddr_ipv4_table;
-/* struct route_table *ifaddr_ipv6_table; */
-
 static void
-ifaddr_ipv4_add (struct in_addr *ifaddr, struct interface *ifp)
+ifaddr_ipv4_add (struct prefix *p, struct connected *ifc)
 {
+  struct prefix_ipv4 key;
   struct route_node *rn;
-  struct prefix_ipv4 p;
 
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
+  if (ifaddr_ipv4_table == NULL || p == NULL || p->family != AF_INET)
+    return;
 
-  rn = route_node_get (ifaddr_ipv4_table, (struct prefix *) &p);
-  if (rn)
-    {
-      route_unlock_node (rn);
-      zlog_info ("ifaddr_ipv4_add(): address %s is already added",
-		 inet_ntoa (*ifaddr));
-      return;
-    }
-  rn->info = ifp;
+  key.family = AF_INET;
+  key.prefix = p->u.prefix4;
+  key.prefixlen = p->prefixlen;
+  apply_mask_ipv4 (&key);
+
+  rn = route_node_get (ifaddr_ipv4_table, (struct prefix *) &key);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = list_new ();
+  listnode_add (rn->info, ifc);
 }
 
 static void
-ifaddr_ipv4_delete (struct in_addr *ifaddr, struct interface *ifp)
+ifaddr_ipv4_delete (struct prefix *p, struct connected *ifc)
 {
+  struct prefix_ipv4 key;
   struct route_node *rn;
-  struct prefix_ipv4 p;
 
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
+  if (ifaddr_ipv4_table == NULL || p == NULL || p->family != AF_INET)
+    return;
 
-  rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
+  key.family = AF_INET;
+  key.prefix = p->u.prefix4;
+  key.prefixlen = p->prefixlen;
+  apply_mask_ipv4 (&key);
+
+  rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &key);
   if (! rn)
+    return;
+  route_unlock_node (rn);
+
+  listnode_delete (rn->info, ifc);
+  if (list_isempty ((struct list *) rn->info))
     {
-      zlog_info ("ifaddr_ipv4_delete(): can't find address %s",
-		 inet_ntoa (*ifaddr));
-      return;
+      list_delete (rn->info);
+      rn->info = NULL;
+      route_unlock_node (rn);
     }
-  rn->info = NULL;
-  route_unlock_node (rn);
-  route_unlock_node (rn);
 }
 
-/* Lookup interface by interface's IP address or interface index. */
-static struct interface *
-ifaddr_ipv4_lookup (struct in_addr *addr, unsigned int ifindex)
+/* Add a connected address, which must not change from now on, to the
+   address index used by the if_lookup_*address functions.  Call this
+   whenever it is added to its interface's connected list. */
+void
+connected_index_add (struct connected *ifc)
 {
-  struct prefix_ipv4 p;
-  struct route_node *rn;
-  struct interface *ifp;
+  ifaddr_ipv4_add (ifc->address, ifc);
+  if (ifc->destination)
+    ifaddr_ipv4_add (ifc->destination, ifc);
+}
 
-  if (addr)
-    {
-      p.family = AF_INET;
-      p.prefixlen = IPV4_MAX_PREFIXLEN;
-      p.prefix = *addr;
-
-      rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
-      if (! rn)
-	return NULL;
-      
-      ifp = rn->info;
-      route_unlock_node (rn);
-      return ifp;
-    }
-  else
-    return if_lookup_by_index(ifindex);
+/* Remove a connected address from the address index.  Call this
+   whenever it is removed from its interface's connected list. */
+void
+connected_index_delete (struct connected *ifc)
+{
+  ifaddr_ipv4_delete (ifc->address, ifc);
+  if (ifc->destination)
+    ifaddr_ipv4_delete (ifc->destination, ifc);
 }
-#endif /* ifaddr_ipv4_table */
 
 /* Initialize interface list. */
 void
 if_init (void)
 {
   iflist = list_new ();
-#if 0
+  ifname_hash = hash_create (if_name_hash_key, if_name_hash_cmp);
+  ifindex_hash = hash_create (if_index_hash_key, if_index_hash_cmp);
   ifaddr_ipv4_table = route_table_init ();
-#endif /* ifaddr_ipv4_table */
 
   if (iflist) {
     iflist->cmp = (int (*)(void *, void *))if_cmp_func;
@@ -917,4 +1009,11 @@ if_terminate (void)
 
   list_delete (iflist);
   iflist = NULL;
+
+  hash_free (ifname_hash);
+  ifname_hash = NULL;
+  hash_free (ifindex_hash);
+  ifindex_hash = NULL;
+  route_table_finish (ifaddr_ipv4_table);
+  ifaddr_ipv4_table = NULL;
 }
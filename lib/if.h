@@ -75,13 +75,14 @@ struct interface
      interface is created, because the configuration info for this interface
      is associated with this structure.  For that reason, the interface
      should also never be deleted (to avoid losing configuration info).
-     To delete, just set ifindex to IFINDEX_INTERNAL to indicate that the
-     interface does not exist in the kernel.
+     To delete, just set ifindex to IFINDEX_INTERNAL with if_set_index to
+     indicate that the interface does not exist in the kernel.
    */
   char name[INTERFACE_NAMSIZ + 1];
 
   /* Interface index (should be IFINDEX_INTERNAL for non-kernel or
-     deleted interfaces). */
+     deleted interfaces).  Only change it with if_set_index, which keeps
+     if_lookup_by_index working. */
   unsigned int ifindex;
 #define IFINDEX_INTERNAL	0
 
@@ -242,6 +243,7 @@ struct connected
 /* Prototypes. */
 extern int if_cmp_func (struct interface *, struct interface *);
 extern struct interface *if_create (const char *name, int namelen);
+extern void if_set_index (struct interface *, unsigned int);
 extern struct interface *if_lookup_by_index (unsigned int);
 extern struct interface *if_lookup_exact_address (struct in_addr);
 extern struct interface *if_lookup_address (struct in_addr);
@@ -303,6 +305,8 @@ extern struct connected  *connected_delete_by_prefix (struct interface *,
                                                struct prefix *);
 extern struct connected  *connected_lookup_address (struct interface *, 
                                              struct in_addr);
+extern void connected_index_add (struct connected *);
+extern void connected_index_delete (struct connected *);
 
 #ifndef HAVE_IF_NAMETOINDEX
 extern unsigned int if_nametoindex (const char *);
@@ -24,6 +24,8 @@
 
 #include <zebra.h>
 
+#include <pthread.h>
+
 #include "log.h"
 #include "memory.h"
 #include "command.h"
@@ -77,42 +79,41 @@ const char *zlog_priority[] =
 
 /* For time string format. */
 
-size_t
-quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
+/* The rendered seconds of the last timestamp. */
+struct timestamp_cache
 {
-  static struct {
-    time_t last;
-    size_t len;
-    char buf[28];
-  } cache;
-  struct timeval clock;
-
-  /* would it be sufficient to use global 'recent_time' here?  I fear not... */
-  gettimeofday(&clock, NULL);
+  time_t last;
+  size_t len;
+  char buf[28];
+};
 
+static size_t
+timestamp_render(struct timestamp_cache *cache, int timestamp_precision,
+		 struct timeval clock, char *buf, size_t buflen)
+{
   /* first, we update the cache if the time has changed */
-  if (cache.last != clock.tv_sec)
+  if (cache->last != clock.tv_sec)
     {
-      struct tm *tm;
-      cache.last = clock.tv_sec;
-      tm = localtime(&cache.last);
-      cache.len = strftime(cache.buf, sizeof(cache.buf),
-      			   "%Y/%m/%d %H:%M:%S", tm);
+      struct tm tm;
+      cache->last = clock.tv_sec;
+      localtime_r(&cache->last, &tm);
+      cache->len = strftime(cache->buf, sizeof(cache->buf),
+      			   "%Y/%m/%d %H:%M:%S", &tm);
     }
   /* note: it's not worth caching the subsecond part, because
      chances are that back-to-back calls are not sufficiently close together
      for the clock not to have ticked forward */
 
-  if (buflen > cache.len)
+  if (buflen > cache->len)
     {
-      memcpy(buf, cache.buf, cache.len);
+      memcpy(buf, cache->buf, cache->len);
       if ((timestamp_precision > 0) &&
-	  (buflen > cache.len+1+timestamp_precision))
+	  (buflen > cache->len+1+timestamp_precision))
 	{
 	  /* should we worry about locale issues? */
 	  static const int divisor[] = {0, 100000, 10000, 1000, 100, 10, 1};
 	  int prec;
-	  char *p = buf+cache.len+1+(prec = timestamp_precision);
+	  char *p = buf+cache->len+1+(prec = timestamp_precision);
 	  *p-- = '\0';
 	  while (prec > 6)
 	    /* this is unlikely to happen, but protect anyway */
@@ -128,16 +129,28 @@ quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
 	    }
 	  while (--prec > 0);
 	  *p = '.';
-	  return cache.len+1+timestamp_precision;
+	  return cache->len+1+timestamp_precision;
 	}
-      buf[cache.len] = '\0';
-      return cache.len;
+      buf[cache->len] = '\0';
+      return cache->len;
     }
   if (buflen > 0)
     buf[0] = '\0';
   return 0;
 }
 
+size_t
+quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
+{
+  static struct timestamp_cache cache;
+  struct timeval clock;
+
+  /* would it be sufficient to use global 'recent_time' here?  I fear not... */
+  gettimeofday(&clock, NULL);
+
+  return timestamp_render(&cache, timestamp_precision, clock, buf, buflen);
+}
+
 /* Utility routine for current time printing. */
 static void
 time_print(FILE *fp, struct timestamp_control *ctl)
@@ -187,6 +200,441 @@ check_log_level(int priority)
 }
 #endif
 
+/*
+ * Asynchronous logging.  Messages are formatted by the thread logging
+ * them into a slot of a ring, and written to syslog, the log file and
+ * stdout by a writer thread, so that a slow disk or syslog daemon does
+ * not hold up the daemon.  The timestamp and prefixes are only
+ * rendered by the writer.  Any thread may log: a slot is claimed by a
+ * compare-and-swap of the tail and handed to the writer through its
+ * sequence number, without taking a lock.  Messages that find the ring
+ * full are dropped and counted, unless they are of LOG_ERR or worse:
+ * those are logged synchronously once the ring is written out.
+ * Messages of LOG_ERR and worse that are queued wait until they are
+ * written out, so that they are not lost if the daemon goes down.
+ * Messages longer than a slot are logged synchronously, after what is
+ * queued ahead of them.  The terminal monitor and the crash logging of
+ * zlog_signal stay synchronous.
+ */
+#define ZLOG_RING_MSGSIZE	1024
+#define ZLOG_DEST_BIT(D)	(1 << (D))
+#define ZLOG_RING_DESTS		(ZLOG_DEST_BIT(ZLOG_DEST_SYSLOG) | \
+				 ZLOG_DEST_BIT(ZLOG_DEST_STDOUT) | \
+				 ZLOG_DEST_BIT(ZLOG_DEST_FILE))
+
+struct zlog_slot
+{
+  unsigned long seq;		/* position of the slot, +1 once filled */
+  int priority;
+  int dests;			/* ZLOG_DEST_BIT()s */
+  struct timeval tv;
+  size_t len;
+  char msg[ZLOG_RING_MSGSIZE];
+};
+
+struct zlog_ring
+{
+  struct zlog *zl;
+  struct zlog_slot *slots;
+  unsigned long mask;
+
+  unsigned long tail;		/* next slot to fill */
+  unsigned long head;		/* next slot to write out */
+  unsigned long dropped;	/* messages that found the ring full */
+  unsigned long dropped_reported;
+
+  pthread_t tid;
+  int running;
+  int stop;
+  int sleeping;			/* writer waits for wake */
+  pthread_mutex_t mtx;
+  pthread_cond_t wake;
+  pthread_cond_t drained;	/* writer caught up with the tail */
+
+  /* held by the writer while it writes, and while zl->fp changes */
+  pthread_mutex_t io_mtx;
+
+  struct timestamp_cache tscache;
+};
+
+static void
+zlog_ring_print (struct zlog *zl, FILE *fp, const char *ts,
+		 struct zlog_slot *slot)
+{
+  fprintf (fp, "%s ", ts);
+  if (zl->record_priority)
+    fprintf (fp, "%s: ", zlog_priority[slot->priority]);
+  fprintf (fp, "%s: ", zlog_proto_names[zl->protocol]);
+  fwrite (slot->msg, 1, slot->len, fp);
+  fputc ('\n', fp);
+}
+
+static void
+zlog_ring_write (struct zlog_ring *ring, struct zlog_slot *slot)
+{
+  struct zlog *zl = ring->zl;
+  char ts[40];
+
+  timestamp_render (&ring->tscache, zl->timestamp_precision, slot->tv,
+		    ts, sizeof (ts));
+
+  if (slot->dests & ZLOG_DEST_BIT(ZLOG_DEST_SYSLOG))
+    syslog (slot->priority|zl->facility, "%s", slot->msg);
+  if ((slot->dests & ZLOG_DEST_BIT(ZLOG_DEST_FILE)) && zl->fp)
+    zlog_ring_print (zl, zl->fp, ts, slot);
+  if (slot->dests & ZLOG_DEST_BIT(ZLOG_DEST_STDOUT))
+    zlog_ring_print (zl, stdout, ts, slot);
+}
+
+/* Log how many messages were dropped since the last time. */
+static void
+zlog_ring_report_dropped (struct zlog_ring *ring)
+{
+  struct zlog *zl = ring->zl;
+  struct zlog_slot slot;
+  unsigned long dropped;
+  zlog_dest_t dest;
+
+  dropped = __atomic_load_n (&ring->dropped, __ATOMIC_RELAXED);
+  if (dropped == ring->dropped_reported)
+    return;
+
+  slot.priority = LOG_WARNING;
+  slot.dests = 0;
+  for (dest = 0; dest < ZLOG_NUM_DESTS; dest++)
+    if (slot.priority <= zl->maxlvl[dest])
+      slot.dests |= ZLOG_DEST_BIT(dest);
+  gettimeofday (&slot.tv, NULL);
+  slot.len = snprintf (slot.msg, sizeof (slot.msg),
+		       "%lu log messages dropped, the log ring was full",
+		       dropped - ring->dropped_reported);
+  zlog_ring_write (ring, &slot);
+
+  ring->dropped_reported = dropped;
+}
+
+static void *
+zlog_ring_writer (void *arg)
+{
+  struct zlog_ring *ring = arg;
+  struct zlog_slot *slot;
+  unsigned long pos;
+
+  pthread_mutex_lock (&ring->mtx);
+  for (;;)
+    {
+      pthread_mutex_unlock (&ring->mtx);
+
+      /* Write out everything that is there, and flush once. */
+      pthread_mutex_lock (&ring->io_mtx);
+      pos = ring->head;
+      for (;;)
+	{
+	  slot = &ring->slots[pos & ring->mask];
+	  if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+	    break;
+	  zlog_ring_write (ring, slot);
+	  __atomic_store_n (&slot->seq, pos + ring->mask + 1,
+			    __ATOMIC_RELEASE);
+	  __atomic_store_n (&ring->head, ++pos, __ATOMIC_RELEASE);
+	}
+      zlog_ring_report_dropped (ring);
+      if (ring->zl->fp)
+	fflush (ring->zl->fp);
+      fflush (stdout);
+      pthread_mutex_unlock (&ring->io_mtx);
+
+      pthread_mutex_lock (&ring->mtx);
+      pthread_cond_broadcast (&ring->drained);
+      if (ring->stop)
+	break;
+
+      /* Sleep unless a message came in meanwhile.  Pairs with the
+         check of sleeping after a slot is filled. */
+      __atomic_store_n (&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+      slot = &ring->slots[pos & ring->mask];
+      if (__atomic_load_n (&slot->seq, __ATOMIC_SEQ_CST) != pos + 1)
+	pthread_cond_wait (&ring->wake, &ring->mtx);
+      __atomic_store_n (&ring->sleeping, 0, __ATOMIC_RELAXED);
+    }
+  pthread_mutex_unlock (&ring->mtx);
+
+  return NULL;
+}
+
+/* The writer is started by the first message, and so again in a child
+   after a fork. */
+static int
+zlog_ring_start (struct zlog_ring *ring)
+{
+  sigset_t sigs, oldsigs;
+  int ret = 0;
+
+  pthread_mutex_lock (&ring->mtx);
+  if (! ring->running)
+    {
+      /* signals are left to the main thread */
+      sigfillset (&sigs);
+      pthread_sigmask (SIG_BLOCK, &sigs, &oldsigs);
+      ring->stop = 0;
+      if (pthread_create (&ring->tid, NULL, zlog_ring_writer, ring) == 0)
+	ring->running = 1;
+      else
+	ret = -1;
+      pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+    }
+  pthread_mutex_unlock (&ring->mtx);
+
+  return ret;
+}
+
+/* Queue a message for the writer.  Returns -1 if it has to be logged
+   synchronously. */
+static int
+zlog_ring_put (struct zlog *zl, int priority, const char *format,
+	       va_list args)
+{
+  struct zlog_ring *ring = zl->ring;
+  struct zlog_slot *slot;
+  unsigned long pos, seq;
+  zlog_dest_t dest;
+  va_list ac;
+  int dests = 0;
+  int len;
+  int truncated;
+
+  for (dest = 0; dest < ZLOG_NUM_DESTS; dest++)
+    if (priority <= zl->maxlvl[dest])
+      dests |= ZLOG_DEST_BIT(dest);
+  dests &= ZLOG_RING_DESTS;
+  if (! dests)
+    return 0;
+
+  if (! ring->running && zlog_ring_start (ring) < 0)
+    return -1;
+
+  pos = __atomic_load_n (&ring->tail, __ATOMIC_RELAXED);
+  for (;;)
+    {
+      slot = &ring->slots[pos & ring->mask];
+      seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+      if (seq == pos)
+	{
+	  if (__atomic_compare_exchange_n (&ring->tail, &pos, pos + 1, 0,
+					   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	    break;
+	}
+      else if ((long) (seq - pos) < 0)
+	{
+	  /* the writer has not got to this slot yet, the ring is full */
+	  if (priority <= LOG_ERR)
+	    {
+	      zlog_async_flush (zl);
+	      return -1;
+	    }
+	  __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELAXED);
+	  return 0;
+	}
+      else
+	pos = __atomic_load_n (&ring->tail, __ATOMIC_RELAXED);
+    }
+
+  slot->priority = priority;
+  slot->dests = dests;
+  gettimeofday (&slot->tv, NULL);
+  va_copy (ac, args);
+  len = vsnprintf (slot->msg, sizeof (slot->msg), format, ac);
+  va_end (ac);
+  if (len < 0)
+    len = 0;
+  slot->len = MIN ((size_t) len, sizeof (slot->msg) - 1);
+  slot->msg[slot->len] = '\0';
+
+  /* A message too long for the slot is not cut short: the slot goes
+     out empty, and once the writer is past it the message is logged
+     synchronously, in its place. */
+  truncated = ((size_t) len >= sizeof (slot->msg));
+  if (truncated)
+    slot->dests = 0;
+  __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n (&ring->sleeping, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock (&ring->mtx);
+      pthread_cond_signal (&ring->wake);
+      pthread_mutex_unlock (&ring->mtx);
+    }
+
+  if (priority <= LOG_ERR || truncated)
+    zlog_async_flush (zl);
+
+  return truncated ? -1 : 0;
+}
+
+void
+zlog_async_flush (struct zlog *zl)
+{
+  struct zlog_ring *ring;
+  unsigned long tail;
+
+  if (zl == NULL)
+    zl = zlog_default;
+  if (zl == NULL || (ring = zl->ring) == NULL || ! ring->running)
+    return;
+
+  tail = __atomic_load_n (&ring->tail, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock (&ring->mtx);
+  pthread_cond_signal (&ring->wake);
+  while (ring->running &&
+	 (long) (__atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) - tail) < 0)
+    pthread_cond_wait (&ring->drained, &ring->mtx);
+  pthread_mutex_unlock (&ring->mtx);
+}
+
+/* Nothing may be queued over a fork, since the writer does not go
+   along into the child. */
+static void
+zlog_async_atfork_prepare (void)
+{
+  struct zlog_ring *ring;
+
+  if (zlog_default == NULL || (ring = zlog_default->ring) == NULL)
+    return;
+  zlog_async_flush (zlog_default);
+  pthread_mutex_lock (&ring->mtx);
+  pthread_mutex_lock (&ring->io_mtx);
+}
+
+static void
+zlog_async_atfork_parent (void)
+{
+  struct zlog_ring *ring;
+
+  if (zlog_default == NULL || (ring = zlog_default->ring) == NULL)
+    return;
+  pthread_mutex_unlock (&ring->io_mtx);
+  pthread_mutex_unlock (&ring->mtx);
+}
+
+static void
+zlog_async_atfork_child (void)
+{
+  struct zlog_ring *ring;
+
+  if (zlog_default == NULL || (ring = zlog_default->ring) == NULL)
+    return;
+  ring->running = 0;
+  ring->sleeping = 0;
+  pthread_mutex_unlock (&ring->io_mtx);
+  pthread_mutex_unlock (&ring->mtx);
+}
+
+int
+zlog_async_enable (struct zlog *zl, unsigned int slots)
+{
+  static int atfork_registered;
+  struct zlog_ring *ring;
+  unsigned long size, i;
+
+  if (zl == NULL)
+    zl = zlog_default;
+
+  if (slots > ZLOG_ASYNC_SLOTS_MAX)
+    slots = ZLOG_ASYNC_SLOTS_MAX;
+  for (size = 2; size < slots; size <<= 1)
+    ;
+
+  /* A ring of another size is set up anew, once the old one is
+     written out. */
+  if (zl->ring)
+    {
+      if (zl->ring->mask + 1 == size)
+	return 0;
+      zlog_async_disable (zl);
+    }
+
+  if (! atfork_registered)
+    {
+      if (pthread_atfork (zlog_async_atfork_prepare, zlog_async_atfork_parent,
+			  zlog_async_atfork_child))
+	return -1;
+      atfork_registered = 1;
+    }
+
+  ring = XCALLOC (MTYPE_ZLOG_RING, sizeof (struct zlog_ring));
+  ring->slots = XCALLOC (MTYPE_ZLOG_RING, size * sizeof (struct zlog_slot));
+  ring->mask = size - 1;
+  for (i = 0; i < size; i++)
+    ring->slots[i].seq = i;
+  ring->zl = zl;
+  pthread_mutex_init (&ring->mtx, NULL);
+  pthread_mutex_init (&ring->io_mtx, NULL);
+  pthread_cond_init (&ring->wake, NULL);
+  pthread_cond_init (&ring->drained, NULL);
+
+  zl->ring = ring;
+  return 0;
+}
+
+void
+zlog_async_disable (struct zlog *zl)
+{
+  struct zlog_ring *ring;
+
+  if (zl == NULL)
+    zl = zlog_default;
+  if ((ring = zl->ring) == NULL)
+    return;
+
+  /* The writer drains what is left before it stops. */
+  zlog_async_flush (zl);
+  zl->ring = NULL;
+  if (ring->running)
+    {
+      pthread_mutex_lock (&ring->mtx);
+      ring->stop = 1;
+      pthread_cond_signal (&ring->wake);
+      pthread_mutex_unlock (&ring->mtx);
+      pthread_join (ring->tid, NULL);
+    }
+
+  pthread_cond_destroy (&ring->drained);
+  pthread_cond_destroy (&ring->wake);
+  pthread_mutex_destroy (&ring->io_mtx);
+  pthread_mutex_destroy (&ring->mtx);
+  XFREE (MTYPE_ZLOG_RING, ring->slots);
+  XFREE (MTYPE_ZLOG_RING, ring);
+}
+
+int
+zlog_async_stats (struct zlog *zl, unsigned long *slots,
+		  unsigned long *dropped)
+{
+  if (zl == NULL)
+    zl = zlog_default;
+  if (zl == NULL || zl->ring == NULL)
+    return 0;
+
+  *slots = zl->ring->mask + 1;
+  *dropped = __atomic_load_n (&zl->ring->dropped, __ATOMIC_RELAXED);
+  return 1;
+}
+
+/* Take the file away from the writer, while it is being changed. */
+static void
+zlog_io_lock (struct zlog *zl)
+{
+  if (zl->ring)
+    pthread_mutex_lock (&zl->ring->io_mtx);
+}
+
+static void
+zlog_io_unlock (struct zlog *zl)
+{
+  if (zl->ring)
+    pthread_mutex_unlock (&zl->ring->io_mtx);
+}
+
 /* va_list version of zlog. */
 static void
 vzlog (struct zlog *zl, int priority, const char *format, va_list args)
@@ -197,6 +645,7 @@ vzlog (struct zlog *zl, int priority, const char *format, va_list args)
 #endif
 
   struct timestamp_control tsctl;
+  int async;
   tsctl.already_rendered = 0;
 
   /* If zlog is not specified, use default one. */
@@ -218,8 +667,11 @@ vzlog (struct zlog *zl, int priority, const char *format, va_list args)
     }
   tsctl.precision = zl->timestamp_precision;
 
+  /* Syslog, file and stdout output through the writer thread. */
+  async = (zl->ring && zlog_ring_put (zl, priority, format, args) == 0);
+
   /* Syslog output */
-  if (priority <= zl->maxlvl[ZLOG_DEST_SYSLOG])
+  if (!async && priority <= zl->maxlvl[ZLOG_DEST_SYSLOG])
     {
       va_list ac;
       va_copy(ac, args);
@@ -228,7 +680,7 @@ vzlog (struct zlog *zl, int priority, const char *format, va_list args)
     }
 
   /* File output. */
-  if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
+  if (!async && (priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
     {
       va_list ac;
       time_print (zl->fp, &tsctl);
@@ -243,7 +695,7 @@ vzlog (struct zlog *zl, int priority, const char *format, va_list args)
     }
 
   /* stdout output. */
-  if (priority <= zl->maxlvl[ZLOG_DEST_STDOUT])
+  if (!async && priority <= zl->maxlvl[ZLOG_DEST_STDOUT])
     {
       va_list ac;
       time_print (stdout, &tsctl);
@@ -743,6 +1195,7 @@ openzlog (const char *progname, zlog_proto_t protocol,
 void
 closezlog (struct zlog *zl)
 {
+  zlog_async_disable (zl);
   closelog();
 
   if (zl->fp != NULL)
@@ -785,10 +1238,12 @@ zlog_set_file (struct zlog *zl, const char *filename, int log_level)
     return 0;
 
   /* Set flags. */
+  zlog_io_lock (zl);
   zl->filename = strdup (filename);
   zl->maxlvl[ZLOG_DEST_FILE] = log_level;
   zl->fp = fp;
   logfile_fd = fileno(fp);
+  zlog_io_unlock (zl);
 
   return 1;
 }
@@ -800,6 +1255,7 @@ zlog_reset_file (struct zlog *zl)
   if (zl == NULL)
     zl = zlog_default;
 
+  zlog_io_lock (zl);
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
@@ -809,6 +1265,7 @@ zlog_reset_file (struct zlog *zl)
   if (zl->filename)
     free (zl->filename);
   zl->filename = NULL;
+  zlog_io_unlock (zl);
 
   return 1;
 }
@@ -822,6 +1279,7 @@ zlog_rotate (struct zlog *zl)
   if (zl == NULL)
     zl = zlog_default;
 
+  zlog_io_lock (zl);
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
@@ -840,6 +1298,7 @@ zlog_rotate (struct zlog *zl)
       umask(oldumask);
       if (zl->fp == NULL)
         {
+	  zlog_io_unlock (zl);
 	  zlog_err("Log rotate failed: cannot open file %s for append: %s",
 	  	   zl->filename, safe_strerror(save_errno));
 	  return -1;
@@ -847,6 +1306,7 @@ zlog_rotate (struct zlog *zl)
       logfile_fd = fileno(zl->fp);
       zl->maxlvl[ZLOG_DEST_FILE] = level;
     }
+  zlog_io_unlock (zl);
 
   return 1;
 }
@@ -87,6 +87,7 @@ struct zlog
   			   priority of the message? */
   int syslog_options;	/* 2nd arg to openlog */
   int timestamp_precision;	/* # of digits of subsecond precision */
+  struct zlog_ring *ring;	/* writer thread, if logging asynchronously */
 };
 
 /* Message structure. */
@@ -152,6 +153,25 @@ extern int zlog_reset_file (struct zlog *zl);
 /* Rotate log. */
 extern int zlog_rotate (struct zlog *);
 
+/* Number of messages the ring of an asynchronous log holds by default,
+   and at most. */
+#define ZLOG_ASYNC_SLOTS	1024
+#define ZLOG_ASYNC_SLOTS_MAX	65536
+
+/* Hand syslog, file and stdout output over to a writer thread, through
+   a ring of the given number of messages, or resize the ring if it is
+   there already.  Messages that find the ring full are dropped and
+   counted.  Returns -1 on failure. */
+extern int zlog_async_enable (struct zlog *zl, unsigned int slots);
+/* Write out what is queued and go back to logging synchronously. */
+extern void zlog_async_disable (struct zlog *zl);
+/* Wait until all queued messages are written out. */
+extern void zlog_async_flush (struct zlog *zl);
+/* Size of the ring and messages dropped so far.  Returns 0 if the log
+   is not asynchronous. */
+extern int zlog_async_stats (struct zlog *zl, unsigned long *slots,
+			     unsigned long *dropped);
+
 /* For hackey message lookup and check */
 #define LOOKUP_DEF(x, y, def) mes_lookup(x, x ## _max, y, def, #x)
 #define LOOKUP(x, y) LOOKUP_DEF(x, y, "(no item found)")
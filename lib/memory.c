@@ -96,6 +96,24 @@ zcalloc (int type, size_t size)
   return memory;
 }
 
+/*
+ * Allocate memory as in zcalloc, aligned to align bytes, which is a
+ * power of two multiple of sizeof (void *).  It is freed with zfree.
+ */
+void *
+zcalloc_aligned (int type, size_t align, size_t size)
+{
+  void *memory;
+
+  if (posix_memalign (&memory, align, size) != 0)
+    zerror ("posix_memalign", type, size);
+  memset (memory, 0, size);
+
+  alloc_inc (type);
+
+  return memory;
+}
+
 /* 
  * Given a pointer returned by zmalloc or zcalloc, free it and
  * return a pointer to a new size, basically acting like realloc().
@@ -199,6 +217,21 @@ mtype_zcalloc (const char *file, int line, int type, size_t size)
   return memory;
 }
 
+void *
+mtype_zcalloc_aligned (const char *file, int line, int type, size_t align,
+                       size_t size)
+{
+  void *memory;
+
+  mstat[type].c_calloc++;
+  mstat[type].t_calloc++;
+
+  memory = zcalloc_aligned (type, align, size);
+  mtype_log ("xcalloc_aligned", memory, file, line, type);
+
+  return memory;
+}
+
 void *
 mtype_zrealloc (const char *file, int line, int type, void *ptr, size_t size)
 {
@@ -45,6 +45,8 @@ extern struct mlist mlists[];
   mtype_zmalloc (__FILE__, __LINE__, (mtype), (size))
 #define XCALLOC(mtype, size) \
   mtype_zcalloc (__FILE__, __LINE__, (mtype), (size))
+#define XCALLOC_ALIGNED(mtype, align, size) \
+  mtype_zcalloc_aligned (__FILE__, __LINE__, (mtype), (align), (size))
 #define XREALLOC(mtype, ptr, size)  \
   mtype_zrealloc (__FILE__, __LINE__, (mtype), (ptr), (size))
 #define XFREE(mtype, ptr) \
@@ -57,6 +59,8 @@ extern struct mlist mlists[];
 #else
 #define XMALLOC(mtype, size)       zmalloc ((mtype), (size))
 #define XCALLOC(mtype, size)       zcalloc ((mtype), (size))
+#define XCALLOC_ALIGNED(mtype, align, size) \
+                                   zcalloc_aligned ((mtype), (align), (size))
 #define XREALLOC(mtype, ptr, size) zrealloc ((mtype), (ptr), (size))
 #define XFREE(mtype, ptr)          do { \
                                      zfree ((mtype), (ptr)); \
@@ -68,6 +72,7 @@ extern struct mlist mlists[];
 /* Prototypes of memory function. */
 extern void *zmalloc (int type, size_t size);
 extern void *zcalloc (int type, size_t size);
+extern void *zcalloc_aligned (int type, size_t align, size_t size);
 extern void *zrealloc (int type, void *ptr, size_t size);
 extern void  zfree (int type, void *ptr);
 extern char *zstrdup (int type, const char *str);
@@ -76,6 +81,9 @@ extern void *mtype_zmalloc (const char *file, int line, int type, size_t size);
 
 extern void *mtype_zcalloc (const char *file, int line, int type, size_t size);
 
+extern void *mtype_zcalloc_aligned (const char *file, int line, int type,
+                                    size_t align, size_t size);
+
 extern void *mtype_zrealloc (const char *file, int line, int type, void *ptr,
 		             size_t size);
 
@@ -954,12 +954,9 @@ enum display_type
 };
 
 static void
-vty_show_prefix_entry (struct vty *vty, afi_t afi, struct prefix_list *plist,
-		       struct prefix_master *master, enum display_type dtype,
-		       int seqnum)
+vty_show_prefix_head (struct vty *vty, afi_t afi, struct prefix_list *plist,
+		      enum display_type dtype)
 {
-  struct prefix_list_entry *pentry;
-
   /* Print the name of the protocol */
   if (zlog_default)
       vty_out (vty, "%s: ", zlog_proto_names[zlog_default->protocol]);
@@ -986,62 +983,193 @@ vty_show_prefix_entry (struct vty *vty, afi_t afi, struct prefix_list *plist,
 	       plist->tail ? plist->tail->seq : 0,
 	       VTY_NEWLINE);
     }
+}
+
+static void
+vty_show_prefix_entry (struct vty *vty, struct prefix_list_entry *pentry,
+		       struct prefix_master *master, enum display_type dtype)
+{
+  vty_out (vty, "   ");
+
+  if (master->seqnum)
+    vty_out (vty, "seq %d ", pentry->seq);
 
-  if (dtype != summary_display)
+  vty_out (vty, "%s ", prefix_list_type_str (pentry));
+
+  if (pentry->any)
+    vty_out (vty, "any");
+  else
     {
-      for (pentry = plist->head; pentry; pentry = pentry->next)
-	{
-	  if (dtype == sequential_display && pentry->seq != seqnum)
-	    continue;
+      struct prefix *p = &pentry->prefix;
+      char buf[BUFSIZ];
 
-	  vty_out (vty, "   ");
+      vty_out (vty, "%s/%d",
+	       inet_ntop (p->family, &p->u.prefix, buf, BUFSIZ),
+	       p->prefixlen);
 
-	  if (master->seqnum)
-	    vty_out (vty, "seq %d ", pentry->seq);
+      if (pentry->ge)
+	vty_out (vty, " ge %d", pentry->ge);
+      if (pentry->le)
+	vty_out (vty, " le %d", pentry->le);
+    }
 
-	  vty_out (vty, "%s ", prefix_list_type_str (pentry));
+  if (dtype == detail_display || dtype == sequential_display)
+    vty_out (vty, " (hit count: %ld, refcount: %ld)",
+	     pentry->hitcnt, pentry->refcnt);
 
-	  if (pentry->any)
-	    vty_out (vty, "any");
-	  else
-	    {
-	      struct prefix *p = &pentry->prefix;
-	      char buf[BUFSIZ];
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
 
-	      vty_out (vty, "%s/%d",
-		       inet_ntop (p->family, &p->u.prefix, buf, BUFSIZ),
-		       p->prefixlen);
+/* State of a "show ip prefix-list" display.  Between two chunks only
+   names and sequence numbers are kept, so lists and entries may be
+   changed or deleted meanwhile. */
+struct prefix_list_show
+{
+  afi_t afi;
+  enum display_type dtype;
+  int seqnum;
 
-	      if (pentry->ge)
-		vty_out (vty, " ge %d", pentry->ge);
-	      if (pentry->le)
-		vty_out (vty, " le %d", pentry->le);
-	    }
+  /* Show all prefix-lists rather than just the named one. */
+  int all;
 
-	  if (dtype == detail_display || dtype == sequential_display)
-	    vty_out (vty, " (hit count: %ld, refcount: %ld)",
-		     pentry->hitcnt, pentry->refcnt);
+  /* Prefix-list being shown, NULL before the first one. */
+  char *name;
 
-	  vty_out (vty, "%s", VTY_NEWLINE);
+  /* Whether its header and any of its entries have been shown. */
+  int head;
+  int entries;
+
+  /* Sequence number of the last entry shown. */
+  int seq;
+};
+
+static void
+prefix_list_show_free (void *arg)
+{
+  struct prefix_list_show *show = arg;
+
+  if (show->name)
+    XFREE (MTYPE_TMP, show->name);
+  XFREE (MTYPE_TMP, show);
+}
+
+static void
+prefix_list_show_set (struct prefix_list_show *show, struct prefix_list *plist)
+{
+  if (show->name)
+    XFREE (MTYPE_TMP, show->name);
+  show->name = plist ? XSTRDUP (MTYPE_TMP, plist->name) : NULL;
+  show->head = 0;
+  show->entries = 0;
+}
+
+/* First prefix-list sorting after the given name, see
+   prefix_list_insert(). */
+static struct prefix_list *
+prefix_list_show_after (struct prefix_master *master, const char *name)
+{
+  struct prefix_list *plist;
+  unsigned int i;
+  long number;
+
+  for (number = 0, i = 0; i < strlen (name); i++)
+    {
+      if (isdigit ((int) name[i]))
+	number = (number * 10) + (name[i] - '0');
+      else
+	break;
+    }
+
+  if (i == strlen (name))
+    {
+      for (plist = master->num.head; plist; plist = plist->next)
+	if (atol (plist->name) > number)
+	  return plist;
+      return master->str.head;
+    }
+
+  for (plist = master->str.head; plist; plist = plist->next)
+    if (strcmp (plist->name, name) > 0)
+      return plist;
+  return NULL;
+}
+
+static int
+vty_show_prefix_list_resume (struct vty *vty, void *arg)
+{
+  struct prefix_list_show *show = arg;
+  struct prefix_master *master;
+  struct prefix_list *plist;
+  struct prefix_list_entry *pentry;
+
+  master = prefix_master_get (show->afi);
+
+  /* Pick up where the last chunk left off. */
+  plist = prefix_list_lookup (show->afi, show->name);
+  if (! plist && show->all)
+    {
+      if (show->name)
+	plist = prefix_list_show_after (master, show->name);
+      else
+	plist = master->num.head ? master->num.head : master->str.head;
+      prefix_list_show_set (show, plist);
+    }
+
+  while (plist)
+    {
+      if (! show->head)
+	{
+	  vty_show_prefix_head (vty, show->afi, plist, show->dtype);
+	  show->head = 1;
 	}
+
+      if (show->dtype != summary_display)
+	for (pentry = plist->head; pentry; pentry = pentry->next)
+	  {
+	    if (show->entries && pentry->seq <= show->seq)
+	      continue;
+	    if (show->dtype == sequential_display
+		&& pentry->seq != show->seqnum)
+	      continue;
+
+	    vty_show_prefix_entry (vty, pentry, master, show->dtype);
+	    show->entries = 1;
+	    show->seq = pentry->seq;
+
+	    if (vty_show_full (vty))
+	      return VTY_SHOW_MORE;
+	  }
+
+      if (! show->all)
+	break;
+
+      if (plist->next)
+	plist = plist->next;
+      else if (plist->type == PREFIX_TYPE_NUMBER)
+	plist = master->str.head;
+      else
+	plist = NULL;
+      prefix_list_show_set (show, plist);
+
+      if (plist && vty_show_full (vty))
+	return VTY_SHOW_MORE;
     }
+
+  return VTY_SHOW_DONE;
 }
 
 static int
 vty_show_prefix_list (struct vty *vty, afi_t afi, const char *name,
 		      const char *seq, enum display_type dtype)
 {
-  struct prefix_list *plist;
+  struct prefix_list *plist = NULL;
   struct prefix_master *master;
-  int seqnum = 0;
+  struct prefix_list_show *show;
 
   master = prefix_master_get (afi);
   if (master == NULL)
     return CMD_WARNING;
 
-  if (seq)
-    seqnum = atoi (seq);
-
   if (name)
     {
       plist = prefix_list_lookup (afi, name);
@@ -1050,7 +1178,6 @@ vty_show_prefix_list (struct vty *vty, afi_t afi, const char *name,
 	  vty_out (vty, "%% Can't find specified prefix-list%s", VTY_NEWLINE);
 	  return CMD_WARNING;
 	}
-      vty_show_prefix_entry (vty, afi, plist, master, dtype, seqnum);
     }
   else
     {
@@ -1060,13 +1187,19 @@ vty_show_prefix_list (struct vty *vty, afi_t afi, const char *name,
 	    vty_out (vty, "Prefix-list with the last deletion/insertion: %s%s",
 		     master->recent->name, VTY_NEWLINE);
 	}
+    }
 
-      for (plist = master->num.head; plist; plist = plist->next)
-	vty_show_prefix_entry (vty, afi, plist, master, dtype, seqnum);
+  show = XCALLOC (MTYPE_TMP, sizeof (struct prefix_list_show));
+  show->afi = afi;
+  show->dtype = dtype;
+  show->all = (name == NULL);
+  if (seq)
+    show->seqnum = atoi (seq);
+  if (plist)
+    prefix_list_show_set (show, plist);
 
-      for (plist = master->str.head; plist; plist = plist->next)
-	vty_show_prefix_entry (vty, afi, plist, master, dtype, seqnum);
-    }
+  vty_show_start (vty, vty_show_prefix_list_resume, show,
+		  prefix_list_show_free);
 
   return CMD_SUCCESS;
 }
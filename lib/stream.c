@@ -111,18 +111,29 @@ stream_new (size_t size)
     }
   
   s->size = size;
+  s->refcnt = 1;
   return s;
 }
 
-/* Free it now. */
+/* Free it now, or drop the reference if the data is shared. */
 void
 stream_free (struct stream *s)
 {
+  struct stream *owner;
+
   if (!s)
     return;
-  
-  XFREE (MTYPE_STREAM_DATA, s->data);
-  XFREE (MTYPE_STREAM, s);
+
+  owner = s->owner ? s->owner : s;
+  if (s != owner)
+    XFREE (MTYPE_STREAM, s);
+
+  /* The owner outlives its references, as it carries the count. */
+  if (--owner->refcnt > 0)
+    return;
+
+  XFREE (MTYPE_STREAM_DATA, owner->data);
+  XFREE (MTYPE_STREAM, owner);
 }
 
 struct stream *
@@ -154,6 +165,27 @@ stream_dup (struct stream *s)
   return (stream_copy (new, s));
 }
 
+/* Return a read-only stream referring to the data of the given one, so
+   that it can be queued in several fifos without copying. */
+struct stream *
+stream_ref (struct stream *s)
+{
+  struct stream *new;
+
+  STREAM_VERIFY_SANE (s);
+
+  if (s->owner)
+    s = s->owner;
+
+  new = XCALLOC (MTYPE_STREAM, sizeof (struct stream));
+  new->data = s->data;
+  new->endp = new->size = s->endp;
+  new->owner = s;
+  s->refcnt++;
+
+  return new;
+}
+
 struct stream *
 stream_dupcat (struct stream *s1, struct stream *s2, size_t offset)
 {
@@ -178,6 +210,7 @@ stream_resize (struct stream *s, size_t newsize)
 {
   u_char *newdata;
   STREAM_VERIFY_SANE (s);
+  assert (s->owner == NULL && s->refcnt == 1);
   
   newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
   
@@ -899,6 +932,22 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Move the data not read yet to the start of the stream, making room
+   for more behind it. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t len;
+
+  STREAM_VERIFY_SANE (s);
+
+  len = STREAM_READABLE (s);
+  if (s->getp)
+    memmove (s->data, s->data + s->getp, len);
+  s->getp = 0;
+  s->endp = len;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
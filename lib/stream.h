@@ -89,6 +89,11 @@
  *
  * Best practice is to use stream_put (<stream *>, NULL, <size>) to zero out
  * any part of a stream which isn't otherwise written to.
+ *
+ * A finished stream can be shared with stream_ref(), which returns a new
+ * stream with its own getp and fifo linkage referring to the same data.
+ * The data is freed once the last of these streams is freed, and must not
+ * be modified through any of them while it is shared.
  */
 
 /* Stream buffer. */
@@ -104,6 +109,8 @@ struct stream
   size_t endp;		/* last valid data position */
   size_t size;		/* size of data segment */
   unsigned char *data; /* data pointer */
+  struct stream *owner;	/* stream the data belongs to, for references */
+  unsigned int refcnt;	/* number of streams using this data */
 };
 
 /* First in first out queue structure. */
@@ -142,6 +149,7 @@ extern struct stream *stream_new (size_t);
 extern void stream_free (struct stream *);
 extern struct stream * stream_copy (struct stream *, struct stream *src);
 extern struct stream *stream_dup (struct stream *);
+extern struct stream *stream_ref (struct stream *);
 extern size_t stream_resize (struct stream *, size_t);
 extern size_t stream_get_getp (struct stream *);
 extern size_t stream_get_endp (struct stream *);
@@ -212,6 +220,8 @@ extern size_t stream_write (struct stream *, const void *, size_t);
 
 /* reset the stream. See Note above */
 extern void stream_reset (struct stream *);
+/* move the unread data to the start of the stream */
+extern void stream_pulldown (struct stream *);
 extern int stream_flush (struct stream *, int);
 extern int stream_empty (struct stream *); /* is the stream empty? */
 
@@ -279,6 +279,55 @@ cpu_record_hash_free (void *a)
   XFREE (MTYPE_THREAD_STATS, hist);
 }
 
+/* Account a duration to a histogram. */
+static void
+thread_hist_add (struct thread_hist *h, unsigned long usec)
+{
+  unsigned long v;
+  unsigned int b;
+
+  for (b = 0, v = usec; v && b < THREAD_HIST_BUCKETS - 1; v >>= 1)
+    b++;
+
+  h->bucket[b]++;
+  h->count++;
+  h->total += usec;
+  if (h->max < usec)
+    h->max = usec;
+}
+
+static void
+thread_hist_merge (struct thread_hist *to, const struct thread_hist *from)
+{
+  int i;
+
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    to->bucket[i] += from->bucket[i];
+  to->count += from->count;
+  to->total += from->total;
+  if (to->max < from->max)
+    to->max = from->max;
+}
+
+static unsigned long
+thread_hist_avg (const struct thread_hist *h)
+{
+  return h->count ? h->total / h->count : 0;
+}
+
+static void
+vty_out_cpu_thread_type (struct vty *vty, struct cpu_thread_history *a)
+{
+  vty_out(vty, " %c%c%c%c%c%c %s%s",
+	  a->types & (1 << THREAD_READ) ? 'R':' ',
+	  a->types & (1 << THREAD_WRITE) ? 'W':' ',
+	  a->types & (1 << THREAD_TIMER) ? 'T':' ',
+	  a->types & (1 << THREAD_EVENT) ? 'E':' ',
+	  a->types & (1 << THREAD_EXECUTE) ? 'X':' ',
+	  a->types & (1 << THREAD_BACKGROUND) ? 'B' : ' ',
+	  a->funcname, VTY_NEWLINE);
+}
+
 static void 
 vty_out_cpu_thread_history(struct vty* vty,
 			   struct cpu_thread_history *a)
@@ -293,16 +342,85 @@ vty_out_cpu_thread_history(struct vty* vty,
 	  a->real.total/1000, a->real.total%1000, a->total_calls,
 	  a->real.total/a->total_calls, a->real.max);
 #endif
-  vty_out(vty, " %c%c%c%c%c%c %s%s",
-	  a->types & (1 << THREAD_READ) ? 'R':' ',
-	  a->types & (1 << THREAD_WRITE) ? 'W':' ',
-	  a->types & (1 << THREAD_TIMER) ? 'T':' ',
-	  a->types & (1 << THREAD_EVENT) ? 'E':' ',
-	  a->types & (1 << THREAD_EXECUTE) ? 'X':' ',
-	  a->types & (1 << THREAD_BACKGROUND) ? 'B' : ' ',
-	  a->funcname, VTY_NEWLINE);
+  vty_out_cpu_thread_type (vty, a);
 }
 
+static void
+vty_out_latency_thread_history (struct vty *vty,
+				struct cpu_thread_history *a)
+{
+  vty_out(vty, "%9d %8lu %9lu %8lu %9lu",
+	  a->total_calls,
+	  thread_hist_avg (&a->queue), a->queue.max,
+	  thread_hist_avg (&a->slip), a->slip.max);
+  vty_out_cpu_thread_type (vty, a);
+}
+
+static void
+vty_out_histogram_thread_history (struct vty *vty,
+				  struct cpu_thread_history *a)
+{
+  int i, last;
+
+  vty_out(vty, "%s, %d calls, types", a->funcname, a->total_calls);
+  vty_out_cpu_thread_type (vty, a);
+
+  for (last = THREAD_HIST_BUCKETS - 1; last > 0; last--)
+    if (a->run.bucket[last] || a->queue.bucket[last] || a->slip.bucket[last])
+      break;
+
+  vty_out(vty, "  %12s %10s %10s %10s%s",
+	  "uSecs", "Run", "Queue", "Slip", VTY_NEWLINE);
+  for (i = 0; i <= last; i++)
+    {
+      char range[16];
+
+      if (i == 0)
+	snprintf (range, sizeof (range), "0");
+      else if (i == THREAD_HIST_BUCKETS - 1)
+	snprintf (range, sizeof (range), ">=%lu", 1UL << (i - 1));
+      else
+	snprintf (range, sizeof (range), "<%lu", 1UL << i);
+
+      vty_out(vty, "  %12s %10lu %10lu %10lu%s", range,
+	      a->run.bucket[i], a->queue.bucket[i], a->slip.bucket[i],
+	      VTY_NEWLINE);
+    }
+}
+
+/* One line per function: name, type bitmask, calls, then for each of run,
+   queue and slip "count:total:max:bucket0,...,bucketN" in uSecs. */
+static void
+vty_out_dump_thread_history (struct vty *vty,
+			     struct cpu_thread_history *a)
+{
+  struct thread_hist *h[] = { &a->run, &a->queue, &a->slip };
+  const char *name[] = { "run", "queue", "slip" };
+  unsigned int i;
+  int b;
+
+  vty_out(vty, "func=%s types=%u calls=%u", a->funcname, a->types, a->total_calls);
+#ifdef HAVE_RUSAGE
+  vty_out(vty, " cpu=%lu:%lu", a->cpu.total, a->cpu.max);
+#endif
+  for (i = 0; i < sizeof (h) / sizeof (h[0]); i++)
+    {
+      vty_out(vty, " %s=%lu:%lu:%lu:", name[i],
+	      h[i]->count, h[i]->total, h[i]->max);
+      for (b = 0; b < THREAD_HIST_BUCKETS; b++)
+	vty_out(vty, "%s%lu", b ? "," : "", h[i]->bucket[b]);
+    }
+  vty_out(vty, "%s", VTY_NEWLINE);
+}
+
+enum cpu_record_view
+{
+  CPU_RECORD_CPU,
+  CPU_RECORD_LATENCY,
+  CPU_RECORD_HISTOGRAM,
+  CPU_RECORD_DUMP,
+};
+
 static void
 cpu_record_hash_print(struct hash_backet *bucket, 
 		      void *args[])
@@ -310,12 +428,29 @@ cpu_record_hash_print(struct hash_backet *bucket,
   struct cpu_thread_history *totals = args[0];
   struct vty *vty = args[1];
   thread_type *filter = args[2];
+  enum cpu_record_view *view = args[3];
   struct cpu_thread_history *a = bucket->data;
   
   a = bucket->data;
   if ( !(a->types & *filter) )
        return;
-  vty_out_cpu_thread_history(vty,a);
+
+  switch (*view)
+    {
+    case CPU_RECORD_CPU:
+      vty_out_cpu_thread_history(vty,a);
+      break;
+    case CPU_RECORD_LATENCY:
+      vty_out_latency_thread_history(vty,a);
+      break;
+    case CPU_RECORD_HISTOGRAM:
+      vty_out_histogram_thread_history(vty,a);
+      break;
+    case CPU_RECORD_DUMP:
+      vty_out_dump_thread_history(vty,a);
+      break;
+    }
+
   totals->total_calls += a->total_calls;
   totals->real.total += a->real.total;
   if (totals->real.max < a->real.max)
@@ -325,82 +460,122 @@ cpu_record_hash_print(struct hash_backet *bucket,
   if (totals->cpu.max < a->cpu.max)
     totals->cpu.max = a->cpu.max;
 #endif
+  thread_hist_merge (&totals->run, &a->run);
+  thread_hist_merge (&totals->queue, &a->queue);
+  thread_hist_merge (&totals->slip, &a->slip);
 }
 
 static void
-cpu_record_print(struct vty *vty, thread_type filter)
+cpu_record_print(struct vty *vty, thread_type filter,
+		 enum cpu_record_view view)
 {
   struct cpu_thread_history tmp;
-  void *args[3] = {&tmp, vty, &filter};
+  void *args[4] = {&tmp, vty, &filter, &view};
 
   memset(&tmp, 0, sizeof tmp);
   tmp.funcname = "TOTAL";
   tmp.types = filter;
 
+  switch (view)
+    {
+    case CPU_RECORD_CPU:
 #ifdef HAVE_RUSAGE
-  vty_out(vty, "%21s %18s %18s%s",
-  	  "", "CPU (user+system):", "Real (wall-clock):", VTY_NEWLINE);
+      vty_out(vty, "%21s %18s %18s%s",
+	      "", "CPU (user+system):", "Real (wall-clock):", VTY_NEWLINE);
 #endif
-  vty_out(vty, "Runtime(ms)   Invoked Avg uSec Max uSecs");
+      vty_out(vty, "Runtime(ms)   Invoked Avg uSec Max uSecs");
 #ifdef HAVE_RUSAGE
-  vty_out(vty, " Avg uSec Max uSecs");
+      vty_out(vty, " Avg uSec Max uSecs");
 #endif
-  vty_out(vty, "  Type  Thread%s", VTY_NEWLINE);
+      vty_out(vty, "  Type  Thread%s", VTY_NEWLINE);
+      break;
+    case CPU_RECORD_LATENCY:
+      vty_out(vty, "%9s %18s %18s%s",
+	      "", "Queueing delay:", "Timer slip:", VTY_NEWLINE);
+      vty_out(vty, "  Invoked Avg uSec Max uSecs Avg uSec Max uSecs"
+	      "  Type  Thread%s", VTY_NEWLINE);
+      break;
+    case CPU_RECORD_HISTOGRAM:
+    case CPU_RECORD_DUMP:
+      break;
+    }
+
   hash_iterate(cpu_record,
 	       (void(*)(struct hash_backet*,void*))cpu_record_hash_print,
 	       args);
 
-  if (tmp.total_calls > 0)
-    vty_out_cpu_thread_history(vty, &tmp);
+  if (tmp.total_calls == 0)
+    return;
+
+  switch (view)
+    {
+    case CPU_RECORD_CPU:
+      vty_out_cpu_thread_history(vty, &tmp);
+      break;
+    case CPU_RECORD_LATENCY:
+      vty_out_latency_thread_history(vty, &tmp);
+      break;
+    case CPU_RECORD_HISTOGRAM:
+      vty_out_histogram_thread_history(vty, &tmp);
+      break;
+    case CPU_RECORD_DUMP:
+      vty_out_dump_thread_history(vty, &tmp);
+      break;
+    }
 }
 
-DEFUN(show_thread_cpu,
-      show_thread_cpu_cmd,
-      "show thread cpu [FILTER]",
-      SHOW_STR
-      "Thread information\n"
-      "Thread CPU usage\n"
-      "Display filter (rwtexb)\n")
+/* Parse a filter of thread type letters (rwtexb), 0 if none is given. */
+static thread_type
+cpu_record_filter (const char *str)
 {
+  thread_type filter = 0;
   int i = 0;
-  thread_type filter = (thread_type) -1U;
 
-  if (argc > 0)
+  while (str[i] != '\0')
     {
-      filter = 0;
-      while (argv[0][i] != '\0')
+      switch ( str[i] )
 	{
-	  switch ( argv[0][i] )
-	    {
-	    case 'r':
-	    case 'R':
-	      filter |= (1 << THREAD_READ);
-	      break;
-	    case 'w':
-	    case 'W':
-	      filter |= (1 << THREAD_WRITE);
-	      break;
-	    case 't':
-	    case 'T':
-	      filter |= (1 << THREAD_TIMER);
-	      break;
-	    case 'e':
-	    case 'E':
-	      filter |= (1 << THREAD_EVENT);
-	      break;
-	    case 'x':
-	    case 'X':
-	      filter |= (1 << THREAD_EXECUTE);
-	      break;
-	    case 'b':
-	    case 'B':
-	      filter |= (1 << THREAD_BACKGROUND);
-	      break;
-	    default:
-	      break;
-	    }
-	  ++i;
+	case 'r':
+	case 'R':
+	  filter |= (1 << THREAD_READ);
+	  break;
+	case 'w':
+	case 'W':
+	  filter |= (1 << THREAD_WRITE);
+	  break;
+	case 't':
+	case 'T':
+	  filter |= (1 << THREAD_TIMER);
+	  break;
+	case 'e':
+	case 'E':
+	  filter |= (1 << THREAD_EVENT);
+	  break;
+	case 'x':
+	case 'X':
+	  filter |= (1 << THREAD_EXECUTE);
+	  break;
+	case 'b':
+	case 'B':
+	  filter |= (1 << THREAD_BACKGROUND);
+	  break;
+	default:
+	  break;
 	}
+      ++i;
+    }
+  return filter;
+}
+
+static int
+cpu_record_show (struct vty *vty, int argc, const char *argv[],
+		 enum cpu_record_view view)
+{
+  thread_type filter = (thread_type) -1U;
+
+  if (argc > 0)
+    {
+      filter = cpu_record_filter (argv[0]);
       if (filter == 0)
 	{
 	  vty_out(vty, "Invalid filter \"%s\" specified,"
@@ -410,10 +585,54 @@ DEFUN(show_thread_cpu,
 	}
     }
 
-  cpu_record_print(vty, filter);
+  cpu_record_print(vty, filter, view);
   return CMD_SUCCESS;
 }
 
+DEFUN(show_thread_cpu,
+      show_thread_cpu_cmd,
+      "show thread cpu [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread CPU usage\n"
+      "Display filter (rwtexb)\n")
+{
+  return cpu_record_show (vty, argc, argv, CPU_RECORD_CPU);
+}
+
+DEFUN(show_thread_latency,
+      show_thread_latency_cmd,
+      "show thread latency [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread queueing delay and timer slip\n"
+      "Display filter (rwtexb)\n")
+{
+  return cpu_record_show (vty, argc, argv, CPU_RECORD_LATENCY);
+}
+
+DEFUN(show_thread_histogram,
+      show_thread_histogram_cmd,
+      "show thread histogram [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread run time, queueing delay and timer slip distribution\n"
+      "Display filter (rwtexb)\n")
+{
+  return cpu_record_show (vty, argc, argv, CPU_RECORD_HISTOGRAM);
+}
+
+DEFUN(show_thread_dump,
+      show_thread_dump_cmd,
+      "show thread dump [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread statistics in machine readable form\n"
+      "Display filter (rwtexb)\n")
+{
+  return cpu_record_show (vty, argc, argv, CPU_RECORD_DUMP);
+}
+
 static void
 cpu_record_hash_clear (struct hash_backet *bucket, 
 		      void *args)
@@ -445,45 +664,11 @@ DEFUN(clear_thread_cpu,
       "Thread CPU usage\n"
       "Display filter (rwtexb)\n")
 {
-  int i = 0;
   thread_type filter = (thread_type) -1U;
 
   if (argc > 0)
     {
-      filter = 0;
-      while (argv[0][i] != '\0')
-	{
-	  switch ( argv[0][i] )
-	    {
-	    case 'r':
-	    case 'R':
-	      filter |= (1 << THREAD_READ);
-	      break;
-	    case 'w':
-	    case 'W':
-	      filter |= (1 << THREAD_WRITE);
-	      break;
-	    case 't':
-	    case 'T':
-	      filter |= (1 << THREAD_TIMER);
-	      break;
-	    case 'e':
-	    case 'E':
-	      filter |= (1 << THREAD_EVENT);
-	      break;
-	    case 'x':
-	    case 'X':
-	      filter |= (1 << THREAD_EXECUTE);
-	      break;
-	    case 'b':
-	    case 'B':
-	      filter |= (1 << THREAD_BACKGROUND);
-	      break;
-	    default:
-	      break;
-	    }
-	  ++i;
-	}
+      filter = cpu_record_filter (argv[0]);
       if (filter == 0)
 	{
 	  vty_out(vty, "Invalid filter \"%s\" specified,"
@@ -683,6 +868,7 @@ thread_get (struct thread_master *m, u_char type,
   thread->func = func;
   thread->arg = arg;
   thread->index = -1;
+  thread->queued.tv_sec = thread->queued.tv_usec = 0;
 
   thread->funcname = funcname;
   thread->schedfrom = schedfrom;
@@ -844,6 +1030,8 @@ funcname_thread_add_event (struct thread_master *m,
 
   thread = thread_get (m, THREAD_EVENT, func, arg, debugargpass);
   thread->u.val = val;
+  quagga_get_relative (NULL);
+  thread->queued = relative_time;
   thread_list_add (&m->event, thread);
 
   return thread;
@@ -990,6 +1178,7 @@ thread_process_fd (struct thread_list *list, fd_set *fdset, fd_set *mfdset)
           thread_list_delete (list, thread);
           thread_list_add (&thread->master->ready, thread);
           thread->type = THREAD_READY;
+          thread->queued = relative_time;
           ready++;
         }
     }
@@ -1010,6 +1199,7 @@ thread_timer_process (struct pqueue *queue, struct timeval *timenow)
         return ready;
       pqueue_dequeue(queue);
       thread->type = THREAD_READY;
+      thread->queued = *timenow;
       thread_list_add (&thread->master->ready, thread);
       ready++;
     }
@@ -1248,6 +1438,18 @@ thread_call (struct thread *thread)
   GETRUSAGE (&before);
   thread->real = before.real;
 
+  /* How long the thread waited once runnable and, for timers, how
+     late it is. */
+  if ((thread->queued.tv_sec || thread->queued.tv_usec)
+      && timeval_cmp (before.real, thread->queued) > 0)
+    thread_hist_add (&thread->hist->queue,
+		     timeval_elapsed (before.real, thread->queued));
+  if ((thread->add_type == THREAD_TIMER
+       || thread->add_type == THREAD_BACKGROUND)
+      && timeval_cmp (before.real, thread->u.sands) > 0)
+    thread_hist_add (&thread->hist->slip,
+		     timeval_elapsed (before.real, thread->u.sands));
+
   thread_current = thread;
   (*thread->func) (thread);
   thread_current = NULL;
@@ -1255,6 +1457,7 @@ thread_call (struct thread *thread)
   GETRUSAGE (&after);
 
   realtime = thread_consumed_time (&after, &before, &cputime);
+  thread_hist_add (&thread->hist->run, realtime);
   thread->hist->real.total += realtime;
   if (thread->hist->real.max < realtime)
     thread->hist->real.max = realtime;
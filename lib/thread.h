@@ -80,12 +80,24 @@ struct thread
   } u;
   int index;			/* used for timers to store position in queue */
   struct timeval real;
+  struct timeval queued;	/* time the thread became runnable */
   struct cpu_thread_history *hist; /* cache pointer to cpu_history */
   const char *funcname;
   const char *schedfrom;
   int schedfrom_line;
 };
 
+/* Log2 histogram of durations in microseconds.  Bucket 0 counts 0,
+   bucket i the values in [2^(i-1), 2^i) and the last one all above. */
+#define THREAD_HIST_BUCKETS 24
+
+struct thread_hist
+{
+  unsigned long count;
+  unsigned long total, max;
+  unsigned long bucket[THREAD_HIST_BUCKETS];
+};
+
 struct cpu_thread_history 
 {
   int (*func)(struct thread *);
@@ -97,6 +109,9 @@ struct cpu_thread_history
 #ifdef HAVE_RUSAGE
   struct time_stats cpu;
 #endif
+  struct thread_hist run;	/* wall-clock run time */
+  struct thread_hist queue;	/* runnable until run */
+  struct thread_hist slip;	/* timers: expiry until run */
   thread_type types;
   const char *funcname;
 };
@@ -215,6 +230,9 @@ extern unsigned long timeval_elapsed (struct timeval a, struct timeval b);
 /* Internal libzebra exports */
 extern void thread_getrusage (RUSAGE_T *);
 extern struct cmd_element show_thread_cpu_cmd;
+extern struct cmd_element show_thread_latency_cmd;
+extern struct cmd_element show_thread_histogram_cmd;
+extern struct cmd_element show_thread_dump_cmd;
 extern struct cmd_element clear_thread_cpu_cmd;
 
 /* replacements for the system gettimeofday(), clock_gettime() and
@@ -54,6 +54,8 @@ enum event
 };
 
 static void vty_event (enum event, int, struct vty *);
+static void vty_show_stop (struct vty *);
+static int vty_show_continue (struct vty *);
 
 /* Extern host structure from command.c */
 extern struct host host;
@@ -147,6 +149,7 @@ vty_out (struct vty *vty, const char *format, ...)
 
       /* Pointer p must point out buffer. */
       buffer_put (vty->obuf, (u_char *) p, len);
+      vty->show_len += len;
 
       /* If p is not different with buf, it is allocated buffer.  */
       if (p != buf)
@@ -1297,7 +1300,8 @@ vty_execute (struct vty *vty)
   vty->cp = vty->length = 0;
   vty_clear_buf (vty);
 
-  if (vty->status != VTY_CLOSE )
+  /* A display still in progress prints the prompt when it is done. */
+  if (vty->status != VTY_CLOSE && ! vty->show_func)
     vty_prompt (vty);
 
   return ret;
@@ -1338,6 +1342,7 @@ vty_escape_map (unsigned char c, struct vty *vty)
 static void
 vty_buffer_reset (struct vty *vty)
 {
+  vty_show_stop (vty);
   buffer_reset (vty->obuf);
   vty_prompt (vty);
   vty_redraw_line (vty);
@@ -1407,7 +1412,8 @@ vty_read (struct thread *thread)
 	}
 	        
 
-      if (vty->status == VTY_MORE)
+      /* While a display is in progress input only controls it. */
+      if (vty->status == VTY_MORE || vty->show_func)
 	{
 	  switch (buf[i])
 	    {
@@ -1571,6 +1577,11 @@ vty_flush (struct thread *thread)
       vty->t_read = NULL;
     }
 
+  /* Produce the next chunk of a display once the last one is out. */
+  if (vty->show_func && vty->status != VTY_CLOSE
+      && buffer_empty (vty->obuf) && ! vty_show_continue (vty))
+    vty_prompt (vty);
+
   /* Function execution continue. */
   erase = ((vty->status == VTY_MORE || vty->status == VTY_MORELINE));
 
@@ -1600,7 +1611,9 @@ vty_flush (struct thread *thread)
       else
 	{
 	  vty->status = VTY_NORMAL;
-	  if (vty->lines == 0)
+	  if (vty->show_func)
+	    vty_event (VTY_WRITE, vty_sock, vty);
+	  else if (vty->lines == 0)
 	    vty_event (VTY_READ, vty_sock, vty);
 	}
       break;
@@ -2056,16 +2069,72 @@ vtysh_flush(struct vty *vty)
   return 0;
 }
 
+/* Send the result of a vtysh command after its output. */
+static void
+vtysh_result (struct vty *vty, int ret)
+{
+  u_char header[4] = {0, 0, 0, 0};
+
+#ifdef VTYSH_DEBUG
+  printf ("result: %d\n", ret);
+  printf ("vtysh node: %d\n", vty->node);
+#endif /* VTYSH_DEBUG */
+
+  header[3] = ret;
+  buffer_put(vty->obuf, header, 4);
+}
+
+/* Execute the NUL-terminated commands read from vtysh.  Returns -1 if
+   the vty has been closed, 1 if a display is in progress and 0
+   otherwise.  Input following a command which started a display is kept
+   in the command buffer until the display is done. */
 static int
-vtysh_read (struct thread *thread)
+vtysh_execute (struct vty *vty, unsigned char *buf, int nbytes)
 {
   int ret;
+  unsigned char *p;
+
+  for (p = buf; p < buf+nbytes; p++)
+    {
+      vty_ensure(vty, vty->length+1);
+      vty->buf[vty->length++] = *p;
+      if (*p == '\0')
+	{
+	  /* Pass this line to parser. */
+	  ret = vty_execute (vty);
+	  /* Note that vty_execute clears the command buffer and resets
+	     vty->length to 0. */
+
+	  if (vty->show_func)
+	    {
+	      vty->show_ret = ret;
+	      p++;
+	      vty_ensure(vty, buf+nbytes-p);
+	      memcpy(vty->buf, p, buf+nbytes-p);
+	      vty->length = buf+nbytes-p;
+	      if (!vty->t_write)
+		vty_event(VTYSH_WRITE, vty->fd, vty);
+	      return 1;
+	    }
+
+	  /* Return result. */
+	  vtysh_result (vty, ret);
+
+	  if (!vty->t_write && (vtysh_flush(vty) < 0))
+	    /* Try to flush results; exit if a write error occurs. */
+	    return -1;
+	}
+    }
+  return 0;
+}
+
+static int
+vtysh_read (struct thread *thread)
+{
   int sock;
   int nbytes;
   struct vty *vty;
   unsigned char buf[VTY_READ_BUFSIZ];
-  unsigned char *p;
-  u_char header[4] = {0, 0, 0, 0};
 
   sock = THREAD_FD (thread);
   vty = THREAD_ARG (thread);
@@ -2096,33 +2165,9 @@ vtysh_read (struct thread *thread)
   printf ("line: %.*s\n", nbytes, buf);
 #endif /* VTYSH_DEBUG */
 
-  for (p = buf; p < buf+nbytes; p++)
-    {
-      vty_ensure(vty, vty->length+1);
-      vty->buf[vty->length++] = *p;
-      if (*p == '\0')
-	{
-	  /* Pass this line to parser. */
-	  ret = vty_execute (vty);
-	  /* Note that vty_execute clears the command buffer and resets
-	     vty->length to 0. */
-
-	  /* Return result. */
-#ifdef VTYSH_DEBUG
-	  printf ("result: %d\n", ret);
-	  printf ("vtysh node: %d\n", vty->node);
-#endif /* VTYSH_DEBUG */
-
-	  header[3] = ret;
-	  buffer_put(vty->obuf, header, 4);
-
-	  if (!vty->t_write && (vtysh_flush(vty) < 0))
-	    /* Try to flush results; exit if a write error occurs. */
-	    return 0;
-	}
-    }
-
-  vty_event (VTYSH_READ, sock, vty);
+  /* No more input is read while a display is in progress. */
+  if (vtysh_execute (vty, buf, nbytes) == 0)
+    vty_event (VTYSH_READ, sock, vty);
 
   return 0;
 }
@@ -2131,9 +2176,34 @@ static int
 vtysh_write (struct thread *thread)
 {
   struct vty *vty = THREAD_ARG (thread);
+  unsigned char buf[VTY_READ_BUFSIZ];
+  int nbytes;
 
   vty->t_write = NULL;
-  vtysh_flush(vty);
+
+  if (vty->show_func && buffer_empty (vty->obuf))
+    {
+      if (vty_show_continue (vty))
+	{
+	  if (vtysh_flush(vty) == 0 && !vty->t_write)
+	    vty_event(VTYSH_WRITE, vty->fd, vty);
+	  return 0;
+	}
+
+      /* Display done, return its result and go on with the input. */
+      vtysh_result (vty, vty->show_ret);
+      nbytes = vty->length;
+      memcpy (buf, vty->buf, nbytes);
+      vty->length = 0;
+      if (vtysh_flush(vty) < 0)
+	return 0;
+      if (vtysh_execute (vty, buf, nbytes) == 0)
+	vty_event (VTYSH_READ, vty->fd, vty);
+      return 0;
+    }
+
+  if (vtysh_flush(vty) == 0 && vty->show_func && !vty->t_write)
+    vty_event(VTYSH_WRITE, vty->fd, vty);
   return 0;
 }
 
@@ -2168,6 +2238,9 @@ vty_close (struct vty *vty)
 {
   int i;
 
+  /* Abort a display in progress. */
+  vty_show_stop (vty);
+
   /* Cancel threads.*/
   if (vty->t_read)
     thread_cancel (vty->t_read);
@@ -2563,6 +2636,59 @@ vty_event (enum event event, int sock, struct vty *vty)
     }
 }
 
+/* Release the state of the display in progress, if any. */
+static void
+vty_show_stop (struct vty *vty)
+{
+  if (! vty->show_func)
+    return;
+
+  if (vty->show_free)
+    (*vty->show_free) (vty->show_arg);
+  vty->show_func = NULL;
+  vty->show_free = NULL;
+  vty->show_arg = NULL;
+}
+
+/* Produce the next chunk of the display in progress.  Returns 1 if
+   there is more to come. */
+static int
+vty_show_continue (struct vty *vty)
+{
+  vty->show_len = 0;
+  if ((*vty->show_func) (vty, vty->show_arg) == VTY_SHOW_MORE)
+    return 1;
+
+  vty_show_stop (vty);
+  return 0;
+}
+
+void
+vty_show_start (struct vty *vty, int (*func) (struct vty *, void *),
+		void *arg, void (*free_func) (void *))
+{
+  vty->show_func = func;
+  vty->show_free = free_func;
+  vty->show_arg = arg;
+
+  /* Only sessions driven by our own event loop can be resumed. */
+  if (master && (vty->type == VTY_TERM || vty->type == VTY_SHELL_SERV))
+    {
+      vty_show_continue (vty);
+      return;
+    }
+
+  while (vty_show_continue (vty))
+    ;
+}
+
+/* Has the current chunk of the display in progress been filled? */
+int
+vty_show_full (struct vty *vty)
+{
+  return vty->show_func && vty->show_len >= VTY_SHOW_CHUNK;
+}
+
 DEFUN (config_who,
        config_who_cmd,
        "who",
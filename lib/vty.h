@@ -119,6 +119,17 @@ struct vty
 
   /* What address is this vty comming from. */
   char address[SU_ADDRSTRLEN];
+
+  /* Resumable display in progress, see vty_show_start(). */
+  int (*show_func) (struct vty *, void *);
+  void (*show_free) (void *);
+  void *show_arg;
+
+  /* Output queued by the current display chunk. */
+  size_t show_len;
+
+  /* vtysh result held back until the display has been written out. */
+  int show_ret;
 };
 
 /* Integrated configuration file. */
@@ -133,6 +144,13 @@ struct vty
 /* Vty read buffer size. */
 #define VTY_READ_BUFSIZ 512
 
+/* Output a resumable display queues before it yields to the event loop. */
+#define VTY_SHOW_CHUNK 32768
+
+/* Return values of a resumable display function. */
+#define VTY_SHOW_DONE 0
+#define VTY_SHOW_MORE 1
+
 /* Directory separator. */
 #ifndef DIRECTORY_SEP
 #define DIRECTORY_SEP '/'
@@ -248,6 +266,18 @@ extern int vty_shell (struct vty *);
 extern int vty_shell_serv (struct vty *);
 extern void vty_hello (struct vty *);
 
+/* Run a long display in bounded chunks.  func is called repeatedly with
+   arg; it returns VTY_SHOW_MORE as soon as vty_show_full() says the
+   current chunk is full, and VTY_SHOW_DONE once everything is shown.
+   On terminal and vtysh sessions the next chunk is only produced after
+   the previous one has been written to the socket, and the prompt (or
+   the vtysh result code) follows the last chunk.  Other vtys get the
+   whole display at once.  free_func, if given, releases arg when the
+   display ends or is aborted. */
+extern void vty_show_start (struct vty *, int (*func) (struct vty *, void *),
+                            void *arg, void (*free_func) (void *));
+extern int vty_show_full (struct vty *);
+
 /* Send a fixed-size message to all vty terminal monitors; this should be
    an async-signal-safe function. */
 extern void vty_log_fixed (char *buf, size_t len);
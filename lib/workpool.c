@@ -0,0 +1,208 @@
+/*
+ * Quagga Work Pool Support.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <lib/zebra.h>
+#include <pthread.h>
+
+#include "memory.h"
+#include "log.h"
+#include "workpool.h"
+
+/* Items are handed out in chunks, several per thread and batch, so that
+ * threads which happen to get the cheap items pick up more of them.
+ */
+#define WORK_POOL_CHUNKS_PER_THREAD 4
+
+struct work_pool
+{
+  char *name;
+
+  /* threads, counting the thread calling work_pool_run */
+  unsigned int threads;
+  pthread_t *tids;
+
+  pthread_mutex_t mtx;
+  pthread_cond_t start;		/* new batch, or stop */
+  pthread_cond_t done;		/* last worker done with the batch */
+
+  /* current batch, under mtx */
+  void (*func) (void *);
+  void **items;
+  unsigned int count;
+  unsigned int next;		/* next item to hand out */
+  unsigned int chunk;
+  unsigned int busy;		/* workers not yet done with the batch */
+  unsigned long gen;		/* batch generation */
+  int stop;
+};
+
+/* Run chunks of the current batch until it is all handed out.  Called,
+ * and returns, with the mutex held.
+ */
+static void
+work_pool_drain (struct work_pool *wp)
+{
+  unsigned int i, end;
+
+  while (wp->next < wp->count)
+    {
+      i = wp->next;
+      end = MIN (i + wp->chunk, wp->count);
+      wp->next = end;
+
+      pthread_mutex_unlock (&wp->mtx);
+      for (; i < end; i++)
+        wp->func (wp->items[i]);
+      pthread_mutex_lock (&wp->mtx);
+    }
+}
+
+static void *
+work_pool_worker (void *arg)
+{
+  struct work_pool *wp = arg;
+  unsigned long gen = 0;
+
+  pthread_mutex_lock (&wp->mtx);
+  for (;;)
+    {
+      while (!wp->stop && wp->gen == gen)
+        pthread_cond_wait (&wp->start, &wp->mtx);
+      if (wp->stop)
+        break;
+
+      gen = wp->gen;
+      work_pool_drain (wp);
+
+      if (--wp->busy == 0)
+        pthread_cond_signal (&wp->done);
+    }
+  pthread_mutex_unlock (&wp->mtx);
+
+  return NULL;
+}
+
+struct work_pool *
+work_pool_new (const char *name, unsigned int threads)
+{
+  struct work_pool *wp;
+  sigset_t sigs, oldsigs;
+  unsigned int i;
+
+  wp = XCALLOC (MTYPE_WORK_POOL, sizeof (struct work_pool));
+  wp->name = XSTRDUP (MTYPE_WORK_POOL, name);
+  wp->threads = 1;
+
+  pthread_mutex_init (&wp->mtx, NULL);
+  pthread_cond_init (&wp->start, NULL);
+  pthread_cond_init (&wp->done, NULL);
+
+  if (threads <= 1)
+    return wp;
+
+  wp->tids = XCALLOC (MTYPE_WORK_POOL, (threads - 1) * sizeof (pthread_t));
+
+  /* signals are left to the main thread */
+  sigfillset (&sigs);
+  pthread_sigmask (SIG_BLOCK, &sigs, &oldsigs);
+
+  for (i = 0; i < threads - 1; i++)
+    {
+      if (pthread_create (&wp->tids[i], NULL, work_pool_worker, wp))
+        {
+          zlog_warn ("%s: could only start %u of %u threads for %s",
+                     __func__, i + 1, threads, name);
+          break;
+        }
+      wp->threads++;
+    }
+
+  pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+
+  return wp;
+}
+
+void
+work_pool_free (struct work_pool *wp)
+{
+  unsigned int i;
+
+  pthread_mutex_lock (&wp->mtx);
+  wp->stop = 1;
+  pthread_cond_broadcast (&wp->start);
+  pthread_mutex_unlock (&wp->mtx);
+
+  for (i = 0; i < wp->threads - 1; i++)
+    pthread_join (wp->tids[i], NULL);
+
+  pthread_cond_destroy (&wp->done);
+  pthread_cond_destroy (&wp->start);
+  pthread_mutex_destroy (&wp->mtx);
+
+  if (wp->tids)
+    XFREE (MTYPE_WORK_POOL, wp->tids);
+  XFREE (MTYPE_WORK_POOL, wp->name);
+  XFREE (MTYPE_WORK_POOL, wp);
+}
+
+unsigned int
+work_pool_threads (struct work_pool *wp)
+{
+  return wp->threads;
+}
+
+void
+work_pool_run (struct work_pool *wp, void (*func) (void *),
+               void **items, unsigned int count)
+{
+  unsigned int i;
+
+  if (wp->threads == 1 || count < 2)
+    {
+      for (i = 0; i < count; i++)
+        func (items[i]);
+      return;
+    }
+
+  pthread_mutex_lock (&wp->mtx);
+
+  wp->func = func;
+  wp->items = items;
+  wp->count = count;
+  wp->next = 0;
+  wp->chunk = count / (wp->threads * WORK_POOL_CHUNKS_PER_THREAD);
+  if (wp->chunk == 0)
+    wp->chunk = 1;
+  wp->busy = wp->threads - 1;
+  wp->gen++;
+  pthread_cond_broadcast (&wp->start);
+
+  work_pool_drain (wp);
+
+  while (wp->busy)
+    pthread_cond_wait (&wp->done, &wp->mtx);
+
+  wp->func = NULL;
+  wp->items = NULL;
+  wp->count = 0;
+
+  pthread_mutex_unlock (&wp->mtx);
+}
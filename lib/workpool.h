@@ -0,0 +1,45 @@
+/*
+ * Quagga Work Pool Support.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_WORK_POOL_H
+#define _QUAGGA_WORK_POOL_H
+
+/* A work pool runs a function over a batch of items on a number of
+ * threads, the calling thread being one of them, and returns once all
+ * items are done.  Everything else in the daemons is single threaded,
+ * so the function must only touch state belonging to its own item: no
+ * allocation, no logging, no interning.
+ */
+struct work_pool;
+
+/* create a work pool of the given number of threads, counting the
+ * calling thread; a pool of one thread runs batches inline.
+ */
+extern struct work_pool *work_pool_new (const char *, unsigned int);
+extern void work_pool_free (struct work_pool *);
+
+extern unsigned int work_pool_threads (struct work_pool *);
+
+/* run func over each of the count items, in parallel */
+extern void work_pool_run (struct work_pool *, void (*func) (void *),
+                           void **items, unsigned int count);
+
+#endif /* _QUAGGA_WORK_POOL_H */
@@ -203,6 +203,12 @@ DEFUN(show_work_queues,
                    (unsigned int) (wq->cycles.total / wq->runs) : 0,
                wq->name,
                VTY_NEWLINE);
+      if (wq->batch.runs)
+        vty_out (vty, "  %8lu units in %lu batches, best %u, avg %lu,"
+                 " %lu out of time%s",
+                 wq->batch.total, wq->batch.runs, wq->batch.best,
+                 wq->batch.total / wq->batch.runs, wq->batch.yields,
+                 VTY_NEWLINE);
     }
     
   return CMD_SUCCESS;
@@ -234,6 +240,23 @@ work_queue_unplug (struct work_queue *wq)
   work_queue_schedule (wq, wq->spec.hold);
 }
 
+int
+work_queue_should_yield (struct work_queue *wq)
+{
+  return wq->running ? thread_should_yield (wq->running) : 0;
+}
+
+void
+work_queue_batch_done (struct work_queue *wq, unsigned int count, int yielded)
+{
+  wq->batch.runs++;
+  wq->batch.total += count;
+  if (count > wq->batch.best)
+    wq->batch.best = count;
+  if (yielded)
+    wq->batch.yields++;
+}
+
 /* timer thread to process a work queue
  * will reschedule itself if required,
  * otherwise work_queue_item_add 
@@ -253,6 +276,8 @@ work_queue_run (struct thread *thread)
 
   assert (wq && wq->items);
 
+  wq->running = thread;
+
   /* calculate cycle granularity:
    * list iteration == 1 cycle
    * granularity == # cycles between checks whether we should yield.
@@ -370,6 +395,7 @@ stats:
   
   wq->runs++;
   wq->cycles.total += cycles;
+  wq->running = NULL;
 
 #if 0
   printf ("%s: cycles %d, new: best %d, worst %d\n",
@@ -96,6 +96,15 @@ struct work_queue
     unsigned long total;
   } cycles;	/* cycle counts */
   
+  struct {
+    unsigned long runs;
+    unsigned long total;
+    unsigned int best;
+    unsigned long yields;
+  } batch;	/* units of work done by batching work functions */
+  
+  struct thread *running;	/* thread of the current run, if any */
+  
   /* private state */
   u_int16_t flags;		/* user set flag */
 };
@@ -119,6 +128,14 @@ extern void work_queue_plug (struct work_queue *wq);
 /* unplug the queue, allow it to be drained again */
 extern void work_queue_unplug (struct work_queue *wq);
 
+/* for work functions processing several units of work per item: check
+ * whether the current run of the queue should yield, and account for the
+ * units done in a batch, 'yielded' telling whether it ran out of time.
+ */
+extern int work_queue_should_yield (struct work_queue *wq);
+extern void work_queue_batch_done (struct work_queue *wq, unsigned int count,
+                                   int yielded);
+
 /* Helpers, exported for thread.c and command.c */
 extern int work_queue_run (struct thread *);
 extern struct cmd_element show_work_queues_cmd;
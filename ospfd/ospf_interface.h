@@ -188,6 +188,8 @@ struct ospf_interface
 #endif /* HAVE_OPAQUE_LSA */
 
   struct route_table *ls_upd_queue;
+  unsigned int ls_upd_queued;           /* LSA bytes on ls_upd_queue */
+  struct timeval ls_upd_since;          /* ls_upd_queue filled since */
 
   struct list *ls_ack;			/* Link State Acknowledgment list. */
   
@@ -205,7 +207,7 @@ struct ospf_interface
   struct thread *t_wait;                /* timer */
   struct thread *t_ls_ack;              /* timer */
   struct thread *t_ls_ack_direct;       /* event */
-  struct thread *t_ls_upd_event;        /* event */
+  struct thread *t_ls_upd_event;        /* timer */
 #ifdef HAVE_OPAQUE_LSA
   struct thread *t_opaque_lsa_self;     /* Type-9 Opaque-LSAs */
 #endif /* HAVE_OPAQUE_LSA */
@@ -223,6 +225,11 @@ struct ospf_interface
   u_int32_t ls_upd_out;         /* LS update message output count. */
   u_int32_t ls_ack_in;          /* LS Ack message input count. */
   u_int32_t ls_ack_out;         /* LS Ack message output count. */
+  u_int32_t ls_upd_lsas;        /* LSAs sent in LS updates. */
+  u_int32_t ls_ack_lsas;        /* LSAs acknowledged in LS Acks. */
+  u_int32_t flood_runs;         /* LS update queue flushes. */
+  unsigned long flood_delay;    /* Total LS update queueing time, msec. */
+  unsigned long flood_delay_max; /* Longest LS update queueing time, msec. */
   u_int32_t discarded;		/* discarded input count by error. */
   u_int32_t state_change;	/* Number of status change. */
 
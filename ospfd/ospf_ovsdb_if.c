@@ -6384,7 +6384,7 @@ ospf_interface_add_from_ovsdb (struct ovsdb_idl *idl, const struct ovsrec_vrf *o
       VLOG_ERR ("Interface %s created - Failed to get ifindex\n", ifp->name);
       //return -1;
     }
-    ifp->ifindex = ifindex;
+    if_set_index (ifp, ifindex);
     VLOG_DBG ("Interface %s created - ifindex:%u\n", ifp->name, ifp->ifindex);
   }
   else {
@@ -6517,6 +6517,7 @@ ospf_interface_update_from_ovsdb (struct ovsdb_idl *idl, const struct ovsrec_vrf
         nextnode = node->next;
         if (ifc && !CHECK_FLAG (ifc->flags, ZEBRA_IFA_SECONDARY)) {
           VLOG_DBG ("ifp %s: primary addr delete %s\n", ifp->name, ovs_port->ip4_address);
+          connected_index_delete (ifc);
           listnode_delete (ifp->connected, ifc);
           ospf_interface_address_delete (ifp, ifc);
         }
@@ -6556,6 +6557,7 @@ ospf_interface_update_from_ovsdb (struct ovsdb_idl *idl, const struct ovsrec_vrf
         for (i = 0, pfx = pfxlist; i < ovs_port->n_ip4_address_secondary; i++, pfx++) {
           if (prefix_same (ifc->address, pfx)) {
             VLOG_DBG ("ifp %s: secondary addr delete %s\n", ifp->name, ovs_port->ip4_address_secondary[i]);
+            connected_index_delete (ifc);
             listnode_delete (ifp->connected, ifc);
             ospf_interface_address_delete (ifp, ifc);
           }
@@ -34,6 +34,7 @@
 #include "log.h"
 #include "sockopt.h"
 #include "checksum.h"
+#include "network.h"
 #include "md5.h"
 
 #include "ospfd/ospfd.h"
@@ -629,95 +630,84 @@ ospf_write_frags (int fd, struct ospf_packet *op, struct ip *iph,
 }
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-static int
-ospf_write (struct thread *thread)
+/* A packet being sent by ospf_write(), with its own IP header. */
+struct ospf_write_msg
 {
-  struct ospf *ospf = THREAD_ARG (thread);
-  struct ospf_interface *oi;
   struct ospf_packet *op;
-  struct sockaddr_in sa_dst;
+  u_char type;
+  int err;                      /* errno if sending failed */
   struct ip iph;
-  struct msghdr msg;
+  struct sockaddr_in sa_dst;
   struct iovec iov[2];
-  u_char type;
-  int ret;
-  int flags = 0;
-  struct listnode *node;
+  struct msghdr msg;
+};
+
+/* Flags to send the packet with. */
+static int
+ospf_write_flags (struct ospf_interface *oi, struct ospf_packet *op)
+{
+  /* Set DONTROUTE flag if dst is unicast. */
+  if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
+    if (!IN_MULTICAST (htonl (op->dst.s_addr)))
+      return MSG_DONTROUTE;
+
+  return 0;
+}
+
+/* Build the IP header and message for the packet. */
+static void
+ospf_write_prepare (struct ospf_interface *oi, struct ospf_packet *op,
+                    struct ospf_write_msg *wm)
+{
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   static u_int16_t ipid = 0;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
-  u_int16_t maxdatasize;
 #define OSPF_WRITE_IPHL_SHIFT 2
 
-  ospf->t_write = NULL;
-
-  node = listhead (ospf->oi_write_q);
-  assert (node);
-  oi = listgetdata (node);
-  assert (oi);
-
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   /* seed ipid static with low order bits of time */
   if (ipid == 0)
     ipid = (time(NULL) & 0xffff);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  /* convenience - max OSPF data per packet,
-   * and reliability - not more data, than our
-   * socket can accept
-   */
-  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
-    sizeof (struct ip);
-
-  /* Get one packet from queue. */
-  op = ospf_fifo_head (oi->obuf);
-  assert (op);
-  assert (op->length >= OSPF_HEADER_SIZE);
-
-  if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
-      || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
-      ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
+  wm->op = op;
+  wm->err = 0;
 
   /* Rewrite the md5 signature & update the seq */
   ospf_make_md5_digest (oi, op);
 
   /* Retrieve OSPF packet type. */
   stream_set_getp (op->s, 1);
-  type = stream_getc (op->s);
+  wm->type = stream_getc (op->s);
 
   /* reset get pointer */
   stream_set_getp (op->s, 0);
 
-  memset (&iph, 0, sizeof (struct ip));
-  memset (&sa_dst, 0, sizeof (sa_dst));
+  memset (&wm->iph, 0, sizeof (struct ip));
+  memset (&wm->sa_dst, 0, sizeof (wm->sa_dst));
 
-  sa_dst.sin_family = AF_INET;
+  wm->sa_dst.sin_family = AF_INET;
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
-  sa_dst.sin_len = sizeof(sa_dst);
+  wm->sa_dst.sin_len = sizeof(wm->sa_dst);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-  sa_dst.sin_addr = op->dst;
-  sa_dst.sin_port = htons (0);
-
-  /* Set DONTROUTE flag if dst is unicast. */
-  if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
-    if (!IN_MULTICAST (htonl (op->dst.s_addr)))
-      flags = MSG_DONTROUTE;
+  wm->sa_dst.sin_addr = op->dst;
+  wm->sa_dst.sin_port = htons (0);
 
-  iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
+  wm->iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
   /* it'd be very strange for header to not be 4byte-word aligned but.. */
   if ( sizeof (struct ip)
-        > (unsigned int)(iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
-    iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
+        > (unsigned int)(wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
+    wm->iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
 
-  iph.ip_v = IPVERSION;
-  iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
-  iph.ip_len = (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
+  wm->iph.ip_v = IPVERSION;
+  wm->iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
+  wm->iph.ip_len = (wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
 
 #if defined(__DragonFly__)
   /*
    * DragonFly's raw socket expects ip_len/ip_off in network byte order.
    */
-  iph.ip_len = htons(iph.ip_len);
+  wm->iph.ip_len = htons(wm->iph.ip_len);
 #endif
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
@@ -725,48 +715,43 @@ ospf_write (struct thread *thread)
    * XXX: this presumes this is only programme sending OSPF packets
    * otherwise, no guarantee ipid will be unique
    */
-  iph.ip_id = ++ipid;
+  wm->iph.ip_id = ++ipid;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  iph.ip_off = 0;
+  wm->iph.ip_off = 0;
   if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
-    iph.ip_ttl = OSPF_VL_IP_TTL;
+    wm->iph.ip_ttl = OSPF_VL_IP_TTL;
   else
-    iph.ip_ttl = OSPF_IP_TTL;
-  iph.ip_p = IPPROTO_OSPFIGP;
-  iph.ip_sum = 0;
-  iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
-  iph.ip_dst.s_addr = op->dst.s_addr;
-
-  memset (&msg, 0, sizeof (msg));
-  msg.msg_name = (caddr_t) &sa_dst;
-  msg.msg_namelen = sizeof (sa_dst);
-  msg.msg_iov = iov;
-  msg.msg_iovlen = 2;
-  iov[0].iov_base = (char*)&iph;
-  iov[0].iov_len = iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
-  iov[1].iov_base = STREAM_PNT (op->s);
-  iov[1].iov_len = op->length;
-
-  /* Sadly we can not rely on kernels to fragment packets because of either
-   * IP_HDRINCL and/or multicast destination being set.
-   */
-#ifdef WANT_OSPF_WRITE_FRAGMENT
-  if ( op->length > maxdatasize )
-    ospf_write_frags (ospf->fd, op, &iph, &msg, maxdatasize,
-                      oi->ifp->mtu, flags, type);
-#endif /* WANT_OSPF_WRITE_FRAGMENT */
+    wm->iph.ip_ttl = OSPF_IP_TTL;
+  wm->iph.ip_p = IPPROTO_OSPFIGP;
+  wm->iph.ip_sum = 0;
+  wm->iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
+  wm->iph.ip_dst.s_addr = op->dst.s_addr;
+
+  memset (&wm->msg, 0, sizeof (wm->msg));
+  wm->msg.msg_name = (caddr_t) &wm->sa_dst;
+  wm->msg.msg_namelen = sizeof (wm->sa_dst);
+  wm->msg.msg_iov = wm->iov;
+  wm->msg.msg_iovlen = 2;
+  wm->iov[0].iov_base = (char*)&wm->iph;
+  wm->iov[0].iov_len = wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
+  wm->iov[1].iov_base = STREAM_PNT (op->s);
+  wm->iov[1].iov_len = op->length;
+}
 
-  /* send final fragment (could be first) */
-  sockopt_iphdrincl_swab_htosys (&iph);
-  ret = sendmsg (ospf->fd, &msg, flags);
-  sockopt_iphdrincl_swab_systoh (&iph);
+/* Report the outcome of sending one packet. */
+static void
+ospf_write_done (struct ospf_interface *oi, struct ospf_write_msg *wm)
+{
+  struct ospf_packet *op = wm->op;
+  u_char type = wm->type;
 
-  if (ret < 0)
+  if (wm->err)
     zlog_warn ("*** sendmsg in ospf_write failed to %s, "
 	       "id %d, off %d, len %d, interface %s, mtu %u: %s",
-	       inet_ntoa (iph.ip_dst), iph.ip_id, iph.ip_off, iph.ip_len,
-	       oi->ifp->name, oi->ifp->mtu, safe_strerror (errno));
+	       inet_ntoa (wm->iph.ip_dst), wm->iph.ip_id, wm->iph.ip_off,
+	       wm->iph.ip_len, oi->ifp->name, oi->ifp->mtu,
+	       safe_strerror (wm->err));
 
   /* Show debug sending packet. */
   if (IS_DEBUG_OSPF_PACKET (type - 1, SEND))
@@ -774,7 +759,7 @@ ospf_write (struct thread *thread)
       if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
 	{
 	  zlog_debug ("-----------------------------------------------------");
-	  ospf_ip_header_dump (&iph);
+	  ospf_ip_header_dump (&wm->iph);
 	  stream_set_getp (op->s, 0);
 	  ospf_packet_dump (op->s);
 	}
@@ -786,17 +771,131 @@ ospf_write (struct thread *thread)
       if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
 	zlog_debug ("-----------------------------------------------------");
     }
+}
 
-  /* Now delete packet from queue. */
-  ospf_packet_delete (oi);
+/* Send up to OSPF_WRITE_BATCH packets from the interfaces on the write
+   queue. Interfaces are served round robin, OSPF_WRITE_OI_QUOTA packets
+   at a time, and the packets taken from one interface in a go are sent
+   with a single sendmmsg() where available. */
+static int
+ospf_write (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+  struct ospf_interface *oi;
+  struct ospf_packet *op;
+  struct ospf_write_msg wm[OSPF_WRITE_OI_QUOTA];
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr mmsg[OSPF_WRITE_OI_QUOTA];
+#endif /* HAVE_SENDMMSG */
+  struct listnode *node;
+  u_int16_t maxdatasize;
+  int budget = OSPF_WRITE_BATCH;
+  int multicast;
+  int flags;
+  int ret;
+  int n, i;
 
-  /* Move this interface to the tail of write_q to
-	 serve everyone in a round robin fashion */
-  listnode_move_to_tail (ospf->oi_write_q, node);
-  if (ospf_fifo_head (oi->obuf) == NULL)
+  ospf->t_write = NULL;
+
+  while (budget > 0 && (node = listhead (ospf->oi_write_q)) != NULL)
     {
-      oi->on_write_q = 0;
-      list_delete_node (ospf->oi_write_q, node);
+      oi = listgetdata (node);
+      assert (oi);
+
+      /* convenience - max OSPF data per packet,
+       * and reliability - not more data, than our
+       * socket can accept
+       */
+      maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
+        sizeof (struct ip);
+
+      /* Take packets from the head of the interface queue as long as
+         they go out with the same flags, since these apply to the
+         whole batch. */
+      op = ospf_fifo_head (oi->obuf);
+      assert (op);
+      flags = ospf_write_flags (oi, op);
+      multicast = 0;
+
+      for (n = 0; op && n < OSPF_WRITE_OI_QUOTA && n < budget;
+           n++, op = op->next)
+        {
+          assert (op->length >= OSPF_HEADER_SIZE);
+          if (n > 0 && ospf_write_flags (oi, op) != flags)
+            break;
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+          /* Leading fragments are sent right away, keep them in order. */
+          if (n > 0 && op->length > maxdatasize)
+            break;
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+
+          if (!multicast
+              && (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
+                  || op->dst.s_addr == htonl (OSPF_ALLDROUTERS)))
+            {
+              ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
+              multicast = 1;
+            }
+
+          ospf_write_prepare (oi, op, &wm[n]);
+
+          /* Sadly we can not rely on kernels to fragment packets because of
+           * either IP_HDRINCL and/or multicast destination being set.
+           */
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+          if ( op->length > maxdatasize )
+            ospf_write_frags (ospf->fd, op, &wm[n].iph, &wm[n].msg,
+                              maxdatasize, oi->ifp->mtu, flags, wm[n].type);
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+        }
+
+      /* send final fragments (could be first) */
+      for (i = 0; i < n; i++)
+        {
+          sockopt_iphdrincl_swab_htosys (&wm[i].iph);
+#ifdef HAVE_SENDMMSG
+          mmsg[i].msg_hdr = wm[i].msg;
+          mmsg[i].msg_len = 0;
+#endif /* HAVE_SENDMMSG */
+        }
+
+      for (i = 0; i < n; i += ret)
+        {
+#ifdef HAVE_SENDMMSG
+          ret = sendmmsg (ospf->fd, &mmsg[i], n - i, flags);
+#else
+          ret = sendmsg (ospf->fd, &wm[i].msg, flags) < 0 ? -1 : 1;
+#endif /* HAVE_SENDMMSG */
+
+          /* A failed packet is dropped, as it has always been. */
+          if (ret <= 0)
+            {
+              wm[i].err = errno;
+              ret = 1;
+            }
+        }
+
+      for (i = 0; i < n; i++)
+        {
+          sockopt_iphdrincl_swab_systoh (&wm[i].iph);
+          ospf_write_done (oi, &wm[i]);
+
+          /* Now delete packet from queue. */
+          ospf_packet_delete (oi);
+        }
+
+      budget -= n;
+      ospf->write_batches++;
+      ospf->write_packets += n;
+
+      /* Move this interface to the tail of write_q to
+	 serve everyone in a round robin fashion */
+      listnode_move_to_tail (ospf->oi_write_q, node);
+      if (ospf_fifo_head (oi->obuf) == NULL)
+        {
+          oi->on_write_q = 0;
+          list_delete_node (ospf->oi_write_q, node);
+        }
     }
 
   /* If packets still remain in queue, call write thread. */
@@ -2042,7 +2141,7 @@ ospf_ls_upd (struct ip *iph, struct ospf_header *ospfh,
 		 from Designated Router, otherwise do nothing. */
 	      if (oi->state == ISM_Backup)
 		if (NBR_IS_DR (nbr))
-		  listnode_add (oi->ls_ack, ospf_lsa_lock (lsa));
+		  ospf_ls_ack_add_delayed (oi, lsa);
 
               DISCARD_LSA (lsa, 5);
 	    }
@@ -2165,30 +2264,16 @@ ospf_ls_ack (struct ip *iph, struct ospf_header *ospfh,
   return;
 }
 
+/* Check a raw packet of ret bytes received into ibuf, and find the
+   interface it came in on from the control data in msgh. */
 static struct stream *
-ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+ospf_recv_packet_check (int ret, struct msghdr *msgh, struct interface **ifp,
+                        struct stream *ibuf)
 {
-  int ret;
   struct ip *iph;
   u_int16_t ip_len;
   unsigned int ifindex = 0;
-  struct iovec iov;
-  /* Header and data both require alignment. */
-  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
-  struct msghdr msgh;
 
-  memset (&msgh, 0, sizeof (struct msghdr));
-  msgh.msg_iov = &iov;
-  msgh.msg_iovlen = 1;
-  msgh.msg_control = (caddr_t) buff;
-  msgh.msg_controllen = sizeof (buff);
-
-  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
-  if (ret < 0)
-    {
-      zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-      return NULL;
-    }
   if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
     {
       zlog_warn("ospf_recv_packet: discarding runt packet of length %d "
@@ -2231,7 +2316,7 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
 #endif
 
-  ifindex = getsockopt_ifindex (AF_INET, &msgh);
+  ifindex = getsockopt_ifindex (AF_INET, msgh);
 
   *ifp = if_lookup_by_index (ifindex);
 
@@ -2245,6 +2330,33 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   return ibuf;
 }
 
+#ifndef HAVE_RECVMMSG
+static struct stream *
+ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+{
+  int ret;
+  struct iovec iov;
+  /* Header and data both require alignment. */
+  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  struct msghdr msgh;
+
+  memset (&msgh, 0, sizeof (struct msghdr));
+  msgh.msg_iov = &iov;
+  msgh.msg_iovlen = 1;
+  msgh.msg_control = (caddr_t) buff;
+  msgh.msg_controllen = sizeof (buff);
+
+  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
+  if (ret < 0)
+    {
+      zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
+      return NULL;
+    }
+
+  return ospf_recv_packet_check (ret, &msgh, ifp, ibuf);
+}
+#endif /* !HAVE_RECVMMSG */
+
 static struct ospf_interface *
 ospf_associate_packet_vl (struct ospf *ospf, struct interface *ifp,
 			  struct ip *iph, struct ospf_header *ospfh)
@@ -2770,28 +2882,17 @@ ospf_verify_header (struct stream *ibuf, struct ospf_interface *oi,
   return 0;
 }
 
-/* Starting point of packet process function. */
-int
-ospf_read (struct thread *thread)
+/* Process one received packet. */
+static int
+ospf_read_packet (struct ospf *ospf, struct stream *ibuf,
+                  struct interface *ifp)
 {
   int ret;
-  struct stream *ibuf;
-  struct ospf *ospf;
   struct ospf_interface *oi;
   struct ip *iph;
   struct ospf_header *ospfh;
   u_int16_t length;
-  struct interface *ifp;
 
-  /* first of all get interface pointer. */
-  ospf = THREAD_ARG (thread);
-
-  /* prepare for next packet. */
-  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
-
-  stream_reset(ospf->ibuf);
-  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf)))
-    return -1;
   /* This raw packet is known to be at least as big as its IP header. */
 
   /* Note that there should not be alignment problems with this assignment
@@ -2993,6 +3094,90 @@ ospf_read (struct thread *thread)
   return 0;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Starting point of packet process function. Up to OSPF_READ_BATCH
+   packets are received with one recvmmsg() per wakeup. */
+int
+ospf_read (struct thread *thread)
+{
+  struct ospf *ospf;
+  struct stream *ibuf;
+  struct interface *ifp;
+  struct mmsghdr mmsg[OSPF_READ_BATCH];
+  struct iovec iov[OSPF_READ_BATCH];
+  /* Header and data both require alignment. */
+  char buff[OSPF_READ_BATCH][CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  int ret;
+  int i;
+
+  /* first of all get interface pointer. */
+  ospf = THREAD_ARG (thread);
+
+  /* prepare for next packet. */
+  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
+
+  memset (mmsg, 0, sizeof (mmsg));
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    {
+      ibuf = ospf->ibuf[i];
+      stream_reset (ibuf);
+      iov[i].iov_base = STREAM_DATA (ibuf);
+      iov[i].iov_len = STREAM_SIZE (ibuf);
+      mmsg[i].msg_hdr.msg_iov = &iov[i];
+      mmsg[i].msg_hdr.msg_iovlen = 1;
+      mmsg[i].msg_hdr.msg_control = (caddr_t) buff[i];
+      mmsg[i].msg_hdr.msg_controllen = sizeof (buff[i]);
+    }
+
+  /* Take whatever is queued on the socket, without waiting for more. */
+  ret = recvmmsg (ospf->fd, mmsg, OSPF_READ_BATCH, MSG_DONTWAIT, NULL);
+  if (ret < 0)
+    {
+      if (!ERRNO_IO_RETRY (errno))
+        zlog_warn ("recvmmsg failed: %s", safe_strerror (errno));
+      return -1;
+    }
+
+  ospf->read_batches++;
+  ospf->read_packets += ret;
+
+  for (i = 0; i < ret; i++)
+    {
+      ibuf = ospf->ibuf[i];
+      stream_set_endp (ibuf, mmsg[i].msg_len);
+      if (ospf_recv_packet_check (mmsg[i].msg_len, &mmsg[i].msg_hdr,
+                                  &ifp, ibuf))
+        ospf_read_packet (ospf, ibuf, ifp);
+    }
+
+  return 0;
+}
+#else
+/* Starting point of packet process function. */
+int
+ospf_read (struct thread *thread)
+{
+  struct ospf *ospf;
+  struct stream *ibuf;
+  struct interface *ifp;
+
+  /* first of all get interface pointer. */
+  ospf = THREAD_ARG (thread);
+
+  /* prepare for next packet. */
+  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
+
+  stream_reset(ospf->ibuf[0]);
+  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf[0])))
+    return -1;
+
+  ospf->read_batches++;
+  ospf->read_packets++;
+
+  return ospf_read_packet (ospf, ibuf, ifp);
+}
+#endif /* HAVE_RECVMMSG */
+
 /* Make OSPF header. */
 static void
 ospf_make_header (int type, struct ospf_interface *oi, struct stream *s)
@@ -3743,6 +3928,7 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
 {
   struct ospf_packet *op;
   u_int16_t length = OSPF_HEADER_SIZE;
+  unsigned int count;
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("listcount = %d, [%s]dst %s", listcount (update), IF_NAME(oi),
@@ -3756,7 +3942,10 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
   /* Prepare OSPF Link State Update body.
    * Includes Type-7 translation.
    */
+  count = listcount (update);
   length += ospf_make_ls_upd (oi, update, op->s);
+  oi->ls_upd_lsas += count - listcount (update);
+  oi->ls_upd_out++;
 
   /* Fill OSPF header. */
   ospf_fill_header (oi, op->s, length);
@@ -3784,13 +3973,28 @@ ospf_ls_upd_send_queue_event (struct thread *thread)
   struct route_node *rn;
   struct route_node *rnext;
   struct list *update;
+  struct listnode *node;
+  struct ospf_lsa *lsa;
   char again = 0;
+  unsigned int queued = 0;
+  struct timeval now;
+  unsigned long delay;
 
   oi->t_ls_upd_event = NULL;
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_ls_upd_send_queue start");
 
+  if (oi->ls_upd_queued)
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      delay = timeval_elapsed (now, oi->ls_upd_since) / 1000;
+      oi->flood_delay += delay;
+      if (delay > oi->flood_delay_max)
+        oi->flood_delay_max = delay;
+      oi->flood_runs++;
+    }
+
   for (rn = route_top (oi->ls_upd_queue); rn; rn = rnext)
     {
       rnext = route_next (rn);
@@ -3810,9 +4014,16 @@ ospf_ls_upd_send_queue_event (struct thread *thread)
           route_unlock_node (rn);
         }
       else
-        again = 1;
+        {
+          again = 1;
+          for (ALL_LIST_ELEMENTS_RO (update, node, lsa))
+            queued += ntohs (lsa->data->length);
+        }
     }
 
+  /* Whatever could not be sent yet stays accounted for. */
+  oi->ls_upd_queued = queued;
+
   if (again != 0)
     {
       if (IS_DEBUG_OSPF_EVENT)
@@ -3870,11 +4081,28 @@ ospf_ls_upd_send (struct ospf_neighbor *nbr, struct list *update, int flag)
     rn->info = list_new ();
 
   for (ALL_LIST_ELEMENTS_RO (update, node, lsa))
-    listnode_add (rn->info, ospf_lsa_lock (lsa)); /* oi->ls_upd_queue */
+    {
+      listnode_add (rn->info, ospf_lsa_lock (lsa)); /* oi->ls_upd_queue */
+      oi->ls_upd_queued += ntohs (lsa->data->length);
+    }
 
+  /* Give other LSAs a moment to join these in the same packets... */
   if (oi->t_ls_upd_event == NULL)
-    oi->t_ls_upd_event =
-      thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &oi->ls_upd_since);
+      oi->t_ls_upd_event =
+        thread_add_timer_msec (master, ospf_ls_upd_send_queue_event, oi,
+                               OSPF_LS_UPD_COALESCE_DELAY);
+    }
+
+  /* ...unless there is enough to fill a packet already. */
+  if (oi->ls_upd_queued >= OSPF_LS_UPD_MAX_DATA (oi)
+      && oi->t_ls_upd_event->type == THREAD_TIMER)
+    {
+      thread_cancel (oi->t_ls_upd_event);
+      oi->t_ls_upd_event =
+        thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+    }
 }
 
 static void
@@ -3883,6 +4111,7 @@ ospf_ls_ack_send_list (struct ospf_interface *oi, struct list *ack,
 {
   struct ospf_packet *op;
   u_int16_t length = OSPF_HEADER_SIZE;
+  unsigned int count;
 
   op = ospf_packet_new (oi->ifp->mtu);
 
@@ -3890,7 +4119,10 @@ ospf_ls_ack_send_list (struct ospf_interface *oi, struct list *ack,
   ospf_make_header (OSPF_MSG_LS_ACK, oi, op->s);
 
   /* Prepare OSPF Link State Acknowledgment body. */
+  count = listcount (ack);
   length += ospf_make_ls_ack (oi, ack, op->s);
+  oi->ls_ack_lsas += count - listcount (ack);
+  oi->ls_ack_out++;
 
   /* Fill OSPF header. */
   ospf_fill_header (oi, op->s, length);
@@ -3927,6 +4159,13 @@ ospf_ls_ack_send (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
   struct ospf_interface *oi = nbr->oi;
 
+  /* Acks pending for another neighbor go out first. */
+  if (listcount (oi->ls_ack_direct.ls_ack)
+      && !IPV4_ADDR_SAME (&oi->ls_ack_direct.dst, &nbr->address.u.prefix4))
+    while (listcount (oi->ls_ack_direct.ls_ack))
+      ospf_ls_ack_send_list (oi, oi->ls_ack_direct.ls_ack,
+                             oi->ls_ack_direct.dst);
+
   if (listcount (oi->ls_ack_direct.ls_ack) == 0)
     oi->ls_ack_direct.dst = nbr->address.u.prefix4;
 
@@ -3974,3 +4213,14 @@ ospf_ls_ack_send_delayed (struct ospf_interface *oi)
   while (listcount (oi->ls_ack))
     ospf_ls_ack_send_list (oi, oi->ls_ack, dst);
 }
+
+/* Schedule a delayed LSA Ack. They are sent by the LS Ack timer, or as
+   soon as there are enough of them to fill a packet. */
+void
+ospf_ls_ack_add_delayed (struct ospf_interface *oi, struct ospf_lsa *lsa)
+{
+  listnode_add (oi->ls_ack, ospf_lsa_lock (lsa)); /* delayed LSA Ack */
+
+  if (listcount (oi->ls_ack) >= OSPF_LS_ACK_MAX_COUNT (oi))
+    ospf_ls_ack_send_delayed (oi);
+}
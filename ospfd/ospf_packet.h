@@ -46,6 +46,10 @@
 
 #define OSPF_HELLO_REPLY_DELAY          1
 
+/* LS Updates are held back for this long (msec), so that LSAs flooded
+   close together go out packed into as few packets as possible. */
+#define OSPF_LS_UPD_COALESCE_DELAY      20
+
 /* Return values of functions involved in packet verification, see ospf6d. */
 #define MSG_OK    0
 #define MSG_NG    1
@@ -130,6 +134,12 @@ struct ospf_ls_update
 /* XXX Perhaps obsolete; function in ospf_packet.c */
 #define OSPF_PACKET_MAX(oi)     ospf_packet_max (oi)
 
+/* Room for LSAs in a LS Update, and LSA headers in a LS Ack. */
+#define OSPF_LS_UPD_MAX_DATA(oi) \
+  (ospf_packet_max (oi) - OSPF_HEADER_SIZE - OSPF_LS_UPD_MIN_SIZE)
+#define OSPF_LS_ACK_MAX_COUNT(oi) \
+  ((ospf_packet_max (oi) - 2 * OSPF_HEADER_SIZE) / OSPF_LSA_HEADER_SIZE + 1)
+
 #define OSPF_OUTPUT_PNT(S)      ((S)->data + (S)->putp)
 #define OSPF_OUTPUT_LENGTH(S)   ((S)->endp)
 
@@ -163,6 +173,8 @@ extern void ospf_ls_upd_send_lsa (struct ospf_neighbor *, struct ospf_lsa *,
 extern void ospf_ls_upd_send (struct ospf_neighbor *, struct list *, int);
 extern void ospf_ls_ack_send (struct ospf_neighbor *, struct ospf_lsa *);
 extern void ospf_ls_ack_send_delayed (struct ospf_interface *);
+extern void ospf_ls_ack_add_delayed (struct ospf_interface *,
+                                     struct ospf_lsa *);
 extern void ospf_ls_retransmit (struct ospf_interface *, struct ospf_lsa *);
 extern void ospf_ls_req_event (struct ospf_neighbor *);
 
@@ -2786,6 +2786,11 @@ DEFUN (show_ip_ospf,
   vty_out (vty, " Number of areas attached to this router: %d%s",
            listcount (ospf->areas), VTY_NEWLINE);
 
+  /* Show packet I/O batching. */
+  vty_out (vty, " Packets received %lu in %lu reads, sent %lu in %lu writes%s",
+           ospf->read_packets, ospf->read_batches,
+           ospf->write_packets, ospf->write_batches, VTY_NEWLINE);
+
   if (CHECK_FLAG(ospf->config, OSPF_LOG_ADJACENCY_CHANGES))
     {
       if (CHECK_FLAG(ospf->config, OSPF_LOG_ADJACENCY_DETAIL))
@@ -2959,6 +2964,13 @@ show_ip_ospf_interface_sub (struct vty *vty, struct ospf *ospf,
       vty_out (vty, "  Neighbor Count is %d, Adjacent neighbor count is %d%s",
 	       ospf_nbr_count (oi, 0), ospf_nbr_count (oi, NSM_Full),
 	       VTY_NEWLINE);
+
+      vty_out (vty, "  LS Update sent %u, %u LSAs, queued %lu msec avg,"
+               " %lu msec max%s", oi->ls_upd_out, oi->ls_upd_lsas,
+               oi->flood_runs ? oi->flood_delay / oi->flood_runs : 0,
+               oi->flood_delay_max, VTY_NEWLINE);
+      vty_out (vty, "  LS Ack sent %u, %u LSAs%s",
+               oi->ls_ack_out, oi->ls_ack_lsas, VTY_NEWLINE);
     }
 }
 
@@ -246,12 +246,13 @@ ospf_new (void)
   if (IS_DEBUG_OSPF (zebra, ZEBRA_INTERFACE))
     zlog_debug ("%s: starting with OSPF send buffer size %u",
       __func__, new->maxsndbuflen);
-  if ((new->ibuf = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
-    {
-      zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
-	       OSPF_MAX_PACKET_SIZE+1);
-      exit(1);
-    }
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    if ((new->ibuf[i] = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
+      {
+        zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
+                 OSPF_MAX_PACKET_SIZE+1);
+        exit(1);
+      }
   new->t_read = thread_add_read (master, ospf_read, new, new->fd);
   new->oi_write_q = list_new ();
 
@@ -535,7 +536,8 @@ ospf_finish_final (struct ospf *ospf)
 #endif
 
   close (ospf->fd);
-  stream_free(ospf->ibuf);
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    stream_free(ospf->ibuf[i]);
 
 #ifdef HAVE_OPAQUE_LSA
   LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
@@ -1008,6 +1010,8 @@ ospf_ls_upd_queue_empty (struct ospf_interface *oi)
 	rn->info = NULL;
       }
 
+  oi->ls_upd_queued = 0;
+
   /* remove update event */
   if (oi->t_ls_upd_event)
     {
@@ -51,6 +51,17 @@
 #define OSPF_ALLSPFROUTERS              0xe0000005      /* 224.0.0.5 */
 #define OSPF_ALLDROUTERS                0xe0000006      /* 224.0.0.6 */
 
+/* Packet I/O batching: packets received per read wakeup, packets sent
+   per write wakeup, and packets sent from one interface before moving
+   on to the next one on the write queue. */
+#ifdef HAVE_RECVMMSG
+#define OSPF_READ_BATCH                 8
+#else
+#define OSPF_READ_BATCH                 1
+#endif
+#define OSPF_WRITE_BATCH                64
+#define OSPF_WRITE_OI_QUOTA             8
+
 
 /* OSPF Authentication Type. */
 #define OSPF_AUTH_NULL                      0
@@ -227,9 +238,15 @@ struct ospf
   struct thread *t_read;
   int fd;
   unsigned int maxsndbuflen;
-  struct stream *ibuf;
+  struct stream *ibuf[OSPF_READ_BATCH];
   struct list *oi_write_q;
 
+  /* Packet I/O batching statistics. */
+  unsigned long read_batches;
+  unsigned long read_packets;
+  unsigned long write_batches;
+  unsigned long write_packets;
+
   /* Distribute lists out of other route sources. */
   struct
   {
@@ -489,7 +489,7 @@ rip_interface_delete (int command, struct zclient *zclient,
   
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -550,6 +550,7 @@ rip_interface_reset (void)
 
       ri->split_horizon = RIP_NO_SPLIT_HORIZON;
       ri->split_horizon_default = RIP_NO_SPLIT_HORIZON;
+      rip_output_cache_free (ri);
 
       ri->list[RIP_FILTER_IN] = NULL;
       ri->list[RIP_FILTER_OUT] = NULL;
@@ -1782,6 +1783,7 @@ DEFUN (ip_rip_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIP_SPLIT_HORIZON;
+  rip_output_cache_flush ();
   return CMD_SUCCESS;
 }
 
@@ -1800,6 +1802,7 @@ DEFUN (ip_rip_split_horizon_poisoned_reverse,
   ri = ifp->info;
 
   ri->split_horizon = RIP_SPLIT_HORIZON_POISONED_REVERSE;
+  rip_output_cache_flush ();
   return CMD_SUCCESS;
 }
 
@@ -1822,6 +1825,7 @@ DEFUN (no_ip_rip_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIP_NO_SPLIT_HORIZON;
+  rip_output_cache_flush ();
   return CMD_SUCCESS;
 }
 
@@ -1847,6 +1851,7 @@ DEFUN (no_ip_rip_split_horizon_poisoned_reverse,
 	default:
 		break;
   }
+  rip_output_cache_flush ();
 
   return CMD_SUCCESS;
 }
@@ -2045,6 +2050,7 @@ rip_interface_new_hook (struct interface *ifp)
 static int
 rip_interface_delete_hook (struct interface *ifp)
 {
+  rip_output_cache_free (ifp->info);
   XFREE (MTYPE_RIP_INTERFACE, ifp->info);
   ifp->info = NULL;
   return 0;
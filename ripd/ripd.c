@@ -121,6 +121,24 @@ rip_info_free (struct rip_info *rinfo)
   XFREE (MTYPE_RIP_INFO, rinfo);
 }
 
+/* Flag the route RINFO at RP as changed and queue RP for the next
+   triggered update. */
+static void
+rip_route_changed (struct route_node *rp, struct rip_info *rinfo)
+{
+  struct route_node *rn;
+
+  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+
+  rn = route_node_get (rip->changed, &rp->p);
+  if (rn->info == NULL)
+    rn->info = route_lock_node (rp);
+  else
+    route_unlock_node (rn);
+
+  rip_output_cache_flush ();
+}
+
 /* RIP route garbage collect timer. */
 static int
 rip_garbage_collect (struct thread *t)
@@ -149,6 +167,8 @@ rip_garbage_collect (struct thread *t)
   /* Free RIP routing information. */
   rip_info_free (rinfo);
 
+  rip_output_cache_flush ();
+
   return 0;
 }
 
@@ -186,7 +206,7 @@ rip_ecmp_add (struct rip_info *rinfo_new)
 
   /* Set the route change flag on the first entry. */
   rinfo = listgetdata (listhead (list));
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+  rip_route_changed (rp, rinfo);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -238,7 +258,7 @@ rip_ecmp_replace (struct rip_info *rinfo_new)
     }
 
   /* Set the route change flag. */
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+  rip_route_changed (rp, rinfo);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -288,7 +308,7 @@ rip_ecmp_delete (struct rip_info *rinfo)
 
   /* Set the route change flag on the first entry. */
   rinfo = listgetdata (listhead (list));
-  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+  rip_route_changed (rp, rinfo);
 
   /* Signal the output process to trigger an update (see section 2.5). */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -740,7 +760,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
 
                   /* - Set the route change flag on the first entry. */
                   rinfo = listgetdata (listhead (list));
-                  SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+                  rip_route_changed (rp, rinfo);
                   rip_event (RIP_TRIGGERED_UPDATE, 0);
                 }
             }
@@ -1678,7 +1698,7 @@ rip_redistribute_delete (int type, int sub_type, struct prefix_ipv4 *p,
               RIP_TIMER_ON (rinfo->t_garbage_collect,
                             rip_garbage_collect, rip->garbage_time);
               RIP_TIMER_OFF (rinfo->t_timeout);
-              rinfo->flags |= RIP_RTF_CHANGED;
+              rip_route_changed (rp, rinfo);
 
               if (IS_RIP_DEBUG_EVENT)
                 zlog_debug ("Poisone %s/%d on the interface %s with an "
@@ -2175,45 +2195,321 @@ rip_write_rte (int num, struct stream *s, struct prefix_ipv4 *p,
   return ++num;
 }
 
-/* Send update to the ifp or spcified neighbor. */
+/* Output generation of the cached full updates, advanced whenever a
+   route or any output policy changes.  Zero never matches. */
+static u_int32_t rip_output_gen = 1;
+
+/* Invalidate the full updates cached on every interface. */
 void
-rip_output_process (struct connected *ifc, struct sockaddr_in *to, 
-                    int route_type, u_char version)
+rip_output_cache_flush (void)
+{
+  if (++rip_output_gen == 0)
+    rip_output_gen = 1;
+}
+
+static void
+rip_output_cache_del (void *arg)
+{
+  struct rip_output_cache *cache = arg;
+
+  stream_free (cache->rte);
+  XFREE (MTYPE_RIP_OUTPUT_CACHE, cache);
+}
+
+/* Free the cached updates of a RIP interface. */
+void
+rip_output_cache_free (struct rip_interface *ri)
+{
+  if (ri->output_cache)
+    {
+      list_delete (ri->output_cache);
+      ri->output_cache = NULL;
+    }
+}
+
+/* Look up or create the cached update of interface address IFC. */
+static struct rip_output_cache *
+rip_output_cache_get (struct connected *ifc, u_char version)
+{
+  struct rip_interface *ri;
+  struct rip_output_cache *cache;
+  struct listnode *node;
+
+  ri = ifc->ifp->info;
+  if (ri->output_cache == NULL)
+    {
+      ri->output_cache = list_new ();
+      ri->output_cache->del = rip_output_cache_del;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (ri->output_cache, node, cache))
+    if (cache->version == version
+        && prefix_same (&cache->address, ifc->address))
+      return cache;
+
+  cache = XCALLOC (MTYPE_RIP_OUTPUT_CACHE, sizeof (struct rip_output_cache));
+  prefix_copy (&cache->address, ifc->address);
+  cache->version = version;
+  cache->rte = stream_new (RIP_MAX_RTE * RIP_RTE_SIZE);
+  listnode_add (ri->output_cache, cache);
+
+  return cache;
+}
+
+/* Apply the output policy of interface address IFC to the route at RP.
+   Return the entry to announce with its _out fields set, or NULL when
+   the route is not announced on IFC. */
+static struct rip_info *
+rip_output_route (struct connected *ifc, u_char version,
+                  struct route_node *rp, struct prefix_ipv4 *ifaddrclass,
+                  int subnetted)
 {
   int ret;
-  struct stream *s;
-  struct route_node *rp;
   struct rip_info *rinfo;
   struct rip_interface *ri;
   struct prefix_ipv4 *p;
   struct prefix_ipv4 classfull;
+  struct list *list = rp->info;
+  struct listnode *listnode = NULL;
+
+  ri = ifc->ifp->info;
+  rinfo = listgetdata (listhead (list));
+  p = (struct prefix_ipv4 *) &rp->p;
+
+  /* For RIPv1, if we are subnetted, output subnets in our network    */
+  /* that have the same mask as the output "interface". For other     */
+  /* networks, only the classfull version is output.                  */
+  if (version == RIPv1)
+    {
+      if (IS_RIP_DEBUG_PACKET)
+	zlog_debug("RIPv1 mask check, %s/%d considered for output",
+		  inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
+
+      if (subnetted &&
+	  prefix_match ((struct prefix *) ifaddrclass, &rp->p))
+	{
+	  if ((ifc->address->prefixlen != rp->p.prefixlen) &&
+	      (rp->p.prefixlen != 32))
+	    return NULL;
+	}
+      else
+	{
+	  memcpy (&classfull, &rp->p, sizeof(struct prefix_ipv4));
+	  apply_classful_mask_ipv4(&classfull);
+	  if (rp->p.u.prefix4.s_addr != 0 &&
+	      classfull.prefixlen != rp->p.prefixlen)
+	    return NULL;
+	}
+      if (IS_RIP_DEBUG_PACKET)
+	zlog_debug("RIPv1 mask check, %s/%d made it through",
+		  inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
+    }
+
+  /* Apply output filters. */
+  ret = rip_outgoing_filter (p, ri);
+  if (ret < 0)
+    return NULL;
+
+  /* Split horizon. */
+  /* if (split_horizon == rip_split_horizon) */
+  if (ri->split_horizon == RIP_SPLIT_HORIZON)
+    {
+      /* 
+       * We perform split horizon for RIP and connected route. 
+       * For rip routes, we want to suppress the route if we would
+       * end up sending the route back on the interface that we
+       * learned it from, with a higher metric. For connected routes,
+       * we suppress the route if the prefix is a subset of the
+       * source address that we are going to use for the packet 
+       * (in order to handle the case when multiple subnets are
+       * configured on the same interface).
+       */
+      int suppress = 0;
+      struct rip_info *tmp_rinfo = NULL;
+
+      for (ALL_LIST_ELEMENTS_RO (list, listnode, tmp_rinfo))
+	if (tmp_rinfo->type == ZEBRA_ROUTE_RIP &&
+	    tmp_rinfo->ifindex == ifc->ifp->ifindex)
+	  {
+	    suppress = 1;
+	    break;
+	  }
+
+      if (!suppress && rinfo->type == ZEBRA_ROUTE_CONNECT &&
+	  prefix_match((struct prefix *)p, ifc->address))
+	suppress = 1;
+
+      if (suppress)
+	return NULL;
+    }
+
+  /* Preparation for route-map. */
+  rinfo->metric_set = 0;
+  rinfo->nexthop_out.s_addr = 0;
+  rinfo->metric_out = rinfo->metric;
+  rinfo->tag_out = rinfo->tag;
+  rinfo->ifindex_out = ifc->ifp->ifindex;
+
+  /* In order to avoid some local loops,
+   * if the RIP route has a nexthop via this interface, keep the nexthop,
+   * otherwise set it to 0. The nexthop should not be propagated
+   * beyond the local broadcast/multicast area in order
+   * to avoid an IGP multi-level recursive look-up.
+   * see (4.4)
+   */
+  if (rinfo->ifindex == ifc->ifp->ifindex)
+    rinfo->nexthop_out = rinfo->nexthop;
+
+  /* Interface route-map */
+  if (ri->routemap[RIP_FILTER_OUT])
+    {
+      ret = route_map_apply (ri->routemap[RIP_FILTER_OUT], 
+			     (struct prefix *) p, RMAP_RIP, 
+			     rinfo);
+
+      if (ret == RMAP_DENYMATCH)
+	{
+	  if (IS_RIP_DEBUG_PACKET)
+	    zlog_debug ("RIP %s/%d is filtered by route-map out",
+		       inet_ntoa (p->prefix), p->prefixlen);
+	  return NULL;
+	}
+    }
+
+  /* Apply redistribute route map - continue, if deny */
+  if (rip->route_map[rinfo->type].name
+      && rinfo->sub_type != RIP_ROUTE_INTERFACE)
+    {
+      ret = route_map_apply (rip->route_map[rinfo->type].map,
+			     (struct prefix *)p, RMAP_RIP, rinfo);
+
+      if (ret == RMAP_DENYMATCH) 
+	{
+	  if (IS_RIP_DEBUG_PACKET)
+	    zlog_debug ("%s/%d is filtered by route-map",
+		       inet_ntoa (p->prefix), p->prefixlen);
+	  return NULL;
+	}
+    }
+
+  /* When route-map does not set metric. */
+  if (! rinfo->metric_set)
+    {
+      /* If redistribute metric is set. */
+      if (rip->route_map[rinfo->type].metric_config
+	  && rinfo->metric != RIP_METRIC_INFINITY)
+	{
+	  rinfo->metric_out = rip->route_map[rinfo->type].metric;
+	}
+      else
+	{
+	  /* If the route is not connected or localy generated
+	     one, use default-metric value*/
+	  if (rinfo->type != ZEBRA_ROUTE_RIP 
+	      && rinfo->type != ZEBRA_ROUTE_CONNECT
+	      && rinfo->metric != RIP_METRIC_INFINITY)
+	    rinfo->metric_out = rip->default_metric;
+	}
+    }
+
+  /* Apply offset-list */
+  if (rinfo->metric != RIP_METRIC_INFINITY)
+    rip_offset_list_apply_out (p, ifc->ifp, &rinfo->metric_out);
+
+  if (rinfo->metric_out > RIP_METRIC_INFINITY)
+    rinfo->metric_out = RIP_METRIC_INFINITY;
+
+  /* Perform split-horizon with poisoned reverse 
+   * for RIP and connected routes.
+   **/
+  if (ri->split_horizon == RIP_SPLIT_HORIZON_POISONED_REVERSE)
+    {
+      struct rip_info *tmp_rinfo = NULL;
+
+      for (ALL_LIST_ELEMENTS_RO (list, listnode, tmp_rinfo))
+	if (tmp_rinfo->type == ZEBRA_ROUTE_RIP  &&
+	    tmp_rinfo->ifindex == ifc->ifp->ifindex)
+	  rinfo->metric_out = RIP_METRIC_INFINITY;
+      if (rinfo->type == ZEBRA_ROUTE_CONNECT &&
+	  prefix_match((struct prefix *)p, ifc->address))
+	rinfo->metric_out = RIP_METRIC_INFINITY;
+    }
+
+  return rinfo;
+}
+
+/* Encode the RTEs announced on interface address IFC into S and
+   return their number.  A full update walks the whole RIP table, a
+   triggered update only the routes changed since the last one. */
+static int
+rip_output_encode (struct connected *ifc, u_char version, int route_type,
+                   struct stream *s)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct route_node *rp;
+  struct rip_info *rinfo;
+  struct list *list;
   struct prefix_ipv4 ifaddrclass;
+  int subnetted = 0;
+  int num = 0;
+
+  if (version == RIPv1)
+    {
+      memcpy (&ifaddrclass, ifc->address, sizeof (struct prefix_ipv4));
+      apply_classful_mask_ipv4 (&ifaddrclass);
+      subnetted = 0;
+      if (ifc->address->prefixlen > ifaddrclass.prefixlen)
+        subnetted = 1;
+    }
+
+  table = (route_type == rip_changed_route) ? rip->changed : rip->table;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    {
+      rp = (route_type == rip_changed_route) ? rn->info : rn;
+      if (rp == NULL || (list = rp->info) == NULL || listcount (list) == 0)
+        continue;
+
+      /* Changed route only output. */
+      rinfo = listgetdata (listhead (list));
+      if (route_type == rip_changed_route &&
+          (! (rinfo->flags & RIP_RTF_CHANGED)))
+        continue;
+
+      rinfo = rip_output_route (ifc, version, rp, &ifaddrclass, subnetted);
+      if (rinfo == NULL)
+        continue;
+
+      if (STREAM_WRITEABLE (s) < RIP_RTE_SIZE)
+        stream_resize (s, stream_get_size (s) * 2);
+
+      num = rip_write_rte (num, s, (struct prefix_ipv4 *) &rp->p,
+                           version, rinfo);
+    }
+
+  return num;
+}
+
+/* Send the NUM RTEs encoded in RTE to the ifp or specified neighbor,
+   adding the header and authentication to each packet. */
+static void
+rip_output_send (struct connected *ifc, struct sockaddr_in *to,
+                 u_char version, struct stream *rte, int num)
+{
+  int ret;
+  struct stream *s;
+  struct rip_interface *ri;
   struct key *key = NULL;
   /* this might need to made dynamic if RIP ever supported auth methods
      with larger key string sizes */
   char auth_str[RIP_AUTH_SIMPLE_SIZE];
   size_t doff = 0; /* offset of digest offset field */
-  int num = 0;
   int rtemax;
-  int subnetted = 0;
-  struct list *list = NULL;
-  struct listnode *listnode = NULL;
-
-  /* Logging output event. */
-  if (IS_RIP_DEBUG_EVENT)
-    {
-      if (to)
-	zlog_debug ("update routes to neighbor %s", inet_ntoa (to->sin_addr));
-      else
-	zlog_debug ("update routes on interface %s ifindex %d",
-		   ifc->ifp->name, ifc->ifp->ifindex);
-    }
+  int i, n;
 
   /* Set output stream. */
   s = rip->obuf;
-
-  /* Reset stream and RTE counter. */
-  stream_reset (s);
   rtemax = RIP_MAX_RTE;
 
   /* Get RIP interface. */
@@ -2245,231 +2541,25 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
       rip_auth_prepare_str_send (ri, key, auth_str, RIP_AUTH_SIMPLE_SIZE);
     }
 
-  if (version == RIPv1)
+  for (i = 0; i < num; i += n)
     {
-      memcpy (&ifaddrclass, ifc->address, sizeof (struct prefix_ipv4));
-      apply_classful_mask_ipv4 (&ifaddrclass);
-      subnetted = 0;
-      if (ifc->address->prefixlen > ifaddrclass.prefixlen)
-        subnetted = 1;
-    }
-
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
-    if ((list = rp->info) != NULL && listcount (list) != 0)
-      {
-        rinfo = listgetdata (listhead (list));
-	/* For RIPv1, if we are subnetted, output subnets in our network    */
-	/* that have the same mask as the output "interface". For other     */
-	/* networks, only the classfull version is output.                  */
-	
-	if (version == RIPv1)
-	  {
-	    p = (struct prefix_ipv4 *) &rp->p;
-
-	    if (IS_RIP_DEBUG_PACKET)
-	      zlog_debug("RIPv1 mask check, %s/%d considered for output",
-			inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
-
-	    if (subnetted &&
-		prefix_match ((struct prefix *) &ifaddrclass, &rp->p))
-	      {
-		if ((ifc->address->prefixlen != rp->p.prefixlen) &&
-		    (rp->p.prefixlen != 32))
-		  continue;
-	      }
-	    else
-	      {
-		memcpy (&classfull, &rp->p, sizeof(struct prefix_ipv4));
-		apply_classful_mask_ipv4(&classfull);
-		if (rp->p.u.prefix4.s_addr != 0 &&
-		    classfull.prefixlen != rp->p.prefixlen)
-		  continue;
-	      }
-	    if (IS_RIP_DEBUG_PACKET)
-	      zlog_debug("RIPv1 mask check, %s/%d made it through",
-			inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
-	  }
-	else 
-	  p = (struct prefix_ipv4 *) &rp->p;
-
-	/* Apply output filters. */
-	ret = rip_outgoing_filter (p, ri);
-	if (ret < 0)
-	  continue;
-
-	/* Changed route only output. */
-	if (route_type == rip_changed_route &&
-	    (! (rinfo->flags & RIP_RTF_CHANGED)))
-	  continue;
-
-	/* Split horizon. */
-	/* if (split_horizon == rip_split_horizon) */
-	if (ri->split_horizon == RIP_SPLIT_HORIZON)
-	  {
-	    /* 
-	     * We perform split horizon for RIP and connected route. 
-	     * For rip routes, we want to suppress the route if we would
-             * end up sending the route back on the interface that we
-             * learned it from, with a higher metric. For connected routes,
-             * we suppress the route if the prefix is a subset of the
-             * source address that we are going to use for the packet 
-             * (in order to handle the case when multiple subnets are
-             * configured on the same interface).
-             */
-	    int suppress = 0;
-	    struct rip_info *tmp_rinfo = NULL;
-
-	    for (ALL_LIST_ELEMENTS_RO (list, listnode, tmp_rinfo))
-	      if (tmp_rinfo->type == ZEBRA_ROUTE_RIP &&
-	          tmp_rinfo->ifindex == ifc->ifp->ifindex)
-	        {
-	          suppress = 1;
-	          break;
-	        }
-
-	    if (!suppress && rinfo->type == ZEBRA_ROUTE_CONNECT &&
-                 prefix_match((struct prefix *)p, ifc->address))
-	      suppress = 1;
-
-	    if (suppress)
-	      continue;
-	  }
-
-	/* Preparation for route-map. */
-	rinfo->metric_set = 0;
-	rinfo->nexthop_out.s_addr = 0;
-	rinfo->metric_out = rinfo->metric;
-	rinfo->tag_out = rinfo->tag;
-	rinfo->ifindex_out = ifc->ifp->ifindex;
-
-	/* In order to avoid some local loops,
-	 * if the RIP route has a nexthop via this interface, keep the nexthop,
-	 * otherwise set it to 0. The nexthop should not be propagated
-	 * beyond the local broadcast/multicast area in order
-	 * to avoid an IGP multi-level recursive look-up.
-	 * see (4.4)
-	 */
-	if (rinfo->ifindex == ifc->ifp->ifindex)
-	  rinfo->nexthop_out = rinfo->nexthop;
-
-	/* Interface route-map */
-	if (ri->routemap[RIP_FILTER_OUT])
-	  {
-	    ret = route_map_apply (ri->routemap[RIP_FILTER_OUT], 
-				     (struct prefix *) p, RMAP_RIP, 
-				     rinfo);
-
-	    if (ret == RMAP_DENYMATCH)
-	      {
-	        if (IS_RIP_DEBUG_PACKET)
-	          zlog_debug ("RIP %s/%d is filtered by route-map out",
-			     inet_ntoa (p->prefix), p->prefixlen);
-		  continue;
-	      }
-	  }
-           
-	/* Apply redistribute route map - continue, if deny */
-	if (rip->route_map[rinfo->type].name
-	    && rinfo->sub_type != RIP_ROUTE_INTERFACE)
-	  {
-	    ret = route_map_apply (rip->route_map[rinfo->type].map,
-				   (struct prefix *)p, RMAP_RIP, rinfo);
-
-	    if (ret == RMAP_DENYMATCH) 
-	      {
-		if (IS_RIP_DEBUG_PACKET)
-		  zlog_debug ("%s/%d is filtered by route-map",
-			     inet_ntoa (p->prefix), p->prefixlen);
-		continue;
-	      }
-	  }
+      n = MIN (rtemax, num - i);
 
-	/* When route-map does not set metric. */
-	if (! rinfo->metric_set)
-	  {
-	    /* If redistribute metric is set. */
-	    if (rip->route_map[rinfo->type].metric_config
-		&& rinfo->metric != RIP_METRIC_INFINITY)
-	      {
-		rinfo->metric_out = rip->route_map[rinfo->type].metric;
-	      }
-	    else
-	      {
-		/* If the route is not connected or localy generated
-		   one, use default-metric value*/
-		if (rinfo->type != ZEBRA_ROUTE_RIP 
-		    && rinfo->type != ZEBRA_ROUTE_CONNECT
-		    && rinfo->metric != RIP_METRIC_INFINITY)
-		  rinfo->metric_out = rip->default_metric;
-	      }
-	  }
-
-	/* Apply offset-list */
-	if (rinfo->metric != RIP_METRIC_INFINITY)
-	  rip_offset_list_apply_out (p, ifc->ifp, &rinfo->metric_out);
-
-	if (rinfo->metric_out > RIP_METRIC_INFINITY)
-	  rinfo->metric_out = RIP_METRIC_INFINITY;
-
-	/* Perform split-horizon with poisoned reverse 
-	 * for RIP and connected routes.
-	 **/
-	if (ri->split_horizon == RIP_SPLIT_HORIZON_POISONED_REVERSE) {
-	    /* 
-	     * We perform split horizon for RIP and connected route. 
-	     * For rip routes, we want to suppress the route if we would
-             * end up sending the route back on the interface that we
-             * learned it from, with a higher metric. For connected routes,
-             * we suppress the route if the prefix is a subset of the
-             * source address that we are going to use for the packet 
-             * (in order to handle the case when multiple subnets are
-             * configured on the same interface).
-             */
-	  struct rip_info *tmp_rinfo = NULL;
-
-	  for (ALL_LIST_ELEMENTS_RO (list, listnode, tmp_rinfo))
-	    if (tmp_rinfo->type == ZEBRA_ROUTE_RIP  &&
-	        tmp_rinfo->ifindex == ifc->ifp->ifindex)
-	      rinfo->metric_out = RIP_METRIC_INFINITY;
-	  if (tmp_rinfo->type == ZEBRA_ROUTE_CONNECT &&
-              prefix_match((struct prefix *)p, ifc->address))
-	    rinfo->metric_out = RIP_METRIC_INFINITY;
-	}
-	
-	/* Prepare preamble, auth headers, if needs be */
-	if (num == 0)
-	  {
-	    stream_putc (s, RIP_RESPONSE);
-	    stream_putc (s, version);
-	    stream_putw (s, 0);
-	    
-	    /* auth header for !v1 && !no_auth */
-            if ( (ri->auth_type != RIP_NO_AUTH) && (version != RIPv1) )
-              doff = rip_auth_header_write (s, ri, key, auth_str, 
-                                              RIP_AUTH_SIMPLE_SIZE);
-          }
-        
-	/* Write RTE to the stream. */
-	num = rip_write_rte (num, s, p, version, rinfo);
-	if (num == rtemax)
-	  {
-	    if (version == RIPv2 && ri->auth_type == RIP_AUTH_MD5)
-              rip_auth_md5_set (s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
+      /* Prepare preamble, auth headers, if needs be */
+      stream_reset (s);
+      stream_putc (s, RIP_RESPONSE);
+      stream_putc (s, version);
+      stream_putw (s, 0);
 
-	    ret = rip_send_packet (STREAM_DATA (s), stream_get_endp (s),
-				   to, ifc);
+      /* auth header for !v1 && !no_auth */
+      if ( (ri->auth_type != RIP_NO_AUTH) && (version != RIPv1) )
+        doff = rip_auth_header_write (s, ri, key, auth_str, 
+                                      RIP_AUTH_SIMPLE_SIZE);
 
-	    if (ret >= 0 && IS_RIP_DEBUG_SEND)
-	      rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
-			       stream_get_endp(s), "SEND");
-	    num = 0;
-	    stream_reset (s);
-	  }
-      }
+      /* Copy the encoded RTEs of this packet. */
+      stream_put (s, STREAM_DATA (rte) + i * RIP_RTE_SIZE,
+                  n * RIP_RTE_SIZE);
 
-  /* Flush unwritten RTE. */
-  if (num != 0)
-    {
       if (version == RIPv2 && ri->auth_type == RIP_AUTH_MD5)
         rip_auth_md5_set (s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
 
@@ -2478,14 +2568,51 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
       if (ret >= 0 && IS_RIP_DEBUG_SEND)
 	rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
 			 stream_get_endp (s), "SEND");
-      num = 0;
-      stream_reset (s);
     }
+  stream_reset (s);
 
   /* Statistics updates. */
   ri->sent_updates++;
 }
 
+/* Send update to the ifp or spcified neighbor.  The RTEs of a full
+   update are cached per interface address until a route or the output
+   policy changes, a triggered update encodes only the changed routes. */
+void
+rip_output_process (struct connected *ifc, struct sockaddr_in *to, 
+                    int route_type, u_char version)
+{
+  struct rip_output_cache *cache;
+  int num;
+
+  /* Logging output event. */
+  if (IS_RIP_DEBUG_EVENT)
+    {
+      if (to)
+	zlog_debug ("update routes to neighbor %s", inet_ntoa (to->sin_addr));
+      else
+	zlog_debug ("update routes on interface %s ifindex %d",
+		   ifc->ifp->name, ifc->ifp->ifindex);
+    }
+
+  if (route_type == rip_changed_route)
+    {
+      stream_reset (rip->tbuf);
+      num = rip_output_encode (ifc, version, route_type, rip->tbuf);
+      rip_output_send (ifc, to, version, rip->tbuf, num);
+      return;
+    }
+
+  cache = rip_output_cache_get (ifc, version);
+  if (cache->gen != rip_output_gen)
+    {
+      stream_reset (cache->rte);
+      cache->num = rip_output_encode (ifc, version, route_type, cache->rte);
+      cache->gen = rip_output_gen;
+    }
+  rip_output_send (ifc, to, version, cache->rte, cache->num);
+}
+
 /* Send RIP packet to the interface. */
 static void
 rip_update_interface (struct connected *ifc, u_char version, int route_type)
@@ -2648,23 +2775,30 @@ rip_update (struct thread *t)
   return 0;
 }
 
-/* Walk down the RIP routing table then clear changed flag. */
+/* Walk down the changed routes then clear changed flag. */
 static void
 rip_clear_changed_flag (void)
 {
+  struct route_node *rn;
   struct route_node *rp;
   struct rip_info *rinfo = NULL;
   struct list *list = NULL;
   struct listnode *listnode = NULL;
 
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
-    if ((list = rp->info) != NULL)
-      for (ALL_LIST_ELEMENTS_RO (list, listnode, rinfo))
-        {
-          UNSET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
-          /* This flag can be set only on the first entry. */
-          break;
-        }
+  for (rn = route_top (rip->changed); rn; rn = route_next (rn))
+    if ((rp = rn->info) != NULL)
+      {
+        if ((list = rp->info) != NULL)
+          for (ALL_LIST_ELEMENTS_RO (list, listnode, rinfo))
+            {
+              UNSET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+              /* This flag can be set only on the first entry. */
+              break;
+            }
+        route_unlock_node (rp);
+        rn->info = NULL;
+        route_unlock_node (rn);
+      }
 }
 
 /* Triggered update interval timer. */
@@ -2747,7 +2881,7 @@ rip_redistribute_withdraw (int type)
 	    RIP_TIMER_ON (rinfo->t_garbage_collect, 
 			  rip_garbage_collect, rip->garbage_time);
 	    RIP_TIMER_OFF (rinfo->t_timeout);
-	    rinfo->flags |= RIP_RTF_CHANGED;
+	    rip_route_changed (rp, rinfo);
 
 	    if (IS_RIP_DEBUG_EVENT) {
               struct prefix_ipv4 *p = (struct prefix_ipv4 *) &rp->p;
@@ -2780,9 +2914,11 @@ rip_create (void)
   rip->table = route_table_init ();
   rip->route = route_table_init ();
   rip->neighbor = route_table_init ();
+  rip->changed = route_table_init ();
 
   /* Make output stream. */
   rip->obuf = stream_new (1500);
+  rip->tbuf = stream_new (RIP_MAX_RTE * RIP_RTE_SIZE);
 
   /* Make socket. */
   rip->sock = rip_create_socket (NULL);
@@ -3073,6 +3209,7 @@ DEFUN (rip_default_metric,
     {
       rip->default_metric = atoi (argv[0]);
       /* rip_update_default_metric (); */
+      rip_output_cache_flush ();
     }
   return CMD_SUCCESS;
 }
@@ -3088,6 +3225,7 @@ DEFUN (no_rip_default_metric,
     {
       rip->default_metric = RIP_DEFAULT_METRIC_DEFAULT;
       /* rip_update_default_metric (); */
+      rip_output_cache_flush ();
     }
   return CMD_SUCCESS;
 }
@@ -3474,7 +3612,7 @@ rip_ecmp_disable (void)
         rip_zebra_ipv4_add (rp);
 
         /* Set the route change flag. */
-        SET_FLAG (rinfo->flags, RIP_RTF_CHANGED);
+        rip_route_changed (rp, rinfo);
 
         /* Signal the output process to trigger an update. */
         rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -3907,6 +4045,8 @@ rip_distribute_update (struct distribute *dist)
     }
   else
     ri->prefix[RIP_FILTER_OUT] = NULL;
+
+  rip_output_cache_flush ();
 }
 
 void
@@ -3949,6 +4089,9 @@ rip_clean (void)
 
   if (rip)
     {
+      /* Release the routes queued for a triggered update. */
+      rip_clear_changed_flag ();
+
       /* Clear RIP routes */
       for (rp = route_top (rip->table); rp; rp = route_next (rp))
         if ((list = rp->info) != NULL)
@@ -4014,6 +4157,8 @@ rip_clean (void)
       XFREE (MTYPE_ROUTE_TABLE, rip->table);
       XFREE (MTYPE_ROUTE_TABLE, rip->route);
       XFREE (MTYPE_ROUTE_TABLE, rip->neighbor);
+      route_table_finish (rip->changed);
+      stream_free (rip->tbuf);
       
       XFREE (MTYPE_RIP, rip);
       rip = NULL;
@@ -4086,6 +4231,8 @@ rip_if_rmap_update (struct if_rmap *if_rmap)
     }
   else
     ri->routemap[RIP_FILTER_OUT] = NULL;
+
+  rip_output_cache_flush ();
 }
 
 void
@@ -4112,6 +4259,7 @@ rip_routemap_update_redistribute (void)
 	      route_map_lookup_by_name (rip->route_map[i].name);
 	}
     }
+  rip_output_cache_flush ();
 }
 
 /* ARGSUSED */
@@ -4127,6 +4275,14 @@ rip_routemap_update (const char *notused)
   rip_routemap_update_redistribute ();
 }
 
+/* A route-map changed its rules, re-evaluate the output policy. */
+/* ARGSUSED */
+static void
+rip_routemap_event (route_map_event_t event, const char *notused)
+{
+  rip_output_cache_flush ();
+}
+
 /* Allocate new rip structure and set default value. */
 void
 rip_init (void)
@@ -4195,6 +4351,7 @@ rip_init (void)
 
   route_map_add_hook (rip_routemap_update);
   route_map_delete_hook (rip_routemap_update);
+  route_map_event_hook (rip_routemap_event);
 
   if_rmap_init (RIP_NODE);
   if_rmap_hook_add (rip_if_rmap_update);
@@ -107,6 +107,9 @@ struct rip
   /* Output buffer of RIP. */
   struct stream *obuf;
 
+  /* RTEs of the triggered update being sent. */
+  struct stream *tbuf;
+
   /* RIP routing information base. */
   struct route_table *table;
 
@@ -115,6 +118,10 @@ struct rip
   
   /* RIP neighbor. */
   struct route_table *neighbor;
+
+  /* Routes changed since the last triggered update, the info of each
+     node is the locked node of the route in table. */
+  struct route_table *changed;
   
   /* RIP threads. */
   struct thread *t_read;
@@ -296,6 +303,20 @@ struct rip_interface
 
   /* Passive interface. */
   int passive;
+
+  /* Cached full updates, struct rip_output_cache. */
+  struct list *output_cache;
+};
+
+/* RTEs of the full update sent from one interface address with one
+   RIP version, valid while gen matches the output generation. */
+struct rip_output_cache
+{
+  struct prefix address;
+  u_char version;
+  u_int32_t gen;
+  int num;
+  struct stream *rte;
 };
 
 /* RIP peer information. */
@@ -409,6 +430,8 @@ extern void rip_zebra_ipv4_delete (struct route_node *);
 extern void rip_interface_multicast_set (int, struct connected *);
 extern void rip_distribute_update_interface (struct interface *);
 extern void rip_if_rmap_update_interface (struct interface *);
+extern void rip_output_cache_flush (void);
+extern void rip_output_cache_free (struct rip_interface *);
 
 extern int config_write_rip_network (struct vty *, int);
 extern int config_write_rip_offset_list (struct vty *);
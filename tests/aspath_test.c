@@ -1311,6 +1311,7 @@ handle_attr_test (struct aspath_tests *t)
     }
 
 out:
+  bgp_attr_cache_flush (&peer);
   if (attr.aspath)
     aspath_unintern (&attr.aspath);
   if (asp)
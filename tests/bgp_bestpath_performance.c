@@ -0,0 +1,303 @@
+/*
+ * BGP best path selection performance test.
+ *
+ * Fills a table with prefixes learnt from a number of peers, then has
+ * bgp_process run best path selection over all of them, with the path
+ * comparisons done by 1, 2, 4, ... threads.  Prints the time each run
+ * took and its speedup over the single threaded run, and checks that
+ * all runs select the same paths.  With -P, bgp pic is on, and the
+ * backup paths are selected as well.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#define REALLY_NEED_PLAIN_GETOPT 1
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "workpool.h"
+#include "sockunion.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_mpath.h"
+
+#define TEST_PEERS	8
+#define TEST_PREFIXES	100000
+#define TEST_THREADS	8
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static struct bgp *
+test_bgp_new (void)
+{
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  bgp = XCALLOC (MTYPE_BGP, sizeof (struct bgp));
+  bgp_lock (bgp);
+  bgp->peer = list_new ();
+  bgp->group = list_new ();
+  bgp->rsclient = list_new ();
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+        bgp->rib[afi][safi] = bgp_table_init (afi, safi);
+        bgp->maxpaths[afi][safi].maxpaths_ebgp = 4;
+        bgp->maxpaths[afi][safi].maxpaths_ibgp = BGP_DEFAULT_MAXPATHS;
+      }
+
+  bgp->default_local_pref = BGP_DEFAULT_LOCAL_PREF;
+  bgp->as = 65000;
+  bgp_flag_set (bgp, BGP_FLAG_ASPATH_MULTIPATH_RELAX);
+
+  return bgp;
+}
+
+static struct peer *
+test_peer_new (struct bgp *bgp, int i)
+{
+  struct peer *peer;
+  char addr[INET_ADDRSTRLEN];
+
+  snprintf (addr, sizeof (addr), "10.0.0.%d", i + 1);
+
+  peer = XCALLOC (MTYPE_BGP_PEER, sizeof (struct peer));
+  peer->bgp = bgp;
+  peer->lock = 1;
+  peer->sort = BGP_PEER_EBGP;
+  peer->as = 65001 + i;
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, addr);
+  peer->su_remote = sockunion_str2su (addr);
+  inet_aton (addr, &peer->remote_id);
+  peer->status = Established;
+
+  return peer;
+}
+
+/* The paths of a prefix mostly tie on the first few steps, so that
+   selection goes down to the later ones. */
+static struct attr *
+test_attr (struct peer *peer, int i, int n)
+{
+  struct attr attr;
+  char path[64];
+
+  memset (&attr, 0, sizeof (attr));
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.nexthop = peer->remote_id;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+
+  if ((n + i) % 7 == 0)
+    snprintf (path, sizeof (path), "%u 65100 65200 %u", peer->as, 65300 + n % 50);
+  else
+    snprintf (path, sizeof (path), "%u 65100 %u", peer->as, 65300 + n % 50);
+  attr.aspath = aspath_str2aspath (path);
+
+  attr.med = (n + i) % 3;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+
+  return bgp_attr_intern (&attr);
+}
+
+static void
+test_fill (struct bgp *bgp, struct peer **peers, int npeers, int nprefixes)
+{
+  struct bgp_table *table = bgp->rib[AFI_IP][SAFI_UNICAST];
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct prefix p;
+  int i, n;
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+
+  for (n = 0; n < nprefixes; n++)
+    {
+      p.u.prefix4.s_addr = htonl (0x10000000 + (n << 8));
+      rn = bgp_node_get (table, &p);
+
+      for (i = 0; i < npeers; i++)
+        {
+          ri = XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+          ri->type = ZEBRA_ROUTE_BGP;
+          ri->sub_type = BGP_ROUTE_NORMAL;
+          ri->peer = peers[i];
+          ri->attr = test_attr (peers[i], i, n);
+          ri->uptime = bgp_clock ();
+          SET_FLAG (ri->flags, BGP_INFO_VALID);
+          bgp_info_add (rn, ri, SAFI_UNICAST);
+        }
+      bgp_unlock_node (rn);
+    }
+}
+
+/* Queue all nodes and run the process queue until they are done. */
+static unsigned long
+test_run (struct bgp *bgp)
+{
+  struct bgp_table *table = bgp->rib[AFI_IP][SAFI_UNICAST];
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct thread thread;
+  struct timeval start, stop;
+
+  /* Start over, as on initial convergence. */
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    for (ri = rn->info; ri; ri = ri->next)
+      UNSET_FLAG (ri->flags, BGP_INFO_SELECTED);
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    if (rn->info)
+      bgp_process (bgp, rn, AFI_IP, SAFI_UNICAST);
+
+  /* Don't count the hold time of the work queue. */
+  bm->process_main_queue->spec.hold = 0;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  while (bm->process_main_head && thread_fetch (master, &thread))
+    thread_call (&thread);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop);
+
+  return (stop.tv_sec - start.tv_sec) * 1000000
+         + (stop.tv_usec - start.tv_usec);
+}
+
+static int
+test_check (struct bgp *bgp, struct bgp_info **selected, int record)
+{
+  struct bgp_table *table = bgp->rib[AFI_IP][SAFI_UNICAST];
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  int n = 0, failed = 0;
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    {
+      if (! rn->info)
+        continue;
+
+      for (ri = rn->info; ri; ri = ri->next)
+        if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+          break;
+
+      if (record)
+        selected[n] = ri;
+      else if (selected[n] != ri)
+        failed++;
+      n++;
+    }
+  return failed;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct bgp *bgp;
+  struct peer *peers[TEST_PEERS];
+  struct bgp_info **selected;
+  int opt, i, threads, failed;
+  int nprefixes = TEST_PREFIXES;
+  int maxthreads = TEST_THREADS;
+  int pic = 0;
+  unsigned long usecs, usecs1 = 0;
+
+  while ((opt = getopt (argc, argv, "p:t:P")) != -1)
+    {
+      switch (opt)
+        {
+        case 'p':
+          nprefixes = atoi (optarg);
+          break;
+        case 't':
+          maxthreads = atoi (optarg);
+          break;
+        case 'P':
+          pic = 1;
+          break;
+        default:
+          fprintf (stderr, "Usage: %s [-p <prefixes>] [-t <threads>] [-P]\n",
+                   argv[0]);
+          exit (1);
+        }
+    }
+
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_FIB);
+  bgp_attr_init ();
+
+  bgp = test_bgp_new ();
+  if (pic)
+    bgp_flag_set (bgp, BGP_FLAG_PIC);
+  for (i = 0; i < TEST_PEERS; i++)
+    peers[i] = test_peer_new (bgp, i);
+  test_fill (bgp, peers, TEST_PEERS, nprefixes);
+
+  selected = XCALLOC (MTYPE_TMP, nprefixes * sizeof (struct bgp_info *));
+
+  failed = 0;
+  for (threads = 1; threads <= maxthreads; threads *= 2)
+    {
+      if (bm->process_pool)
+        work_pool_free (bm->process_pool);
+      bm->process_threads = threads;
+      bm->process_pool = work_pool_new ("bgp_best_compare", threads);
+
+      usecs = test_run (bgp);
+      if (threads == 1)
+        {
+          usecs1 = usecs;
+          test_check (bgp, selected, 1);
+        }
+      else
+        failed += test_check (bgp, selected, 0);
+
+      printf ("%d prefixes from %d peers, %d threads: %lu.%03lu ms, "
+              "speedup %.2f\n", nprefixes, TEST_PEERS, threads,
+              usecs / 1000, usecs % 1000,
+              usecs ? (double) usecs1 / usecs : 0.0);
+    }
+
+  if (failed)
+    printf ("%d prefixes selected differently.\n", failed);
+
+  XFREE (MTYPE_TMP, selected);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * BGP checkpoint test.
+ * Writes a checkpoint of a table, restores from it and checks which
+ * routes bgp_checkpoint_fib_update finds to be in the FIB already.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "zclient.h"
+#include "thread.h"
+#include "sockunion.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_checkpoint.h"
+
+#include "bgp_test.h"
+
+#define TEST_PREFIXES	2000
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static char path[] = "/tmp/testbgpcheckpoint.XXXXXX";
+
+static struct bgp_info *
+test_info_new (struct bgp_node *rn, struct peer *peer, afi_t afi)
+{
+  struct bgp_info *ri;
+  struct attr attr;
+  struct attr_extra *extra;
+
+  memset (&attr, 0, sizeof (attr));
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.nexthop = peer->su.sin.sin_addr;
+  if (afi == AFI_IP6)
+    {
+      extra = bgp_attr_extra_get (&attr);
+      extra->mp_nexthop_len = 16;
+      inet_pton (AF_INET6, "2001:db8::1", &extra->mp_nexthop_global);
+      extra->mp_nexthop_global.s6_addr[15] =
+        ntohl (peer->su.sin.sin_addr.s_addr) & 0xff;
+    }
+
+  ri = XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+  ri->type = ZEBRA_ROUTE_BGP;
+  ri->sub_type = BGP_ROUTE_NORMAL;
+  ri->peer = peer;
+  ri->attr = bgp_attr_intern (&attr);
+  bgp_attr_extra_free (&attr);
+  SET_FLAG (ri->flags, BGP_INFO_VALID);
+  bgp_info_add (rn, ri, SAFI_UNICAST);
+  return ri;
+}
+
+/* /24s with some covering /20s and /32s inside them, and some IPv6
+   prefixes, each with a path from both peers. */
+static void
+test_fill (struct bgp *bgp, struct peer **peers)
+{
+  struct bgp_node *rn;
+  struct prefix p;
+  int n;
+
+  for (n = 0; n < TEST_PREFIXES; n++)
+    {
+      memset (&p, 0, sizeof (p));
+      if (n % 10 == 9)
+        {
+          p.family = AF_INET6;
+          p.prefixlen = 48 + n % 17;
+          inet_pton (AF_INET6, "2001:db8::", &p.u.prefix6);
+          p.u.prefix6.s6_addr[2] = n >> 8;
+          p.u.prefix6.s6_addr[3] = n;
+          apply_mask (&p);
+          rn = bgp_node_get (bgp->rib[AFI_IP6][SAFI_UNICAST], &p);
+          if (! rn->info)
+            {
+              test_info_new (rn, peers[0], AFI_IP6);
+              test_info_new (rn, peers[1], AFI_IP6);
+            }
+          bgp_unlock_node (rn);
+          continue;
+        }
+
+      p.family = AF_INET;
+      p.prefixlen = 24;
+      p.u.prefix4.s_addr = htonl (0x10000000 + (n << 8));
+      if (n % 16 == 0)
+        p.prefixlen = 20;
+      else if (n % 7 == 0)
+        {
+          p.prefixlen = 32;
+          p.u.prefix4.s_addr |= htonl (n % 256);
+        }
+      rn = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+      if (! rn->info)
+        {
+          test_info_new (rn, peers[0], AFI_IP);
+          test_info_new (rn, peers[1], AFI_IP);
+        }
+      bgp_unlock_node (rn);
+    }
+}
+
+/* Select the path of peer 0, or of peer 1 for every fifth prefix if
+   change is set. */
+static void
+test_select (struct bgp *bgp, int change)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  afi_t afi;
+  int n = 0;
+
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if ((ri = rn->info) != NULL)
+        {
+          UNSET_FLAG (ri->flags, BGP_INFO_SELECTED);
+          UNSET_FLAG (ri->next->flags, BGP_INFO_SELECTED);
+          if (change && n % 5 == 0)
+            ri = ri->next;
+          SET_FLAG (ri->flags, BGP_INFO_SELECTED);
+          n++;
+        }
+}
+
+static struct bgp_info *
+test_selected (struct bgp_node *rn)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      return ri;
+  return NULL;
+}
+
+/* Restore from the checkpoint, with the FIB holding the routes of all
+   prefixes, as OVSDB finds them in the Route table. */
+static void
+test_init_fib (struct bgp *bgp)
+{
+  struct bgp_node *rn;
+  afi_t afi;
+
+  bgp_checkpoint_init (path);
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if (rn->info)
+        bgp_checkpoint_adopt (&rn->p, SAFI_UNICAST);
+}
+
+/* Does fib_update find the route to be in the FIB, for every fifth or
+   tenth prefix in table order or for the others? */
+static int
+test_restore (struct bgp *bgp, int every, int expect)
+{
+  struct bgp_node *rn;
+  afi_t afi;
+  int n = 0, failed = 0, ret;
+
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if (rn->info)
+        {
+          ret = bgp_checkpoint_fib_update (bgp, rn, afi, SAFI_UNICAST,
+                                           test_selected (rn));
+          if (ret != (n % every == 0 ? expect : ! expect))
+            failed++;
+
+          /* A route is only left alone the first time. */
+          if (bgp_checkpoint_fib_update (bgp, rn, afi, SAFI_UNICAST,
+                                         test_selected (rn)))
+            failed++;
+          n++;
+        }
+  return failed;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct bgp *bgp;
+  struct peer *peers[2];
+  struct bgp_node *rn, *extra;
+  struct bgp_info *ri;
+  struct prefix p;
+  afi_t afi;
+  int fd, n, failed;
+
+  bgp = test_bgp_init ();
+  peers[0] = test_peer (bgp, "10.0.0.1", 201);
+  peers[1] = test_peer (bgp, "10.0.0.2", 202);
+  test_fill (bgp, peers);
+  test_select (bgp, 0);
+
+  fd = mkstemp (path);
+  close (fd);
+  unlink (path);
+
+  bgp_checkpoint_init (path);
+  test_result ("checkpoint write", bgp_checkpoint_write () == 0);
+
+  /* Nothing changes, all routes are in the FIB already. */
+  bgp_checkpoint_finish ();
+  test_init_fib (bgp);
+  test_result ("restore unchanged", test_restore (bgp, 1, 1) == 0);
+
+  /* Nothing is known to be in the FIB, as when zebra restarted too:
+     every route is installed again. */
+  bgp_checkpoint_finish ();
+  bgp_checkpoint_init (path);
+  test_result ("restore without fib", test_restore (bgp, 1, 0) == 0);
+
+  /* The FIB changes for every tenth prefix after the checkpoint was
+     written, then bgpd goes away. */
+  bgp_checkpoint_finish ();
+  unlink (path);
+  bgp_checkpoint_init (path);
+  bgp_checkpoint_write ();
+  n = 0;
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if (rn->info && n++ % 10 == 0)
+        bgp_checkpoint_fib_update (bgp, rn, afi, SAFI_UNICAST,
+                                   test_selected (rn));
+  bgp_checkpoint_finish ();
+  test_init_fib (bgp);
+  test_result ("restore dirty", test_restore (bgp, 10, 0) == 0);
+
+  /* bgpd goes away again while restoring, after every tenth prefix was
+     withdrawn, some of them after being found in the FIB first. */
+  bgp_checkpoint_finish ();
+  unlink (path);
+  bgp_checkpoint_init (path);
+  bgp_checkpoint_write ();
+  bgp_checkpoint_finish ();
+  test_init_fib (bgp);
+  n = 0;
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if (rn->info)
+        {
+          if (n % 20 == 0)
+            bgp_checkpoint_fib_update (bgp, rn, afi, SAFI_UNICAST,
+                                       test_selected (rn));
+          if (n % 10 == 0)
+            bgp_checkpoint_fib_update (bgp, rn, afi, SAFI_UNICAST, NULL);
+          n++;
+        }
+  bgp_checkpoint_finish ();
+  test_init_fib (bgp);
+  test_result ("restore crashed", test_restore (bgp, 10, 0) == 0);
+
+  /* Every fifth prefix selects another path after the restart. */
+  bgp_checkpoint_finish ();
+  unlink (path);
+  bgp_checkpoint_init (path);
+  bgp_checkpoint_write ();
+  bgp_checkpoint_finish ();
+  test_select (bgp, 1);
+  test_init_fib (bgp);
+  test_result ("restore changed", test_restore (bgp, 5, 0) == 0);
+
+  /* A route the checkpoint does not have goes into the FIB, after the
+     checkpoint was written or while restoring from it.  Without OVSDB
+     such a checkpoint is not restored from. */
+  str2prefix ("10.255.0.0/16", &p);
+  extra = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+  ri = test_info_new (extra, peers[0], AFI_IP);
+  failed = 0;
+  for (n = 0; n < 2; n++)
+    {
+      bgp_checkpoint_finish ();
+      unlink (path);
+      bgp_checkpoint_init (path);
+      UNSET_FLAG (ri->flags, BGP_INFO_SELECTED);
+      bgp_checkpoint_write ();
+      if (n == 1)
+        {
+          bgp_checkpoint_finish ();
+          bgp_checkpoint_init (path);
+        }
+      SET_FLAG (ri->flags, BGP_INFO_SELECTED);
+      bgp_checkpoint_fib_update (bgp, extra, AFI_IP, SAFI_UNICAST,
+                                 test_selected (extra));
+      bgp_checkpoint_finish ();
+      test_init_fib (bgp);
+      failed += test_restore (bgp, 1, 0);
+    }
+  bgp_unlock_node (extra);
+  test_result ("restore incomplete", failed == 0);
+
+  /* A truncated checkpoint is not restored from. */
+  bgp_checkpoint_finish ();
+  truncate (path, 100);
+  test_init_fib (bgp);
+  failed = test_restore (bgp, 1, 0);
+  bgp_checkpoint_finish ();
+  test_result ("restore truncated", failed == 0);
+
+  unlink (path);
+  return test_failed;
+}
@@ -0,0 +1,256 @@
+/*
+ * BGP packet test.
+ * Feeds several messages to bgp_read in one buffer and checks that the
+ * FSM has acted upon each one before the next is parsed.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <poll.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "zclient.h"
+#include "thread.h"
+#include "sockunion.h"
+#include "network.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_io.h"
+
+#include "bgp_test.h"
+
+#define MARKER \
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, \
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+/* From AS 300, hold time 180, identifier 10.0.0.3, no capabilities. */
+static const u_char open_msg[] =
+{
+  MARKER, 0, 29, BGP_MSG_OPEN,
+  BGP_VERSION_4, 1, 44, 0, 180, 10, 0, 0, 3, 0,
+};
+
+static const u_char keepalive[] =
+{
+  MARKER, 0, 19, BGP_MSG_KEEPALIVE,
+};
+
+/* 192.0.2.0/24 from AS 200, next hop 10.0.0.2. */
+static const u_char update[] =
+{
+  MARKER, 0, 45, BGP_MSG_UPDATE,
+  0, 0,
+  0, 18,
+  0x40, BGP_ATTR_ORIGIN, 1, BGP_ORIGIN_IGP,
+  0x40, BGP_ATTR_AS_PATH, 4, AS_SEQUENCE, 1, 0, 200,
+  0x40, BGP_ATTR_NEXT_HOP, 4, 10, 0, 0, 2,
+  24, 192, 0, 2,
+};
+
+/* IPv4 unicast. */
+static const u_char refresh[] =
+{
+  MARKER, 0, 23, BGP_MSG_ROUTE_REFRESH_NEW,
+  0, AFI_IP, 0, SAFI_UNICAST,
+};
+
+/* Cease, administrative shutdown. */
+static const u_char notify[] =
+{
+  MARKER, 0, 21, BGP_MSG_NOTIFY,
+  BGP_NOTIFY_CEASE, BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN,
+};
+
+/* The peer's end of the last connection made. */
+static int test_remote = -1;
+
+static int
+test_timer (struct thread *thread)
+{
+  return 0;
+}
+
+/* Hand the peer a new connection, on which msgs are waiting. */
+static void
+test_connect (struct peer *peer, int status, const u_char *msgs[],
+              const size_t sizes[])
+{
+  u_char buf[BGP_MAX_PACKET_SIZE];
+  size_t len = 0;
+  int fds[2];
+  int i;
+
+  for (i = 0; msgs[i]; i++)
+    {
+      memcpy (buf + len, msgs[i], sizes[i]);
+      len += sizes[i];
+    }
+
+  assert (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  assert (write (fds[1], buf, len) == (ssize_t) len);
+  set_nonblocking (fds[0]);
+  set_nonblocking (fds[1]);
+  test_remote = fds[1];
+
+  BGP_READ_OFF (peer->t_read);
+  bgp_io_stop (peer);
+  peer->fd = fds[0];
+  peer->status = status;
+  peer->afc_nego[AFI_IP][SAFI_UNICAST] = 1;
+  stream_reset (peer->ibuf_work);
+  assert (bgp_io_start (peer) == 0);
+}
+
+/* Read what is waiting, once the reader has handed it over, and run
+   the events that raises. */
+static void
+test_read (struct peer *peer)
+{
+  struct thread thread;
+  struct pollfd pfd;
+
+  pfd.fd = bgp_io_fd (peer);
+  pfd.events = POLLIN;
+  assert (poll (&pfd, 1, 5000) == 1);
+
+  BGP_READ_OFF (peer->t_read);
+  memset (&thread, 0, sizeof (thread));
+  thread.arg = peer;
+  thread.u.fd = pfd.fd;
+  bgp_read (&thread);
+
+  while (master->event.count || master->ready.count)
+    if (thread_fetch (master, &thread))
+      thread_call (&thread);
+}
+
+int
+main (void)
+{
+  static const u_char *keepalive_update[] = { keepalive, update, NULL };
+  static const size_t keepalive_update_size[] =
+    { sizeof (keepalive), sizeof (update) };
+  static const u_char *refresh_only[] = { refresh, NULL };
+  static const size_t refresh_only_size[] = { sizeof (refresh) };
+  static const u_char *notify_update[] = { notify, update, NULL };
+  static const size_t notify_update_size[] =
+    { sizeof (notify), sizeof (update) };
+  static const u_char *open_keepalive[] = { open_msg, keepalive, NULL };
+  static const size_t open_keepalive_size[] =
+    { sizeof (open_msg), sizeof (keepalive) };
+  struct bgp *bgp;
+  struct peer *peer, *accept;
+  u_char buf[BGP_MAX_PACKET_SIZE];
+  struct stream *s;
+  u_int32_t update_in;
+  u_int32_t keepalive_out;
+
+  bgp = test_bgp_init ();
+  peer = test_peer (bgp, "10.0.0.2", 200);
+
+  /* The KEEPALIVE takes the session to Established before the UPDATE
+     is looked at, rather than the UPDATE being refused in OpenConfirm. */
+  test_connect (peer, OpenConfirm, keepalive_update, keepalive_update_size);
+  test_read (peer);
+  test_result ("keepalive then update",
+               peer->status == Established && peer->notify_out == 0
+               && peer->update_in == 1);
+
+  /* A keepalive which fell due while the main thread was busy goes out
+     without waiting for its timer to run. */
+  keepalive_out = peer->keepalive_out;
+  BGP_TIMER_OFF (peer->t_keepalive);
+  peer->t_keepalive = thread_add_timer (master, test_timer, peer, 0);
+  bgp_keepalives_send_due ();
+  test_result ("keepalive due",
+               peer->keepalive_out > keepalive_out
+               && stream_fifo_head (peer->obuf) == NULL
+               && peer->t_keepalive
+               && thread_timer_remain_second (peer->t_keepalive) > 0);
+
+  /* It goes out ahead of what is queued for the peer already. */
+  while (read (test_remote, buf, sizeof (buf)) > 0)
+    ;
+  s = stream_new (sizeof (update));
+  stream_put (s, update, sizeof (update));
+  stream_fifo_push (peer->obuf, s);
+  BGP_TIMER_OFF (peer->t_keepalive);
+  peer->t_keepalive = thread_add_timer (master, test_timer, peer, 0);
+  sleep (1);
+  bgp_keepalives_send_due ();
+  test_result ("keepalive ahead of update",
+               read (test_remote, buf, sizeof (buf))
+                 == sizeof (keepalive) + sizeof (update)
+               && ! memcmp (buf, keepalive, sizeof (keepalive))
+               && ! memcmp (buf + sizeof (keepalive), update,
+                            sizeof (update))
+               && stream_fifo_head (peer->obuf) == NULL);
+
+  /* Every message heard from the peer counts for the hold timer. */
+  test_connect (peer, Established, refresh_only, refresh_only_size);
+  peer->readtime = 0;
+  test_read (peer);
+  test_result ("refresh read time",
+               peer->readtime != 0 && peer->refresh_in == 1);
+
+  /* Nothing is parsed after a NOTIFICATION. */
+  update_in = peer->update_in;
+  test_connect (peer, Established, notify_update, notify_update_size);
+  test_read (peer);
+  test_result ("notify then update",
+               peer->status != Established && peer->notify_in == 1
+               && peer->update_in == update_in);
+
+  /* A connection accepted from a configured peer is handed over to it
+     with the Open, and so is the KEEPALIVE read behind the Open. */
+  peer = test_peer (bgp, "10.0.0.3", 300);
+  peer->status = Active;
+  accept = peer_create_accept (bgp);
+  SET_FLAG (accept->sflags, PEER_STATUS_ACCEPT_PEER);
+  accept->su = peer->su;
+  accept->host = XSTRDUP (MTYPE_BGP_PEER_HOST, "10.0.0.3");
+  accept->local_id = peer->local_id;
+  accept->v_holdtime = peer->v_holdtime;
+  accept->v_keepalive = peer->v_keepalive;
+  test_connect (accept, OpenSent, open_keepalive, open_keepalive_size);
+  test_read (accept);
+  test_result ("open then keepalive",
+               peer->status == Established && peer->notify_out == 0);
+
+  printf ("failures: %d\n", test_failed);
+  return test_failed;
+}
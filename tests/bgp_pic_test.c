@@ -0,0 +1,306 @@
+/*
+ * BGP prefix independent convergence test.
+ * Checks which path "bgp pic" keeps as the backup of a prefix, and that
+ * the prefix is moved over to it when the selected path fails, ahead of
+ * best path selection.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "zclient.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "sockunion.h"
+#include "network.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_nexthop.h"
+
+#include "bgp_test.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+extern struct zclient *zlookup;
+
+/* Zebra, as far as the nexthop lookups go: every nexthop is reached
+   over test_igp_gate, at test_igp_metric.  They are only changed while
+   no lookup is under way. */
+static struct in_addr test_igp_gate;
+static u_int32_t test_igp_metric;
+static int test_lookups;
+
+static void *
+test_zebra (void *arg)
+{
+  int sock = *(int *) arg;
+  struct stream *s;
+  struct in_addr addr;
+  u_int16_t length;
+
+  s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  while (1)
+    {
+      stream_reset (s);
+      if (stream_read (s, sock, 2) != 2)
+        break;
+      length = stream_getw (s);
+      if (length < ZEBRA_HEADER_SIZE + 4
+          || stream_read (s, sock, length - 2) != length - 2)
+        break;
+      stream_forward_getp (s, ZEBRA_HEADER_SIZE - 2);
+      addr.s_addr = stream_get_ipv4 (s);
+
+      stream_reset (s);
+      zclient_create_header (s, ZEBRA_IPV4_NEXTHOP_LOOKUP);
+      stream_put_in_addr (s, &addr);
+      stream_putl (s, test_igp_metric);
+      stream_putc (s, 1);
+      stream_putc (s, ZEBRA_NEXTHOP_IPV4);
+      stream_put_in_addr (s, &test_igp_gate);
+      stream_putw_at (s, 0, stream_get_endp (s));
+      __atomic_add_fetch (&test_lookups, 1, __ATOMIC_SEQ_CST);
+      if (writen (sock, STREAM_DATA (s), stream_get_endp (s)) < 0)
+        break;
+    }
+  stream_free (s);
+  return NULL;
+}
+
+/* Up, but without anything negotiated to be announced to it. */
+static struct peer *
+test_peer_up (struct bgp *bgp, const char *addr, as_t as)
+{
+  struct peer *peer;
+
+  peer = test_peer (bgp, addr, as);
+  peer->status = Established;
+  peer->su_remote = sockunion_dup (&peer->su);
+  return peer;
+}
+
+/* Learn the prefix from the peer, over the AS path and nexthop. */
+static struct bgp_info *
+test_update (struct peer *peer, struct prefix *p, const char *path,
+             const char *nexthop)
+{
+  struct attr attr;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+
+  memset (&attr, 0, sizeof (attr));
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  aspath_unintern (&attr.aspath);
+  attr.aspath = aspath_intern (aspath_str2aspath (path));
+  inet_aton (nexthop, &attr.nexthop);
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+
+  bgp_update (peer, p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+              BGP_ROUTE_NORMAL, NULL, NULL, 0);
+  bgp_attr_unintern_sub (&attr);
+  bgp_attr_extra_free (&attr);
+
+  rn = bgp_node_lookup (peer->bgp->rib[AFI_IP][SAFI_UNICAST], p);
+  bgp_unlock_node (rn);
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer)
+      return ri;
+  return NULL;
+}
+
+/* Run the work queues until the condition no longer holds. */
+#define test_run(cond) \
+  do { \
+    struct thread thread; \
+    while ((cond) && thread_fetch (master, &thread)) \
+      thread_call (&thread); \
+  } while (0)
+
+#define SELECTED(ri) CHECK_FLAG ((ri)->flags, BGP_INFO_SELECTED)
+
+/* Run the nexthop scan, which looks up at least one nexthop. */
+static void
+test_scan (void)
+{
+  int lookups = __atomic_load_n (&test_lookups, __ATOMIC_SEQ_CST);
+
+  bgp_scan_now ();
+  test_run (__atomic_load_n (&test_lookups, __ATOMIC_SEQ_CST) == lookups);
+}
+
+int
+main (void)
+{
+  struct bgp *bgp;
+  struct peer *a, *b, *c, *d, *e, *f, *g, *h, *i;
+  struct bgp_info *ra, *rb, *rc, *rd, *re, *rf, *rg, *rh;
+  struct bgp_node *rn;
+  struct prefix p;
+  pthread_t tid;
+  int sv[2];
+
+  bgp = test_bgp_init ();
+  a = test_peer_up (bgp, "10.0.0.1", 201);
+  b = test_peer_up (bgp, "10.0.0.2", 202);
+  c = test_peer_up (bgp, "10.0.0.3", 203);
+
+  /* The path of A is the best, then that of C, which goes over the same
+     nexthop though, and then that of B. */
+  str2prefix ("192.0.2.0/24", &p);
+  ra = test_update (a, &p, "201", "10.0.0.1");
+  rc = test_update (c, &p, "203 300", "10.0.0.1");
+  rb = test_update (b, &p, "202 300 400", "10.0.0.2");
+  rn = ra->net;
+  test_run (bm->process_main_head);
+  test_result ("pic off",
+               SELECTED (ra) && ! SELECTED (rb) && ! SELECTED (rc)
+               && rn->pic_backup == NULL);
+
+  /* Turning bgp pic on picks the backups of the routes there are. */
+  bgp_flag_set (bgp, BGP_FLAG_PIC);
+  bgp_process_all (bgp);
+  test_run (bm->process_main_head);
+  test_result ("pic backup", SELECTED (ra) && rn->pic_backup == rb);
+
+  /* A backup which is down itself is not switched over to. */
+  b->status = Idle;
+  test_result ("pic backup down",
+               ! bgp_pic_switchover (bgp, rn, ra, AFI_IP, SAFI_UNICAST)
+               && SELECTED (ra) && ! SELECTED (rb));
+  b->status = Established;
+
+  test_result ("pic switchover",
+               bgp_pic_switchover (bgp, rn, ra, AFI_IP, SAFI_UNICAST)
+               && ! SELECTED (ra) && SELECTED (rb)
+               && CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED));
+
+  /* Selection catches up, and goes back to A which is still there. */
+  test_run (bm->process_main_head);
+  test_result ("pic selection", SELECTED (ra) && rn->pic_backup == rb);
+
+  /* The node is filed under the peer and nexthop of the path of A. */
+  test_result ("pic index",
+               rn->pic_dep && rn->pic_dep->peer == a
+               && a->pic_deps[AFI_IP][SAFI_UNICAST] == rn->pic_dep
+               && rn->pic_dep->nodes == rn && ! rn->pic_next
+               && ! b->pic_deps[AFI_IP][SAFI_UNICAST]);
+
+  /* Clearing the routes of A as it goes down switches the nodes filed
+     under it over at once, before the clear queue gets to them and
+     before selection runs again. */
+  a->status = Clearing;
+  bgp_clear_route (a, AFI_IP, SAFI_UNICAST, BGP_CLEAR_ROUTE_NORMAL);
+  test_result ("pic peer down",
+               SELECTED (rb) && ! SELECTED (ra) && ! SELECTED (rc)
+               && a->clear_node_queue->items->count
+               && ! rn->pic_dep && ! a->pic_deps[AFI_IP][SAFI_UNICAST]
+               && CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED));
+  test_run (a->clear_node_queue->items->count);
+
+  /* Then C is the best path left, with B its backup. */
+  test_run (bm->process_main_head);
+  test_result ("pic peer down selection",
+               SELECTED (rc) && ! SELECTED (rb) && rn->pic_backup == rb
+               && rn->pic_dep && rn->pic_dep->peer == c);
+
+  /* Without zebra every nexthop is reachable, so the nexthop scan
+     leaves the node be. */
+  bgp_pic_nexthop_scan (bgp, AFI_IP);
+  test_result ("pic nexthop scan",
+               SELECTED (rc) && rn->pic_backup == rb
+               && CHECK_FLAG (rc->flags, BGP_INFO_VALID));
+
+  /* With two multipaths out of three equal paths, the one left over is
+     the backup, rather than the worse path of G. */
+  bgp_flag_set (bgp, BGP_FLAG_ASPATH_MULTIPATH_RELAX);
+  bgp->maxpaths[AFI_IP][SAFI_UNICAST].maxpaths_ebgp = 2;
+  d = test_peer_up (bgp, "10.0.0.4", 204);
+  e = test_peer_up (bgp, "10.0.0.5", 205);
+  f = test_peer_up (bgp, "10.0.0.6", 206);
+  g = test_peer_up (bgp, "10.0.0.7", 207);
+  str2prefix ("198.51.100.0/24", &p);
+  rg = test_update (g, &p, "207 300 400", "10.0.0.7");
+  rd = test_update (d, &p, "204 300", "10.0.0.4");
+  re = test_update (e, &p, "205 300", "10.0.0.5");
+  rf = test_update (f, &p, "206 300", "10.0.0.6");
+  rn = rd->net;
+  test_run (bm->process_main_head);
+  test_result ("pic multipath backup",
+               rn->pic_backup && rn->pic_backup != rg
+               && ! SELECTED (rn->pic_backup)
+               && ! CHECK_FLAG (rn->pic_backup->flags, BGP_INFO_MULTIPATH)
+               && (SELECTED (rd) || SELECTED (re) || SELECTED (rf)));
+
+  /* Now with zebra to look the nexthops up.  The IGP route to the
+     nexthop of the IBGP path of H changes, and the scan marks the path,
+     though bgp pic looked the nexthop up first, on its own. */
+  bgp_scan_init ();
+  thread_cancel (zlookup->t_connect);
+  zlookup->t_connect = NULL;
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0
+      || pthread_create (&tid, NULL, test_zebra, &sv[1]))
+    {
+      printf ("no zebra\n");
+      exit (1);
+    }
+  zlookup->sock = sv[0];
+  inet_aton ("10.1.0.1", &test_igp_gate);
+  test_igp_metric = 10;
+
+  h = test_peer_up (bgp, "10.0.1.1", 100);
+  i = test_peer_up (bgp, "10.0.1.2", 100);
+  str2prefix ("203.0.113.0/24", &p);
+  rh = test_update (h, &p, "", "10.0.1.1");
+  test_update (i, &p, "", "10.0.1.2");
+  rn = rh->net;
+  test_run (bm->process_main_head);
+  test_scan ();
+  test_run (bm->process_main_head);
+  test_result ("pic igp unchanged",
+               SELECTED (rh) && rn->pic_dep && rn->pic_dep->peer == h
+               && ! CHECK_FLAG (rh->flags, BGP_INFO_IGP_CHANGED)
+               && rh->extra && rh->extra->igpmetric == 10);
+
+  inet_aton ("10.1.0.2", &test_igp_gate);
+  test_igp_metric = 20;
+  test_scan ();
+  test_result ("pic igp changed",
+               CHECK_FLAG (rh->flags, BGP_INFO_IGP_CHANGED)
+               && rh->extra->igpmetric == 20);
+
+  printf ("failures: %d\n", test_failed);
+  return test_failed;
+}
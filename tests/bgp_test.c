@@ -0,0 +1,88 @@
+/*
+ * Fixtures shared by the bgpd tests.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "thread.h"
+#include "zclient.h"
+#include "sockunion.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_nexthop.h"
+
+#include "bgp_test.h"
+
+/* The nexthop lookups treat every nexthop as reachable when there is
+   no connection to zebra. */
+extern struct zclient *zlookup;
+
+/* Set up by bgp_route_init, along with the commands. */
+extern struct bgp_table *bgp_distance_table;
+
+int test_failed = 0;
+
+/* Set up bgpd without a listening socket, zebra or a FIB to talk to,
+   and return its default instance, of AS 100. */
+struct bgp *
+test_bgp_init (void)
+{
+  struct bgp *bgp;
+  as_t asn = 100;
+
+  bgp_master_init ();
+  master = bm->master;
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_option_set (BGP_OPT_NO_FIB);
+  bgp_attr_init ();
+  bgp_address_init ();
+  bgp_distance_table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  zlookup = zclient_new ();
+  zlookup->sock = -1;
+
+  if (bgp_get (&bgp, &asn, NULL))
+    {
+      printf ("bgp_get failed\n");
+      exit (1);
+    }
+  return bgp;
+}
+
+/* A configured peer, as by "neighbor ADDR remote-as AS". */
+struct peer *
+test_peer (struct bgp *bgp, const char *addr, as_t as)
+{
+  union sockunion su;
+
+  str2sockunion (addr, &su);
+  peer_remote_as (bgp, &su, &as, AFI_IP, SAFI_UNICAST);
+  return peer_lookup (bgp, &su);
+}
+
+void
+test_result (const char *desc, int ok)
+{
+  printf ("%s: %s\n", desc, ok ? "OK" : "failed");
+  if (! ok)
+    test_failed++;
+}
@@ -24,6 +24,7 @@
 #include <time.h>
 
 #include "checksum.h"
+#include "thread.h"
 
 struct thread_master *master;
 
@@ -504,24 +505,104 @@ in_cksum_rfc(void *parg, int count)
 }
 
 
+/* Bytes checksummed per implementation and size in a throughput run. */
+#define BENCHBYTES (256 * 1024 * 1024)
+
+static unsigned long
+usecs_since (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000
+         + (now.tv_usec - start->tv_usec);
+}
+
+/* Throughput of each implementation, on packet sized buffers up to
+   the largest LSP/LSA sizes. */
+static void
+benchmark (u_char *buffer)
+{
+  static const int sizes[] = { 64, 576, 1500, 9000, 60000 };
+  struct timeval start;
+  unsigned long usecs;
+  volatile u_int16_t sink;
+  int impl, i, n, rounds;
+
+  for (i = 0; i < 60000 + 2; i++)
+    buffer[i] = random ();
+
+  for (impl = 0; impl < CHECKSUM_IMPL_MAX; impl++)
+    {
+      if (checksum_impl_set (impl) < 0)
+        {
+          printf ("%-8s not supported\n", checksum_impl_name (impl));
+          continue;
+        }
+      for (i = 0; i < (int) (sizeof (sizes) / sizeof (sizes[0])); i++)
+        {
+          rounds = BENCHBYTES / sizes[i];
+
+          quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+          for (n = 0; n < rounds; n++)
+            sink = in_cksum (buffer, sizes[i]);
+          usecs = usecs_since (&start);
+          printf ("%-8s in_cksum          %6d bytes: %8.1f MB/s\n",
+                  checksum_impl_name (impl), sizes[i],
+                  usecs ? (double) BENCHBYTES / usecs : 0.0);
+
+          quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+          for (n = 0; n < rounds; n++)
+            sink = fletcher_checksum (buffer, sizes[i] + 2, sizes[i]);
+          usecs = usecs_since (&start);
+          printf ("%-8s fletcher_checksum %6d bytes: %8.1f MB/s\n",
+                  checksum_impl_name (impl), sizes[i],
+                  usecs ? (double) BENCHBYTES / usecs : 0.0);
+        }
+    }
+  (void) sink;
+}
+
 int
 main(int argc, char **argv)
 {
 /* 60017 65629 702179 */
 #define MAXDATALEN 60017
-#define BUFSIZE MAXDATALEN + sizeof(u_int16_t)
-  u_char buffer[BUFSIZE];
+#define BUFSIZE MAXDATALEN + sizeof(u_int16_t) + sizeof (long int)
+  u_char buffer_space[BUFSIZE];
+  u_char *buffer;
   int exercise = 0;
+  int rounds = -1;
+  int impl, opt;
 #define EXERCISESTEP 257
-  
+
+  while ((opt = getopt (argc, argv, "br:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'b':
+          benchmark (buffer_space);
+          exit (0);
+        case 'r':
+          rounds = atoi (optarg);
+          break;
+        default:
+          fprintf (stderr, "Usage: %s [-b] [-r <rounds>]\n", argv[0]);
+          exit (1);
+        }
+    }
+
   srandom (time (NULL));
   
-  while (1) {
+  while (rounds < 0 || rounds-- > 0) {
     u_int16_t ospfd, isisd, lib, in_csum, in_csum_res, in_csum_rfc;
     int i,j;
 
     exercise += EXERCISESTEP;
     exercise %= MAXDATALEN;
+
+    /* Not always on an aligned buffer, as in received packets. */
+    buffer = buffer_space + exercise % sizeof (long int);
     
     for (i = 0; i < exercise; i += sizeof (long int)) {
       long int rand = random ();
@@ -530,56 +611,67 @@ main(int argc, char **argv)
         buffer[i + (sizeof (long int) - j)] = (rand >> (j * 8)) & 0xff;
     }
     
-    in_csum = in_cksum(buffer, exercise);
     in_csum_res = in_cksum_optimized(buffer, exercise);
     in_csum_rfc = in_cksum_rfc(buffer, exercise);
-    if (in_csum_res != in_csum || in_csum != in_csum_rfc)
-      printf ("verify: in_chksum failed in_csum:%x, in_csum_res:%x,"
-	      "in_csum_rfc %x, len:%d\n", 
-	      in_csum, in_csum_res, in_csum_rfc, exercise);
-
     ospfd = ospfd_checksum (buffer, exercise + sizeof(u_int16_t), exercise);
     if (verify (buffer, exercise + sizeof(u_int16_t)))
       printf ("verify: ospfd failed\n");
     isisd = iso_csum_create (buffer, exercise + sizeof(u_int16_t), exercise);
     if (verify (buffer, exercise + sizeof(u_int16_t)))
       printf ("verify: isisd failed\n");
-    lib = fletcher_checksum (buffer, exercise + sizeof(u_int16_t), exercise);
-    if (verify (buffer, exercise + sizeof(u_int16_t)))
-      printf ("verify: lib failed\n");
+
+    for (impl = 0; impl < CHECKSUM_IMPL_MAX; impl++)
+      {
+        if (checksum_impl_set (impl) < 0)
+          continue;
+
+        in_csum = in_cksum(buffer, exercise);
+        if (in_csum_res != in_csum || in_csum != in_csum_rfc)
+          printf ("verify: in_chksum %s failed in_csum:%x, in_csum_res:%x,"
+		  "in_csum_rfc %x, len:%d\n", checksum_impl_name (impl),
+		  in_csum, in_csum_res, in_csum_rfc, exercise);
+
+        lib = fletcher_checksum (buffer, exercise + sizeof(u_int16_t), exercise);
+        if (verify (buffer, exercise + sizeof(u_int16_t)))
+          printf ("verify: lib %s failed\n", checksum_impl_name (impl));
+        if (fletcher_checksum (buffer, exercise + sizeof(u_int16_t),
+                               FLETCHER_CHECKSUM_VALIDATE) != 0)
+          printf ("verify: lib %s validate failed\n", checksum_impl_name (impl));
     
-    if (ospfd != lib) {
-      printf ("Mismatch in values at size %u\n"
-              "ospfd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
-              "isisd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
-              "lib: 0x%04x\n",
-              exercise,
-              ospfd, ospfd_vals.a.c0, ospfd_vals.a.c1, ospfd_vals.x, ospfd_vals.y,
-              isisd, isisd_vals.a.c0, isisd_vals.a.c1, isisd_vals.x, isisd_vals.y,
-              lib
-              );
+        if (ospfd != lib) {
+          printf ("Mismatch in values at size %u, %s\n"
+                  "ospfd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
+                  "isisd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
+                  "lib: 0x%04x\n",
+                  exercise, checksum_impl_name (impl),
+                  ospfd, ospfd_vals.a.c0, ospfd_vals.a.c1, ospfd_vals.x, ospfd_vals.y,
+                  isisd, isisd_vals.a.c0, isisd_vals.a.c1, isisd_vals.x, isisd_vals.y,
+                  lib
+                  );
       
-      /* Investigate reduction phase discrepencies */
-      if (ospfd_vals.a.c0 == isisd_vals.a.c0
-          && ospfd_vals.a.c1 == isisd_vals.a.c1) {
-        printf ("\n");
-        for (i = 0; reducts[i].name != NULL; i++) {	
-          ospfd = reducts[i].f (&ospfd_vals,
-                                exercise + sizeof (u_int16_t),
-                                exercise);
-          printf ("%20s: x: %02x, y %02x, checksum 0x%04x\n",
-                  reducts[i].name, ospfd_vals.x & 0xff, ospfd_vals.y & 0xff, ospfd);
-        }
-      }
+          /* Investigate reduction phase discrepencies */
+          if (ospfd_vals.a.c0 == isisd_vals.a.c0
+              && ospfd_vals.a.c1 == isisd_vals.a.c1) {
+            printf ("\n");
+            for (i = 0; reducts[i].name != NULL; i++) {	
+              ospfd = reducts[i].f (&ospfd_vals,
+                                    exercise + sizeof (u_int16_t),
+                                    exercise);
+              printf ("%20s: x: %02x, y %02x, checksum 0x%04x\n",
+                      reducts[i].name, ospfd_vals.x & 0xff, ospfd_vals.y & 0xff, ospfd);
+            }
+          }
               
-      printf ("\n  u_char testdata [] = {\n  ");
-      for (i = 0; i < exercise; i++) {
-        printf ("0x%02x,%s",
-                buffer[i],
-                (i + 1) % 8 ? " " : "\n  ");
+          printf ("\n  u_char testdata [] = {\n  ");
+          for (i = 0; i < exercise; i++) {
+            printf ("0x%02x,%s",
+                    buffer[i],
+                    (i + 1) % 8 ? " " : "\n  ");
+          }
+          printf ("\n}\n");
+          exit (1);
+        }
       }
-      printf ("\n}\n");
-      exit (1);
-    }
   }
+  return 0;
 }
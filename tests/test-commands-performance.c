@@ -0,0 +1,279 @@
+/*
+ * Test program which measures the time it takes to execute a large
+ * configuration through lib/command.c.
+ *
+ * The command lines are read from stdin in the format of testcommands.in,
+ * or generated as a large configuration of prefix-lists and neighbors.
+ * Every line which executes successfully at some node is replayed until
+ * the requested number of lines has been executed, the way a config
+ * file is loaded.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#define REALLY_NEED_PLAIN_GETOPT 1
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "memory.h"
+#include "thread.h"
+#include "vector.h"
+
+#define EXECUTE_LINES 100000
+
+extern vector cmdvec;
+extern struct cmd_node vty_node;
+extern void test_init_cmd(void); /* provided in test-commands-defun.c */
+
+struct thread_master *master; /* dummy for libzebra*/
+
+struct test_line
+{
+  vector vline;
+  enum node_type node;
+};
+
+static struct cmd_node test_nodes[] =
+{
+  { BGP_NODE, "%s(config-router)# " },
+  { RIP_NODE, "%s(config-router)# " },
+  { INTERFACE_NODE, "%s(config-if)# " },
+  { RMAP_NODE, "%s(config-route-map)# " },
+  { ZEBRA_NODE, "%s(config-router)# " },
+  { BGP_VPNV4_NODE, "%s(config-router-af)# " },
+  { BGP_IPV4_NODE, "%s(config-router-af)# " },
+  { BGP_IPV4M_NODE, "%s(config-router-af)# " },
+  { BGP_IPV6_NODE, "%s(config-router-af)# " },
+  { BGP_IPV6M_NODE, "%s(config-router-af)# " },
+  { OSPF_NODE, "%s(config-router)# " },
+  { RIPNG_NODE, "%s(config-router)# " },
+  { OSPF6_NODE, "%s(config-ospf6)# " },
+  { BABEL_NODE, "%s(config-babel)# " },
+  { KEYCHAIN_NODE, "%s(config-keychain)# " },
+  { KEYCHAIN_KEY_NODE, "%s(config-keychain-key)# " },
+  { ISIS_NODE, "%s(config-router)# " },
+};
+
+static int
+test_callback(struct cmd_element *cmd, struct vty *vty, int argc, const char *argv[])
+{
+  return CMD_SUCCESS;
+}
+
+static void
+test_init(void)
+{
+  unsigned int node;
+  unsigned int i;
+  struct cmd_node *cnode;
+  struct cmd_element *cmd;
+
+  cmd_init(1);
+
+  for (i = 0; i < sizeof(test_nodes) / sizeof(test_nodes[0]); i++)
+    install_node (&test_nodes[i], NULL);
+  install_node (&vty_node, NULL);
+
+  test_init_cmd();
+
+  for (node = 0; node < vector_active(cmdvec); node++)
+    if ((cnode = vector_slot(cmdvec, node)) != NULL)
+      for (i = 0; i < vector_active(cnode->cmd_vector); i++)
+        if ((cmd = vector_slot(cnode->cmd_vector, i)) != NULL)
+          {
+            cmd->daemon = 0;
+            cmd->func = test_callback;
+          }
+  vty_init_vtysh();
+}
+
+/* Read the command lines and find a node each of them executes at. */
+static vector
+test_load(struct vty *vty)
+{
+  char line[4096];
+  vector lines;
+  vector vline;
+  struct test_line *test_line;
+  struct cmd_node *cnode = NULL;
+  unsigned int node;
+
+  lines = vector_init(VECTOR_MIN_SIZE);
+
+  while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+      if (line[0] == '#')
+        continue;
+      if ((vline = cmd_make_strvec(line)) == NULL)
+        continue;
+
+      for (node = 0; node < vector_active(cmdvec); node++)
+        if ((cnode = vector_slot(cmdvec, node)) != NULL)
+          {
+            vty->node = cnode->node;
+            if (cmd_execute_command_strict(vline, vty, NULL) == CMD_SUCCESS)
+              break;
+          }
+
+      if (node == vector_active(cmdvec))
+        {
+          cmd_free_strvec(vline);
+          continue;
+        }
+
+      test_line = XCALLOC(MTYPE_TMP, sizeof(struct test_line));
+      test_line->vline = vline;
+      test_line->node = cnode->node;
+      vector_set(lines, test_line);
+    }
+  return lines;
+}
+
+static void
+test_add(vector lines, enum node_type node, const char *line)
+{
+  struct test_line *test_line;
+
+  test_line = XCALLOC(MTYPE_TMP, sizeof(struct test_line));
+  test_line->vline = cmd_make_strvec(line);
+  test_line->node = node;
+  vector_set(lines, test_line);
+}
+
+/* Generate a configuration of the given number of lines: prefix-lists
+ * of 100 entries each, and BGP neighbors with a description. */
+static vector
+test_generate(unsigned int count)
+{
+  char line[256];
+  vector lines;
+  unsigned int i;
+
+  lines = vector_init(count);
+
+  for (i = 0; i < count; i++)
+    {
+      if (i % 4 == 3)
+        {
+          snprintf(line, sizeof(line), "neighbor 10.%u.%u.%u remote-as %u",
+                   (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff, 64512 + i % 1000);
+          test_add(lines, BGP_NODE, line);
+        }
+      else
+        {
+          snprintf(line, sizeof(line),
+                   "ip prefix-list PL%u seq %u %s 172.%u.%u.0/24 le 32",
+                   i / 100, (i % 100 + 1) * 5, i % 2 ? "deny" : "permit",
+                   16 + ((i >> 8) & 0x0f), i & 0xff);
+          test_add(lines, CONFIG_NODE, line);
+        }
+    }
+  return lines;
+}
+
+int
+main(int argc, char **argv)
+{
+  int opt;
+  struct vty *vty;
+  vector lines;
+  struct test_line *test_line;
+  unsigned int num_lines;
+  unsigned int generate;
+  unsigned int failed;
+  unsigned int i;
+  struct timeval tv_start, tv_stop;
+  unsigned long t_execute;
+
+  num_lines = 0;
+  generate = 0;
+
+  while ((opt = getopt(argc, argv, "g:l:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'g':
+          generate = atoi(optarg);
+          break;
+        case 'l':
+          num_lines = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr, "Usage: %s [-l <lines>] < testcommands.in\n"
+                  "       %s -g <lines> [-l <lines>]\n", argv[0], argv[0]);
+          exit(1);
+          break;
+        }
+    }
+
+  test_init();
+
+  vty = vty_new();
+  vty->type = VTY_TERM;
+
+  if (generate)
+    lines = test_generate(generate);
+  else
+    lines = test_load(vty);
+  if (num_lines == 0)
+    num_lines = generate ? generate : EXECUTE_LINES;
+  if (vector_active(lines) == 0)
+    {
+      fprintf(stderr, "No executable command lines given.\n");
+      exit(1);
+    }
+
+  failed = 0;
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_start);
+
+  for (i = 0; i < num_lines; i++)
+    {
+      test_line = vector_slot(lines, i % vector_active(lines));
+      vty->node = test_line->node;
+      if (cmd_execute_command_strict(test_line->vline, vty, NULL) != CMD_SUCCESS)
+        failed++;
+    }
+
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv_stop);
+
+  t_execute = 1000 * (tv_stop.tv_sec - tv_start.tv_sec);
+  t_execute += (tv_stop.tv_usec - tv_start.tv_usec) / 1000;
+
+  printf("Executing %u lines of %u different commands took %ld.%03ld seconds.\n",
+         num_lines, vector_active(lines), t_execute/1000, t_execute%1000);
+  if (failed)
+    printf("%u lines failed to execute.\n", failed);
+  fflush(stdout);
+
+  for (i = 0; i < vector_active(lines); i++)
+    {
+      test_line = vector_slot(lines, i);
+      cmd_free_strvec(test_line->vline);
+      XFREE(MTYPE_TMP, test_line);
+    }
+  vector_free(lines);
+  vty_close(vty);
+  vty_terminate();
+  cmd_terminate();
+  return failed ? 1 : 0;
+}
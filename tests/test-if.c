@@ -0,0 +1,196 @@
+/*
+ * Interface lookup test.
+ * Checks the hashed name/ifindex lookups and the address index of
+ * lib/if.c against a plain walk of iflist.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "if.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "prng.h"
+
+struct thread_master *master;
+
+#define TEST_IFS	200
+#define TEST_ROUNDS	20000
+
+/* Reference lookups, as lib/if.c did them before it kept indexes. */
+static struct interface *
+ref_lookup_address (struct in_addr src)
+{
+  struct listnode *node, *cnode;
+  struct interface *ifp, *match = NULL;
+  struct connected *c;
+  struct prefix addr;
+  int bestlen = 0;
+
+  addr.family = AF_INET;
+  addr.u.prefix4 = src;
+  addr.prefixlen = IPV4_MAX_BITLEN;
+
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
+      if (c->address && c->address->family == AF_INET &&
+	  prefix_match (CONNECTED_PREFIX(c), &addr) &&
+	  c->address->prefixlen > bestlen)
+	{
+	  bestlen = c->address->prefixlen;
+	  match = ifp;
+	}
+  return match;
+}
+
+static struct interface *
+ref_lookup_exact_address (struct in_addr src)
+{
+  struct listnode *node, *cnode;
+  struct interface *ifp;
+  struct connected *c;
+
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
+      if (c->address && c->address->family == AF_INET &&
+	  IPV4_ADDR_SAME (&c->address->u.prefix4, &src))
+	return ifp;
+  return NULL;
+}
+
+static void
+test_name_index (void)
+{
+  struct interface *ifp[TEST_IFS];
+  struct interface *a, *b;
+  char name[INTERFACE_NAMSIZ];
+  int i;
+
+  for (i = 0; i < TEST_IFS; i++)
+    {
+      snprintf (name, sizeof (name), "eth%d", i);
+      ifp[i] = if_get_by_name (name);
+      if_set_index (ifp[i], i + 1);
+    }
+
+  for (i = 0; i < TEST_IFS; i++)
+    {
+      snprintf (name, sizeof (name), "eth%d", i);
+      assert (if_lookup_by_name (name) == ifp[i]);
+      assert (if_lookup_by_name_len (name, strlen (name)) == ifp[i]);
+      assert (if_lookup_by_index (i + 1) == ifp[i]);
+    }
+  assert (if_lookup_by_name ("eth") == NULL);
+  assert (if_lookup_by_name_len ("eth10", 4) == ifp[1]);
+  assert (if_lookup_by_index (IFINDEX_INTERNAL) == NULL);
+  assert (if_lookup_by_index (TEST_IFS + 1) == NULL);
+
+  /* An interface going away in the kernel keeps its name. */
+  if_set_index (ifp[3], IFINDEX_INTERNAL);
+  assert (if_lookup_by_index (4) == NULL);
+  assert (if_lookup_by_name ("eth3") == ifp[3]);
+
+  /* The kernel reusing an index before we saw it being released. */
+  a = ifp[5];
+  b = ifp[6];
+  if_set_index (b, a->ifindex);
+  assert (if_lookup_by_index (7) == NULL);
+  assert (if_lookup_by_index (a->ifindex) == a);
+  if_delete (a);
+  ifp[5] = NULL;
+  assert (if_lookup_by_name ("eth5") == NULL);
+  assert (if_lookup_by_index (b->ifindex) == b);
+}
+
+static void
+test_address (void)
+{
+  struct prng *prng;
+  struct interface *ifp;
+  struct connected *ifc;
+  struct listnode *node;
+  struct prefix p, d;
+  struct in_addr addr;
+  int i;
+
+  prng = prng_new (0);
+
+  /* A few addresses per interface out of 10.0.0.0/16, with overlapping
+     prefixes of various lengths and some point-to-point peers. */
+  i = 0;
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    {
+      int n;
+
+      for (n = prng_rand (prng) % 4; n > 0; n--)
+	{
+	  memset (&p, 0, sizeof (p));
+	  p.family = AF_INET;
+	  p.u.prefix4.s_addr = htonl (0x0a000000 | (prng_rand (prng) & 0xffff));
+	  p.prefixlen = 16 + prng_rand (prng) % 17;
+
+	  if (++i % 5 == 0)
+	    {
+	      d = p;
+	      d.u.prefix4.s_addr = htonl (0x0a000000 | (prng_rand (prng) & 0xffff));
+	      ifc = connected_add_by_prefix (ifp, &p, &d);
+	      SET_FLAG (ifc->flags, ZEBRA_IFA_PEER);
+	    }
+	  else
+	    connected_add_by_prefix (ifp, &p, NULL);
+	}
+    }
+
+  for (i = 0; i < TEST_ROUNDS; i++)
+    {
+      addr.s_addr = htonl (0x0a000000 | (prng_rand (prng) & 0x1ffff));
+      assert (if_lookup_address (addr) == ref_lookup_address (addr));
+      assert (if_lookup_exact_address (addr) ==
+	      ref_lookup_exact_address (addr));
+
+      /* Now and then move an address around. */
+      if (i % 100 == 0)
+	{
+	  ifp = if_lookup_address (addr);
+	  if (ifp && listhead (ifp->connected))
+	    {
+	      ifc = listgetdata (listhead (ifp->connected));
+	      ifc = connected_delete_by_prefix (ifp, ifc->address);
+	      connected_free (ifc);
+	    }
+	}
+    }
+
+  prng_free (prng);
+}
+
+int
+main (int argc, char **argv)
+{
+  if_init ();
+
+  test_name_index ();
+  printf ("Name and index lookup test passed.\n");
+
+  test_address ();
+  printf ("Address lookup test passed.\n");
+
+  if_terminate ();
+  return 0;
+}
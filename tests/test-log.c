@@ -0,0 +1,228 @@
+/*
+ * Asynchronous logging test.
+ * Logs through the ring of an asynchronous log, from several threads
+ * and into a ring that overflows, and checks what ends up in the log
+ * file.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "log.h"
+
+struct thread_master *master;
+
+#define TEST_THREADS	4
+#define TEST_MESSAGES	20000
+#define TEST_SLOTS	64
+
+static char path[] = "/tmp/testlog.XXXXXX";
+
+struct test_count
+{
+  unsigned long lines;		/* test messages */
+  unsigned long dropped;	/* as reported in the log */
+  int ordered;			/* messages of each thread in order */
+  unsigned long whole;		/* long messages which are not cut short */
+  unsigned long errors;		/* errors logged into a full ring */
+};
+
+/* Count the messages in the log file, which are "<thread> <n>". */
+static void
+test_read (struct test_count *count)
+{
+  long next[TEST_THREADS + 1];
+  char line[4096];
+  unsigned long dropped;
+  int thread, n;
+  char *msg;
+  FILE *fp;
+
+  memset (count, 0, sizeof (*count));
+  memset (next, 0, sizeof (next));
+  count->ordered = 1;
+
+  fp = fopen (path, "r");
+  assert (fp);
+  while (fgets (line, sizeof (line), fp))
+    {
+      if ((msg = strstr (line, "NONE: ")) == NULL)
+	continue;
+      msg += strlen ("NONE: ");
+      if (sscanf (msg, "%lu log messages dropped", &dropped) == 1)
+	count->dropped += dropped;
+      else if (sscanf (msg, "test %d %d", &thread, &n) == 2)
+	{
+	  assert (thread >= 0 && thread <= TEST_THREADS);
+	  if (n < next[thread])
+	    count->ordered = 0;
+	  next[thread] = n + 1;
+	  count->lines++;
+	  if (strstr (msg, "x end\n"))
+	    count->whole++;
+	}
+      else if (sscanf (msg, "error %d", &n) == 1)
+	count->errors++;
+    }
+  fclose (fp);
+}
+
+static void *
+test_thread (void *arg)
+{
+  int thread = (long) arg;
+  int n;
+
+  for (n = 0; n < TEST_MESSAGES; n++)
+    zlog_debug ("test %d %d", thread, n);
+  return NULL;
+}
+
+/* Read the pipe stdout is sent to, once the ring had time to fill. */
+static void *
+test_drain (void *arg)
+{
+  int fd = (long) arg;
+  char buf[4096];
+
+  usleep (100000);
+  while (read (fd, buf, sizeof (buf)) > 0)
+    ;
+  return NULL;
+}
+
+static void
+test_result (const char *desc, int failed)
+{
+  printf ("%s: %s\n", desc, failed ? "failed" : "OK");
+  if (failed)
+    exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  pthread_t tids[TEST_THREADS];
+  struct test_count count;
+  unsigned long slots, dropped, resized, dropped_resized;
+  unsigned long full_dropped, now_dropped;
+  pthread_t drain;
+  int pipefd[2], saved;
+  char pad[2000];
+  long i;
+  int fd;
+
+  fd = mkstemp (path);
+  close (fd);
+
+  zlog_default = openzlog ("testlog", ZLOG_NONE, 0, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+  zlog_set_file (NULL, path, LOG_DEBUG);
+
+  /* Messages of the main thread are all there, in order. */
+  zlog_async_enable (NULL, TEST_SLOTS);
+  for (i = 0; i < TEST_SLOTS / 2; i++)
+    zlog_debug ("test %d %ld", TEST_THREADS, i);
+  zlog_async_flush (NULL);
+  test_read (&count);
+  test_result ("async ordered",
+	       count.lines != TEST_SLOTS / 2 || !count.ordered);
+
+  /* Errors are written out before zlog_err returns. */
+  zlog_err ("test %d %d", TEST_THREADS, TEST_SLOTS);
+  test_read (&count);
+  test_result ("async error", count.lines != TEST_SLOTS / 2 + 1);
+
+  /* Threads overflowing the ring: what is not written out is counted,
+     and reported in the log. */
+  for (i = 0; i < TEST_THREADS; i++)
+    pthread_create (&tids[i], NULL, test_thread, (void *) i);
+  for (i = 0; i < TEST_THREADS; i++)
+    pthread_join (tids[i], NULL);
+  zlog_async_flush (NULL);
+  zlog_async_stats (NULL, &slots, &dropped);
+  test_read (&count);
+  test_result ("async threads",
+	       slots != TEST_SLOTS || !count.ordered
+	       || count.dropped != dropped
+	       || count.lines + dropped
+	          != TEST_SLOTS / 2 + 1 + TEST_THREADS * TEST_MESSAGES);
+
+  /* An error which finds the ring full is not dropped, but written
+     out directly.  The writer is held up on a pipe that is not read,
+     until the ring overflows. */
+  assert (pipe (pipefd) == 0);
+  fflush (stdout);
+  saved = dup (STDOUT_FILENO);
+  dup2 (pipefd[1], STDOUT_FILENO);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, LOG_DEBUG);
+  zlog_async_stats (NULL, &slots, &full_dropped);
+  for (i = 0; zlog_async_stats (NULL, &slots, &now_dropped)
+	      && now_dropped == full_dropped; i++)
+    zlog_debug ("flood %ld", i);
+  pthread_create (&drain, NULL, test_drain, (void *) (long) pipefd[0]);
+  zlog_err ("error %d", TEST_SLOTS);
+  zlog_async_flush (NULL);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  fflush (stdout);
+  dup2 (saved, STDOUT_FILENO);
+  close (saved);
+  close (pipefd[1]);
+  pthread_join (drain, NULL);
+  close (pipefd[0]);
+  test_read (&count);
+  test_result ("async full error", count.errors != 1);
+
+  /* A message longer than a slot is written whole, in its place. */
+  memset (pad, 'x', sizeof (pad) - 1);
+  pad[sizeof (pad) - 1] = '\0';
+  zlog_debug ("test %d %d", TEST_THREADS, TEST_SLOTS + 1);
+  zlog_debug ("test %d %d %s end", TEST_THREADS, TEST_SLOTS + 2, pad);
+  zlog_async_flush (NULL);
+  test_read (&count);
+  test_result ("async long",
+	       count.whole != 1 || !count.ordered
+	       || count.lines + dropped
+	          != TEST_SLOTS / 2 + 3 + TEST_THREADS * TEST_MESSAGES);
+
+  /* The ring is resized, up to its maximum size, and back to the
+     default. */
+  zlog_async_enable (NULL, 2 * ZLOG_ASYNC_SLOTS_MAX);
+  zlog_async_stats (NULL, &resized, &dropped_resized);
+  test_result ("async resize", resized != ZLOG_ASYNC_SLOTS_MAX);
+  zlog_async_enable (NULL, ZLOG_ASYNC_SLOTS);
+  zlog_async_stats (NULL, &resized, &dropped_resized);
+  test_result ("async default", resized != ZLOG_ASYNC_SLOTS);
+
+  /* Nothing is lost going back to synchronous logging. */
+  for (i = 0; i < TEST_SLOTS / 2; i++)
+    zlog_debug ("test %d %ld", TEST_THREADS, TEST_SLOTS + 3 + i);
+  zlog_async_disable (NULL);
+  zlog_debug ("test %d %d", TEST_THREADS, 2 * TEST_SLOTS);
+  test_read (&count);
+  test_result ("async disable",
+	       count.lines + dropped
+	       != TEST_SLOTS + 4 + TEST_THREADS * TEST_MESSAGES
+	       || zlog_async_stats (NULL, &slots, &dropped));
+
+  closezlog (zlog_default);
+  unlink (path);
+  return 0;
+}
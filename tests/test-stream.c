@@ -53,6 +53,7 @@ int
 main (void)
 {
   struct stream *s;
+  struct stream *r;
   
   s = stream_new (1024);
   
@@ -72,5 +73,18 @@ main (void)
   printf ("l: 0x%x\n", stream_getl (s));
   printf ("q: 0x%lx\n", stream_getq (s));
   
+  stream_set_getp (s, 7);
+  stream_pulldown (s);
+  
+  print_stream (s);
+  
+  r = stream_ref (s);
+  stream_forward_getp (r, 4);
+  stream_free (s);
+  
+  print_stream (r);
+  
+  stream_free (r);
+  
   return 0;
 }
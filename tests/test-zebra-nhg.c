@@ -0,0 +1,244 @@
+/*
+ * Kernel nexthop object test.
+ * Interns nexthop groups against a fake kernel and checks that they are
+ * shared, refcounted, replaced and deleted as they should be.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "zebra/zebra_nhg.h"
+
+struct thread_master *master;
+
+#define TEST_IDS	64
+
+/* The objects the fake kernel has, by ID. */
+static int kernel[TEST_IDS];
+static int kernel_refuse;
+static int kernel_replaced;
+
+int
+kernel_nhg_add (struct kernel_nhg *nhg)
+{
+  int i;
+
+  assert (nhg->id < TEST_IDS && ! kernel[nhg->id]);
+  if (kernel_refuse && nhg->members)
+    return -1;
+  if (nhg->members)
+    for (i = 0; i < nhg->count; i++)
+      assert (kernel[nhg->members[i]->id]);
+  kernel[nhg->id] = 1;
+  return 0;
+}
+
+int
+kernel_nhg_replace (struct kernel_nhg *nhg)
+{
+  int i;
+
+  assert (nhg->id < TEST_IDS && kernel[nhg->id] && nhg->members);
+  if (kernel_refuse)
+    return -1;
+  for (i = 0; i < nhg->count; i++)
+    assert (kernel[nhg->members[i]->id]);
+  kernel_replaced++;
+  return 0;
+}
+
+int
+kernel_nhg_delete (struct kernel_nhg *nhg)
+{
+  assert (nhg->id < TEST_IDS);
+  if (! kernel[nhg->id])
+    return -1;
+  kernel[nhg->id] = 0;
+  return 0;
+}
+
+static int
+kernel_count (void)
+{
+  int i, n = 0;
+
+  for (i = 0; i < TEST_IDS; i++)
+    n += kernel[i];
+  return n;
+}
+
+/* Nexthops 10.0.0.<a>, 10.0.0.<b>... on interface 1, ended by 0. */
+static int
+test_nexthops (struct kernel_nhg_member *nh, int a, va_list ap)
+{
+  int count = 0;
+
+  memset (nh, 0, 8 * sizeof (struct kernel_nhg_member));
+  for (; a; a = va_arg (ap, int))
+    {
+      nh[count].family = AF_INET;
+      nh[count].ifindex = 1;
+      nh[count].gate.ipv4.s_addr = htonl (0x0a000000 + a);
+      count++;
+    }
+  return count;
+}
+
+static struct kernel_nhg *
+test_find (int a, ...)
+{
+  struct kernel_nhg_member nh[8];
+  va_list ap;
+  int count;
+
+  va_start (ap, a);
+  count = test_nexthops (nh, a, ap);
+  va_end (ap);
+  return kernel_nhg_find (nh, count);
+}
+
+static struct kernel_nhg *
+test_change (struct kernel_nhg *nhg, int a, ...)
+{
+  struct kernel_nhg_member nh[8];
+  va_list ap;
+  int count;
+
+  va_start (ap, a);
+  count = test_nexthops (nh, a, ap);
+  va_end (ap);
+  return kernel_nhg_change (nhg, nh, count);
+}
+
+static void
+test_result (const char *desc, int ok)
+{
+  printf ("%s: %s\n", desc, ok ? "OK" : "failed");
+  if (! ok)
+    exit (1);
+}
+
+int
+main (void)
+{
+  struct kernel_nhg *ab, *ba, *bc, *aa, *refused, *ab2;
+  struct kernel_nhg *abc, *chg, *ad;
+  u_int32_t a_id, id;
+
+  /* The same nexthops in any order make one group. */
+  ab = test_find (1, 2, 0);
+  ba = test_find (2, 1, 0);
+  test_result ("nhg shared",
+               ab && ab == ba && ab->refcnt == 2 && ab->count == 2
+               && ab->members[0]->refcnt == 1 && kernel_count () == 3);
+
+  /* Members are shared between the groups. */
+  bc = test_find (2, 3, 0);
+  test_result ("nhg members shared",
+               bc && bc != ab && bc->members[0] == ab->members[1]
+               && bc->members[0]->refcnt == 2 && kernel_count () == 5
+               && kernel_nhg_count () == 5);
+
+  /* A single distinct nexthop is not a group. */
+  aa = test_find (1, 1, 0);
+  test_result ("nhg duplicates", aa == NULL && kernel_count () == 5);
+
+  /* What the kernel refuses leaves nothing behind. */
+  kernel_refuse = 1;
+  refused = test_find (4, 5, 0);
+  kernel_refuse = 0;
+  test_result ("nhg refused",
+               refused == NULL && kernel_count () == 5
+               && kernel_nhg_count () == 5);
+
+  /* An object goes with its last reference, and so do its members. */
+  kernel_nhg_release (bc);
+  kernel_nhg_release (ba);
+  test_result ("nhg release",
+               ab->refcnt == 1 && kernel_count () == 3
+               && kernel_nhg_count () == 3);
+
+  /* Once the kernel deleted a member, new routes get a new group. */
+  a_id = ab->members[0]->id;
+  kernel[a_id] = 0;
+  kernel_nhg_invalidate (a_id);
+  ab2 = test_find (1, 2, 0);
+  test_result ("nhg invalidate",
+               ab2 && ab2 != ab && ab2->members[0]->id != a_id
+               && ab2->members[1] == ab->members[1]
+               && ab->invalid && ab->members[0]->invalid
+               && ! ab->members[1]->invalid);
+
+  kernel_nhg_release (ab);
+  kernel_nhg_release (ab2);
+  test_result ("nhg release all",
+               kernel_count () == 0 && kernel_nhg_count () == 0);
+
+  /* The nexthops of the only route using a group change: the group is
+     replaced in place, keeping its ID, and the member it lost goes. */
+  abc = test_find (1, 2, 3, 0);
+  id = abc->id;
+  chg = test_change (abc, 2, 1, 0);
+  test_result ("nhg change in place",
+               chg == abc && chg->id == id && chg->count == 2
+               && chg->refcnt == 1 && kernel_replaced == 1
+               && kernel_count () == 3 && kernel_nhg_count () == 3
+               && test_find (1, 2, 0) == chg && chg->refcnt == 2);
+  kernel_nhg_release (chg);
+
+  /* Nothing to replace if the nexthops in use stay the same. */
+  chg = test_change (abc, 1, 2, 1, 0);
+  test_result ("nhg change same",
+               chg == abc && chg->refcnt == 1 && kernel_replaced == 1);
+
+  /* A group other routes use is left to them. */
+  ab = test_find (1, 2, 0);
+  chg = test_change (abc, 1, 4, 0);
+  test_result ("nhg change shared",
+               chg && chg != abc && abc->refcnt == 2 && chg->refcnt == 1
+               && abc->count == 2 && kernel_replaced == 1
+               && kernel_count () == 5);
+  kernel_nhg_release (ab);
+
+  /* So is a group with the new nexthops there is already. */
+  ad = chg;
+  chg = test_change (abc, 4, 1, 0);
+  test_result ("nhg change existing",
+               chg == ad && ad->refcnt == 2 && abc->refcnt == 1
+               && kernel_replaced == 1);
+  kernel_nhg_release (chg);
+
+  /* What the kernel refuses leaves the group as it was. */
+  kernel_refuse = 1;
+  chg = test_change (abc, 1, 2, 5, 0);
+  kernel_refuse = 0;
+  test_result ("nhg change refused",
+               chg == NULL && abc->count == 2 && abc->refcnt == 1
+               && abc->members[1]->refcnt == 1
+               && kernel_count () == 5 && kernel_nhg_count () == 5
+               && test_find (2, 1, 0) == abc);
+
+  kernel_nhg_release (abc);
+  kernel_nhg_release (abc);
+  kernel_nhg_release (ad);
+  test_result ("nhg change release",
+               kernel_count () == 0 && kernel_nhg_count () == 0);
+
+  return 0;
+}
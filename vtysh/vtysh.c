@@ -1628,6 +1628,47 @@ DEFUNSH (VTYSH_ALL,
   return CMD_SUCCESS;
 }
 
+DEFUNSH (VTYSH_ALL,
+	 vtysh_log_async,
+	 vtysh_log_async_cmd,
+	 "log asynchronous",
+	 "Logging control\n"
+	 "Write syslog, file and stdout logs from a separate thread\n")
+{
+  return CMD_SUCCESS;
+}
+
+DEFUNSH (VTYSH_ALL,
+	 vtysh_log_async_slots,
+	 vtysh_log_async_slots_cmd,
+	 "log asynchronous <64-65536>",
+	 "Logging control\n"
+	 "Write syslog, file and stdout logs from a separate thread\n"
+	 "Number of messages queued before messages are dropped\n")
+{
+  return CMD_SUCCESS;
+}
+
+DEFUNSH (VTYSH_ALL,
+	 no_vtysh_log_async,
+	 no_vtysh_log_async_cmd,
+	 "no log asynchronous",
+	 NO_STR
+	 "Logging control\n"
+	 "Write syslog, file and stdout logs from a separate thread\n")
+{
+  return CMD_SUCCESS;
+}
+
+ALIAS_SH (VTYSH_ALL,
+	  no_vtysh_log_async,
+	  no_vtysh_log_async_slots_cmd,
+	  "no log asynchronous <64-65536>",
+	  NO_STR
+	  "Logging control\n"
+	  "Write syslog, file and stdout logs from a separate thread\n"
+	  "Number of messages queued before messages are dropped\n")
+
 DEFUNSH (VTYSH_ALL,
 	 vtysh_service_password_encrypt,
 	 vtysh_service_password_encrypt_cmd,
@@ -2471,6 +2512,10 @@ vtysh_init_vty (void)
   install_element (CONFIG_NODE, &no_vtysh_log_record_priority_cmd);
   install_element (CONFIG_NODE, &vtysh_log_timestamp_precision_cmd);
   install_element (CONFIG_NODE, &no_vtysh_log_timestamp_precision_cmd);
+  install_element (CONFIG_NODE, &vtysh_log_async_cmd);
+  install_element (CONFIG_NODE, &vtysh_log_async_slots_cmd);
+  install_element (CONFIG_NODE, &no_vtysh_log_async_cmd);
+  install_element (CONFIG_NODE, &no_vtysh_log_async_slots_cmd);
 
   install_element (CONFIG_NODE, &vtysh_service_password_encrypt_cmd);
   install_element (CONFIG_NODE, &no_vtysh_service_password_encrypt_cmd);
@@ -79,6 +79,7 @@ connected_announce (struct interface *ifp, struct connected *ifc)
     return;
   
   listnode_add (ifp->connected, ifc);
+  connected_index_add (ifc);
 
   /* Update interface address information to protocol daemon. */
   if (ifc->address->family == AF_INET)
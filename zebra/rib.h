@@ -81,6 +81,9 @@ struct rib
   u_char nexthop_active_num;
   u_char nexthop_fib_num;
 
+  /* Kernel nexthop group the route is installed with, if any. */
+  struct kernel_nhg *kernel_nhg;
+
 #ifdef ENABLE_OVSDB
    /*
     * Pointer to the uuid fpr the route row in OVSDB
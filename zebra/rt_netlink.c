@@ -40,6 +40,7 @@
 
 #include "zebra/zserv.h"
 #include "zebra/rt.h"
+#include "zebra/zebra_nhg.h"
 #include "zebra/redistribute.h"
 #include "zebra/interface.h"
 #include "zebra/debug.h"
@@ -49,6 +50,15 @@
 #include "eventlog.h"
 #endif
 
+/* Nexthop objects appeared together with RTM_NEWNEXTHOP. */
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+#ifndef RTM_NHA
+#define RTM_NHA(h) \
+  ((struct rtattr *) (((char *) (h)) + NLMSG_ALIGN (sizeof (struct nhmsg))))
+#endif
+#endif /* RTM_NEWNEXTHOP */
+
 /* Socket interface to kernel */
 struct nlsock
 {
@@ -69,6 +79,10 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWADDR,  "RTM_NEWADDR"},
   {RTM_DELADDR,  "RTM_DELADDR"},
   {RTM_GETADDR,  "RTM_GETADDR"},
+#ifdef RTM_NEWNEXTHOP
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+#endif /* RTM_NEWNEXTHOP */
   {0, NULL}
 };
 
@@ -102,7 +116,7 @@ set_ifindex(struct interface *ifp, unsigned int ifi_index)
 	  if_delete_update(oifp);
         }
     }
-  ifp->ifindex = ifi_index;
+  if_set_index (ifp, ifi_index);
 }
 
 #ifndef SO_RCVBUFFORCE
@@ -389,7 +403,11 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 	      if (nl == &netlink_cmd
 		  && ((msg_type == RTM_DELROUTE &&
 		       (-errnum == ENODEV || -errnum == ESRCH))
-		      || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)))
+		      || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)
+#ifdef RTM_NEWNEXTHOP
+		      || (msg_type == RTM_DELNEXTHOP && -errnum == ENOENT)
+#endif /* RTM_NEWNEXTHOP */
+		      ))
 		{
 		  if (IS_ZEBRA_DEBUG_KERNEL)
 		    zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
@@ -403,6 +421,7 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 			nl->name, safe_strerror (-errnum),
 			lookup (nlmsg_str, msg_type),
 			msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+	      errno = -errnum;
               return -1;
             }
 
@@ -1530,6 +1549,10 @@ netlink_link_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
+#ifdef RTM_NEWNEXTHOP
+static int netlink_nexthop_change (struct sockaddr_nl *, struct nlmsghdr *);
+#endif /* RTM_NEWNEXTHOP */
+
 static int
 netlink_information_fetch (struct sockaddr_nl *snl, struct nlmsghdr *h)
 {
@@ -1560,6 +1583,14 @@ netlink_information_fetch (struct sockaddr_nl *snl, struct nlmsghdr *h)
     case RTM_DELADDR:
       return netlink_interface_addr (snl, h);
       break;
+#ifdef RTM_NEWNEXTHOP
+    case RTM_NEWNEXTHOP:
+      return netlink_nexthop_change (snl, h);
+      break;
+    case RTM_DELNEXTHOP:
+      return netlink_nexthop_change (snl, h);
+      break;
+#endif /* RTM_NEWNEXTHOP */
     default:
       zlog_warn ("Unknown netlink nlmsg_type %d\n", h->nlmsg_type);
       break;
@@ -1715,9 +1746,11 @@ netlink_talk_filter (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
-/* sendmsg() to netlink socket then recvmsg(). */
+/* sendmsg() to netlink socket then recvmsg(), passing what comes back
+   to the given function. */
 static int
-netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
+netlink_talk_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
+                   struct nlmsghdr *n, struct nlsock *nl)
 {
   int status;
   struct sockaddr_nl snl;
@@ -1762,11 +1795,18 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
     }
 
 
+  return netlink_parse_info (filter, nl);
+}
+
+/* sendmsg() to netlink socket then recvmsg(). */
+static int
+netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
+{
   /*
    * Get reply from netlink socket.
    * The reply should either be an acknowlegement or an error.
    */
-  return netlink_parse_info (netlink_talk_filter, nl);
+  return netlink_talk_info (netlink_talk_filter, n, nl);
 }
 
 /* Routing table change via netlink interface. */
@@ -2051,6 +2091,334 @@ _netlink_route_debug(
     }
 }
 
+#ifdef RTM_NEWNEXTHOP
+/* Cleared when the kernel turns out not to support nexthop objects. */
+static int kernel_nhg_supported = 1;
+
+/* Add, replace or delete the nexthop object in the kernel. */
+static int
+kernel_nhg_talk (int cmd, int flags, struct kernel_nhg *nhg)
+{
+  int i;
+  int ret;
+  struct nexthop_grp *grp;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[NL_PKT_BUF_SIZE];
+  } req;
+
+  memset (&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST | flags;
+  req.n.nlmsg_type = cmd;
+  req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, nhg->id);
+
+  if (cmd == RTM_NEWNEXTHOP)
+    {
+      if (nhg->members)
+        {
+          req.nhm.nh_family = AF_UNSPEC;
+
+          grp = XCALLOC (MTYPE_TMP, nhg->count * sizeof (struct nexthop_grp));
+          for (i = 0; i < nhg->count; i++)
+            grp[i].id = nhg->members[i]->id;
+          ret = addattr_l (&req.n, sizeof req, NHA_GROUP, grp,
+                           nhg->count * sizeof (struct nexthop_grp));
+          XFREE (MTYPE_TMP, grp);
+          if (ret < 0)
+            return -1;
+        }
+      else
+        {
+          req.nhm.nh_family = nhg->nh->family;
+          req.nhm.nh_flags = nhg->nh->flags;
+
+          if (nhg->nh->family == AF_INET && nhg->nh->gate.ipv4.s_addr)
+            addattr_l (&req.n, sizeof req, NHA_GATEWAY,
+                       &nhg->nh->gate.ipv4, 4);
+#ifdef HAVE_IPV6
+          if (nhg->nh->family == AF_INET6
+              && ! IN6_IS_ADDR_UNSPECIFIED (&nhg->nh->gate.ipv6))
+            addattr_l (&req.n, sizeof req, NHA_GATEWAY,
+                       &nhg->nh->gate.ipv6, 16);
+#endif /* HAVE_IPV6 */
+          addattr32 (&req.n, sizeof req, NHA_OIF, nhg->nh->ifindex);
+        }
+    }
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("kernel_nhg_talk(): %s%s nexthop object %u, %d nexthops",
+                lookup (nlmsg_str, cmd),
+                (flags & NLM_F_REPLACE) ? " (replace)" : "",
+                nhg->id, nhg->count);
+
+  return netlink_talk (&req.n, &netlink_cmd);
+}
+
+int
+kernel_nhg_add (struct kernel_nhg *nhg)
+{
+  /* Never take over an object someone else added. */
+  return kernel_nhg_talk (RTM_NEWNEXTHOP, NLM_F_CREATE | NLM_F_EXCL, nhg);
+}
+
+int
+kernel_nhg_replace (struct kernel_nhg *nhg)
+{
+  return kernel_nhg_talk (RTM_NEWNEXTHOP, NLM_F_REPLACE, nhg);
+}
+
+int
+kernel_nhg_delete (struct kernel_nhg *nhg)
+{
+  return kernel_nhg_talk (RTM_DELNEXTHOP, 0, nhg);
+}
+
+/* Nexthop objects a previous zebra left in the kernel, found at startup. */
+struct kernel_nhg_leftover
+{
+  u_int32_t id;
+  int group;
+};
+
+static struct kernel_nhg_leftover *kernel_nhg_leftover;
+static int kernel_nhg_leftover_count;
+
+static int
+netlink_nexthop_leftover (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct nhmsg *nhm;
+  struct rtattr *tb[NHA_MAX + 1];
+  u_int32_t id;
+  int len;
+
+  if (h->nlmsg_type != RTM_NEWNEXTHOP)
+    return 0;
+
+  nhm = NLMSG_DATA (h);
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg));
+  if (len < 0)
+    return -1;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, RTM_NHA (nhm), len);
+  if (tb[NHA_ID] == NULL)
+    return 0;
+  id = *(u_int32_t *) RTA_DATA (tb[NHA_ID]);
+
+  /* The IDs of the objects of others are not used. */
+  if (nhm->nh_protocol != RTPROT_ZEBRA)
+    {
+      kernel_nhg_id_skip (id);
+      return 0;
+    }
+
+  kernel_nhg_leftover = XREALLOC (MTYPE_TMP, kernel_nhg_leftover,
+                                  (kernel_nhg_leftover_count + 1)
+                                  * sizeof (struct kernel_nhg_leftover));
+  kernel_nhg_leftover[kernel_nhg_leftover_count].id = id;
+  kernel_nhg_leftover[kernel_nhg_leftover_count].group = tb[NHA_GROUP] != NULL;
+  kernel_nhg_leftover_count++;
+  return 0;
+}
+
+/* Find out whether the kernel knows about nexthop objects, and flush
+ * the ones a previous zebra left behind, groups before their members. */
+static void
+kernel_nhg_init (void)
+{
+  struct kernel_nhg nhg;
+  int group;
+  int i;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = sizeof req;
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+  req.n.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST;
+  req.nhm.nh_family = AF_UNSPEC;
+
+  if (netlink_talk_info (netlink_nexthop_leftover, &req.n, &netlink_cmd) < 0
+      && (errno == EINVAL || errno == EOPNOTSUPP))
+    {
+      zlog_info ("Kernel nexthop objects not available, "
+                 "installing multipath routes with RTA_MULTIPATH");
+      kernel_nhg_supported = 0;
+    }
+
+  memset (&nhg, 0, sizeof nhg);
+  for (group = 1; group >= 0; group--)
+    for (i = 0; i < kernel_nhg_leftover_count; i++)
+      if (kernel_nhg_leftover[i].group == group)
+        {
+          nhg.id = kernel_nhg_leftover[i].id;
+          kernel_nhg_delete (&nhg);
+        }
+
+  if (kernel_nhg_leftover_count)
+    zlog_info ("Flushed %d kernel nexthop objects of a previous zebra",
+               kernel_nhg_leftover_count);
+  XFREE (MTYPE_TMP, kernel_nhg_leftover);
+  kernel_nhg_leftover_count = 0;
+}
+
+/* Someone else deleted a nexthop object, or the kernel did as the
+ * interface went away. */
+static int
+netlink_nexthop_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct nhmsg *nhm;
+  struct rtattr *tb[NHA_MAX + 1];
+  int len;
+
+  if (h->nlmsg_type != RTM_DELNEXTHOP)
+    return 0;
+
+  nhm = NLMSG_DATA (h);
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg));
+  if (len < 0)
+    return -1;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, RTM_NHA (nhm), len);
+  if (tb[NHA_ID] == NULL || nhm->nh_protocol != RTPROT_ZEBRA)
+    return 0;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("nexthop object %u deleted by the kernel",
+                *(u_int32_t *) RTA_DATA (tb[NHA_ID]));
+  kernel_nhg_invalidate (*(u_int32_t *) RTA_DATA (tb[NHA_ID]));
+  return 0;
+}
+
+/* Find the nexthop group for the active nexthops of a multipath route,
+ * marking them as installed.  A route installed with a group already
+ * keeps it where it can, see kernel_nhg_change.  Returns NULL if the
+ * route can't use a nexthop group, in which case nothing has been
+ * changed. */
+static struct kernel_nhg *
+kernel_nhg_rib (struct prefix *p, struct rib *rib, int family,
+                int nexthop_num, union g_addr **src)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  struct kernel_nhg_member *nh;
+  struct kernel_nhg *nhg = NULL;
+  int count = 0;
+  int i;
+
+  if (! kernel_nhg_supported)
+    return NULL;
+
+  nh = XCALLOC (MTYPE_TMP, nexthop_num * sizeof (struct kernel_nhg_member));
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (count >= nexthop_num)
+        break;
+
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+
+      /* Nexthop objects are always bound to an interface. */
+      if (nexthop->ifindex == 0)
+        goto out;
+
+      if (nexthop->type == NEXTHOP_TYPE_IPV4
+          || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+        nh[count].gate.ipv4 = nexthop->gate.ipv4;
+#ifdef HAVE_IPV6
+      else if (nexthop->type == NEXTHOP_TYPE_IPV6
+               || nexthop->type == NEXTHOP_TYPE_IPV6_IFNAME
+               || nexthop->type == NEXTHOP_TYPE_IPV6_IFINDEX)
+        nh[count].gate.ipv6 = nexthop->gate.ipv6;
+#endif /* HAVE_IPV6 */
+      else if (nexthop->type != NEXTHOP_TYPE_IFINDEX
+               && nexthop->type != NEXTHOP_TYPE_IFNAME)
+        goto out;
+      nh[count].ifindex = nexthop->ifindex;
+      nh[count].family = family;
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ONLINK))
+        nh[count].flags = RTNH_F_ONLINK;
+      count++;
+    }
+
+  if (rib->kernel_nhg)
+    nhg = kernel_nhg_change (rib->kernel_nhg, nh, count);
+  else
+    nhg = kernel_nhg_find (nh, count);
+  if (nhg == NULL)
+    goto out;
+
+  i = 0;
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (i >= nexthop_num)
+        break;
+
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+
+      _netlink_route_debug (RTM_NEWROUTE, p, nexthop,
+                            recursing ? "recursive, multihop" : "multihop",
+                            family);
+      if (nexthop->src.ipv4.s_addr)
+        *src = &nexthop->src;
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      i++;
+    }
+
+ out:
+  XFREE (MTYPE_TMP, nh);
+  return nhg;
+}
+
+/* Whether any nexthop of the route asks for a preferred source, which
+ * may change along with the nexthops in use. */
+static int
+kernel_nhg_rib_prefsrc (struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    if (nexthop->src.ipv4.s_addr)
+      return 1;
+  return 0;
+}
+#else
+int
+kernel_nhg_add (struct kernel_nhg *nhg)
+{
+  return -1;
+}
+
+int
+kernel_nhg_replace (struct kernel_nhg *nhg)
+{
+  return -1;
+}
+
+int
+kernel_nhg_delete (struct kernel_nhg *nhg)
+{
+  return -1;
+}
+#endif /* RTM_NEWNEXTHOP */
+
 /* Routing table change via netlink interface. */
 static int
 netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
@@ -2063,6 +2431,9 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
   int nexthop_num;
   int discard;
   const char *routedesc;
+  union g_addr *src = NULL;
+  int ret;
+  struct kernel_nhg *nhg = NULL;
 
   struct
   {
@@ -2139,6 +2510,22 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
       nexthop_num++;
     }
 
+#ifdef RTM_NEWNEXTHOP
+  /* A route installed with a nexthop group is replaced, rather than
+   * deleted and added again, when its nexthops change; see rib_process.
+   * One left without any is deleted. */
+  if (cmd == RTM_NEWROUTE && rib->kernel_nhg)
+    {
+      ret = nexthop_num ? 0
+        : netlink_route_multipath (RTM_DELROUTE, p, rib, family);
+      for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+        UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      if (nexthop_num == 0)
+        return ret;
+      req.n.nlmsg_flags |= NLM_F_REPLACE;
+    }
+#endif /* RTM_NEWNEXTHOP */
+
   /* Singlepath case. */
   if (nexthop_num == 1 || MULTIPATH_NUM == 1)
     {
@@ -2168,12 +2555,31 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
             }
         }
     }
+#ifdef RTM_NEWNEXTHOP
+  else if (cmd == RTM_DELROUTE && rib->kernel_nhg)
+    addattr32 (&req.n, sizeof req, RTA_NH_ID, rib->kernel_nhg->id);
+  else if (cmd == RTM_NEWROUTE
+           && (nhg = kernel_nhg_rib (p, rib, family,
+                                     (MULTIPATH_NUM != 0
+                                      && nexthop_num > MULTIPATH_NUM)
+                                     ? MULTIPATH_NUM : nexthop_num,
+                                     &src)) != NULL)
+    {
+      /* Still the same group, which kernel_nhg_change replaced if need
+       * be, so there is nothing to tell the kernel about the route. */
+      if (nhg == rib->kernel_nhg && ! kernel_nhg_rib_prefsrc (rib))
+        return 0;
+
+      addattr32 (&req.n, sizeof req, RTA_NH_ID, nhg->id);
+      if (src)
+        addattr_l (&req.n, sizeof req, RTA_PREFSRC, &src->ipv4, bytelen);
+    }
+#endif /* RTM_NEWNEXTHOP */
   else
     {
       char buf[NL_PKT_BUF_SIZE];
       struct rtattr *rta = (void *) buf;
       struct rtnexthop *rtnh;
-      union g_addr *src = NULL;
 
       rta->rta_type = RTA_MULTIPATH;
       rta->rta_len = RTA_LENGTH (0);
@@ -2219,6 +2625,13 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
     {
       if (IS_ZEBRA_DEBUG_KERNEL)
         zlog_debug ("netlink_route_multipath(): No useful nexthop.");
+#ifdef RTM_NEWNEXTHOP
+      if (cmd == RTM_DELROUTE && rib->kernel_nhg)
+        {
+          kernel_nhg_release (rib->kernel_nhg);
+          rib->kernel_nhg = NULL;
+        }
+#endif /* RTM_NEWNEXTHOP */
       return 0;
     }
 
@@ -2229,7 +2642,25 @@ skip:
   snl.nl_family = AF_NETLINK;
 
   /* Talk to netlink socket. */
-  return netlink_talk (&req.n, &netlink_cmd);
+  ret = netlink_talk (&req.n, &netlink_cmd);
+
+#ifdef RTM_NEWNEXTHOP
+  /* The route holds on to the group it was installed with until it is
+   * deleted or moved to another. */
+  if (cmd == RTM_NEWROUTE && ret < 0)
+    {
+      if (nhg && nhg != rib->kernel_nhg)
+        kernel_nhg_release (nhg);
+    }
+  else
+    {
+      if (rib->kernel_nhg && rib->kernel_nhg != nhg)
+        kernel_nhg_release (rib->kernel_nhg);
+      rib->kernel_nhg = nhg;
+    }
+#endif /* RTM_NEWNEXTHOP */
+
+  return ret;
 }
 
 int
@@ -2377,6 +2808,21 @@ kernel_init (void)
 #endif /* HAVE_IPV6 */
   netlink_socket (&netlink, groups);
   netlink_socket (&netlink_cmd, 0);
+#ifdef RTM_NEWNEXTHOP
+  if (netlink_cmd.sock > 0)
+    kernel_nhg_init ();
+
+  /* There is no RTMGRP_ mask for the nexthop group. */
+  if (netlink.sock > 0 && kernel_nhg_supported)
+    {
+      int group = RTNLGRP_NEXTHOP;
+
+      if (setsockopt (netlink.sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+                      &group, sizeof group) < 0)
+        zlog_warn ("Can't join netlink nexthop group: %s",
+                   safe_strerror (errno));
+    }
+#endif /* RTM_NEWNEXTHOP */
   /* Register kernel socket. */
   if (netlink.sock > 0)
     {
@@ -0,0 +1,344 @@
+/*
+ * Kernel nexthop objects shared between routes.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Multipath routes can be installed referring to a nexthop group object
+ * by ID instead of carrying their own list of nexthops.  Groups are
+ * interned by their member set, so all the routes using the same ECMP
+ * set share one group in the kernel.  Every member is a nexthop object
+ * of its own, shared by all the groups it belongs to.  Objects are
+ * refcounted by the routes and groups using them, and deleted from the
+ * kernel with the last reference.  A group used by a single route is
+ * replaced in place when the nexthops of the route change, so that the
+ * route keeps referring to the same ID. */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
+
+#include "zebra/zebra_nhg.h"
+
+static struct hash *kernel_nhg_hash;
+static u_int32_t kernel_nhg_next_id = 1;
+
+static unsigned int
+kernel_nhg_hash_key (void *arg)
+{
+  struct kernel_nhg *nhg = arg;
+
+  return jhash (nhg->nh, nhg->count * sizeof (struct kernel_nhg_member),
+                nhg->count);
+}
+
+static int
+kernel_nhg_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct kernel_nhg *nhg1 = arg1;
+  const struct kernel_nhg *nhg2 = arg2;
+
+  return nhg1->count == nhg2->count
+    && memcmp (nhg1->nh, nhg2->nh,
+               nhg1->count * sizeof (struct kernel_nhg_member)) == 0;
+}
+
+static int
+kernel_nhg_member_cmp (const void *arg1, const void *arg2)
+{
+  return memcmp (arg1, arg2, sizeof (struct kernel_nhg_member));
+}
+
+static void
+kernel_nhg_free (struct kernel_nhg *nhg)
+{
+  XFREE (MTYPE_NEXTHOP_GROUP, nhg->members);
+  XFREE (MTYPE_NEXTHOP_GROUP, nhg->nh);
+  XFREE (MTYPE_NEXTHOP_GROUP, nhg);
+}
+
+/* Drop a reference to the object, deleting it from the kernel once
+ * nothing refers to it anymore. */
+void
+kernel_nhg_release (struct kernel_nhg *nhg)
+{
+  int i;
+
+  if (--nhg->refcnt > 0)
+    return;
+
+  kernel_nhg_delete (nhg);
+  if (! nhg->invalid)
+    hash_release (kernel_nhg_hash, nhg);
+
+  if (nhg->members)
+    for (i = 0; i < nhg->count; i++)
+      kernel_nhg_release (nhg->members[i]);
+
+  kernel_nhg_free (nhg);
+}
+
+/* Return a reference to the object for the given nexthops, adding it to
+ * the kernel if it is not there yet. */
+static struct kernel_nhg *
+kernel_nhg_get (struct kernel_nhg *key)
+{
+  struct kernel_nhg *nhg;
+  struct kernel_nhg member;
+  int i;
+
+  if (! kernel_nhg_hash)
+    kernel_nhg_hash = hash_create (kernel_nhg_hash_key, kernel_nhg_hash_cmp);
+
+  nhg = hash_lookup (kernel_nhg_hash, key);
+  if (nhg)
+    {
+      nhg->refcnt++;
+      return nhg;
+    }
+
+  nhg = XCALLOC (MTYPE_NEXTHOP_GROUP, sizeof (struct kernel_nhg));
+  nhg->id = kernel_nhg_next_id++;
+  nhg->count = key->count;
+  nhg->nh = XMALLOC (MTYPE_NEXTHOP_GROUP,
+                     key->count * sizeof (struct kernel_nhg_member));
+  memcpy (nhg->nh, key->nh, key->count * sizeof (struct kernel_nhg_member));
+
+  if (key->count > 1)
+    {
+      nhg->members = XCALLOC (MTYPE_NEXTHOP_GROUP,
+                              key->count * sizeof (struct kernel_nhg *));
+      memset (&member, 0, sizeof (member));
+      member.count = 1;
+      for (i = 0; i < key->count; i++)
+        {
+          member.nh = &key->nh[i];
+          if ((nhg->members[i] = kernel_nhg_get (&member)) == NULL)
+            break;
+        }
+      if (i < key->count)
+        {
+          while (i-- > 0)
+            kernel_nhg_release (nhg->members[i]);
+          kernel_nhg_free (nhg);
+          return NULL;
+        }
+    }
+
+  if (kernel_nhg_add (nhg) < 0)
+    {
+      if (nhg->members)
+        for (i = 0; i < nhg->count; i++)
+          kernel_nhg_release (nhg->members[i]);
+      kernel_nhg_free (nhg);
+      return NULL;
+    }
+
+  hash_get (kernel_nhg_hash, nhg, hash_alloc_intern);
+  nhg->refcnt = 1;
+  return nhg;
+}
+
+/* Sort the nexthops and free them of duplicates in place, returning
+ * how many are left.  The same nexthops in any order make the same
+ * group; a group can't hold the same nexthop twice. */
+static int
+kernel_nhg_sort (struct kernel_nhg_member *nh, int count)
+{
+  int i;
+
+  qsort (nh, count, sizeof (struct kernel_nhg_member), kernel_nhg_member_cmp);
+  for (i = 1; i < count; i++)
+    if (kernel_nhg_member_cmp (&nh[i - 1], &nh[i]) == 0)
+      {
+        memmove (&nh[i], &nh[i + 1],
+                 (count - i - 1) * sizeof (struct kernel_nhg_member));
+        count--;
+        i--;
+      }
+  return count;
+}
+
+/* Return a reference to the group for the nexthops, which are sorted
+ * and freed of duplicates in place.  NULL if there are fewer than two
+ * distinct nexthops, or the kernel refused the group. */
+struct kernel_nhg *
+kernel_nhg_find (struct kernel_nhg_member *nh, int count)
+{
+  struct kernel_nhg key;
+
+  count = kernel_nhg_sort (nh, count);
+  if (count < 2)
+    return NULL;
+
+  memset (&key, 0, sizeof (key));
+  key.count = count;
+  key.nh = nh;
+  return kernel_nhg_get (&key);
+}
+
+/* The nexthops of a route using the group changed.  Return the group
+ * for the new nexthops, which are sorted and freed of duplicates in
+ * place, with a reference in place of the one the route holds to the
+ * group.  If the route is the only one using the group, and no other
+ * group has the new nexthops, the group is replaced in the kernel and
+ * keeps its ID.  Otherwise a reference to another group is returned,
+ * and the caller releases the old one once the route moved.  NULL if
+ * there are fewer than two distinct nexthops, or the kernel refused the
+ * group; the reference to the old one is kept then. */
+struct kernel_nhg *
+kernel_nhg_change (struct kernel_nhg *nhg, struct kernel_nhg_member *nh,
+                   int count)
+{
+  struct kernel_nhg key;
+  struct kernel_nhg old;
+  struct kernel_nhg member;
+  int i;
+
+  count = kernel_nhg_sort (nh, count);
+  if (count < 2)
+    return NULL;
+
+  memset (&key, 0, sizeof (key));
+  key.count = count;
+  key.nh = nh;
+
+  /* The route already uses the group for these nexthops. */
+  if (! nhg->invalid && kernel_nhg_hash_cmp (nhg, &key))
+    return nhg;
+
+  if (nhg->invalid || nhg->refcnt > 1
+      || hash_lookup (kernel_nhg_hash, &key))
+    return kernel_nhg_get (&key);
+
+  /* Take the new members before the group lets go of the old ones, so
+   * that those the group keeps stay in the kernel. */
+  memset (&old, 0, sizeof (old));
+  old.count = nhg->count;
+  old.nh = nhg->nh;
+  old.members = nhg->members;
+
+  nhg->members = XCALLOC (MTYPE_NEXTHOP_GROUP,
+                          count * sizeof (struct kernel_nhg *));
+  memset (&member, 0, sizeof (member));
+  member.count = 1;
+  for (i = 0; i < count; i++)
+    {
+      member.nh = &nh[i];
+      if ((nhg->members[i] = kernel_nhg_get (&member)) == NULL)
+        break;
+    }
+
+  if (i == count)
+    {
+      hash_release (kernel_nhg_hash, nhg);
+      nhg->count = count;
+      nhg->nh = XMALLOC (MTYPE_NEXTHOP_GROUP,
+                         count * sizeof (struct kernel_nhg_member));
+      memcpy (nhg->nh, nh, count * sizeof (struct kernel_nhg_member));
+
+      if (kernel_nhg_replace (nhg) == 0)
+        {
+          hash_get (kernel_nhg_hash, nhg, hash_alloc_intern);
+          for (i = 0; i < old.count; i++)
+            kernel_nhg_release (old.members[i]);
+          XFREE (MTYPE_NEXTHOP_GROUP, old.members);
+          XFREE (MTYPE_NEXTHOP_GROUP, old.nh);
+          return nhg;
+        }
+
+      /* The kernel still has the group with the old members. */
+      XFREE (MTYPE_NEXTHOP_GROUP, nhg->nh);
+      nhg->count = old.count;
+      nhg->nh = old.nh;
+      hash_get (kernel_nhg_hash, nhg, hash_alloc_intern);
+    }
+
+  while (i-- > 0)
+    kernel_nhg_release (nhg->members[i]);
+  XFREE (MTYPE_NEXTHOP_GROUP, nhg->members);
+  nhg->members = old.members;
+  return NULL;
+}
+
+/* Mark the object with the ID, and the groups it is a member of. */
+static void
+kernel_nhg_invalidate_walker (struct hash_backet *backet, void *arg)
+{
+  u_int32_t id = *(u_int32_t *) arg;
+  struct kernel_nhg *nhg = backet->data;
+  int i;
+
+  if (nhg->id == id)
+    nhg->invalid = 1;
+  else if (nhg->members)
+    for (i = 0; i < nhg->count; i++)
+      if (nhg->members[i]->id == id)
+        nhg->invalid = 1;
+}
+
+static void
+kernel_nhg_invalid_collect (struct hash_backet *backet, void *arg)
+{
+  struct list *invalid = arg;
+  struct kernel_nhg *nhg = backet->data;
+
+  if (nhg->invalid)
+    listnode_add (invalid, nhg);
+}
+
+/* The kernel deleted the object with the ID.  It and the groups it was
+ * a member of are not handed out to new routes any more; the routes
+ * still referring to them release them as usual. */
+void
+kernel_nhg_invalidate (u_int32_t id)
+{
+  struct list *invalid;
+  struct listnode *node;
+  struct kernel_nhg *nhg;
+
+  if (! kernel_nhg_hash)
+    return;
+
+  hash_iterate (kernel_nhg_hash, kernel_nhg_invalidate_walker, &id);
+
+  /* The hash can't change while it is walked. */
+  invalid = list_new ();
+  hash_iterate (kernel_nhg_hash, kernel_nhg_invalid_collect, invalid);
+  for (ALL_LIST_ELEMENTS_RO (invalid, node, nhg))
+    hash_release (kernel_nhg_hash, nhg);
+  list_delete (invalid);
+}
+
+/* An object with the ID exists in the kernel already; don't use it. */
+void
+kernel_nhg_id_skip (u_int32_t id)
+{
+  if (id >= kernel_nhg_next_id)
+    kernel_nhg_next_id = id + 1;
+}
+
+/* Number of objects that can be handed out. */
+unsigned long
+kernel_nhg_count (void)
+{
+  return kernel_nhg_hash ? kernel_nhg_hash->count : 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Kernel nexthop objects shared between routes.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "zebra/rib.h"
+
+/* A nexthop of a kernel nexthop object. */
+struct kernel_nhg_member
+{
+  union g_addr gate;
+  unsigned int ifindex;
+  u_char family;
+  u_char flags;
+};
+
+/* A kernel nexthop object: a single nexthop, or a group of those. */
+struct kernel_nhg
+{
+  /* Kernel object ID. */
+  u_int32_t id;
+
+  /* Number of routes and groups referring to this object. */
+  unsigned long refcnt;
+
+  /* Set once the object is not to be handed out again, because the
+     kernel deleted it or one of its members. */
+  int invalid;
+
+  /* The nexthops, sorted; a single one for a member object. */
+  int count;
+  struct kernel_nhg_member *nh;
+
+  /* Member objects of a group. */
+  struct kernel_nhg **members;
+};
+
+extern struct kernel_nhg *kernel_nhg_find (struct kernel_nhg_member *, int);
+extern struct kernel_nhg *kernel_nhg_change (struct kernel_nhg *,
+                                             struct kernel_nhg_member *, int);
+extern void kernel_nhg_release (struct kernel_nhg *);
+extern void kernel_nhg_invalidate (u_int32_t);
+extern void kernel_nhg_id_skip (u_int32_t);
+extern unsigned long kernel_nhg_count (void);
+
+/* Provided by the kernel method. */
+extern int kernel_nhg_add (struct kernel_nhg *);
+extern int kernel_nhg_replace (struct kernel_nhg *);
+extern int kernel_nhg_delete (struct kernel_nhg *);
+
+#endif /* _ZEBRA_NHG_H */
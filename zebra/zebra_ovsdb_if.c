@@ -100,6 +100,7 @@ struct list *zebra_route_del_list;
 
 static int zebra_ovspoll_enqueue (zebra_ovsdb_t *zovs_g);
 static int zovs_read_cb (struct thread *thread);
+static void zebra_selected_discard (void);
 int zebra_add_route (bool is_ipv6, struct prefix *p, int type, safi_t safi,
                      const struct ovsrec_route *route);
 #ifdef HAVE_IPV6
@@ -3314,20 +3315,343 @@ zebra_update_port_active_state (const struct ovsrec_interface *interface)
 }
 
 /*
- * This function adds work for the quagga back-end thread to revisit
- * a static route in case its resolving next-hop has changed admin
- * state or the resolving IP/IPv6 address changes or gets deleted.
- * This function also handles the clean-up of static routes in case
- * the interface gets converted into L2 or the L3 interface gets
- * deleted.
+ * Reverse index from the L3 ports to the route nodes having static
+ * routes through them, kept per VRF, so that a change on an L3 port only
+ * revisits the routes depending on it instead of walking the whole route
+ * table. The index is filled as static routes are added, from the OVSDB
+ * as well as from the CLI, and pruned as they are deleted. A route node
+ * moves between ports when it gets revisited for a port change, or is
+ * dropped lazily once it turns out not to use the port anymore.
  */
+static struct hash *zebra_nh_deps;
+
+static unsigned int
+zebra_nh_dep_key_make (void *p)
+{
+  return jhash(p, offsetof(struct zebra_nh_dep, nodes), 0);
+}
+
+static int
+zebra_nh_dep_key_cmp (const void *arg1, const void *arg2)
+{
+  return !memcmp(arg1, arg2, offsetof(struct zebra_nh_dep, nodes));
+}
+
+static unsigned int
+zebra_nh_dep_node_key_make (void *p)
+{
+  return jhash_1word((u_int32_t)(uintptr_t)p, 0);
+}
+
+static int
+zebra_nh_dep_node_key_cmp (const void *arg1, const void *arg2)
+{
+  return arg1 == arg2;
+}
+
+static void *
+zebra_nh_dep_alloc (void *p)
+{
+  struct zebra_nh_dep *dep;
+
+  dep = XMALLOC(MTYPE_ZEBRA_NH_DEP, sizeof(struct zebra_nh_dep));
+  memcpy(dep, p, sizeof(struct zebra_nh_dep));
+  dep->nodes = hash_create(zebra_nh_dep_node_key_make,
+                           zebra_nh_dep_node_key_cmp);
+
+  return dep;
+}
+
 static void
-zebra_find_routes_with_updated_ports_state (
-                        afi_t afi, safi_t safi, u_int32_t id,
-                        const char* cleanup_reason)
+zebra_nh_dep_key_set (struct zebra_nh_dep *key, u_int32_t vrf_id,
+                      afi_t afi, const char *port)
+{
+  memset(key, 0, sizeof(struct zebra_nh_dep));
+  key->vrf_id = vrf_id;
+  key->afi = afi;
+  strncpy(key->port, port, IF_NAMESIZE);
+}
+
+/*
+ * This function finds the L3 port the next-hop 'gate' or 'ifname' goes
+ * through, leaving 'port' empty if no cached L3 port resolves the
+ * next-hop address yet. It returns false for a next-hop which does not
+ * depend on any port.
+ */
+static bool
+zebra_nh_dep_port_find (afi_t afi, void *gate, const char *ifname,
+                        char *port)
+{
+  char nexthop_str[256];
+  struct zebra_l3_port* l3_port = NULL;
+
+  memset(port, 0, IF_NAMESIZE + 1);
+
+  if (ifname)
+    {
+      strncpy(port, ifname, IF_NAMESIZE);
+      return true;
+    }
+
+  if (!gate)
+    return false;
+
+  memset(nexthop_str, 0, sizeof(nexthop_str));
+  inet_ntop((afi == AFI_IP) ? AF_INET : AF_INET6, gate,
+            nexthop_str, sizeof(nexthop_str));
+
+  l3_port = zebra_search_nh_addr_in_l3_ports_hash(&zebra_cached_l3_ports,
+                                                  nexthop_str, afi);
+  if (l3_port)
+    strncpy(port, l3_port->port_name, IF_NAMESIZE);
+
+  return true;
+}
+
+static bool
+zebra_nh_dep_nexthop_port (afi_t afi, struct nexthop *nexthop, char *port)
+{
+  if (((nexthop->type == NEXTHOP_TYPE_IFNAME) ||
+       (nexthop->type == NEXTHOP_TYPE_IPV4_IFNAME) ||
+       (nexthop->type == NEXTHOP_TYPE_IPV6_IFNAME)) &&
+      nexthop->ifname)
+    return zebra_nh_dep_port_find(afi, NULL, nexthop->ifname, port);
+
+  if (afi == AFI_IP && nexthop->type == NEXTHOP_TYPE_IPV4)
+    return zebra_nh_dep_port_find(afi, &nexthop->gate.ipv4, NULL, port);
+
+  if (afi == AFI_IP6 && nexthop->type == NEXTHOP_TYPE_IPV6)
+    return zebra_nh_dep_port_find(afi, &nexthop->gate.ipv6, NULL, port);
+
+  return false;
+}
+
+/*
+ * This function finds if any static route of the route node still
+ * goes through the port of the index entry.
+ */
+static bool
+zebra_nh_dep_node_uses (struct zebra_nh_dep *dep, struct route_node *rn)
+{
+  struct rib *rib;
+  struct nexthop *nexthop;
+  char port[IF_NAMESIZE + 1];
+
+  RNODE_FOREACH_RIB (rn, rib)
+    {
+      if (rib->type != ZEBRA_ROUTE_STATIC ||
+          CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED))
+        continue;
+
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+        if (zebra_nh_dep_nexthop_port(dep->afi, nexthop, port) &&
+            !strcmp(port, dep->port))
+          return true;
+    }
+
+  return false;
+}
+
+/*
+ * This function records that the route node goes through 'port'.
+ */
+static void
+zebra_nh_dep_node_add (u_int32_t vrf_id, afi_t afi, const char *port,
+                       struct route_node *rn)
+{
+  struct zebra_nh_dep key;
+  struct zebra_nh_dep *dep;
+
+  if (!zebra_nh_deps)
+    zebra_nh_deps = hash_create(zebra_nh_dep_key_make,
+                                zebra_nh_dep_key_cmp);
+
+  zebra_nh_dep_key_set(&key, vrf_id, afi, port);
+  dep = hash_get(zebra_nh_deps, &key, zebra_nh_dep_alloc);
+
+  if (!hash_lookup(dep->nodes, rn))
+    {
+      route_lock_node(rn);
+      hash_get(dep->nodes, rn, hash_alloc_intern);
+    }
+}
+
+/*
+ * This function drops the route node from the index entry, freeing the
+ * entry once no route node uses it.
+ */
+static void
+zebra_nh_dep_release (struct zebra_nh_dep *dep, struct route_node *rn)
+{
+  if (hash_release(dep->nodes, rn))
+    route_unlock_node(rn);
+
+  if (dep->nodes->count == 0)
+    {
+      hash_release(zebra_nh_deps, dep);
+      hash_free(dep->nodes);
+      XFREE(MTYPE_ZEBRA_NH_DEP, dep);
+    }
+}
+
+/*
+ * This function drops the route node from the index entry for 'port',
+ * unless other static routes of the node still go through the port.
+ */
+static void
+zebra_nh_dep_node_del (u_int32_t vrf_id, afi_t afi, const char *port,
+                       struct route_node *rn)
+{
+  struct zebra_nh_dep key;
+  struct zebra_nh_dep *dep;
+
+  if (!zebra_nh_deps)
+    return;
+
+  zebra_nh_dep_key_set(&key, vrf_id, afi, port);
+  dep = hash_lookup(zebra_nh_deps, &key);
+  if (!dep || !hash_lookup(dep->nodes, rn))
+    return;
+
+  if (!zebra_nh_dep_node_uses(dep, rn))
+    zebra_nh_dep_release(dep, rn);
+}
+
+/*
+ * This function is called once the static route for prefix 'p' through
+ * the next-hop 'gate' or 'ifname' got installed.
+ */
+void
+zebra_nh_dep_add (u_int32_t vrf_id, afi_t afi, safi_t safi, struct prefix *p,
+                  void *gate, const char *ifname)
 {
   struct route_table *table;
   struct route_node *rn;
+  char port[IF_NAMESIZE + 1];
+
+  if (!zebra_nh_dep_port_find(afi, gate, ifname, port))
+    return;
+
+  table = vrf_table (afi, safi, vrf_id);
+  if (!table)
+    return;
+
+  rn = route_node_get(table, p);
+  zebra_nh_dep_node_add(vrf_id, afi, port, rn);
+  route_unlock_node(rn);
+}
+
+/*
+ * This function is called once the static route for prefix 'p' through
+ * the next-hop 'gate' or 'ifname' got deleted. The route node may still
+ * be listed as unresolved if the next-hop got resolved since.
+ */
+void
+zebra_nh_dep_del (u_int32_t vrf_id, afi_t afi, safi_t safi, struct prefix *p,
+                  void *gate, const char *ifname)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  char port[IF_NAMESIZE + 1];
+
+  if (!zebra_nh_dep_port_find(afi, gate, ifname, port))
+    return;
+
+  table = vrf_table (afi, safi, vrf_id);
+  if (!table)
+    return;
+
+  rn = route_node_lookup(table, p);
+  if (!rn)
+    return;
+
+  zebra_nh_dep_node_del(vrf_id, afi, port, rn);
+  if (port[0])
+    zebra_nh_dep_node_del(vrf_id, afi, "", rn);
+  route_unlock_node(rn);
+}
+
+/*
+ * This function files the revisited route node under the ports its
+ * static routes go through now.
+ */
+static void
+zebra_nh_dep_node_reindex (u_int32_t vrf_id, afi_t afi,
+                           struct route_node *rn)
+{
+  struct rib *rib;
+  struct nexthop *nexthop;
+  char port[IF_NAMESIZE + 1];
+
+  RNODE_FOREACH_RIB (rn, rib)
+    {
+      if (rib->type != ZEBRA_ROUTE_STATIC ||
+          CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED))
+        continue;
+
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+        if (zebra_nh_dep_nexthop_port(afi, nexthop, port))
+          zebra_nh_dep_node_add(vrf_id, afi, port, rn);
+    }
+}
+
+static void
+zebra_nh_dep_list_add (struct hash_backet *backet, void *arg)
+{
+  listnode_add((struct list *)arg, backet->data);
+}
+
+/*
+ * This function collects the route nodes of the table which went through
+ * 'port' into 'affected', locking them, and drops from the index entry
+ * those not going through the port anymore.
+ */
+static void
+zebra_nh_dep_collect (u_int32_t vrf_id, afi_t afi, const char *port,
+                      struct route_table *table, struct hash *affected)
+{
+  struct zebra_nh_dep key;
+  struct zebra_nh_dep *dep;
+  struct list *nodes;
+  struct listnode *node;
+  struct route_node *rn;
+
+  zebra_nh_dep_key_set(&key, vrf_id, afi, port);
+  dep = hash_lookup(zebra_nh_deps, &key);
+  if (!dep)
+    return;
+
+  nodes = list_new();
+  hash_iterate(dep->nodes, zebra_nh_dep_list_add, nodes);
+
+  for (ALL_LIST_ELEMENTS_RO (nodes, node, rn))
+    {
+      if (rn->table != table)
+        continue;
+
+      if (!hash_lookup(affected, rn))
+        {
+          route_lock_node(rn);
+          hash_get(affected, rn, hash_alloc_intern);
+        }
+
+      /*
+       * The entry goes with its last node, which is the last one listed.
+       */
+      if (!zebra_nh_dep_node_uses(dep, rn))
+        zebra_nh_dep_release(dep, rn);
+    }
+
+  list_delete(nodes);
+}
+
+/*
+ * This function revisits the static routes of a route node whose
+ * next-hops may have changed state.
+ */
+static void
+zebra_revisit_route_node_for_ports_state (struct route_node *rn, afi_t afi)
+{
   struct rib *rib;
   struct nexthop *nexthop;
   char prefix_str[256];
@@ -3340,252 +3664,307 @@ zebra_find_routes_with_updated_ports_state (
   const struct ovsrec_route *ovs_route = NULL;
   #endif
 
-  table = vrf_table (afi, safi, id);
-  if (!table)
-    {
-      VLOG_ERR("Table not found");
-      return;
-    }
+  if_revisit_route_node = false;
 
-  /*
-   * returning from the function if the hash table
-   * 'zebra_updated_or_changed_l3_ports' is empty.
-   */
-  if (!zebra_get_if_port_updated_or_changed()
-      && !zebra_get_if_port_active_state_changed())
-    {
-      VLOG_DBG("No change in L3 port configuration. No nexthops to delete");
-      return;
-    }
+  p = &rn->p;
+  memset(prefix_str, 0, sizeof(prefix_str));
+  prefix2str(p, prefix_str, sizeof(prefix_str));
 
-  VLOG_DBG("Cleaning-up/Populating %s routes in response to %s trigger",
-           (afi == AFI_IP) ? "IPv4" : "IPv6",cleanup_reason);
+  VLOG_DBG("Prefix %s Family %d\n",prefix_str, PREFIX_FAMILY(p));
 
-  for (rn = route_top (table); rn; rn = route_next (rn))
+  RNODE_FOREACH_RIB (rn, rib)
     {
-      /*
-       * Create a transaction for any IDL route updates to OVSDB from
-       * the zebra main thread.
-       */
-      zebra_create_txn();
-
-      if (!rn)
+      #ifdef VRF_ENABLE
+      if (rib->ovsdb_route_row_uuid_ptr)
         {
-          VLOG_ERR("Route node is NULL");
-          continue;
-        }
+          ovs_route = ovsrec_route_get_for_uuid(idl,
+                      (const struct uuid*)rib->ovsdb_route_row_uuid_ptr);
 
-      if_revisit_route_node = false;
+          if (!ovs_route) {
+              VLOG_DBG("Route not found using route UUID");
+              continue;
+          }
 
-      p = &rn->p;
-      memset(prefix_str, 0, sizeof(prefix_str));
-      prefix2str(p, prefix_str, sizeof(prefix_str));
+          if (!(zebra_is_route_in_my_vrf(ovs_route)))
+            continue;
+        }
+      #endif
 
-      VLOG_DBG("Prefix %s Family %d\n",prefix_str, PREFIX_FAMILY(p));
+      if (rib->type != ZEBRA_ROUTE_STATIC ||
+          !rib->nexthop)
+        {
+          VLOG_DBG("Not a static route or null next-hop");
+          continue;
+        }
 
-      RNODE_FOREACH_RIB (rn, rib)
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
         {
-          #ifdef VRF_ENABLE
-          if (rib->ovsdb_route_row_uuid_ptr)
+          memset(nexthop_str, 0, sizeof(nexthop_str));
+          memset(ifname, 0, sizeof(ifname));
+          l3_port = NULL;
+
+          if (afi == AFI_IP)
+            {
+              if (nexthop->type == NEXTHOP_TYPE_IPV4)
+                inet_ntop(AF_INET, &nexthop->gate.ipv4,
+                          nexthop_str, sizeof(nexthop_str));
+            }
+          else if (afi == AFI_IP6)
             {
-              ovs_route = ovsrec_route_get_for_uuid(idl,
-                          (const struct uuid*)rib->ovsdb_route_row_uuid_ptr);
+              if (nexthop->type == NEXTHOP_TYPE_IPV6)
+                inet_ntop(AF_INET6, &nexthop->gate.ipv6,
+                          nexthop_str, sizeof(nexthop_str));
+            }
 
-              if (!ovs_route) {
-                  VLOG_DBG("Route not found using route UUID");
-                  continue;
-              }
+          if ((nexthop->type == NEXTHOP_TYPE_IFNAME) ||
+              (nexthop->type == NEXTHOP_TYPE_IPV4_IFNAME) ||
+              (nexthop->type == NEXTHOP_TYPE_IPV6_IFNAME))
+            strncpy(ifname, nexthop->ifname, IF_NAMESIZE);
 
-              if (!(zebra_is_route_in_my_vrf(ovs_route)))
-                continue;
-            }
-          #endif
+          VLOG_DBG("Processing route %s for the next-hop IP %s or "
+                   "interface %s\n", prefix_str,
+                   nexthop_str[0] ? nexthop_str : "NONE",
+                   ifname[0] ? ifname : "NONE");
 
-          if (rib->type != ZEBRA_ROUTE_STATIC ||
-              !rib->nexthop)
+          /*
+           * If 'ifname' is legal, then find the L3 port node having
+           * this name.
+           */
+          if (ifname[0])
             {
-              VLOG_DBG("Not a static route or null next-hop");
-              continue;
+              l3_port = zebra_search_port_name_in_l3_ports_hash(
+                                                     &zebra_cached_l3_ports,
+                                                     ifname);
             }
 
-          for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+          /*
+           * If 'nexthop' is legal, then walk the hash table of L3
+           * port nodes to find if the nexthop IP/IPv6 addresses occurs
+           * in the subnets configured on L3 interfaces.
+           */
+          if (nexthop_str[0])
             {
-              memset(nexthop_str, 0, sizeof(nexthop_str));
-              memset(ifname, 0, sizeof(ifname));
-              l3_port = NULL;
-
-              if (afi == AFI_IP)
-                {
-                  if (nexthop->type == NEXTHOP_TYPE_IPV4)
-                    inet_ntop(AF_INET, &nexthop->gate.ipv4,
-                              nexthop_str, sizeof(nexthop_str));
-                }
-              else if (afi == AFI_IP6)
-                {
-                  if (nexthop->type == NEXTHOP_TYPE_IPV6)
-                    inet_ntop(AF_INET6, &nexthop->gate.ipv6,
-                              nexthop_str, sizeof(nexthop_str));
-                }
-
-              if ((nexthop->type == NEXTHOP_TYPE_IFNAME) ||
-                  (nexthop->type == NEXTHOP_TYPE_IPV4_IFNAME) ||
-                  (nexthop->type == NEXTHOP_TYPE_IPV6_IFNAME))
-                strncpy(ifname, nexthop->ifname, IF_NAMESIZE);
+              l3_port = zebra_search_nh_addr_in_l3_ports_hash(
+                                             &zebra_cached_l3_ports,
+                                             nexthop_str, afi);
+            }
 
-              VLOG_DBG("Processing route %s for the next-hop IP %s or "
-                       "interface %s\n", prefix_str,
-                       nexthop_str[0] ? nexthop_str : "NONE",
-                       ifname[0] ? ifname : "NONE");
+          /*
+           * There is a possibility that in case of next-hop as IP/IPv6 address,
+           * we could have forward reference and we cannot find a L3 port node
+           * with that next-hop IP subnet. In that case mark this node for
+           * inspection by backend thread.
+           */
+          if (!l3_port)
+            {
+              VLOG_DBG("Next-hop %s not found in L3 port cache",
+                        ifname[0] ? ifname :
+                            (nexthop_str[0] ? nexthop_str:"NONE"));
 
               /*
-               * If 'ifname' is legal, then find the L3 port node having
-               * this name.
+               * We should always be able to find a L3 port node, if the
+               * next-hop is IP/IPv6 address.
                */
               if (ifname[0])
+                assert(0);
+
+              if (nexthop_str[0])
                 {
-                  l3_port = zebra_search_port_name_in_l3_ports_hash(
-                                                         &zebra_cached_l3_ports,
-                                                         ifname);
+                  if_revisit_route_node = true;
+                  continue;
                 }
+            }
+          else
+            {
+              VLOG_DBG("Found L3 port node %s with action %s",
+                       l3_port->port_name,
+                       zebra_l3_port_cache_actions_str[l3_port->port_action]);
+            }
 
+          switch (l3_port->port_action)
+            {
               /*
-               * If 'nexthop' is legal, then walk the hash table of L3
-               * port nodes to find if the nexthop IP/IPv6 addresses occurs
-               * in the subnets configured on L3 interfaces.
+               * In case nothing changed in the L3 port node,
+               * zebra is in sync with OVSDB and no action needs
+               * to be taken
                */
-              if (nexthop_str[0])
-                {
-                  l3_port = zebra_search_nh_addr_in_l3_ports_hash(
-                                                 &zebra_cached_l3_ports,
-                                                 nexthop_str, afi);
-                }
+              case ZEBRA_L3_PORT_NO_CHANGE:
+                break;
 
               /*
-               * There is a possibility that in case of next-hop as IP/IPv6 address,
-               * we could have forward reference and we cannot find a L3 port node
-               * with that next-hop IP subnet. In that case mark this node for
-               * inspection by backend thread.
+               * We need to have the backend zebra thread to examine
+               * the route node in the following cases:-
+               * 1. A new L3 port node got added
+               * 2. Some IP address got added on an L3 port
+               * 3. Some admin or link state change happened on the
+               *    L3 interface
                */
-              if (!l3_port)
-                {
-                  VLOG_DBG("Next-hop %s not found in L3 port cache",
-                            ifname[0] ? ifname :
-                                (nexthop_str[0] ? nexthop_str:"NONE"));
+              case ZEBRA_L3_PORT_ADD:
+              case ZEBRA_L3_PORT_UPADTE_IP_ADDR:
+              case ZEBRA_L3_PORT_ACTIVE_STATE_CHANGE:
+                if_revisit_route_node = true;
+                break;
 
-                  /*
-                   * We should always be able to find a L3 port node, if the
-                   * next-hop is IP/IPv6 address.
-                   */
-                  if (ifname[0])
-                    assert(0);
+              /*
+               * We need to delete the static route configuration
+               * and trigger a kernel cleanup for a route in case
+               * of the following:-
+               * 1. We get a "no routing" trigger on an interface
+               *    and the interface becomes L2
+               * 2. We get an interface delete like
+               *    "no interface <blah>"
+               */
+              case ZEBRA_L3_PORT_L3_CHANGED_TO_L2:
+              case ZEBRA_L3_PORT_DELETE:
 
-                  if (nexthop_str[0])
-                    {
-                      if_revisit_route_node = true;
-                      continue;
-                    }
-                }
-              else
-                {
-                  VLOG_DBG("Found L3 port node %s with action %s",
-                           l3_port->port_name,
-                           zebra_l3_port_cache_actions_str[l3_port->port_action]);
-                }
+                /*
+                 * Add the route in deleted list
+                 */
+                zebra_route_list_add_data(rn, rib, nexthop);
+
+                if (ifname[0])
+                  {
+                    VLOG_DBG("The next-hop port %s found in the "
+                             " deleted L3 port list", ifname);
+
+                    /*
+                     * Delete the static route from OVSDB
+                     */
+                    zebra_delete_route_nexthop_port_from_db(rib,
+                                                           ifname);
+                  }
+
+                if (nexthop_str[0])
+                  {
+                    VLOG_DBG("The next-hop IP %s found in the "
+                             " deleted L3 port list", nexthop_str);
+
+                    /*
+                     * Delete the static route from OVSDB
+                     */
+                    zebra_delete_route_nexthop_addr_from_db(rib,
+                                                         nexthop_str);
+                  }
+                break;
+
+              default:
+                VLOG_ERR("Wrong L3 port action");
+            }
+        }
+    }
+
+  if (if_revisit_route_node)
+    {
+      VLOG_DBG("Adding route node with prefix %s for backend "
+               "processing", prefix_str);
+      rib_queue_add(&zebrad, rn);
+    }
+}
+
+/*
+ * This function adds work for the quagga back-end thread to revisit
+ * a static route in case its resolving next-hop has changed admin
+ * state or the resolving IP/IPv6 address changes or gets deleted.
+ * This function also handles the clean-up of static routes in case
+ * the interface gets converted into L2 or the L3 interface gets
+ * deleted.
+ *
+ * Only the route nodes found through the next-hop index under the
+ * changed L3 ports, or under no port at all, are visited.
+ */
+static void
+zebra_find_routes_with_updated_ports_state (
+                        afi_t afi, safi_t safi, u_int32_t id,
+                        const char* cleanup_reason)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct zebra_l3_port* l3_port = NULL;
+  struct shash_node *port_node;
+  struct list *nodes;
+  struct listnode *rn_node;
+  struct hash *affected;
+
+  table = vrf_table (afi, safi, id);
+  if (!table)
+    {
+      VLOG_ERR("Table not found");
+      return;
+    }
+
+  /*
+   * returning from the function if the hash table
+   * 'zebra_updated_or_changed_l3_ports' is empty.
+   */
+  if (!zebra_get_if_port_updated_or_changed()
+      && !zebra_get_if_port_active_state_changed())
+    {
+      VLOG_DBG("No change in L3 port configuration. No nexthops to delete");
+      return;
+    }
+
+  if (!zebra_nh_deps)
+    {
+      VLOG_DBG("No static route next-hops to revisit");
+      return;
+    }
+
+  VLOG_DBG("Cleaning-up/Populating %s routes in response to %s trigger",
+           (afi == AFI_IP) ? "IPv4" : "IPv6",cleanup_reason);
+
+  /*
+   * Find the route nodes going through the changed L3 ports, and the
+   * ones with forward referenced next-hops which the changes may have
+   * resolved, visiting each of them once.
+   */
+  affected = hash_create(zebra_nh_dep_node_key_make,
+                         zebra_nh_dep_node_key_cmp);
+
+  SHASH_FOR_EACH (port_node, &zebra_cached_l3_ports)
+    {
+      l3_port = (struct zebra_l3_port *)port_node->data;
 
-              switch (l3_port->port_action)
-                {
-                  /*
-                   * In case nothing changed in the L3 port node,
-                   * zebra is in sync with OVSDB and no action needs
-                   * to be taken
-                   */
-                  case ZEBRA_L3_PORT_NO_CHANGE:
-                    break;
+      if (l3_port->port_action != ZEBRA_L3_PORT_NO_CHANGE)
+        zebra_nh_dep_collect(id, afi, l3_port->port_name, table, affected);
+    }
 
-                  /*
-                   * We need to have the backend zebra thread to examine
-                   * the route node in the following cases:-
-                   * 1. A new L3 port node got added
-                   * 2. Some IP address got added on an L3 port
-                   * 3. Some admin or link state change happened on the
-                   *    L3 interface
-                   */
-                  case ZEBRA_L3_PORT_ADD:
-                  case ZEBRA_L3_PORT_UPADTE_IP_ADDR:
-                  case ZEBRA_L3_PORT_ACTIVE_STATE_CHANGE:
-                    if_revisit_route_node = true;
-                    break;
+  zebra_nh_dep_collect(id, afi, "", table, affected);
 
-                  /*
-                   * We need to delete the static route configuration
-                   * and trigger a kernel cleanup for a route in case
-                   * of the following:-
-                   * 1. We get a "no routing" trigger on an interface
-                   *    and the interface becomes L2
-                   * 2. We get an interface delete like
-                   *    "no interface <blah>"
-                   */
-                  case ZEBRA_L3_PORT_L3_CHANGED_TO_L2:
-                  case ZEBRA_L3_PORT_DELETE:
+  nodes = list_new();
+  hash_iterate(affected, zebra_nh_dep_list_add, nodes);
+  hash_free(affected);
 
-                    /*
-                     * Add the route in deleted list
-                     */
-                    zebra_route_list_add_data(rn, rib, nexthop);
-
-                    if (ifname[0])
-                      {
-                        VLOG_DBG("The next-hop port %s found in the "
-                                 " deleted L3 port list", ifname);
-
-                        /*
-                         * Delete the static route from OVSDB
-                         */
-                        zebra_delete_route_nexthop_port_from_db(rib,
-                                                               ifname);
-                      }
-
-                    if (nexthop_str[0])
-                      {
-                        VLOG_DBG("The next-hop IP %s found in the "
-                                 " deleted L3 port list", nexthop_str);
-
-                        /*
-                         * Delete the static route from OVSDB
-                         */
-                        zebra_delete_route_nexthop_addr_from_db(rib,
-                                                             nexthop_str);
-                      }
-                    break;
-
-                  default:
-                    VLOG_ERR("Wrong L3 port action");
-                }
-            }
-        }
+  VLOG_DBG("Revisiting %u route nodes", listcount(nodes));
 
-      if (if_revisit_route_node)
-        {
-          VLOG_DBG("Adding route node with prefix %s for backend "
-                   "processing", prefix_str);
-          rib_queue_add(&zebrad, rn);
-        }
+  for (ALL_LIST_ELEMENTS_RO (nodes, rn_node, rn))
+    {
+      /*
+       * Create a transaction for any IDL route updates to OVSDB from
+       * the zebra main thread.
+       */
+      zebra_create_txn();
 
-        /*
-         * Since there are further routes to process for the
-         * main thread, we should try to see if there are
-         * MAX_ZEBRA_TXN_COUNT route updates to OVSDB at this time.
-         * In this case we should publish the route updates to OVSDB.
-         */
-        zebra_finish_txn(false);
+      zebra_revisit_route_node_for_ports_state(rn, afi);
+      zebra_nh_dep_node_reindex(id, afi, rn);
+      route_unlock_node(rn);
+
+      /*
+       * Since there are further routes to process for the
+       * main thread, we should try to see if there are
+       * MAX_ZEBRA_TXN_COUNT route updates to OVSDB at this time.
+       * In this case we should publish the route updates to OVSDB.
+       */
+      zebra_finish_txn(false);
     }
 
-    /*
-     * Since there are no further routes to process for the
-     * main thread, we should submit all the outstanding
-     * route updates to OVSDB at this time.
-     */
-    zebra_finish_txn(true);
+  list_delete(nodes);
+
+  /*
+   * Since there are no further routes to process for the
+   * main thread, we should submit all the outstanding
+   * route updates to OVSDB at this time.
+   */
+  zebra_finish_txn(true);
 }
 
 /*
@@ -5631,6 +6010,7 @@ zebra_ovsdb_exit (void)
   zebra_vrf = NULL;
   #endif
   log_event("ZEBRA_OVSDB_EXIT",NULL);
+  zebra_selected_discard();
   ovsdb_exit();
 }
 
@@ -5924,169 +6304,279 @@ zebra_ovs_update_selected_route (const struct ovsrec_route *ovs_route,
 }
 
 /*
- * When zebra is ready to update the kernel with the selected route,
- * update the DB with the same information. This function will take care
- * of updating the DB
+ * Selected status publisher. rib_process only records the selected state
+ * each next-hop of a route should end up with, keyed by the UUID of the
+ * route row, and the rows are written later from an event of their own
+ * so that FIB programming does not wait on OVSDB. Flips of the same
+ * next-hop which happen before the flush overwrite each other, and a
+ * flush run writes at most ZEBRA_SELECTED_FLUSH_MAX routes before
+ * yielding to the other events.
  */
+#define ZEBRA_SELECTED_FLUSH_MAX 1000
+
+struct zebra_selected_nh
+{
+  bool is_port;
+  bool selected;
+  char *name;      /* Next-hop port name or IP/IPv6 address */
+};
+
+struct zebra_selected_route
+{
+  struct uuid uuid;
+  struct list *nexthops;
+};
+
+static struct hash *zebra_selected_routes;
+static struct list *zebra_selected_queue;
+static struct thread *zebra_selected_thread;
+
+static unsigned int
+zebra_selected_route_key_make (void *p)
+{
+  const struct zebra_selected_route *sr = p;
+
+  return uuid_hash(&sr->uuid);
+}
+
 static int
-zebra_update_selected_route_to_db (struct route_node *rn, struct rib *route,
-                                   int action)
+zebra_selected_route_key_cmp (const void *arg1, const void *arg2)
 {
-  char prefix_str[256];
-  const struct ovsrec_route *ovs_route = NULL;
-  bool selected = (action == ZEBRA_RT_INSTALL) ? true:false;
-  struct prefix *p = NULL;
-  rib_table_info_t *info = NULL;
+  const struct zebra_selected_route *sr1 = arg1;
+  const struct zebra_selected_route *sr2 = arg2;
+
+  return uuid_equals(&sr1->uuid, &sr2->uuid);
+}
+
+static void
+zebra_selected_nh_free (void *p)
+{
+  struct zebra_selected_nh *snh = p;
+
+  XFREE(MTYPE_TMP, snh->name);
+  XFREE(MTYPE_TMP, snh);
+}
+
+static void *
+zebra_selected_route_alloc (void *p)
+{
+  struct zebra_selected_route *sr;
+
+  sr = XMALLOC(MTYPE_TMP, sizeof(struct zebra_selected_route));
+  sr->uuid = ((struct zebra_selected_route *)p)->uuid;
+  sr->nexthops = list_new();
+  sr->nexthops->del = zebra_selected_nh_free;
+
+  /* Routes are flushed in the order they were first dirtied. */
+  listnode_add(zebra_selected_queue, sr);
+
+  return sr;
+}
+
+static void
+zebra_selected_route_free (struct zebra_selected_route *sr)
+{
+  list_delete(sr->nexthops);
+  XFREE(MTYPE_TMP, sr);
+}
+
+/*
+ * This function takes the OVSDB route row and a pending next-hop state,
+ * looks for the next-hop row matching the port or IP/IPv6 address and
+ * marks its selected bit as true or false.
+ *
+ * If all the next-hops are marked as unselected in the OVSDB, then the
+ * OSVDB route's selected bit is also marked as false. If a next-hop is
+ * marked as selected and this is the first next-hop for the route to be
+ * marked selected, then the route's selected bit is also marked as true.
+ */
+static void
+zebra_publish_selected_nh (const struct ovsrec_route *route_row,
+                           const struct zebra_selected_nh *snh)
+{
+  struct ovsrec_nexthop *nh_row;
+  struct ovsrec_nexthop *cand_nh_row;
+  const char *port_name = snh->is_port ? snh->name : NULL;
+  const char *nh_addr = snh->is_port ? NULL : snh->name;
+  bool is_selected = snh->selected;
+  int next_hop_index;
+  int number_of_selected_nh;
+
+  VLOG_DBG("OVSDB Route Entry: Prefix %s family %s "
+           "from %s priv %p for setting %s to %s", route_row->prefix,
+           route_row->address_family, route_row->from,
+           route_row->protocol_private, snh->name,
+           is_selected ? "true" : "false");
+
+  cand_nh_row = NULL; /* reference to the candidate next-hop row which
+                         matches the port or next-hop address. */
+  number_of_selected_nh = 0; /* counter to keep track of the number of
+                                next-hops whose selected bit is set to
+                                true. */
 
   /*
-   * Fetch the rib entry from the DB and update the selected field based
-   * on action:
-   * action == ZEBRA_RT_INSTALL => selected = 1
-   * action == ZEBRA_RT_UNINSTALL => selected = 0
-   *
-   * If the 'route' has a valid 'ovsdb_route_row_uuid_ptr' pointer,
-   * then look-up the 'ovsrec_route' structure directly from
-   * 'ovsdb_route_row_uuid_ptr' pointer. Otherwise iterate through the
-   * OVSDB route to find out the relevant 'ovsrec_route' structure.
+   * Walk all next-hops to find which next-hop needs to
+   * selected or unselected in OVSDB.
    */
-  if (route->ovsdb_route_row_uuid_ptr)
+  for (next_hop_index = 0; next_hop_index < route_row->n_nexthops;
+       ++next_hop_index)
     {
-      ovs_route = ovsrec_route_get_for_uuid(idl,
-                     (const struct uuid*)route->ovsdb_route_row_uuid_ptr);
+      nh_row = route_row->nexthops[next_hop_index];
 
-      if (!ovs_route) {
-        VLOG_DBG("Route not found using UUID");
-        return 0;
-      }
+      /*
+       * Check if the port_name matches the next-hop port.
+       */
+      if (port_name && nh_row->ports && nh_row->ports[0]
+          && nh_row->ports[0]->name)
+        {
+          if (strcmp(nh_row->ports[0]->name, port_name) == 0)
+            {
+              VLOG_DBG("Found a match with the nh port %s",
+                        nh_row->ports[0]->name);
+              cand_nh_row = nh_row;
+            }
+        }
 
-      #ifdef VRF_ENABLE
-      if (!(zebra_is_route_in_my_vrf(ovs_route)))
-        return 0;
-      #endif
+      /*
+       * Check if the nh_addr matches the next-hop IP/IPv6 address.
+       */
+      if (nh_addr && nh_row->ip_address)
+        {
+          if (strcmp(nh_row->ip_address, nh_addr) == 0)
+            {
+              VLOG_DBG("Found a match with the nh address %s",
+                        nh_row->ip_address);
+              cand_nh_row = nh_row;
+            }
+        }
 
-      VLOG_DBG("Cached OVSDB Route Entry: Prefix %s family %s "
-               "from %s priv %p for setting selected to %s", ovs_route->prefix,
-               ovs_route->address_family, ovs_route->from,
-               ovs_route->protocol_private,
-               selected ? "true" : "false");
+      /*
+       * If the selected field for the next-hop is set to true
+       * increment the counter number_of_selected_nh.
+       */
+      if (((!cand_nh_row) || (cand_nh_row != nh_row)) &&
+          ((nh_row->selected) && (nh_row->selected[0] == true)))
+        {
+          ++number_of_selected_nh;
+        }
     }
-  else
+
+  if (!cand_nh_row)
+    {
+      VLOG_DBG("Cannot update the selected flag for the next-hop");
+      return;
+    }
+
+  /*
+   * Update the selected bit if it is not set yet or if it differs
+   * from is_selected.
+   */
+  if (!(cand_nh_row->selected) || (cand_nh_row->selected[0] != is_selected))
     {
-      p = &rn->p;
-      info = rib_table_info(rn->table);
-      memset(prefix_str, 0, sizeof(prefix_str));
-      prefix2str(p, prefix_str, sizeof(prefix_str));
+      VLOG_DBG("Changing the next-hop selected flag from %s to %s",
+               (cand_nh_row->selected && cand_nh_row->selected[0]) ?
+               "true" : "false", is_selected ? "true" : "false");
+      log_event("ZEBRA_NEXTHOP_STATE_CHANGE", EV_KV("nexthop_port", "%s",
+                cand_nh_row->ip_address), EV_KV("old_state", "%s",
+                (cand_nh_row->selected && cand_nh_row->selected[0]) ?
+                "true" : "false"),
+                EV_KV("new_state","%s", is_selected ? "true" : "false"));
+      ovsrec_nexthop_set_selected(cand_nh_row, &is_selected, 1);
+      zebra_txn_updates = true;
+    }
 
-      VLOG_DBG("Prefix %s Family %d\n",prefix_str, PREFIX_FAMILY(p));
+  /*
+   * If this is the first selected next-hop, mark the route as selected.
+   * If no other next-hop is selected and this one is not either, then
+   * mark the route as unselected.
+   */
+  if (!number_of_selected_nh)
+    {
+      VLOG_DBG("The route has %s active next-hops. %s the selected bit "
+               "on the route.", is_selected ? "at least one" : "no",
+               is_selected ? "Set" : "Unset");
+      zebra_ovs_update_selected_route(route_row, &is_selected);
+    }
+}
 
-      switch (PREFIX_FAMILY (p))
-        {
-	case AF_INET:
+/*
+ * Event which writes the pending selected states into OVSDB. The route
+ * rows are only ever looked up by their UUID; a route whose row has been
+ * deleted in the meantime is simply dropped.
+ */
+static int
+zebra_selected_flush (struct thread *thread)
+{
+  struct zebra_selected_route *sr;
+  struct zebra_selected_nh *snh;
+  const struct ovsrec_route *route_row;
+  struct listnode *node;
+  int count = 0;
 
-	  VLOG_DBG("Walk the OVSDB route DB to find the relevant row for"
-		   " prefix %s\n", prefix_str);
+  zebra_selected_thread = NULL;
 
-	  OVSREC_ROUTE_FOR_EACH (ovs_route, idl)
-	    {
-              #ifdef VRF_ENABLE
-              if (!(zebra_is_route_in_my_vrf(ovs_route)))
-                continue;
-              #endif
+  while (count < ZEBRA_SELECTED_FLUSH_MAX
+         && (node = listhead(zebra_selected_queue)) != NULL)
+    {
+      sr = listgetdata(node);
+      list_delete_node(zebra_selected_queue, node);
+      hash_release(zebra_selected_routes, sr);
+      count++;
 
-	      VLOG_DBG("DB Entry: Prefix %s family %s from %s",
-		       ovs_route->prefix, ovs_route->address_family,
-		       ovs_route->from);
+      route_row = ovsrec_route_get_for_uuid(idl, &sr->uuid);
+      if (!route_row)
+        {
+          VLOG_DBG("Route "UUID_FMT" not found, dropping its selected state",
+                   UUID_ARGS(&sr->uuid));
+          zebra_selected_route_free(sr);
+          continue;
+        }
 
-	      if (!strcmp(ovs_route->address_family,
-			  OVSREC_ROUTE_ADDRESS_FAMILY_IPV4))
-		{
-		  if (!strcmp(ovs_route->prefix, prefix_str))
-		    {
-		      if (route->type ==
-			  ovsdb_proto_to_zebra_proto(ovs_route->from))
-			{
-			  if (info->safi ==
-			      ovsdb_safi_to_zebra_safi(
-					ovs_route->sub_address_family))
-			    break;
-			}
-		    }
-		}
-	    }
-	  break;
-#ifdef HAVE_IPV6
-	case AF_INET6:
+      #ifdef VRF_ENABLE
+      if (!(zebra_is_route_in_my_vrf(route_row)))
+        {
+          zebra_selected_route_free(sr);
+          continue;
+        }
+      #endif
 
-          VLOG_DBG("Walk the OVSDB route DB to find the relevant row for"
-		   " prefix %s\n", prefix_str);
+      zebra_create_txn();
 
-          OVSREC_ROUTE_FOR_EACH (ovs_route, idl)
-	    {
-              #ifdef VRF_ENABLE
-              if (!(zebra_is_route_in_my_vrf(ovs_route)))
-                continue;
-              #endif
+      for (ALL_LIST_ELEMENTS_RO(sr->nexthops, node, snh))
+        zebra_publish_selected_nh(route_row, snh);
 
-	      VLOG_DBG("DB Entry: Prefix %s family %s from %s",
-		       ovs_route->prefix, ovs_route->address_family,
-		       ovs_route->from);
+      zebra_selected_route_free(sr);
 
-	      if (!strcmp(ovs_route->address_family,
-				  OVSREC_ROUTE_ADDRESS_FAMILY_IPV6))
-		{
-		  if (!strcmp(ovs_route->prefix, prefix_str))
-		    {
-		      if (route->type ==
-			      ovsdb_proto_to_zebra_proto(ovs_route->from))
-			{
-			  if (info->safi ==
-			      ovsdb_safi_to_zebra_safi(
-					ovs_route->sub_address_family))
-			    break;
-			}
-		    }
-		}
-	    }
-          break;
-#endif
-          default:
-          /* Unsupported protocol family! */
-          VLOG_ERR("Unsupported protocol in route update");
-          return 0;
-	}
+      /*
+       * Commit the transaction if the number of route updates in the
+       * transaction exceed a given number
+       */
+      zebra_finish_txn(false);
     }
 
-  if (ovs_route)
-    {
-        VLOG_DBG("Updating the selected flag for the non-private routes. "
-                 "Setting selected %s for prefix %s",
-                 selected ? "true":"false", ovs_route->prefix);
-        zebra_ovs_update_selected_route(ovs_route, &selected);
-    }
+  zebra_finish_txn(true);
+
+  if (listcount(zebra_selected_queue))
+    zebra_selected_thread = thread_add_event(zebrad.master,
+                                             zebra_selected_flush, NULL, 0);
   return 0;
 }
 
 /*
  * This function takes a zebra rn, zebra rib entry, the next-hop
- * port or IP/IPv6 address and the selected bit. The function then
- * looks for the corresponding next-hop row for the port or next-hop
- * IP/IPv6 addresses  in the OVSDB and marks the selected bit for
- * OVSDB next-hop row as true or false depending on the selected value.
- *
- * If all the next-hops are marked as unselected in the OVSDB, then the
- * OSVDB route's selected bit is also marked as false. If a next-hop is
- * marked as selected and this is the first next-hop for the route to be
- * marked selected, then the route's selected bit is also marked as true.
+ * port or IP/IPv6 address and the selected bit, and records that the
+ * selected bit of the corresponding OVSDB next-hop row should be set
+ * to true or false. The OVSDB rows are updated later from
+ * zebra_selected_flush().
  */
 void zebra_update_selected_nh (struct route_node *rn, struct rib *route,
                                char* port_name, char* nh_addr, int selected)
 {
-  struct ovsrec_route *route_row = NULL;
-  struct ovsrec_nexthop *nh_row;
-  struct ovsrec_nexthop *cand_nh_row;
-  int next_hop_index;
-  bool is_selected = (ZEBRA_NH_INSTALL == selected) ? true : false;
-  int number_of_selected_nh = 0;
+  struct zebra_selected_route key;
+  struct zebra_selected_route *sr;
+  struct zebra_selected_nh *snh;
+  struct listnode *node;
+  const char *name;
 
   /*
    * If the zebra route node rib entry are NULL and both of port_name
@@ -6098,165 +6588,80 @@ void zebra_update_selected_nh (struct route_node *rn, struct rib *route,
       return;
     }
 
-  if (route->ovsdb_route_row_uuid_ptr)
+  /*
+   * Only routes coming from OVSDB have a row whose selected bit can be
+   * updated.
+   */
+  if (!route->ovsdb_route_row_uuid_ptr)
     {
-      route_row = (struct ovsrec_route *)ovsrec_route_get_for_uuid(idl,
-                     (const struct uuid*)route->ovsdb_route_row_uuid_ptr);
+      VLOG_DBG("Cannot update the selected flag for the next-hop");
+      return;
+    }
 
-      if (!route_row) {
-        VLOG_DBG("Route not found using UUID");
-        return;
-      }
+  if (!zebra_selected_routes)
+    {
+      zebra_selected_routes = hash_create(zebra_selected_route_key_make,
+                                          zebra_selected_route_key_cmp);
+      zebra_selected_queue = list_new();
+    }
 
-      #ifdef VRF_ENABLE
-      if (!(zebra_is_route_in_my_vrf(route_row)))
-        return;
-      #endif
-      VLOG_DBG("Cached OVSDB Route Entry: Prefix %s family %s "
-               "from %s priv %p for setting %s to %s", route_row->prefix,
-               route_row->address_family, route_row->from,
-               route_row->protocol_private, port_name ? port_name : nh_addr,
-               is_selected ? "true" : "false");
+  memcpy(&key.uuid, route->ovsdb_route_row_uuid_ptr, sizeof(struct uuid));
+  sr = hash_get(zebra_selected_routes, &key, zebra_selected_route_alloc);
 
+  name = port_name ? port_name : nh_addr;
+  for (ALL_LIST_ELEMENTS_RO(sr->nexthops, node, snh))
+    if (snh->is_port == (port_name != NULL) && !strcmp(snh->name, name))
+      break;
 
-      cand_nh_row = NULL; /* reference to the candidate next-hop row which
-                             matches the port or next-hop address. */
-      number_of_selected_nh = 0; /* counter to keep track of the number of
-                                    next-hops whose selected bit is set to
-                                    true. */
+  if (!snh)
+    {
+      snh = XMALLOC(MTYPE_TMP, sizeof(struct zebra_selected_nh));
+      snh->is_port = (port_name != NULL);
+      snh->name = XSTRDUP(MTYPE_TMP, name);
+      listnode_add(sr->nexthops, snh);
+    }
 
-      /*
-       * Walk all next-hops to find which next-hop needs to
-       * selected or unselected in OVSDB.
-       */
-      for (next_hop_index = 0; next_hop_index < route_row->n_nexthops;
-           ++next_hop_index)
-        {
-          nh_row = route_row->nexthops[next_hop_index];
+  /* The last state recorded before the flush wins. */
+  snh->selected = (ZEBRA_NH_INSTALL == selected) ? true : false;
 
-          /*
-           * Check if the port_name matches the next-hop port.
-           */
-          if (port_name && nh_row->ports && nh_row->ports[0]
-              && nh_row->ports[0]->name)
-            {
-              if (strcmp(nh_row->ports[0]->name, port_name) == 0)
-                {
-                  VLOG_DBG("Found a match with the nh port %s",
-                            nh_row->ports[0]->name);
-                  cand_nh_row = nh_row;
-                }
-            }
+  if (!zebra_selected_thread)
+    zebra_selected_thread = thread_add_event(zebrad.master,
+                                             zebra_selected_flush, NULL, 0);
+}
 
-          /*
-           * Check if the nh_addr matches the next-hop IP/IPv6 address.
-           */
-          if (nh_addr && nh_row->ip_address)
-            {
-              if (strcmp(nh_row->ip_address, nh_addr) == 0)
-                {
-                  VLOG_DBG("Found a match with the nh address %s",
-                            nh_row->ip_address);
-                  cand_nh_row = nh_row;
-                }
-            }
+/*
+ * Drop the selected states which have not been written yet.
+ */
+static void
+zebra_selected_discard (void)
+{
+  struct zebra_selected_route *sr;
+  struct listnode *node;
 
-          /*
-           * If the selected field for the next-hop is set to true
-           * increment the counter number_of_selected_nh.
-           */
-          if (((!cand_nh_row) || (cand_nh_row != nh_row)) &&
-              ((nh_row->selected) && (nh_row->selected[0] == true)))
-            {
-              ++number_of_selected_nh;
-            }
-        }
+  THREAD_OFF(zebra_selected_thread);
 
-      if (cand_nh_row)
-        {
-          if (!(cand_nh_row->selected))
-            {
-              /*
-               * If the selected pointer is null, update the selected
-               * with the is_selected boolean.
-               */
-              VLOG_DBG("Changing the next-hop selected flag from %s to %s",
-                       !cand_nh_row->selected ? "true" : "false",
-                       is_selected ? "true" : "false");
-              log_event("ZEBRA_NEXTHOP_STATE_CHANGE", EV_KV("nexthop_port", "%s",
-                        cand_nh_row->ip_address), EV_KV("old_state", "%s",
-                        !cand_nh_row->selected ? "true" : "false"),
-                        EV_KV("new_state","%s", is_selected ? "true" : "false"));
-              ovsrec_nexthop_set_selected(cand_nh_row, &is_selected, 1);
-              zebra_txn_updates = true;
-            }
-          else
-            {
-              /*
-               * If the selected pointer is not null, update the selected
-               * with the is_selected boolean if the selected value and the
-               * is_selected values are different.
-               */
-              if (cand_nh_row->selected[0] != is_selected)
-                {
-                  VLOG_DBG("Changing the next-hop selected flag from %s to %s",
-                           cand_nh_row->selected[0] ? "true" : "false",
-                           is_selected ? "true" : "false");
-                  log_event("ZEBRA_NEXTHOP_STATE_CHANGE", EV_KV("nexthop_port", "%s",
-                            cand_nh_row->ip_address), EV_KV("old_state", "%s",
-                            cand_nh_row->selected[0] ? "true" : "false"),
-                            EV_KV("new_state","%s", is_selected ? "true" : "false"));
-                  ovsrec_nexthop_set_selected(cand_nh_row, &is_selected, 1);
-                  zebra_txn_updates = true;
-                }
-            }
+  if (!zebra_selected_routes)
+    return;
 
-          if (is_selected)
-            {
-              /*
-               * If at least one next-hop is selected, then mark the
-               * route as selected. if 'number_of_selected_nh' is zero,
-               * we have at least one next-hop that is selected.
-               */
-              if (!number_of_selected_nh)
-                {
-                  VLOG_DBG("The route has at least one active next-hop. "
-                           "Set the selected bit on the route.");
-                  zebra_update_selected_route_to_db(rn, route,
-                                                    ZEBRA_RT_INSTALL);
-                }
-            }
-          else
-            {
-              /*
-               * If no next-hop is selected, then mark the route as
-               * unselected. If 'number_of_selected_nh' is one, then
-               * we should mark the route as unselected as no next-hops
-               * that are selected.
-               */
-              if (!number_of_selected_nh)
-                {
-                  VLOG_DBG("The route has no active next-hops. "
-                           "Unset the selected bit on the route.");
-                  zebra_update_selected_route_to_db(rn, route,
-                                                    ZEBRA_RT_UNINSTALL);
-                }
-            }
-        }
-    }
-  else
+  while ((node = listhead(zebra_selected_queue)) != NULL)
     {
-      VLOG_DBG("Cannot update the selected flag for the next-hop");
+      sr = listgetdata(node);
+      list_delete_node(zebra_selected_queue, node);
+      zebra_selected_route_free(sr);
     }
+
+  list_delete(zebra_selected_queue);
+  hash_free(zebra_selected_routes);
+  zebra_selected_queue = NULL;
+  zebra_selected_routes = NULL;
 }
 
 /*
  * This function sets the selected flag on the route and next-hops
- * based on the 'action' variable. The OVSDB route entry is references
- * from the 'rib' data structure from zebra. This function should not
- * be called in cases when there are route entry deletions in the
- * OVSDB route table. The OVSDB route table entry is garbage collected
- * and hence the related pointer should not be referenced.
+ * based on the 'action' variable. The OVSDB route entry is referenced
+ * by the UUID cached in the 'rib' data structure from zebra, and the
+ * update is only queued here. If the route row has been deleted by the
+ * time the queue is flushed, the update is dropped.
  */
 void
 zebra_update_selected_route_nexthops_to_db (struct route_node *rn,
@@ -89,6 +89,21 @@ struct zebra_route_del_data
   struct nexthop *nexthop;
 };
 
+/*
+ * Entry of the reverse index from the L3 ports to the route nodes having
+ * static routes through them. A next-hop goes through the port it names,
+ * or the port whose subnet holds the next-hop address. An empty port name
+ * collects the next-hops no port resolves yet.
+ */
+struct zebra_nh_dep
+{
+  u_int32_t vrf_id;
+  afi_t afi;
+  char port[IF_NAMESIZE+1];
+  struct hash *nodes;                    /* Route nodes having static routes
+                                            through this port, locked */
+};
+
 /*
  * Type of port actions. The action done on the port is stored in the
  * cached L3 port node.
@@ -183,5 +198,9 @@ zebra_ovs_update_selected_route (const struct ovsrec_route *ovs_route,
 void cleanup_kernel_routes_after_restart();
 extern int zebra_create_txn (void);
 extern int zebra_finish_txn (bool);
+extern void zebra_nh_dep_add (u_int32_t, afi_t, safi_t, struct prefix *,
+                              void *, const char *);
+extern void zebra_nh_dep_del (u_int32_t, afi_t, safi_t, struct prefix *,
+                              void *, const char *);
 
 #endif /* ZEBRA_OVSDB_IF_H */
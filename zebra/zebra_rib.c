@@ -1965,7 +1965,10 @@ rib_process (struct route_node *rn)
           redistribute_delete (&rn->p, select);
           if (! RIB_SYSTEM_ROUTE (select))
             {
-              rib_uninstall_kernel (rn, select);
+              /* A route installed with a kernel nexthop group is
+                 replaced in place by rib_install_kernel below. */
+              if (! select->kernel_nhg)
+                rib_uninstall_kernel (rn, select);
 #ifdef ENABLE_OVSDB
               if (!CHECK_FLAG (select->status, RIB_ENTRY_REMOVED))
                 zebra_update_selected_route_nexthops_to_db(rn, select,
@@ -2159,15 +2162,18 @@ process_subq (struct list * subq, u_char qindex)
   return 1;
 }
 
-/* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
- * is pointed to the meta queue structure.
+/* Dispatch the meta queue by picking, processing and unlocking RNs from the
+ * non-empty sub-queue with lowest priority, until the meta queue is empty or
+ * the time slot of this work queue run is used up. wq is equal to zebra->ribq
+ * and data is pointed to the meta queue structure.
  */
 static wq_item_status
-meta_queue_process (struct work_queue *dummy, void *data)
+meta_queue_process (struct work_queue *wq, void *data)
 {
   struct meta_queue * mq = data;
   unsigned i;
+  unsigned int count = 0;
+  int yielded = 0;
 
 #ifdef ENABLE_OVSDB
   /*
@@ -2178,12 +2184,26 @@ meta_queue_process (struct work_queue *dummy, void *data)
   zebra_create_txn();
 #endif
 
-  for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
+  while (mq->size)
+    {
+      for (i = 0; i < MQ_SIZE; i++)
+        if (process_subq (mq->subq[i], i))
+          {
+            mq->size--;
+            count++;
+            break;
+          }
+      if (i == MQ_SIZE)
+        break;
+
+      if (mq->size && work_queue_should_yield (wq))
+        {
+          yielded = 1;
+          break;
+        }
+    }
+
+  work_queue_batch_done (wq, count, yielded);
 
 #ifdef ENABLE_OVSDB
   if (!(mq->size))
@@ -2199,24 +2219,13 @@ meta_queue_process (struct work_queue *dummy, void *data)
           cleanup_kernel_routes_after_restart();
           zebra_cleanup_kernel_after_restart = false;
         }
-
-      /*
-       * Since there are no further routes to process for this
-       * worker thread, we should submit all the outstanding
-       * route updates to OVSDB at this time.
-       */
-      zebra_finish_txn(true);
-    }
-  else
-    {
-      /*
-       * Since there are further routes to process for this
-       * worker thread, we should try to see if there are i
-       * MAX_ZEBRA_TXN_COUNT route updates to OVSDB at this time.
-       * In this case we should publish the route updates to OVSDB.
-       */
-      zebra_finish_txn(false);
     }
+
+  /*
+   * Submit the route updates of this batch to OVSDB, the worker
+   * thread yields to the other threads until the next batch.
+   */
+  zebra_finish_txn(true);
 #endif
 
   return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
@@ -3287,6 +3296,7 @@ static_add_ipv4_safi (safi_t safi, struct prefix *p, struct in_addr *gate,
   /* Install into rib. */
 #ifdef ENABLE_OVSDB
   static_install_ipv4 (safi, p, si, ovsrec_route_ptr);
+  zebra_nh_dep_add (vrf_id, AFI_IP, safi, p, gate, ifname);
 #else
   static_install_ipv4 (safi, p, si);
 #endif
@@ -3355,6 +3365,10 @@ static_delete_ipv4_safi (safi_t safi, struct prefix *p, struct in_addr *gate,
 
   route_unlock_node (rn);
 
+#ifdef ENABLE_OVSDB
+  zebra_nh_dep_del (vrf_id, AFI_IP, safi, p, gate, ifname);
+#endif
+
   return 1;
 }
 
@@ -3887,6 +3901,7 @@ static_add_ipv6 (struct prefix *p, u_char type, struct in6_addr *gate,
   /* Install into rib. */
 #ifdef ENABLE_OVSDB
   static_install_ipv6 (p, si, ovsrec_route_ptr);
+  zebra_nh_dep_add (vrf_id, AFI_IP6, SAFI_UNICAST, p, gate, ifname);
 #else
   static_install_ipv6 (p, si);
 #endif
@@ -3944,6 +3959,10 @@ static_delete_ipv6 (struct prefix *p, u_char type, struct in6_addr *gate,
     XFREE (0, si->ifname);
   XFREE (MTYPE_STATIC_IPV6, si);
 
+#ifdef ENABLE_OVSDB
+  zebra_nh_dep_del (vrf_id, AFI_IP6, SAFI_UNICAST, p, gate, ifname);
+#endif
+
   return 1;
 }
 #endif /* HAVE_IPV6 */